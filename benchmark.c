@@ -0,0 +1,172 @@
+/* benchmark.c: unthrottled batch execution with speed reporting
+   Copyright (c) 2026 Fuse contributors
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+#include <config.h>
+
+#include <stdio.h>
+
+#include <libspectrum.h>
+
+#include "benchmark.h"
+#include "fuse.h"
+#include "infrastructure/startup_manager.h"
+#include "machine.h"
+#include "screenshot.h"
+#include "settings.h"
+#include "snapshot.h"
+#include "spectrum.h"
+#include "timer/timer.h"
+
+int benchmark_active = 0;
+
+/* Wall clock time when the run started */
+static double start_time;
+
+/* Emulated frames so far */
+static libspectrum_dword frames;
+
+/* T-states taken off the processor's counter at the end of each frame so
+   far, and its value when the run started. The T-states emulated by the
+   end of the run are the sum of the frame lengths plus however far the
+   processor has got into the current frame, less where it started */
+static libspectrum_qword frame_tstates;
+static libspectrum_dword start_tstates;
+
+typedef struct benchmark_hook_t {
+  const int *enabled;
+  benchmark_fn start;
+  benchmark_fn finish;
+} benchmark_hook_t;
+
+/* The microbenchmarks registered by each subsystem */
+static GArray *hooks;
+
+void
+benchmark_register( const int *enabled, benchmark_fn start,
+                    benchmark_fn finish )
+{
+  benchmark_hook_t hook;
+
+  if( !hooks ) hooks = g_array_new( FALSE, FALSE, sizeof( hook ) );
+
+  hook.enabled = enabled;
+  hook.start = start;
+  hook.finish = finish;
+
+  g_array_append_val( hooks, hook );
+}
+
+static void
+benchmark_end( void )
+{
+  if( hooks ) {
+    g_array_free( hooks, TRUE );
+    hooks = NULL;
+  }
+}
+
+void
+benchmark_register_startup( void )
+{
+  startup_manager_register_no_dependencies( STARTUP_MANAGER_MODULE_BENCHMARK,
+                                            NULL, NULL, benchmark_end );
+}
+
+/* Start a benchmark run if one was requested on the command line */
+int
+benchmark_start( void )
+{
+  guint i;
+
+  if( settings_current.benchmark <= 0 ) return 0;
+
+  start_time = timer_get_time(); if( start_time < 0 ) return 1;
+
+  frames = 0;
+  frame_tstates = 0;
+  start_tstates = tstates;
+
+  for( i = 0; hooks && i < hooks->len; i++ ) {
+    benchmark_hook_t *hook = &g_array_index( hooks, benchmark_hook_t, i );
+    if( *hook->enabled && hook->start ) hook->start();
+  }
+
+  benchmark_active = 1;
+
+  return 0;
+}
+
+/* Called at the end of every emulated frame, once frame_length T-states
+   have been taken off the processor's counter */
+void
+benchmark_frame( libspectrum_dword frame_length )
+{
+  if( !benchmark_active ) return;
+
+  frame_tstates += frame_length;
+
+  if( ++frames >= settings_current.benchmark ) fuse_exiting = 1;
+}
+
+/* Write out the final state and report the speed of the run */
+int
+benchmark_finish( void )
+{
+  libspectrum_qword emulated;
+  double elapsed;
+  int error = 0;
+  guint i;
+
+  if( !benchmark_active ) return 0;
+
+  benchmark_active = 0;
+
+  elapsed = timer_get_time() - start_time;
+  if( elapsed <= 0 ) elapsed = 1e-6;
+
+  /* Worked out here rather than per frame so that a run ended part way
+     through a frame by the debugger is counted up to where it stopped */
+  emulated = frame_tstates + tstates - start_tstates;
+
+  if( settings_current.benchmark_screen )
+    error = screenshot_scr_write( settings_current.benchmark_screen ) || error;
+
+  if( settings_current.benchmark_snapshot )
+    error = snapshot_write( settings_current.benchmark_snapshot ) || error;
+
+  printf( "%s: benchmark: %lu frames in %.3f s\n", fuse_progname,
+          (unsigned long)frames, elapsed );
+  printf( "%s: benchmark: %.1f frames/s (%.1f%% of real time)\n",
+          fuse_progname, frames / elapsed,
+          100.0 * emulated / machine_current->timings.processor_speed /
+          elapsed );
+  printf( "%s: benchmark: %.0f T-states (%.3f MHz)\n", fuse_progname,
+          (double)emulated, emulated / elapsed / 1e6 );
+
+  for( i = 0; hooks && i < hooks->len; i++ ) {
+    benchmark_hook_t *hook = &g_array_index( hooks, benchmark_hook_t, i );
+    if( *hook->enabled ) hook->finish();
+  }
+
+  return error;
+}
@@ -0,0 +1,47 @@
+/* benchmark.h: unthrottled batch execution with speed reporting
+   Copyright (c) 2026 Fuse contributors
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+#ifndef FUSE_BENCHMARK_H
+#define FUSE_BENCHMARK_H
+
+#include <libspectrum.h>
+
+/* Is benchmark mode active? If so, the timer doesn't throttle emulation
+   and no sound is produced */
+extern int benchmark_active;
+
+/* A subsystem's microbenchmark: start is called when the run starts and
+   may be NULL; finish is called once the run is over. Both are called only
+   if the setting pointed to by enabled is non-zero */
+typedef void (*benchmark_fn)( void );
+
+void benchmark_register( const int *enabled, benchmark_fn start,
+                         benchmark_fn finish );
+
+void benchmark_register_startup( void );
+
+int benchmark_start( void );
+void benchmark_frame( libspectrum_dword frame_length );
+int benchmark_finish( void );
+
+#endif			/* #ifndef FUSE_BENCHMARK_H */
@@ -27,6 +27,8 @@
 #include <config.h>
 
 #include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <libspectrum.h>
@@ -35,6 +37,8 @@
 #include "event.h"
 #include "fuse.h"
 #include "memory_pages.h"
+#include "mempool.h"
+#include "timer/timer.h"
 #include "ui/ui.h"
 #include "utils.h"
 
@@ -44,6 +48,42 @@ GSList *debugger_breakpoints;
 /* The next breakpoint ID to use */
 static size_t next_breakpoint_id;
 
+/* Lookup structures for the address and port breakpoints, rebuilt
+   whenever the list of breakpoints changes. These let debugger_check()
+   reject almost every address or port without walking the list */
+
+/* Indexed by breakpoint type: one bit per address, set if any execute,
+   read or write breakpoint could match that address */
+static libspectrum_byte address_map[ DEBUGGER_BREAKPOINT_TYPE_WRITE + 1 ]
+                                   [ 0x10000 / 8 ];
+
+/* The address breakpoints of each type, sorted by their offset within
+   a 16K page and then by ID */
+static GArray *address_index[ DEBUGGER_BREAKPOINT_TYPE_WRITE + 1 ];
+
+/* One bucket for each distinct mask used by the port read and port
+   write breakpoints, with a bit set for each masked port value which is
+   being looked for */
+typedef struct port_bucket_t {
+  libspectrum_word mask;
+  libspectrum_byte map[ 0x10000 / 8 ];
+} port_bucket_t;
+
+static GArray *port_buckets[ 2 ];
+
+/* The port breakpoints of each type, in ID order */
+static GArray *port_index[ 2 ];
+
+/* Non-zero while debugger_check() is using the index; any changes made
+   by breakpoint commands are applied once it has finished */
+static int index_busy;
+static int index_stale;
+
+#define MAP_TEST( map, value ) \
+  ( (map)[ (value) >> 3 ] & ( 1 << ( (value) & 7 ) ) )
+#define MAP_SET( map, value ) \
+  ( (map)[ (value) >> 3 ] |= 1 << ( (value) & 7 ) )
+
 /* Textual representations of the breakpoint types and lifetimes */
 const char *debugger_breakpoint_type_text[] = {
   "Execute", "Read", "Write", "Port Read", "Port Write", "Time", "Event",
@@ -78,6 +118,7 @@ static gint find_breakpoint_by_address( gconstpointer data,
 					gconstpointer user_data );
 static void free_breakpoint( gpointer data, gpointer user_data );
 static void add_time_event( gpointer data, gpointer user_data );
+static void index_update( void );
 
 /* Add a breakpoint */
 int
@@ -205,13 +246,16 @@ breakpoint_add( debugger_breakpoint_type type, debugger_breakpoint_value value,
       libspectrum_free( bp );
       return 1;
     }
+    bp->program = debugger_expression_compile( bp->condition );
   } else {
     bp->condition = NULL;
+    bp->program = NULL;
   }
 
   bp->commands = NULL;
 
   debugger_breakpoints = g_slist_append( debugger_breakpoints, bp );
+  index_update();
 
   if( debugger_mode == DEBUGGER_MODE_INACTIVE )
     debugger_mode = DEBUGGER_MODE_ACTIVE;
@@ -226,6 +270,202 @@ breakpoint_add( debugger_breakpoint_type type, debugger_breakpoint_value value,
   return 0;
 }
 
+static int
+key_compare( const void *a, const void *b )
+{
+  const debugger_breakpoint *bp1 = *(debugger_breakpoint* const*)a;
+  const debugger_breakpoint *bp2 = *(debugger_breakpoint* const*)b;
+  int key1 = bp1->value.address.offset & 0x3fff;
+  int key2 = bp2->value.address.offset & 0x3fff;
+
+  if( key1 != key2 ) return key1 - key2;
+  return bp1->id < bp2->id ? -1 : bp1->id > bp2->id;
+}
+
+static void
+index_add_port( debugger_breakpoint *bp )
+{
+  int index = bp->type - DEBUGGER_BREAKPOINT_TYPE_PORT_READ;
+  libspectrum_word mask = bp->value.port.mask;
+  port_bucket_t *bucket = NULL;
+  size_t i;
+
+  g_array_append_val( port_index[ index ], bp );
+
+  for( i = 0; i < port_buckets[ index ]->len; i++ ) {
+    bucket = &g_array_index( port_buckets[ index ], port_bucket_t, i );
+    if( bucket->mask == mask ) break;
+  }
+
+  if( i == port_buckets[ index ]->len ) {
+    g_array_set_size( port_buckets[ index ], i + 1 );
+    bucket = &g_array_index( port_buckets[ index ], port_bucket_t, i );
+    memset( bucket, 0, sizeof( *bucket ) );
+    bucket->mask = mask;
+  }
+
+  MAP_SET( bucket->map, bp->value.port.port & mask );
+}
+
+/* Rebuild the lookup structures from the list of breakpoints */
+static void
+index_update( void )
+{
+  GSList *ptr;
+  debugger_breakpoint *bp;
+  libspectrum_word offset;
+  int i, alias;
+
+  if( index_busy ) { index_stale = 1; return; }
+  index_stale = 0;
+
+  memset( address_map, 0, sizeof( address_map ) );
+
+  for( i = 0; i <= DEBUGGER_BREAKPOINT_TYPE_WRITE; i++ ) {
+    if( !address_index[i] )
+      address_index[i] = g_array_new( FALSE, FALSE,
+                                      sizeof( debugger_breakpoint* ) );
+    g_array_set_size( address_index[i], 0 );
+  }
+
+  for( i = 0; i < 2; i++ ) {
+    if( !port_index[i] ) {
+      port_index[i] = g_array_new( FALSE, FALSE,
+                                   sizeof( debugger_breakpoint* ) );
+      port_buckets[i] = g_array_new( FALSE, FALSE, sizeof( port_bucket_t ) );
+    }
+    g_array_set_size( port_index[i], 0 );
+    g_array_set_size( port_buckets[i], 0 );
+  }
+
+  for( ptr = debugger_breakpoints; ptr; ptr = ptr->next ) {
+    bp = ptr->data;
+
+    switch( bp->type ) {
+
+    case DEBUGGER_BREAKPOINT_TYPE_EXECUTE:
+    case DEBUGGER_BREAKPOINT_TYPE_READ:
+    case DEBUGGER_BREAKPOINT_TYPE_WRITE:
+      g_array_append_val( address_index[ bp->type ], bp );
+
+      /* A page-specific breakpoint could match wherever its page is
+         mapped in */
+      offset = bp->value.address.offset;
+      if( bp->value.address.source == memory_source_any ) {
+        MAP_SET( address_map[ bp->type ], offset );
+      } else {
+        for( alias = 0; alias < 4; alias++ )
+          MAP_SET( address_map[ bp->type ],
+                   ( alias << 14 ) | ( offset & 0x3fff ) );
+      }
+      break;
+
+    case DEBUGGER_BREAKPOINT_TYPE_PORT_READ:
+    case DEBUGGER_BREAKPOINT_TYPE_PORT_WRITE:
+      index_add_port( bp );
+      break;
+
+    case DEBUGGER_BREAKPOINT_TYPE_TIME:
+    case DEBUGGER_BREAKPOINT_TYPE_EVENT:
+      /* Not indexed */
+      break;
+    }
+  }
+
+  for( i = 0; i <= DEBUGGER_BREAKPOINT_TYPE_WRITE; i++ )
+    qsort( address_index[i]->data, address_index[i]->len,
+           sizeof( debugger_breakpoint* ), key_compare );
+}
+
+/* Check a single breakpoint, stopping emulation if it triggers. Returns
+   non-zero if the breakpoint was removed */
+static int
+check_candidate( debugger_breakpoint *bp, debugger_breakpoint_type type,
+                 libspectrum_dword value )
+{
+  GSList *ptr;
+
+  /* A breakpoint command may have removed this breakpoint */
+  if( index_stale ) {
+    for( ptr = debugger_breakpoints; ptr && ptr->data != bp; ptr = ptr->next )
+      ;
+    if( !ptr ) return 0;
+  }
+
+  if( !breakpoint_check( bp, type, value ) ) return 0;
+
+  debugger_mode = DEBUGGER_MODE_HALTED;
+  debugger_command_evaluate( bp->commands );
+
+  if( bp->life != DEBUGGER_BREAKPOINT_LIFE_ONESHOT ) return 0;
+
+  debugger_breakpoints = g_slist_remove( debugger_breakpoints, bp );
+  free_breakpoint( bp, NULL );
+  index_update();
+
+  return 1;
+}
+
+static int
+check_address( debugger_breakpoint_type type, libspectrum_word address )
+{
+  GArray *index = address_index[ type ];
+  debugger_breakpoint **candidates;
+  size_t low, high, middle, end;
+  int key = address & 0x3fff, removed = 0;
+
+  if( !MAP_TEST( address_map[ type ], address ) ) return 0;
+
+  /* Find the range of breakpoints for this offset */
+  candidates = (debugger_breakpoint**)index->data;
+  low = 0; high = index->len;
+  while( low < high ) {
+    middle = ( low + high ) / 2;
+    if( ( candidates[ middle ]->value.address.offset & 0x3fff ) < key ) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  for( end = low;
+       end < index->len &&
+         ( candidates[ end ]->value.address.offset & 0x3fff ) == key;
+       end++ )
+    ;
+
+  /* The index isn't changed until we're done, so the candidates stay
+     put even if a breakpoint command adds or removes breakpoints */
+  for( ; low < end; low++ )
+    removed |= check_candidate( candidates[ low ], type, address );
+
+  return removed;
+}
+
+static int
+check_port( debugger_breakpoint_type type, libspectrum_word port )
+{
+  int index = type - DEBUGGER_BREAKPOINT_TYPE_PORT_READ;
+  port_bucket_t *bucket;
+  debugger_breakpoint **candidates;
+  size_t i;
+  int removed = 0;
+
+  if( !port_buckets[ index ] ) return 0;
+
+  for( i = 0; i < port_buckets[ index ]->len; i++ ) {
+    bucket = &g_array_index( port_buckets[ index ], port_bucket_t, i );
+    if( MAP_TEST( bucket->map, port & bucket->mask ) ) break;
+  }
+  if( i == port_buckets[ index ]->len ) return 0;
+
+  candidates = (debugger_breakpoint**)port_index[ index ]->data;
+  for( i = 0; i < port_index[ index ]->len; i++ )
+    removed |= check_candidate( candidates[i], type, port );
+
+  return removed;
+}
+
 /* Check whether the debugger should become active at this point */
 int
 debugger_check( debugger_breakpoint_type type, libspectrum_dword value )
@@ -240,23 +480,35 @@ debugger_check( debugger_breakpoint_type type, libspectrum_dword value )
   case DEBUGGER_MODE_INACTIVE: return 0;
 
   case DEBUGGER_MODE_ACTIVE:
-    for( ptr = debugger_breakpoints; ptr; ptr = ptr_next ) {
+    index_busy = 1;
+
+    switch( type ) {
+
+    case DEBUGGER_BREAKPOINT_TYPE_EXECUTE:
+    case DEBUGGER_BREAKPOINT_TYPE_READ:
+    case DEBUGGER_BREAKPOINT_TYPE_WRITE:
+      signal_breakpoints_updated = check_address( type, value );
+      break;
 
-      bp = ptr->data;
-      ptr_next = ptr->next;
+    case DEBUGGER_BREAKPOINT_TYPE_PORT_READ:
+    case DEBUGGER_BREAKPOINT_TYPE_PORT_WRITE:
+      signal_breakpoints_updated = check_port( type, value );
+      break;
 
-      if( breakpoint_check( bp, type, value ) ) {
-        debugger_mode = DEBUGGER_MODE_HALTED;
-        debugger_command_evaluate( bp->commands );
+    default:
+      for( ptr = debugger_breakpoints; ptr; ptr = ptr_next ) {
 
-        if( bp->life == DEBUGGER_BREAKPOINT_LIFE_ONESHOT ) {
-          debugger_breakpoints = g_slist_remove( debugger_breakpoints, bp );
-          libspectrum_free( bp );
-          signal_breakpoints_updated = 1;
-        }
+        bp = ptr->data;
+        ptr_next = ptr->next;
+
+        signal_breakpoints_updated |= check_candidate( bp, type, value );
       }
+      break;
 
     }
+
+    index_busy = 0;
+    if( index_stale ) index_update();
     break;
 
   case DEBUGGER_MODE_HALTED: return 1;
@@ -318,7 +570,7 @@ debugger_breakpoint_trigger( debugger_breakpoint *bp )
   if( bp->type == DEBUGGER_BREAKPOINT_TYPE_TIME )
     bp->value.time.triggered = 1;
 
-  if( bp->condition && !debugger_expression_evaluate( bp->condition ) )
+  if( bp->program && !debugger_program_run( bp->program ) )
     return 0;
 
   return 1;
@@ -400,7 +652,8 @@ debugger_breakpoint_remove( size_t id )
     event_foreach( remove_time, &remove );
   }
 
-  libspectrum_free( bp );
+  free_breakpoint( bp, NULL );
+  index_update();
 
   ui_breakpoints_updated();
 
@@ -474,6 +727,8 @@ debugger_breakpoint_clear( libspectrum_word address )
     free_breakpoint( ptr_data, NULL );
   }
 
+  if( found ) index_update();
+
   if( !found ) {
     if( debugger_output_base == 10 ) {
       ui_error( UI_ERROR_ERROR, "No breakpoint at %d", address );
@@ -517,6 +772,8 @@ debugger_breakpoint_remove_all( void )
   /* Restart the breakpoint numbering */
   next_breakpoint_id = 1;
 
+  index_update();
+
   ui_breakpoints_updated();
 
   return 0;
@@ -544,6 +801,7 @@ free_breakpoint( gpointer data, gpointer user_data GCC_UNUSED )
   }
 
   if( bp->condition ) debugger_expression_delete( bp->condition );
+  if( bp->program ) debugger_program_free( bp->program );
   if( bp->commands ) libspectrum_free( bp->commands );
 
   libspectrum_free( bp );
@@ -571,10 +829,13 @@ debugger_breakpoint_set_condition( size_t id, debugger_expression *condition )
   bp = get_breakpoint_by_id( id ); if( !bp ) return 1;
 
   if( bp->condition ) debugger_expression_delete( bp->condition );
+  if( bp->program ) debugger_program_free( bp->program );
+  bp->program = NULL;
 
   if( condition ) {
     bp->condition = debugger_expression_copy( condition );
     if( !bp->condition ) return 1;
+    bp->program = debugger_expression_compile( bp->condition );
   } else {
     bp->condition = NULL;
   }
@@ -621,3 +882,240 @@ debugger_breakpoint_time_fn( libspectrum_dword tstates, int type GCC_UNUSED,
 {
   debugger_check( DEBUGGER_BREAKPOINT_TYPE_TIME, 0 );
 }
+
+/* Put the user's breakpoints to one side while the benchmark or unit
+   tests use their own */
+
+static GSList *saved_breakpoints;
+static size_t saved_breakpoint_id;
+static enum debugger_mode_t saved_mode;
+
+static void
+breakpoints_save( void )
+{
+  saved_breakpoints = debugger_breakpoints;
+  saved_breakpoint_id = next_breakpoint_id;
+  saved_mode = debugger_mode;
+
+  debugger_breakpoints = NULL;
+  next_breakpoint_id = 1;
+  debugger_mode = DEBUGGER_MODE_INACTIVE;
+  index_update();
+}
+
+static void
+breakpoints_restore( void )
+{
+  debugger_breakpoint_remove_all();
+
+  debugger_breakpoints = saved_breakpoints;
+  next_breakpoint_id = saved_breakpoint_id;
+  debugger_mode = saved_mode;
+  index_update();
+
+  ui_breakpoints_updated();
+}
+
+/* Time debugger_check() for a pseudo-random mix of execute, read and
+   write accesses with 0, 10 and 1000 breakpoints set */
+void
+debugger_breakpoint_benchmark( void )
+{
+  static const size_t counts[] = { 0, 10, 1000 };
+  const libspectrum_dword checks = 4000000;
+  debugger_expression *condition, *a;
+  double start, elapsed, base = 0;
+  libspectrum_dword i, seed, hits;
+  debugger_breakpoint_type type;
+  size_t count, n;
+
+  breakpoints_save();
+
+  /* Never true as A is only 8 bits, so every breakpoint has to be
+     checked in full but none of them will stop emulation */
+  a = debugger_expression_new_system_variable( "z80", "a",
+                                               debugger_memory_pool );
+  condition = debugger_expression_new_binaryop(
+    '>', a ? a : debugger_expression_new_number( 0, debugger_memory_pool ),
+    debugger_expression_new_number( 0xff, debugger_memory_pool ),
+    debugger_memory_pool
+  );
+
+  for( count = 0, n = 0; n < ARRAY_SIZE( counts ); n++ ) {
+
+    for( ; count < counts[n]; count++ )
+      debugger_breakpoint_add_address( count % 3, memory_source_any, 0,
+                                       ( count * 40503 ) & 0xffff, 0,
+                                       DEBUGGER_BREAKPOINT_LIFE_PERMANENT,
+                                       condition );
+
+    seed = 1; hits = 0;
+    start = timer_get_time();
+
+    for( i = 0; i < checks; i++ ) {
+      seed = seed * 1103515245 + 12345;
+      type = i % 3;
+      if( debugger_mode != DEBUGGER_MODE_INACTIVE )
+        hits += debugger_check( type, ( seed >> 16 ) & 0xffff );
+    }
+
+    elapsed = timer_get_time() - start;
+    if( n == 0 ) base = elapsed;
+
+    printf( "%s: debugger benchmark: %4lu breakpoints: %.2f ns/check",
+            fuse_progname, (unsigned long)count, elapsed / checks * 1e9 );
+    if( n ) printf( " (%.1f times no breakpoints)", elapsed / base );
+    printf( "\n" );
+
+    if( hits ) {
+      printf( "%s: debugger benchmark: breakpoint unexpectedly triggered\n",
+              fuse_progname );
+      break;
+    }
+  }
+
+  mempool_free( debugger_memory_pool );
+
+  breakpoints_restore();
+}
+
+static int
+unittest_expression( debugger_expression *exp )
+{
+  debugger_program *program = debugger_expression_compile( exp );
+  libspectrum_dword expected, actual;
+  char buffer[ 80 ];
+
+  expected = debugger_expression_evaluate( exp );
+  actual = debugger_program_run( program );
+  debugger_program_free( program );
+
+  if( actual != expected ) {
+    debugger_expression_deparse( buffer, sizeof( buffer ), exp );
+    printf( "%s: breakpoint test: `%s' compiled to %u, expected %u\n",
+            fuse_progname, buffer, actual, expected );
+    return 1;
+  }
+
+  return 0;
+}
+
+static int
+unittest_check( debugger_breakpoint_type type, libspectrum_word value,
+                int expected )
+{
+  int actual = debugger_check( type, value );
+
+  if( debugger_mode == DEBUGGER_MODE_HALTED )
+    debugger_mode = DEBUGGER_MODE_ACTIVE;
+
+  if( actual != expected ) {
+    printf( "%s: breakpoint test: %s at 0x%04x %s, expected %s\n",
+            fuse_progname, debugger_breakpoint_type_text[ type ], value,
+            actual ? "triggered" : "did not trigger",
+            expected ? "triggered" : "did not trigger" );
+    return 1;
+  }
+
+  return 0;
+}
+
+int
+debugger_breakpoint_unittest( void )
+{
+  const int pool = debugger_memory_pool;
+  debugger_expression *n0, *n2, *n3, *n7, *exp;
+  memory_page *page;
+  int r = 0, aliased;
+
+  n0 = debugger_expression_new_number( 0, pool );
+  n2 = debugger_expression_new_number( 2, pool );
+  n3 = debugger_expression_new_number( 3, pool );
+  n7 = debugger_expression_new_number( 7, pool );
+
+  /* ( 2 + 3 * 7 == 23 ) && !0 */
+  exp = debugger_expression_new_binaryop(
+    DEBUGGER_TOKEN_LOGICAL_AND,
+    debugger_expression_new_binaryop(
+      DEBUGGER_TOKEN_EQUAL_TO,
+      debugger_expression_new_binaryop(
+        '+', n2, debugger_expression_new_binaryop( '*', n3, n7, pool ), pool
+      ),
+      debugger_expression_new_number( 23, pool ), pool
+    ),
+    debugger_expression_new_unaryop( '!', n0, pool ), pool
+  );
+  r += unittest_expression( exp );
+
+  /* 0 || 2 - 7, which must give a truth value */
+  r += unittest_expression( debugger_expression_new_binaryop(
+    DEBUGGER_TOKEN_LOGICAL_OR, n0,
+    debugger_expression_new_binaryop( '-', n2, n7, pool ), pool
+  ) );
+
+  /* 0 && 7, 7 || 0 and ~0 / 3 ^ -7 | 2 < 3 */
+  r += unittest_expression( debugger_expression_new_binaryop(
+    DEBUGGER_TOKEN_LOGICAL_AND, n0, n7, pool
+  ) );
+  r += unittest_expression( debugger_expression_new_binaryop(
+    DEBUGGER_TOKEN_LOGICAL_OR, n7, n0, pool
+  ) );
+  r += unittest_expression( debugger_expression_new_binaryop(
+    '|',
+    debugger_expression_new_binaryop(
+      '^',
+      debugger_expression_new_binaryop(
+        '/', debugger_expression_new_unaryop( '~', n0, pool ), n3, pool
+      ),
+      debugger_expression_new_unaryop( '-', n7, pool ), pool
+    ),
+    debugger_expression_new_binaryop( '<', n2, n3, pool ), pool
+  ) );
+
+  breakpoints_save();
+
+  /* An absolute execute breakpoint, a read breakpoint on whichever page
+   is at 0x4000, a port breakpoint and a one-shot breakpoint whose
+   condition is true */
+  page = &memory_map_read[ 0x4000 >> MEMORY_PAGE_SIZE_LOGARITHM ];
+  debugger_breakpoint_add_address( DEBUGGER_BREAKPOINT_TYPE_EXECUTE,
+                                   memory_source_any, 0, 0x1234, 0,
+                                   DEBUGGER_BREAKPOINT_LIFE_PERMANENT, NULL );
+  debugger_breakpoint_add_address( DEBUGGER_BREAKPOINT_TYPE_READ,
+                                   page->source, page->page_num, 0x0010, 0,
+                                   DEBUGGER_BREAKPOINT_LIFE_PERMANENT, NULL );
+  debugger_breakpoint_add_port( DEBUGGER_BREAKPOINT_TYPE_PORT_WRITE, 0x00fe,
+                                0x00ff, 0, DEBUGGER_BREAKPOINT_LIFE_PERMANENT,
+                                NULL );
+  debugger_breakpoint_add_address( DEBUGGER_BREAKPOINT_TYPE_WRITE,
+                                   memory_source_any, 0, 0x5678, 0,
+                                   DEBUGGER_BREAKPOINT_LIFE_ONESHOT, exp );
+
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_EXECUTE, 0x1234, 1 );
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_EXECUTE, 0x1235, 0 );
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_READ, 0x1234, 0 );
+
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_READ, 0x4010, 1 );
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_WRITE, 0x4010, 0 );
+
+  /* Only matches at 0xc010 if the same page is also mapped there */
+  aliased =
+    memory_map_read[ 0xc000 >> MEMORY_PAGE_SIZE_LOGARITHM ].source ==
+      page->source &&
+    memory_map_read[ 0xc000 >> MEMORY_PAGE_SIZE_LOGARITHM ].page_num ==
+      page->page_num;
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_READ, 0xc010, aliased );
+
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_PORT_WRITE, 0x12fe, 1 );
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_PORT_WRITE, 0x12fd, 0 );
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_PORT_READ, 0x12fe, 0 );
+
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_WRITE, 0x5678, 1 );
+  r += unittest_check( DEBUGGER_BREAKPOINT_TYPE_WRITE, 0x5678, 0 );
+
+  mempool_free( pool );
+
+  breakpoints_restore();
+
+  return r;
+}
@@ -94,6 +94,7 @@ typedef union debugger_breakpoint_value {
 } debugger_breakpoint_value;
 
 typedef struct debugger_expression debugger_expression;
+typedef struct debugger_program debugger_program;
 
 /* The breakpoint structure */
 typedef struct debugger_breakpoint {
@@ -106,6 +107,7 @@ typedef struct debugger_breakpoint {
   debugger_breakpoint_life life;
   debugger_expression *condition; /* Conditional expression to activate this
 				     breakpoint */
+  debugger_program *program;	/* 'condition', compiled */
 
   char *commands;
 
@@ -23,6 +23,7 @@
 
 #include <config.h>
 
+#include "benchmark.h"
 #include "debugger.h"
 #include "debugger_internals.h"
 #include "event.h"
@@ -31,6 +32,7 @@
 #include "memory_pages.h"
 #include "mempool.h"
 #include "periph.h"
+#include "settings.h"
 #include "ui/ui.h"
 #include "z80/z80.h"
 #include "z80/z80_macros.h"
@@ -65,6 +67,9 @@ debugger_init( void *context )
   debugger_variable_init();
   debugger_reset();
 
+  benchmark_register( &settings_current.benchmark_debugger, NULL,
+                      debugger_breakpoint_benchmark );
+
   return 0;
 }
 
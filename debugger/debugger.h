@@ -94,7 +94,11 @@ void debugger_system_variable_register(
   debugger_get_system_variable_fn_t get,
   debugger_set_system_variable_fn_t set );
 
+/* Time breakpoint checking at the end of a benchmark run */
+void debugger_breakpoint_benchmark( void );
+
 /* Unit tests */
+int debugger_breakpoint_unittest( void );
 int debugger_disassemble_unittest( void );
 
 #endif				/* #ifndef FUSE_DEBUGGER_H */
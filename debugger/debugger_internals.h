@@ -93,6 +93,10 @@ void debugger_expression_delete( debugger_expression* expression );
 libspectrum_dword
 debugger_expression_evaluate( debugger_expression* expression );
 
+debugger_program* debugger_expression_compile( const debugger_expression *exp );
+void debugger_program_free( debugger_program *program );
+libspectrum_dword debugger_program_run( const debugger_program *program );
+
 /* Event handling */
 
 void debugger_event_init( void );
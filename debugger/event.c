@@ -92,8 +92,6 @@ debugger_event( int event_code )
   debugger_breakpoint *bp;
   GSList *ptr, *ptr_next;
 
-  int signal_breakpoints_updated = 0;
-
   if( event_code >= registered_events->len ) {
     ui_error( UI_ERROR_ERROR, "internal error: invalid debugger event %d",
 	      event_code );
@@ -114,16 +112,12 @@ debugger_event( int event_code )
       debugger_mode = DEBUGGER_MODE_HALTED;
       debugger_command_evaluate( bp->commands );
 
-      if( bp->life == DEBUGGER_BREAKPOINT_LIFE_ONESHOT ) {
-        debugger_breakpoints = g_slist_remove( debugger_breakpoints, bp );
-        libspectrum_free( bp );
-        signal_breakpoints_updated = 1;
-      }
+      /* Removing the breakpoint frees its event, condition and commands
+         and tells the UI */
+      if( bp->life == DEBUGGER_BREAKPOINT_LIFE_ONESHOT )
+        debugger_breakpoint_remove( bp->id );
     }
   }
-
-  if( signal_breakpoints_updated )
-      ui_breakpoints_updated();
 }
 
 /* Tidy-up function called at end of emulation */
@@ -426,6 +426,294 @@ evaluate_binaryop( struct binaryop_type *binary )
   fuse_abort();
 }
 
+/* Breakpoint conditions are evaluated every time their breakpoint is
+   hit, so they are flattened into a postfix program for a small stack
+   machine rather than walking the tree each time */
+
+typedef enum program_opcode {
+
+  PROGRAM_NUMBER,		/* Push 'value' */
+  PROGRAM_SYSVAR,		/* Push system variable 'value' */
+  PROGRAM_VARIABLE,		/* Push user variable 'name' */
+
+  PROGRAM_NOT,
+  PROGRAM_COMPLEMENT,
+  PROGRAM_NEGATE,
+  PROGRAM_DEREFERENCE,
+
+  PROGRAM_ADD,
+  PROGRAM_SUBTRACT,
+  PROGRAM_MULTIPLY,
+  PROGRAM_DIVIDE,
+  PROGRAM_EQUAL_TO,
+  PROGRAM_NOT_EQUAL_TO,
+  PROGRAM_LESS_THAN,
+  PROGRAM_GREATER_THAN,
+  PROGRAM_LESS_THAN_OR_EQUAL_TO,
+  PROGRAM_GREATER_THAN_OR_EQUAL_TO,
+  PROGRAM_BITWISE_AND,
+  PROGRAM_BITWISE_XOR,
+  PROGRAM_BITWISE_OR,
+
+  /* Short-circuit evaluation for && and ||: if the top of the stack is
+     false (true), replace it with 0 (1) and continue at instruction
+     'value'; otherwise pop it */
+  PROGRAM_JUMP_IF_FALSE,
+  PROGRAM_JUMP_IF_TRUE,
+
+  PROGRAM_BOOLEAN,		/* Replace the top of the stack with its truth
+				   value */
+
+} program_opcode;
+
+typedef struct program_instruction {
+
+  program_opcode opcode;
+  libspectrum_dword value;
+  const char *name;
+
+} program_instruction;
+
+struct debugger_program {
+
+  program_instruction *code;
+  size_t length;
+
+  /* Enough stack for the deepest point of the program */
+  libspectrum_dword *stack;
+
+};
+
+static size_t
+program_size( const debugger_expression *exp, size_t *depth )
+{
+  size_t size1, size2, depth1, depth2;
+
+  switch( exp->type ) {
+
+  case DEBUGGER_EXPRESSION_TYPE_INTEGER:
+  case DEBUGGER_EXPRESSION_TYPE_SYSVAR:
+  case DEBUGGER_EXPRESSION_TYPE_VARIABLE:
+    *depth = 1;
+    return 1;
+
+  case DEBUGGER_EXPRESSION_TYPE_UNARYOP:
+    return program_size( exp->types.unaryop.op, depth ) + 1;
+
+  case DEBUGGER_EXPRESSION_TYPE_BINARYOP:
+    size1 = program_size( exp->types.binaryop.op1, &depth1 );
+    size2 = program_size( exp->types.binaryop.op2, &depth2 );
+    *depth = depth1 > depth2 + 1 ? depth1 : depth2 + 1;
+    /* The logical operators need both a jump and a final truth value */
+    return size1 + size2 + 2;
+
+  }
+
+  ui_error( UI_ERROR_ERROR, "unknown expression type %d", exp->type );
+  fuse_abort();
+}
+
+static void
+program_emit( debugger_program *program, program_opcode opcode,
+              libspectrum_dword value, const char *name )
+{
+  program_instruction *instruction = &program->code[ program->length++ ];
+
+  instruction->opcode = opcode;
+  instruction->value = value;
+  instruction->name = name;
+}
+
+static program_opcode
+unaryop_opcode( int operation )
+{
+  switch( operation ) {
+
+  case '!': return PROGRAM_NOT;
+  case '~': return PROGRAM_COMPLEMENT;
+  case '-': return PROGRAM_NEGATE;
+  case DEBUGGER_TOKEN_DEREFERENCE: return PROGRAM_DEREFERENCE;
+
+  }
+
+  ui_error( UI_ERROR_ERROR, "unknown unary operator %d", operation );
+  fuse_abort();
+}
+
+static program_opcode
+binaryop_opcode( int operation )
+{
+  switch( operation ) {
+
+  case '+': return PROGRAM_ADD;
+  case '-': return PROGRAM_SUBTRACT;
+  case '*': return PROGRAM_MULTIPLY;
+  case '/': return PROGRAM_DIVIDE;
+  case DEBUGGER_TOKEN_EQUAL_TO: return PROGRAM_EQUAL_TO;
+  case DEBUGGER_TOKEN_NOT_EQUAL_TO: return PROGRAM_NOT_EQUAL_TO;
+  case '<': return PROGRAM_LESS_THAN;
+  case '>': return PROGRAM_GREATER_THAN;
+  case DEBUGGER_TOKEN_LESS_THAN_OR_EQUAL_TO:
+    return PROGRAM_LESS_THAN_OR_EQUAL_TO;
+  case DEBUGGER_TOKEN_GREATER_THAN_OR_EQUAL_TO:
+    return PROGRAM_GREATER_THAN_OR_EQUAL_TO;
+  case '&': return PROGRAM_BITWISE_AND;
+  case '^': return PROGRAM_BITWISE_XOR;
+  case '|': return PROGRAM_BITWISE_OR;
+
+  }
+
+  ui_error( UI_ERROR_ERROR, "unknown binary operator %d", operation );
+  fuse_abort();
+}
+
+static void
+program_compile( debugger_program *program, const debugger_expression *exp )
+{
+  const struct binaryop_type *binary;
+  size_t jump;
+
+  switch( exp->type ) {
+
+  case DEBUGGER_EXPRESSION_TYPE_INTEGER:
+    program_emit( program, PROGRAM_NUMBER, exp->types.integer, NULL );
+    return;
+
+  case DEBUGGER_EXPRESSION_TYPE_SYSVAR:
+    program_emit( program, PROGRAM_SYSVAR, exp->types.system_variable, NULL );
+    return;
+
+  case DEBUGGER_EXPRESSION_TYPE_VARIABLE:
+    program_emit( program, PROGRAM_VARIABLE, 0, exp->types.variable );
+    return;
+
+  case DEBUGGER_EXPRESSION_TYPE_UNARYOP:
+    program_compile( program, exp->types.unaryop.op );
+    program_emit( program, unaryop_opcode( exp->types.unaryop.operation ), 0,
+                  NULL );
+    return;
+
+  case DEBUGGER_EXPRESSION_TYPE_BINARYOP:
+    binary = &exp->types.binaryop;
+    program_compile( program, binary->op1 );
+
+    if( binary->operation == DEBUGGER_TOKEN_LOGICAL_AND ||
+        binary->operation == DEBUGGER_TOKEN_LOGICAL_OR ) {
+      jump = program->length;
+      program_emit( program,
+                    binary->operation == DEBUGGER_TOKEN_LOGICAL_AND ?
+                      PROGRAM_JUMP_IF_FALSE : PROGRAM_JUMP_IF_TRUE,
+                    0, NULL );
+      program_compile( program, binary->op2 );
+      program_emit( program, PROGRAM_BOOLEAN, 0, NULL );
+      program->code[ jump ].value = program->length;
+    } else {
+      program_compile( program, binary->op2 );
+      program_emit( program, binaryop_opcode( binary->operation ), 0, NULL );
+    }
+    return;
+
+  }
+
+  ui_error( UI_ERROR_ERROR, "unknown expression type %d", exp->type );
+  fuse_abort();
+}
+
+/* Compile 'exp' for debugger_program_run(). The program refers to the
+   names of any variables in 'exp', so must not outlive it */
+debugger_program*
+debugger_expression_compile( const debugger_expression *exp )
+{
+  debugger_program *program;
+  size_t size, depth;
+
+  size = program_size( exp, &depth );
+
+  program = libspectrum_new( debugger_program, 1 );
+  program->code = libspectrum_new( program_instruction, size );
+  program->stack = libspectrum_new( libspectrum_dword, depth );
+  program->length = 0;
+
+  program_compile( program, exp );
+
+  return program;
+}
+
+void
+debugger_program_free( debugger_program *program )
+{
+  libspectrum_free( program->code );
+  libspectrum_free( program->stack );
+  libspectrum_free( program );
+}
+
+/* Gives the same result as debugger_expression_evaluate() on the
+   expression 'program' was compiled from */
+libspectrum_dword
+debugger_program_run( const debugger_program *program )
+{
+  const program_instruction *pc = program->code;
+  const program_instruction *end = program->code + program->length;
+  libspectrum_dword *sp = program->stack - 1;
+
+  while( pc < end ) {
+
+    switch( pc->opcode ) {
+
+    case PROGRAM_NUMBER: *++sp = pc->value; break;
+    case PROGRAM_SYSVAR: *++sp = debugger_system_variable_get( pc->value );
+      break;
+    case PROGRAM_VARIABLE: *++sp = debugger_variable_get( pc->name ); break;
+
+    case PROGRAM_NOT: *sp = !*sp; break;
+    case PROGRAM_COMPLEMENT: *sp = ~*sp; break;
+    case PROGRAM_NEGATE: *sp = -*sp; break;
+    case PROGRAM_DEREFERENCE: *sp = readbyte_internal( *sp ); break;
+
+    case PROGRAM_ADD: sp--; *sp = sp[0] + sp[1]; break;
+    case PROGRAM_SUBTRACT: sp--; *sp = sp[0] - sp[1]; break;
+    case PROGRAM_MULTIPLY: sp--; *sp = sp[0] * sp[1]; break;
+
+    case PROGRAM_DIVIDE:
+      sp--;
+      if( sp[1] == 0 ) {
+        ui_error( UI_ERROR_ERROR, "divide by 0" );
+        *sp = 0;
+      } else {
+        *sp = sp[0] / sp[1];
+      }
+      break;
+
+    case PROGRAM_EQUAL_TO: sp--; *sp = sp[0] == sp[1]; break;
+    case PROGRAM_NOT_EQUAL_TO: sp--; *sp = sp[0] != sp[1]; break;
+    case PROGRAM_LESS_THAN: sp--; *sp = sp[0] < sp[1]; break;
+    case PROGRAM_GREATER_THAN: sp--; *sp = sp[0] > sp[1]; break;
+    case PROGRAM_LESS_THAN_OR_EQUAL_TO: sp--; *sp = sp[0] <= sp[1]; break;
+    case PROGRAM_GREATER_THAN_OR_EQUAL_TO: sp--; *sp = sp[0] >= sp[1]; break;
+    case PROGRAM_BITWISE_AND: sp--; *sp = sp[0] & sp[1]; break;
+    case PROGRAM_BITWISE_XOR: sp--; *sp = sp[0] ^ sp[1]; break;
+    case PROGRAM_BITWISE_OR: sp--; *sp = sp[0] | sp[1]; break;
+
+    case PROGRAM_JUMP_IF_FALSE:
+      if( !*sp ) { pc = program->code + pc->value; continue; }
+      sp--;
+      break;
+
+    case PROGRAM_JUMP_IF_TRUE:
+      if( *sp ) { *sp = 1; pc = program->code + pc->value; continue; }
+      sp--;
+      break;
+
+    case PROGRAM_BOOLEAN: *sp = !!*sp; break;
+
+    }
+
+    pc++;
+  }
+
+  return *sp;
+}
+
 int
 debugger_expression_deparse( char *buffer, size_t length,
 			     const debugger_expression *exp )
@@ -29,6 +29,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "benchmark.h"
 #include "display.h"
 #include "fuse.h"
 #include "infrastructure/startup_manager.h"
@@ -92,6 +93,15 @@ static libspectrum_qword display_is_dirty[ DISPLAY_SCREEN_HEIGHT ];
    corresponds to pixels 0-7, bit 31 to pixels 248-255. */
 static libspectrum_dword display_maybe_dirty[ DISPLAY_HEIGHT ];
 
+/* Which eight-pixel chunks on each line were written after the beam had
+   passed them, and so must be looked at again next frame */
+static libspectrum_dword display_next_dirty[ DISPLAY_HEIGHT ];
+
+/* Writes to the screen since the critical region was last copied, when the
+   raster renderer is in use */
+display_write_t display_write_log[ DISPLAY_WRITE_LOG_SIZE ];
+size_t display_write_log_count = 0;
+
 /* This value signifies that the entire line must be redisplayed */
 static libspectrum_qword display_all_dirty;
 
@@ -122,6 +132,14 @@ static void display_dirty64( libspectrum_word address );
 static void display_get_attr( int x, int y,
 			      libspectrum_byte *ink, libspectrum_byte *paper);
 
+/* Consecutive chunks waiting to be sent to the UI in one go */
+static struct {
+  int x, y, count, hires;
+  libspectrum_byte data[ 2 * DISPLAY_SCREEN_WIDTH_COLS ];
+  libspectrum_byte ink[ DISPLAY_SCREEN_WIDTH_COLS ];
+  libspectrum_byte paper[ DISPLAY_SCREEN_WIDTH_COLS ];
+} display_run;
+
 static int border_changes_last = 0;
 static struct border_change_t *border_changes = NULL;
 
@@ -199,6 +217,9 @@ display_init( int *argc, char ***argv )
   display_last_border = scld_last_dec.name.hires ?
                             display_hires_border : display_lores_border;
 
+  benchmark_register( &settings_current.benchmark_rectangles,
+                      rectangle_trace_start, rectangle_benchmark );
+
   return 0;
 }
 
@@ -352,6 +373,51 @@ update_dirty_rects( void )
   rectangle_end_line( DISPLAY_SCREEN_HEIGHT );
 }
 
+/* Send any pending run of chunks to the UI */
+static void
+display_run_flush( void )
+{
+  if( !display_run.count ) return;
+
+  if( display_run.hires ) {
+    uidisplay_plot16_run( display_run.x, display_run.y, display_run.count,
+                          display_run.data, display_run.ink,
+                          display_run.paper );
+  } else {
+    uidisplay_plot8_run( display_run.x, display_run.y, display_run.count,
+                         display_run.data, display_run.ink,
+                         display_run.paper );
+  }
+
+  display_run.count = 0;
+}
+
+/* Queue the chunk at ( x, y ) for plotting, extending the current run if
+   possible. `data' is 8 pixels, or 16 in hi-res mode */
+static void
+display_run_add( int x, int y, int hires, libspectrum_word data,
+                 libspectrum_byte ink, libspectrum_byte paper )
+{
+  if( display_run.count &&
+      ( y != display_run.y || x != display_run.x + display_run.count ||
+        hires != display_run.hires ) )
+    display_run_flush();
+
+  if( !display_run.count ) {
+    display_run.x = x; display_run.y = y; display_run.hires = hires;
+  }
+
+  if( hires ) {
+    display_run.data[ 2 * display_run.count     ] = data >> 8;
+    display_run.data[ 2 * display_run.count + 1 ] = data & 0xff;
+  } else {
+    display_run.data[ display_run.count ] = data;
+  }
+  display_run.ink[ display_run.count ] = ink;
+  display_run.paper[ display_run.count ] = paper;
+  display_run.count++;
+}
+
 void
 display_write_if_dirty_timex( int x, int y )
 {
@@ -407,9 +473,9 @@ display_write_if_dirty_timex( int x, int y )
     display_get_attr( x, y, &ink, &paper );
     if( scld_last_dec.name.hires ) {
       libspectrum_word hires_data = (data << 8) + data2;
-      uidisplay_plot16( beam_x, beam_y, hires_data, ink, paper );
+      display_run_add( beam_x, beam_y, 1, hires_data, ink, paper );
     } else {
-      uidisplay_plot8( beam_x, beam_y, data, ink, paper );
+      display_run_add( beam_x, beam_y, 0, data, ink, paper );
     }
 
     /* Update last display record */
@@ -501,24 +567,18 @@ display_write_if_dirty_pentagon_16_col( int x, int y )
   }
 }
 
-void
-display_write_if_dirty_sinclair( int x, int y )
+/* Draw the chunk at ( x, y ) from the given pixel and attribute bytes, if
+   that's different to what was there last time */
+static void
+display_write_chunk_sinclair( int x, int y, libspectrum_byte data,
+                              libspectrum_byte data2 )
 {
   int beam_x, beam_y;
   int index;
-  libspectrum_word offset;
-  libspectrum_byte *screen;
-  libspectrum_byte data, data2;
   libspectrum_dword last_chunk_detail;
 
   beam_x = x + DISPLAY_BORDER_WIDTH_COLS;
   beam_y = y + DISPLAY_BORDER_HEIGHT;
-  offset = display_get_addr( x, y );
-
-  /* Read byte, atrr/byte, and screen mode */
-  screen = RAM[ memory_current_screen ];
-  data = screen[ offset ];
-  data2 = display_get_attr_byte( x, y );
 
   last_chunk_detail = (display_flash_reversed << 24) | (data2 << 8) | data;
   /* And draw it if it is different to what was there last time */
@@ -526,7 +586,7 @@ display_write_if_dirty_sinclair( int x, int y )
   if( display_last_screen[ index ] != last_chunk_detail ) {
     libspectrum_byte ink, paper;
     display_parse_attr( data2, &ink, &paper );
-    uidisplay_plot8( beam_x, beam_y, data, ink, paper );
+    display_run_add( beam_x, beam_y, 0, data, ink, paper );
 
     /* Update last display record */
     display_last_screen[ index ] = last_chunk_detail;
@@ -536,10 +596,24 @@ display_write_if_dirty_sinclair( int x, int y )
   }
 }
 
-/* Plot any dirty data from ( x, y ) to ( end, y ) of the critical
-   region to the drawing region */
-static void
-copy_critical_region_line( int y, int x, int end )
+void
+display_write_if_dirty_sinclair( int x, int y )
+{
+  libspectrum_byte *screen;
+  libspectrum_byte data, data2;
+
+  /* Read byte and atrr/byte */
+  screen = RAM[ memory_current_screen ];
+  data = screen[ display_get_addr( x, y ) ];
+  data2 = display_get_attr_byte( x, y );
+
+  display_write_chunk_sinclair( x, y, data, data2 );
+}
+
+/* Take the maybe dirty bits for ( x, y ) to ( end, y ) out of the mask,
+   and return them (bit 0 corresponding to x) */
+static libspectrum_dword
+take_maybe_dirty( int y, int x, int end )
 {
   libspectrum_dword bit_mask, dirty;
 
@@ -564,6 +638,16 @@ copy_critical_region_line( int y, int x, int end )
 
   }
 
+  return dirty;
+}
+
+/* Plot any dirty data from ( x, y ) to ( end, y ) of the critical
+   region to the drawing region */
+static void
+copy_critical_region_line( int y, int x, int end )
+{
+  libspectrum_dword dirty = take_maybe_dirty( y, x, end );
+
   while( dirty ) {
 
     /* Find the first dirty chunk on this row */
@@ -586,13 +670,122 @@ copy_critical_region_line( int y, int x, int end )
     } while( dirty & 0x01 );
 
   }
-  
+
+  display_run_flush();
+}
+
+/* The time at which the beam picks up chunk ( x, y ) of the main screen.
+   A write before this is seen; one at or after it isn't. This is the same
+   test as display_update_critical() makes */
+static inline libspectrum_dword
+raster_capture_time( int x, int y )
+{
+  return machine_current->line_times[ y + DISPLAY_BORDER_HEIGHT ] +
+         4 * ( x + DISPLAY_BORDER_WIDTH_COLS + 1 );
+}
+
+/* Mark the chunks affected by a logged write as maybe dirty, and also for
+   next frame if the beam had already gone past them */
+static void
+raster_mark( const display_write_t *write )
+{
+  libspectrum_dword bit;
+  int x, y, lines, i;
+
+  if( write->offset < 0x1800 ) {
+    x = display_dirty_xtable[ write->offset ];
+    y = display_dirty_ytable[ write->offset ];
+    lines = 1;
+  } else {
+    x = display_dirty_xtable2[ write->offset - 0x1800 ];
+    y = display_dirty_ytable2[ write->offset - 0x1800 ];
+    lines = 8;
+  }
+
+  bit = (libspectrum_dword)1 << x;
+
+  for( i = 0; i < lines; i++, y++ ) {
+    display_maybe_dirty[y] |= bit;
+    if( write->tstates >= raster_capture_time( x, y ) )
+      display_next_dirty[y] |= bit;
+  }
+}
+
+/* Plot any dirty data from ( x, y ) to ( end, y ) of the critical region.
+   `screen' starts off as the screen memory at some later time, and writes
+   from the log are undone (latest first, down from `undo') until it
+   matches what the beam saw at each chunk. Chunks are read right to left
+   so that only ever needs to go backwards */
+static void
+raster_copy_line( int y, int x, int end, libspectrum_byte *screen,
+                  size_t *undo )
+{
+  libspectrum_byte data[ DISPLAY_WIDTH_COLS ], attr[ DISPLAY_WIDTH_COLS ];
+  libspectrum_dword dirty;
+  int i;
+
+  if( x >= end ) return;
+
+  dirty = take_maybe_dirty( y, x, end ) << x;
+  if( !dirty ) return;
+
+  for( i = end - 1; i >= x; i-- ) {
+    libspectrum_dword capture;
+
+    if( !( dirty & ( (libspectrum_dword)1 << i ) ) ) continue;
+
+    capture = raster_capture_time( i, y );
+    while( *undo && display_write_log[ *undo - 1 ].tstates >= capture ) {
+      const display_write_t *write = &display_write_log[ --*undo ];
+      screen[ write->offset ] = write->old;
+    }
+
+    data[i] = screen[ display_line_start[y] + i ];
+    attr[i] = screen[ display_attr_start[y] + i ];
+  }
+
+  for( i = x; i < end; i++ )
+    if( dirty & ( (libspectrum_dword)1 << i ) )
+      display_write_chunk_sinclair( i, y, data[i], attr[i] );
+
+  display_run_flush();
+}
+
+/* Copy the critical region when there are logged writes to account for.
+   Rather than catching up with the beam on every write, each line is drawn
+   in one go from the screen memory as it is now, with any writes made
+   after the beam passed a chunk undone */
+static void
+raster_copy_critical_region( int beam_x, int beam_y )
+{
+  static libspectrum_byte screen[ 0x1b00 ];
+  size_t i, undo = display_write_log_count;
+  int y;
+
+  for( i = 0; i < display_write_log_count; i++ )
+    raster_mark( &display_write_log[i] );
+
+  memcpy( screen, RAM[ memory_current_screen ], sizeof( screen ) );
+
+  for( y = beam_y; y >= critical_region_y; y-- )
+    raster_copy_line( y, y == critical_region_y ? critical_region_x : 0,
+                      y == beam_y ? beam_x : DISPLAY_WIDTH_COLS,
+                      screen, &undo );
+
+  display_write_log_count = 0;
+
+  critical_region_x = beam_x; critical_region_y = beam_y;
 }
 
 /* Copy any dirty data from the critical region to the drawing region */
 static void
 copy_critical_region( int beam_x, int beam_y )
 {
+  if( display_write_log_count ) {
+    raster_copy_critical_region( beam_x, beam_y );
+    return;
+  }
+
   if( critical_region_y == beam_y ) {
 
     copy_critical_region_line( critical_region_y, critical_region_x, beam_x );
@@ -628,8 +821,9 @@ get_beam_position( int *x, int *y )
   else *x = 0;
 }
 
-void
-display_update_critical( int x, int y )
+/* Where the beam is on the main screen, clamped to its edges */
+static void
+get_critical_beam_position( int *x, int *y )
 {
   int beam_x, beam_y;
 
@@ -651,11 +845,31 @@ display_update_critical( int x, int y )
     beam_x = DISPLAY_WIDTH_COLS;
   }
 
+  *x = beam_x; *y = beam_y;
+}
+
+void
+display_update_critical( int x, int y )
+{
+  int beam_x, beam_y;
+
+  get_critical_beam_position( &beam_x, &beam_y );
+
   if(   y <  beam_y                 ||
       ( y == beam_y && x < beam_x )    )
     copy_critical_region( beam_x, beam_y );
 }
 
+/* The write log has filled up, so draw what the beam has passed so far */
+void
+display_write_log_full( void )
+{
+  int beam_x, beam_y;
+
+  get_critical_beam_position( &beam_x, &beam_y );
+  raster_copy_critical_region( beam_x, beam_y );
+}
+
 /* Mark the 8-pixel chunk at (x,y) as maybe dirty and update the critical
    region as appropriate */
 static inline void
@@ -780,7 +994,7 @@ set_border( int y, int start, int end, int colour )
     /* Draw it if it is different to what was there last time - we know that
     data and mode will have been the same */
     if( display_last_screen[ index ] != chunk_detail ) {
-      uidisplay_plot8( start, y, 0x00, 0, colour );
+      display_run_add( start, y, 0, 0x00, 0, colour );
 
       /* Update last display record */
       display_last_screen[ index ] = chunk_detail;
@@ -790,6 +1004,8 @@ set_border( int y, int start, int end, int colour )
     }
     index++;
   }
+
+  display_run_flush();
 }
 
 static void
@@ -883,7 +1099,22 @@ update_border( void )
   error = add_border_sentinel(); if( error ) return;
 }
 
-/* Send the updated screen to the UI-specific code */
+/* How many Spectrum frames are emulated for each one sent to the UI. In
+   turbo mode this is raised to the turbo frame skip; movie recording
+   always uses the plain frame rate, as that is written to the movie header */
+int
+display_frame_skip( void )
+{
+  if( settings_current.turbo && !movie_recording &&
+      settings_current.turbo_frame_skip > settings_current.frame_rate )
+    return settings_current.turbo_frame_skip;
+
+  return settings_current.frame_rate;
+}
+
+/* Send the updated screen to the UI-specific code. On skipped frames the
+   dirty rectangles are left to accumulate so the next frame sent redraws
+   everything which changed in the meantime */
 static void
 update_ui_screen( void )
 {
@@ -892,7 +1123,7 @@ update_ui_screen( void )
   size_t i;
   struct rectangle *ptr;
 
-  if( settings_current.frame_rate <= ++frame_count ) {
+  if( display_frame_skip() <= ++frame_count ) {
     frame_count = 0;
     if( movie_recording ) {
       movie_start_frame();
@@ -908,6 +1139,8 @@ update_ui_screen( void )
                       scale * DISPLAY_SCREEN_HEIGHT );
       display_redraw_all = 0;
     } else {
+      rectangle_coalesce();
+
       for( i = 0, ptr = rectangle_inactive;
            i < rectangle_inactive_count;
            i++, ptr++ ) {
@@ -928,10 +1161,18 @@ update_ui_screen( void )
 int
 display_frame( void )
 {
+  size_t i;
+
   /* Copy all the critical region to the display */
   copy_critical_region( DISPLAY_WIDTH_COLS, DISPLAY_HEIGHT - 1 );
   critical_region_x = critical_region_y = 0;
 
+  /* Anything written after the beam passed it needs another look */
+  for( i = 0; i < DISPLAY_HEIGHT; i++ ) {
+    display_maybe_dirty[i] |= display_next_dirty[i];
+    display_next_dirty[i] = 0;
+  }
+
   update_border();
   update_dirty_rects();
   update_ui_screen();
@@ -1017,6 +1258,12 @@ void display_refresh_all(void)
 
   display_redraw_all = 1;
 
+  /* Everything is about to be drawn from the screen memory as it is now,
+     which may not be what the logged writes were made to (e.g. after a
+     snapshot has been loaded) */
+  display_write_log_count = 0;
+  memset( display_next_dirty, 0, sizeof( display_next_dirty ) );
+
   display_refresh_main_screen();
 
   for( i = 0; i < DISPLAY_SCREEN_HEIGHT; i++ )
@@ -1144,3 +1391,92 @@ display_getpixel( int x, int y )
 
   return paper;
 }
+
+/* Draw a frame with some writes just before and after the beam passes,
+   with and without the raster renderer, and check both show what was
+   there as the beam went by */
+int
+display_raster_unittest( void )
+{
+  static const struct {
+    int x, y, after;		/* Chunk, and tstates after it is captured */
+    libspectrum_word offset;	/* 0 for the pixel byte of the chunk */
+    libspectrum_byte value;
+  } writes[] = {
+    { 5, 10, -1, 0, 0x11 },
+    { 6, 10,  0, 0, 0x22 },
+    { 3, 19,  0, 0x1843, 0x38 },
+    { 7, 20, -40, 0, 0x33 },
+    { 7, 20,  1, 0, 0x44 },
+  };
+  static const struct {
+    int x, y;
+    libspectrum_word seen;	/* Attribute and pixel byte */
+  } expected[] = {
+    { 5, 10, 0x0011 }, { 6, 10, 0x0000 }, { 7, 20, 0x0033 },
+    { 3, 19, 0x0000 }, { 3, 20, 0x3800 }, { 3, 23, 0x3800 },
+  };
+  static libspectrum_word seen[ 2 ][ DISPLAY_HEIGHT ][ DISPLAY_WIDTH_COLS ];
+  memory_display_dirty_fn old_dirty = memory_display_dirty;
+  libspectrum_dword old_tstates = tstates;
+  memory_page *mapping =
+    &memory_map_write[ 0x4000 >> MEMORY_PAGE_SIZE_LOGARITHM ];
+  size_t i;
+  int pass, x, y, r = 0;
+
+  if( display_write_if_dirty != display_write_if_dirty_sinclair ||
+      mapping->source != memory_source_ram ||
+      mapping->page_num != memory_current_screen || mapping->offset )
+    return 0;
+
+  for( pass = 0; pass < 2; pass++ ) {
+    memory_display_dirty = pass ? memory_display_dirty_raster :
+                                  memory_display_dirty_sinclair;
+
+    memset( RAM[ memory_current_screen ], 0, 0x1b00 );
+    display_refresh_all();
+    critical_region_x = critical_region_y = 0;
+
+    for( i = 0; i < ARRAY_SIZE( writes ); i++ ) {
+      libspectrum_word offset = writes[i].offset ? writes[i].offset :
+        display_line_start[ writes[i].y ] + writes[i].x;
+
+      tstates = raster_capture_time( writes[i].x, writes[i].y ) +
+                writes[i].after;
+      writebyte_internal( 0x4000 + offset, writes[i].value );
+    }
+
+    tstates = machine_current->timings.tstates_per_frame;
+    copy_critical_region( DISPLAY_WIDTH_COLS, DISPLAY_HEIGHT - 1 );
+    critical_region_x = critical_region_y = 0;
+
+    for( y = 0; y < DISPLAY_HEIGHT; y++ )
+      for( x = 0; x < DISPLAY_WIDTH_COLS; x++ )
+        seen[ pass ][y][x] = display_last_screen[
+          x + DISPLAY_BORDER_WIDTH_COLS +
+          ( y + DISPLAY_BORDER_HEIGHT ) * DISPLAY_SCREEN_WIDTH_COLS ] & 0xffff;
+
+    for( i = 0; i < ARRAY_SIZE( expected ); i++ ) {
+      libspectrum_word got = seen[ pass ][ expected[i].y ][ expected[i].x ];
+
+      if( got != expected[i].seen ) {
+        fprintf( stderr, "%s: display: pass %d chunk %d,%d showed 0x%04x, "
+                 "expected 0x%04x\n", fuse_progname, pass, expected[i].x,
+                 expected[i].y, got, expected[i].seen );
+        r++;
+      }
+    }
+  }
+
+  if( memcmp( seen[0], seen[1], sizeof( seen[0] ) ) ) {
+    fprintf( stderr, "%s: display: raster renderer differs\n",
+             fuse_progname );
+    r++;
+  }
+
+  memory_display_dirty = old_dirty;
+  tstates = old_tstates;
+  display_refresh_all();
+
+  return r;
+}
@@ -113,6 +113,7 @@ void display_set_hires_border(int colour);
 int display_dirty_border(void);
 
 int display_frame(void);
+int display_frame_skip( void );
 void display_refresh_main_screen(void);
 void display_refresh_all(void);
 #if defined(VKEYBOARD) || defined(GCWZERO)
@@ -130,4 +131,24 @@ int display_getpixel( int x, int y );
 
 void display_update_critical( int x, int y );
 
+/* A write to the current screen, recorded by the raster renderer (see
+   memory_display_dirty_raster()) rather than catching the display up to
+   the beam there and then */
+typedef struct display_write_t {
+  libspectrum_dword tstates;	/* When the write happened */
+  libspectrum_word offset;	/* Offset within the screen page */
+  libspectrum_byte old;		/* What was there before */
+} display_write_t;
+
+/* Every write takes at least three tstates, so this is more than a frame's
+   worth on every machine */
+#define DISPLAY_WRITE_LOG_SIZE 24576
+
+extern display_write_t display_write_log[ DISPLAY_WRITE_LOG_SIZE ];
+extern size_t display_write_log_count;
+
+void display_write_log_full( void );
+
+int display_raster_unittest( void );
+
 #endif			/* #ifndef FUSE_DISPLAY_H */
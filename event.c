@@ -23,13 +23,17 @@
 
 #include <config.h>
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <libspectrum.h>
 
+#include "benchmark.h"
 #include "event.h"
 #include "infrastructure/startup_manager.h"
 #include "fuse.h"
+#include "settings.h"
+#include "timer/timer.h"
 #include "ui/ui.h"
 #include "utils.h"
 
@@ -39,11 +43,61 @@ static const libspectrum_dword event_no_events = 0xffffffff;
 /* When will the next event happen? */
 libspectrum_dword event_next_event;
 
-/* The actual list of events */
-static GSList *event_list = NULL;
+/* An event in the queue. The public part must come first so that
+   event_foreach() callers can treat this as an event_t */
+typedef struct event_node_t {
+  event_t event;
 
-/* An event ready to be reused */
-static event_t *event_free = NULL;
+  /* The type the event was added with. Removing an event changes the
+     public type to event_type_null, but the event keeps its place in the
+     queue, so this is what the ordering uses */
+  int order_type;
+
+  /* When this event was added; used to order events with the same time
+     and type and for lazy cancellation */
+  libspectrum_qword sequence;
+} event_node_t;
+
+/* The queue of events, held as a binary min-heap. The times stored in
+   the nodes are offset by event_rebase so that event_frame() doesn't have
+   to touch every node */
+static event_node_t **event_heap = NULL;
+static size_t event_heap_count = 0, event_heap_size = 0;
+
+/* The amount by which the stored times are ahead of the real times */
+static libspectrum_dword event_rebase = 0;
+
+/* Fold event_rebase back into the stored times once it gets this large */
+static const libspectrum_dword event_rebase_limit = 0x10000000;
+
+/* Nodes ready to be reused */
+static event_node_t **event_pool = NULL;
+static size_t event_pool_count = 0, event_pool_size = 0;
+
+/* The sequence number to be given to the next event added */
+static libspectrum_qword event_sequence = 0;
+
+/* Benchmark support: while this is non-NULL, each addition to the queue,
+   each time events are done and each end of frame is recorded, so that
+   event_benchmark() can replay what the queue did during the run */
+typedef enum event_trace_op {
+  EVENT_TRACE_ADD,
+  EVENT_TRACE_DO,
+  EVENT_TRACE_FRAME
+} event_trace_op;
+
+typedef struct event_trace_entry_t {
+  event_trace_op op;
+  libspectrum_dword tstates;
+} event_trace_entry_t;
+
+static GArray *event_trace = NULL;
+
+/* Stop recording once the trace holds this many entries */
+static const guint event_trace_limit = 1 << 22;
+
+static void event_benchmark_start( void );
+static void event_benchmark( void );
 
 /* A null event */
 int event_type_null;
@@ -51,6 +105,8 @@ int event_type_null;
 typedef struct event_descriptor_t {
   event_fn_t fn;
   char *description;
+  /* Events of this type added before this point have been removed */
+  libspectrum_qword removed_before;
 } event_descriptor_t; 
 
 static GArray *registered_events;
@@ -64,6 +120,9 @@ event_init( void *context )
 
   event_next_event = event_no_events;
 
+  benchmark_register( &settings_current.benchmark_events,
+                      event_benchmark_start, event_benchmark );
+
   return 0;
 }
 
@@ -74,96 +133,198 @@ event_register( event_fn_t fn, const char *description )
 
   descriptor.fn = fn;
   descriptor.description = utils_safe_strdup( description );
+  descriptor.removed_before = 0;
 
   g_array_append_val( registered_events, descriptor );
 
   return registered_events->len - 1;
 }
 
-static gint
-event_add_cmp( gconstpointer a1, gconstpointer b1 )
+/* Does event a happen before event b? Events are ordered by time, then
+   by type and then with the most recently added first */
+static inline int
+event_before( const event_node_t *a, const event_node_t *b )
 {
-  const event_t *a = a1, *b = b1;
+  if( a->event.tstates != b->event.tstates )
+    return a->event.tstates < b->event.tstates;
+  if( a->order_type != b->order_type )
+    return a->order_type < b->order_type;
+  return a->sequence > b->sequence;
+}
+
+static void
+event_heap_sift_up( size_t i )
+{
+  event_node_t *node = event_heap[i];
+
+  while( i > 0 ) {
+    size_t parent = ( i - 1 ) / 2;
+    if( !event_before( node, event_heap[ parent ] ) ) break;
+    event_heap[i] = event_heap[ parent ];
+    i = parent;
+  }
+
+  event_heap[i] = node;
+}
+
+static void
+event_heap_sift_down( size_t i )
+{
+  event_node_t *node = event_heap[i];
+
+  while( 1 ) {
+    size_t child = 2 * i + 1;
+    if( child >= event_heap_count ) break;
+    if( child + 1 < event_heap_count &&
+        event_before( event_heap[ child + 1 ], event_heap[ child ] ) )
+      child++;
+    if( !event_before( event_heap[ child ], node ) ) break;
+    event_heap[i] = event_heap[ child ];
+    i = child;
+  }
+
+  event_heap[i] = node;
+}
+
+/* Update event_next_event from the top of the heap */
+static void
+event_update_next( void )
+{
+  event_next_event = event_heap_count ?
+    event_heap[0]->event.tstates - event_rebase : event_no_events;
+}
+
+/* Has this event been removed since it was added? */
+static inline int
+event_removed( const event_node_t *node )
+{
+  const event_descriptor_t *descriptor =
+    &g_array_index( registered_events, event_descriptor_t, node->event.type );
+
+  return node->sequence < descriptor->removed_before;
+}
+
+/* Bring every node up to date: apply any pending rebase to the stored
+   times, and mark any lazily removed events as null events. Neither of
+   these changes the heap order */
+static void
+event_normalise( void )
+{
+  size_t i;
+
+  for( i = 0; i < event_heap_count; i++ ) {
+    event_node_t *node = event_heap[i];
+    node->event.tstates -= event_rebase;
+    if( event_removed( node ) ) node->event.type = event_type_null;
+  }
+
+  event_rebase = 0;
+}
+
+static void
+event_trace_record( event_trace_op op, libspectrum_dword tstates )
+{
+  event_trace_entry_t entry;
+
+  if( event_trace->len >= event_trace_limit ) return;
 
-  return a->tstates != b->tstates ? a->tstates - b->tstates
-		                  : a->type - b->type;
+  entry.op = op;
+  entry.tstates = tstates;
+  g_array_append_val( event_trace, entry );
 }
 
 /* Add an event at the correct place in the event list */
 void
 event_add_with_data( libspectrum_dword event_time, int type, void *user_data )
 {
-  event_t *ptr;
+  event_node_t *ptr;
+
+  if( event_trace ) event_trace_record( EVENT_TRACE_ADD, event_time );
 
-  if( event_free ) {
-    ptr = event_free;
-    event_free = NULL;
+  /* An event so far in the future that its stored time would wrap: fold
+     the rebase back in first so the time can be stored as it is */
+  if( event_time > event_no_events - event_rebase ) event_normalise();
+
+  if( event_pool_count ) {
+    ptr = event_pool[ --event_pool_count ];
   } else {
-    ptr = libspectrum_new( event_t, 1 );
+    ptr = libspectrum_new( event_node_t, 1 );
   }
 
-  ptr->tstates = event_time;
-  ptr->type =type;
-  ptr->user_data = user_data;
+  ptr->event.tstates = event_time + event_rebase;
+  ptr->event.type = type;
+  ptr->event.user_data = user_data;
+  ptr->order_type = type;
+  ptr->sequence = event_sequence++;
 
-  if( event_time < event_next_event ) {
-    event_next_event = event_time;
-    event_list = g_slist_prepend( event_list, ptr );
-  } else {
-    event_list = g_slist_insert_sorted( event_list, ptr, event_add_cmp );
+  if( event_heap_count == event_heap_size ) {
+    event_heap_size = event_heap_size ? 2 * event_heap_size : 64;
+    event_heap = libspectrum_renew( event_node_t*, event_heap,
+                                    event_heap_size );
   }
+
+  event_heap[ event_heap_count++ ] = ptr;
+  event_heap_sift_up( event_heap_count - 1 );
+
+  if( event_time < event_next_event ) event_next_event = event_time;
+}
+
+/* Return a node to the pool for reuse */
+static void
+event_node_release( event_node_t *ptr )
+{
+  if( event_pool_count == event_pool_size ) {
+    event_pool_size = event_pool_size ? 2 * event_pool_size : 64;
+    event_pool = libspectrum_renew( event_node_t*, event_pool,
+                                    event_pool_size );
+  }
+
+  event_pool[ event_pool_count++ ] = ptr;
 }
 
 /* Do all events which have passed */
 int
 event_do_events( void )
 {
-  event_t *ptr;
+  event_node_t *ptr;
+
+  if( event_trace && event_next_event <= tstates )
+    event_trace_record( EVENT_TRACE_DO, tstates );
 
   while(event_next_event <= tstates) {
     event_descriptor_t descriptor;
-    ptr = event_list->data;
+    libspectrum_dword event_time;
+
+    ptr = event_heap[0];
     descriptor =
-      g_array_index( registered_events, event_descriptor_t, ptr->type );
+      g_array_index( registered_events, event_descriptor_t, ptr->event.type );
+    event_time = ptr->event.tstates - event_rebase;
 
     /* Remove the event from the list *before* processing */
-    event_list = g_slist_remove( event_list, ptr );
+    event_heap[0] = event_heap[ --event_heap_count ];
+    if( event_heap_count ) event_heap_sift_down( 0 );
 
-    if( event_list == NULL ) {
-      event_next_event = event_no_events;
-    } else {
-      event_next_event = ((event_t*)(event_list->data))->tstates;
-    }
+    event_update_next();
 
-    if( descriptor.fn ) descriptor.fn( ptr->tstates, ptr->type, ptr->user_data );
+    if( descriptor.fn && ptr->sequence >= descriptor.removed_before )
+      descriptor.fn( event_time, ptr->event.type, ptr->event.user_data );
 
-    if( event_free ) {
-      libspectrum_free( ptr );
-    } else {
-      event_free = ptr;
-    }
+    event_node_release( ptr );
   }
 
   return 0;
 }
 
-static void
-event_reduce_tstates( gpointer data, gpointer user_data )
-{
-  event_t *ptr = data;
-  libspectrum_dword *tstates_per_frame = user_data;
-
-  ptr->tstates -= *tstates_per_frame;
-}
-
 /* Called at end of frame to reduce T-state count of all entries */
 void
 event_frame( libspectrum_dword tstates_per_frame )
 {
-  g_slist_foreach( event_list, event_reduce_tstates, &tstates_per_frame );
+  if( event_trace ) event_trace_record( EVENT_TRACE_FRAME, tstates_per_frame );
+
+  event_rebase += tstates_per_frame;
+  if( event_rebase >= event_rebase_limit ) event_normalise();
 
-  event_next_event = event_list ?
-    ((event_t*)(event_list->data))->tstates : event_no_events;
+  event_update_next();
 }
 
 /* Do all events that would happen between the current time and when
@@ -183,69 +344,81 @@ event_force_events( void )
   }
 }
 
-static void
-set_event_null( gpointer data, gpointer user_data )
-{
-  event_t *ptr = data;
-  int *type = user_data;
-
-  if( ptr->type == *type ) ptr->type = event_type_null;
-}
-
-static void
-set_event_null_with_user_data( gpointer data, gpointer user_data )
-{
-  event_t *event = data;
-  event_t *template = user_data;
-
-  if( event->type == template->type && event->user_data == template->user_data )
-    event->type = event_type_null;
-}
-
 /* Remove all events of a specific type from the stack */
 void
 event_remove_type( int type )
 {
-  g_slist_foreach( event_list, set_event_null, &type );
+  event_descriptor_t *descriptor =
+    &g_array_index( registered_events, event_descriptor_t, type );
+
+  descriptor->removed_before = event_sequence;
 }
 
 /* Remove all events of a specific type and user data from the stack */
 void
 event_remove_type_user_data( int type, gpointer user_data )
 {
-  event_t template;
+  size_t i;
 
-  template.type = type;
-  template.user_data = user_data;
-  g_slist_foreach( event_list, set_event_null_with_user_data, &template );
-}
-
-/* Free the memory used by a specific entry */
-static void
-event_free_entry( gpointer data, gpointer user_data GCC_UNUSED )
-{
-  libspectrum_free( data );
+  for( i = 0; i < event_heap_count; i++ ) {
+    event_t *event = &( event_heap[i]->event );
+    if( event->type == type && event->user_data == user_data )
+      event->type = event_type_null;
+  }
 }
 
 /* Clear the event stack */
 void
 event_reset( void )
 {
-  g_slist_foreach( event_list, event_free_entry, NULL );
-  g_slist_free( event_list );
-  event_list = NULL;
+  size_t i;
+
+  for( i = 0; i < event_heap_count; i++ )
+    libspectrum_free( event_heap[i] );
+  libspectrum_free( event_heap );
+  event_heap = NULL;
+  event_heap_count = event_heap_size = 0;
+  event_rebase = 0;
 
   event_next_event = event_no_events;
 
-  libspectrum_free( event_free );
-  event_free = NULL;
+  for( i = 0; i < event_pool_count; i++ )
+    libspectrum_free( event_pool[i] );
+  libspectrum_free( event_pool );
+  event_pool = NULL;
+  event_pool_count = event_pool_size = 0;
 }
 
-/* Call a user-supplied function for every event in the current list */
+static int
+event_foreach_cmp( const void *a1, const void *b1 )
+{
+  const event_node_t *a = *(const event_node_t* const*)a1,
+    *b = *(const event_node_t* const*)b1;
+
+  return event_before( a, b ) ? -1 : event_before( b, a ) ? 1 : 0;
+}
+
+/* Call a user-supplied function for every event in the current list, in
+   the order in which they will occur */
 void
 event_foreach( GFunc function, gpointer user_data )
 {
-  g_slist_foreach( event_list, function, user_data );
+  event_node_t **sorted;
+  size_t i, count;
+
+  event_normalise();
+
+  count = event_heap_count;
+  if( !count ) return;
+
+  sorted = libspectrum_new( event_node_t*, count );
+  memcpy( sorted, event_heap, count * sizeof( *sorted ) );
+  qsort( sorted, count, sizeof( *sorted ), event_foreach_cmp );
+
+  for( i = 0; i < count; i++ )
+    function( &( sorted[i]->event ), user_data );
+
+  libspectrum_free( sorted );
 }
 
 /* A textual representation of each event type */
@@ -255,6 +428,254 @@ event_name( int type )
   return g_array_index( registered_events, event_descriptor_t, type ).description;
 }
 
+/* Unit test support: record the order in which events fire */
+static int unittest_order[ 8 ], unittest_fired;
+
+static void
+unittest_event( libspectrum_dword event_tstates, int type, void *user_data )
+{
+  if( unittest_fired < (int)ARRAY_SIZE( unittest_order ) )
+    unittest_order[ unittest_fired++ ] = GPOINTER_TO_INT( user_data );
+}
+
+/* Check the event queue ordering, frame rebasing and removal. This
+   clears the event queue, so must be run after any tests which depend
+   on the machine's own events */
+int
+event_unittest( void )
+{
+  static const int expected[] = { 1, 3, 2, 4, 5 };
+  int type1, type2, i;
+
+  type1 = event_register( unittest_event, "Unit test 1" );
+  type2 = event_register( unittest_event, "Unit test 2" );
+
+  event_reset();
+  unittest_fired = 0;
+
+  /* Removed events must not fire, but later ones of the same type must */
+  event_add_with_data( 150, type2, GINT_TO_POINTER( 9 ) );
+  event_remove_type( type2 );
+
+  /* Same time: lower type first, then most recently added first */
+  event_add_with_data( 100, type2, GINT_TO_POINTER( 4 ) );
+  event_add_with_data( 100, type1, GINT_TO_POINTER( 2 ) );
+  event_add_with_data( 100, type1, GINT_TO_POINTER( 3 ) );
+  event_add_with_data(  50, type2, GINT_TO_POINTER( 1 ) );
+
+  event_add_with_data( 100000 + 40, type1, GINT_TO_POINTER( 5 ) );
+
+  tstates = 200;
+  event_do_events();
+
+  /* After the end of frame, the remaining event is due at 40 */
+  event_frame( 100000 );
+  if( event_next_event != 40 ) {
+    printf( "%s: event test: next event at %u, expected 40\n",
+            fuse_progname, event_next_event );
+    event_reset();
+    return 1;
+  }
+
+  tstates = 40;
+  event_do_events();
+  event_reset();
+
+  if( unittest_fired != ARRAY_SIZE( expected ) ) {
+    printf( "%s: event test: %d events fired, expected %d\n", fuse_progname,
+            unittest_fired, (int)ARRAY_SIZE( expected ) );
+    return 1;
+  }
+
+  for( i = 0; i < unittest_fired; i++ ) {
+    if( unittest_order[i] != expected[i] ) {
+      printf( "%s: event test: event %d was %d, expected %d\n",
+              fuse_progname, i, unittest_order[i], expected[i] );
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Start recording what the event queue does */
+static void
+event_benchmark_start( void )
+{
+  if( event_trace ) g_array_free( event_trace, TRUE );
+  event_trace = g_array_new( FALSE, FALSE, sizeof( event_trace_entry_t ) );
+}
+
+static void
+benchmark_event( libspectrum_dword event_tstates, int type, void *user_data )
+{
+}
+
+/* Replay the trace on the event heap, with every event given the type
+   passed in */
+static void
+benchmark_heap( const GArray *trace, int type )
+{
+  guint i;
+
+  for( i = 0; i < trace->len; i++ ) {
+    const event_trace_entry_t *entry =
+      &g_array_index( trace, event_trace_entry_t, i );
+
+    switch( entry->op ) {
+    case EVENT_TRACE_ADD:
+      event_add_with_data( entry->tstates, type, NULL );
+      break;
+    case EVENT_TRACE_DO:
+      tstates = entry->tstates;
+      event_do_events();
+      break;
+    case EVENT_TRACE_FRAME:
+      event_frame( entry->tstates );
+      break;
+    }
+  }
+
+  event_reset();
+}
+
+static gint
+benchmark_list_cmp( gconstpointer a1, gconstpointer b1 )
+{
+  const event_t *a = a1, *b = b1;
+
+  return a->tstates < b->tstates ? -1 : a->tstates > b->tstates;
+}
+
+static void
+benchmark_list_reduce( gpointer data, gpointer user_data )
+{
+  ( (event_t*)data )->tstates -= *(libspectrum_dword*)user_data;
+}
+
+static void
+benchmark_list_free( gpointer data, gpointer user_data )
+{
+  libspectrum_free( data );
+}
+
+/* Replay the trace on a sorted list, as the queue used to be */
+static void
+benchmark_list( const GArray *trace, int type )
+{
+  GSList *list = NULL;
+  event_t *event;
+  guint i;
+
+  for( i = 0; i < trace->len; i++ ) {
+    const event_trace_entry_t *entry =
+      &g_array_index( trace, event_trace_entry_t, i );
+
+    switch( entry->op ) {
+    case EVENT_TRACE_ADD:
+      event = libspectrum_new( event_t, 1 );
+      event->tstates = entry->tstates;
+      event->type = type;
+      event->user_data = NULL;
+      list = g_slist_insert_sorted( list, event, benchmark_list_cmp );
+      break;
+    case EVENT_TRACE_DO:
+      while( list && ( (event_t*)list->data )->tstates <= entry->tstates ) {
+        event = list->data;
+        list = g_slist_remove( list, event );
+        libspectrum_free( event );
+      }
+      break;
+    case EVENT_TRACE_FRAME:
+      g_slist_foreach( list, benchmark_list_reduce,
+                       (gpointer)&entry->tstates );
+      break;
+    }
+  }
+
+  g_slist_foreach( list, benchmark_list_free, NULL );
+  g_slist_free( list );
+}
+
+/* Replay what the event queue did during the benchmark run on the event
+   heap and on the sorted list it replaced, and report the time taken per
+   event added. Events removed by type aren't in the trace, so are done at
+   their original time in both replays. The current queue is set aside
+   while this runs */
+static void
+event_benchmark( void )
+{
+  event_node_t **heap, **pool;
+  size_t heap_count, heap_size, pool_count, pool_size;
+  libspectrum_dword rebase, next_event, saved_tstates;
+  libspectrum_dword adds, frames, repeats, r;
+  double start, heap_time, list_time;
+  GArray *trace;
+  guint i;
+  int type;
+
+  trace = event_trace; event_trace = NULL;
+  if( !trace ) return;
+
+  adds = frames = 0;
+  for( i = 0; i < trace->len; i++ ) {
+    switch( g_array_index( trace, event_trace_entry_t, i ).op ) {
+    case EVENT_TRACE_ADD: adds++; break;
+    case EVENT_TRACE_FRAME: frames++; break;
+    default: break;
+    }
+  }
+
+  if( !adds ) {
+    printf( "%s: event benchmark: no events were added during the run\n",
+            fuse_progname );
+    g_array_free( trace, TRUE );
+    return;
+  }
+
+  /* Replay short traces several times for a measurable time */
+  repeats = 1 + 1000000 / adds;
+
+  heap = event_heap; heap_count = event_heap_count;
+  heap_size = event_heap_size;
+  pool = event_pool; pool_count = event_pool_count;
+  pool_size = event_pool_size;
+  rebase = event_rebase; next_event = event_next_event;
+  saved_tstates = tstates;
+
+  event_heap = NULL; event_heap_count = event_heap_size = 0;
+  event_pool = NULL; event_pool_count = event_pool_size = 0;
+  event_rebase = 0; event_next_event = event_no_events;
+
+  type = event_register( benchmark_event, "Benchmark" );
+
+  start = timer_get_time();
+  for( r = 0; r < repeats; r++ ) benchmark_heap( trace, type );
+  heap_time = timer_get_time() - start;
+  if( heap_time <= 0 ) heap_time = 1e-9;
+
+  start = timer_get_time();
+  for( r = 0; r < repeats; r++ ) benchmark_list( trace, type );
+  list_time = timer_get_time() - start;
+
+  printf( "%s: event benchmark: %lu events added over %lu frames%s\n",
+          fuse_progname, (unsigned long)adds, (unsigned long)frames,
+          trace->len >= event_trace_limit ? " (trace truncated)" : "" );
+  printf( "%s: event benchmark: heap %.1f ns/event, "
+          "sorted list %.1f ns/event (%.1f times faster)\n", fuse_progname,
+          heap_time / repeats / adds * 1e9, list_time / repeats / adds * 1e9,
+          list_time / heap_time );
+
+  event_heap = heap; event_heap_count = heap_count;
+  event_heap_size = heap_size;
+  event_pool = pool; event_pool_count = pool_count;
+  event_pool_size = pool_size;
+  event_rebase = rebase; event_next_event = next_event;
+  tstates = saved_tstates;
+
+  g_array_free( trace, TRUE );
+}
+
 static void
 registered_events_free( void )
 {
@@ -278,6 +699,11 @@ event_end( void )
 {
   event_reset();
   registered_events_free();
+
+  if( event_trace ) {
+    g_array_free( event_trace, TRUE );
+    event_trace = NULL;
+  }
 }
 
 void
@@ -83,6 +83,8 @@ void event_foreach( GFunc function, gpointer user_data );
 /* A textual representation of each event type */
 const char *event_name( int type );
 
+int event_unittest( void );
+
 /* Register the init and end functions */
 void event_register_startup( void );
 
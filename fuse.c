@@ -61,6 +61,7 @@
 #include <libxml/encoding.h>
 #endif
 
+#include "benchmark.h"
 #include "debugger/debugger.h"
 #include "display.h"
 #include "event.h"
@@ -102,6 +103,7 @@
 #include "pokefinder/pokemem.h"
 #include "profile.h"
 #include "psg.h"
+#include "rewind.h"
 #include "rzx.h"
 #include "screenshot.h"
 #include "settings.h"
@@ -208,11 +210,18 @@ int main(int argc, char **argv)
   if( settings_current.unittests ) {
     r = unittests_run();
   } else {
+    if( benchmark_start() ) {
+      fuse_end();
+      return 1;
+    }
+
     while( !fuse_exiting ) {
       z80_do_opcodes();
       event_do_events();
     }
     r = debugger_get_exit_code();
+
+    if( benchmark_finish() && !r ) r = 1;
   }
 
   fuse_end();
@@ -306,6 +315,7 @@ run_startup_manager( int *argc, char ***argv )
 
   /* Get every module to register its init function */
   ay_register_startup();
+  benchmark_register_startup();
   beta_register_startup();
   creator_register_startup();
   covox_register_startup();
@@ -337,7 +347,9 @@ run_startup_manager( int *argc, char ***argv )
   printer_register_startup();
   profile_register_startup();
   psg_register_startup();
+  rewind_register_startup();
   rzx_register_startup();
+  scaler_threads_register_startup();
   scld_register_startup();
   screenshot_register_startup();
   settings_register_startup();
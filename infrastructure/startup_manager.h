@@ -28,6 +28,7 @@
 typedef enum startup_manager_module {
 
   STARTUP_MANAGER_MODULE_AY,
+  STARTUP_MANAGER_MODULE_BENCHMARK,
   STARTUP_MANAGER_MODULE_BETA,
   STARTUP_MANAGER_MODULE_COVOX,
   STARTUP_MANAGER_MODULE_CREATOR,
@@ -59,7 +60,9 @@ typedef enum startup_manager_module {
   STARTUP_MANAGER_MODULE_PRINTER,
   STARTUP_MANAGER_MODULE_PROFILE,
   STARTUP_MANAGER_MODULE_PSG,
+  STARTUP_MANAGER_MODULE_REWIND,
   STARTUP_MANAGER_MODULE_RZX,
+  STARTUP_MANAGER_MODULE_SCALER_THREADS,
   STARTUP_MANAGER_MODULE_SCLD,
   STARTUP_MANAGER_MODULE_SCREENSHOT,
   STARTUP_MANAGER_MODULE_SETTINGS_END,
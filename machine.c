@@ -331,7 +331,6 @@ machine_load_rom( int page_num, const char *filename, const char *fallback,
 int
 machine_reset( int hard_reset )
 {
-  size_t i;
   int error;
 
   /* Clear poke list (undoes effects of active pokes on Spectrum memory) */
@@ -356,11 +355,8 @@ machine_reset( int hard_reset )
 
   error = machine_current->memory_map(); if( error ) return error;
 
-  /* Set up the contention array */
-  for( i = 0; i < machine_current->timings.tstates_per_frame; i++ ) {
-    ula_contention[ i ] = machine_current->ram.contend_delay( i );
-    ula_contention_no_mreq[ i ] = machine_current->ram.contend_delay_no_mreq( i );
-  }
+  /* Set up the contention arrays */
+  ula_contention_setup();
 
   /* Update the disk menu items */
   ui_menu_disk_update();
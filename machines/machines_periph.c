@@ -25,12 +25,14 @@
 
 #include <config.h>
 
+#include "benchmark.h"
 #include "fuse.h"
 #include "infrastructure/startup_manager.h"
 #include "machines_periph.h"
 #include "pentagon.h"
 #include "periph.h"
 #include "peripherals/disk/beta.h"
+#include "settings.h"
 #include "spec128.h"
 #include "specplus3.h"
 #include "tc2068.h"
@@ -163,6 +165,9 @@ machines_periph_init( void *context )
   periph_register( PERIPH_TYPE_BETA128_PENTAGON_LATE, &beta128_pentagon_late );
   periph_register( PERIPH_TYPE_PENTAGON1024_MEMORY, &pentagon1024_memory );
 
+  benchmark_register( &settings_current.benchmark_ports, NULL,
+                      periph_dispatch_benchmark );
+
   return 0;
 }
 
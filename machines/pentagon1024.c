@@ -131,6 +131,10 @@ pentagon1024_v22_memoryport_write( libspectrum_word port GCC_UNUSED,
   if( machine_current->ram.locked ) return;
 
   machine_current->ram.last_byte2 = b;
+
+  /* Draw everything the beam has passed in the old mode */
+  display_update_critical( 0, 0 );
+
   if( b & 0x01 ) {
     display_dirty = display_dirty_pentagon_16_col;
     display_write_if_dirty = display_write_if_dirty_pentagon_16_col;
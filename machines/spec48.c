@@ -98,7 +98,9 @@ spec48_common_display_setup( void )
   display_write_if_dirty = display_write_if_dirty_sinclair;
   display_dirty_flashing = display_dirty_flashing_sinclair;
 
-  memory_display_dirty = memory_display_dirty_sinclair;
+  memory_display_dirty = settings_current.raster_display ?
+                         memory_display_dirty_raster :
+                         memory_display_dirty_sinclair;
 }
 
 int
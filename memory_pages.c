@@ -45,6 +45,7 @@
 #include "peripherals/spectranet.h"
 #include "peripherals/ttx2000s.h"
 #include "peripherals/ula.h"
+#include "rewind.h"
 #include "settings.h"
 #include "spectrum.h"
 #include "ui/ui.h"
@@ -86,6 +87,9 @@ int memory_current_screen;
 /* Which bits to look at when working out where the screen is */
 libspectrum_word memory_screen_mask;
 
+/* Should snapshots include the main RAM pages? */
+int memory_snapshot_ram = 1;
+
 static void memory_from_snapshot( libspectrum_snap *snap );
 static void memory_to_snapshot( libspectrum_snap *snap );
 
@@ -382,7 +386,7 @@ readbyte( libspectrum_word address )
   if( debugger_mode != DEBUGGER_MODE_INACTIVE )
     debugger_check( DEBUGGER_BREAKPOINT_TYPE_READ, address );
 
-  if( mapping->contended ) tstates += ula_contention[ tstates ];
+  if( mapping->contended ) ula_contend( ula_contention );
   tstates += 3;
 
   if( opus_active && address >= 0x2800 && address < 0x3800 )
@@ -415,7 +419,7 @@ writebyte( libspectrum_word address, libspectrum_byte b )
   if( debugger_mode != DEBUGGER_MODE_INACTIVE )
     debugger_check( DEBUGGER_BREAKPOINT_TYPE_WRITE, address );
 
-  if( mapping->contended ) tstates += ula_contention[ tstates ];
+  if( mapping->contended ) ula_contend( ula_contention );
 
   tstates += 3;
 
@@ -470,6 +474,32 @@ memory_display_dirty_sinclair( libspectrum_word address, libspectrum_byte b ) \
     display_dirty( offset2 );
 }
 
+/* As memory_display_dirty_sinclair(), but just log the write. The display
+   code works out what the beam saw when it next catches up */
+void
+memory_display_dirty_raster( libspectrum_word address, libspectrum_byte b )
+{
+  libspectrum_word bank = address >> MEMORY_PAGE_SIZE_LOGARITHM;
+  memory_page *mapping = &memory_map_write[ bank ];
+  libspectrum_word offset = address & MEMORY_PAGE_SIZE_MASK;
+  libspectrum_byte *memory = mapping->page;
+  libspectrum_word offset2 = offset + mapping->offset;
+
+  if( mapping->source == memory_source_ram && 
+      mapping->page_num == memory_current_screen &&
+      ( offset2 & memory_screen_mask ) < 0x1b00 &&
+      memory[ offset ] != b ) {
+    display_write_t *write = &display_write_log[ display_write_log_count ];
+
+    write->tstates = tstates;
+    write->offset = offset2;
+    write->old = memory[ offset ];
+
+    if( ++display_write_log_count == DISPLAY_WRITE_LOG_SIZE )
+      display_write_log_full();
+  }
+}
+
 memory_display_dirty_fn memory_display_dirty;
 
 void
@@ -509,6 +539,11 @@ writebyte_internal( libspectrum_word address, libspectrum_byte b )
 
     memory_display_dirty( address, b );
 
+    if( mapping->source == memory_source_ram )
+      rewind_ram_write( mapping->page_num, mapping->offset + offset );
+    else
+      rewind_memory_write( memory + offset );
+
     memory[ offset ] = b;
   }
 }
@@ -563,9 +598,13 @@ memory_from_snapshot( libspectrum_snap *snap )
   }
 
   for( i = 0; i < 64; i++ )
-    if( libspectrum_snap_pages( snap, i ) )
+    if( libspectrum_snap_pages( snap, i ) ) {
       memcpy( RAM[i], libspectrum_snap_pages( snap, i ), 0x4000 );
 
+      /* RAM has changed without going through writebyte_internal() */
+      rewind_reset();
+    }
+
   if( libspectrum_snap_custom_rom( snap ) ) {
     for( i = 0; i < libspectrum_snap_custom_rom_pages( snap ) && i < 4; i++ ) {
       if( libspectrum_snap_roms( snap, i ) ) {
@@ -666,7 +705,7 @@ memory_to_snapshot( libspectrum_snap *snap )
   libspectrum_snap_set_out_plus3_memoryport( snap,
 					     machine_current->ram.last_byte2 );
 
-  for( i = 0; i < 64; i++ ) {
+  for( i = 0; i < 64 && memory_snapshot_ram; i++ ) {
     if( RAM[i] != NULL ) {
 
       buffer = libspectrum_new( libspectrum_byte, 0x4000 );
@@ -115,6 +115,11 @@ extern int memory_current_screen;
 /* Which bits to look at when working out where the screen is */
 extern libspectrum_word memory_screen_mask;
 
+/* Should snapshots include the main RAM pages and the peripheral memory
+   registered with rewind_register_memory()? Cleared by the rewind buffer,
+   which keeps track of that memory itself */
+extern int memory_snapshot_ram;
+
 void memory_register_startup( void );
 libspectrum_byte *memory_pool_allocate( size_t length );
 libspectrum_byte *memory_pool_allocate_persistent( size_t length,
@@ -200,6 +205,8 @@ void memory_display_dirty_sinclair( libspectrum_word address,
                                     libspectrum_byte b );
 void memory_display_dirty_pentagon_16_col( libspectrum_word address,
                                            libspectrum_byte b );
+void memory_display_dirty_raster( libspectrum_word address,
+                                  libspectrum_byte b );
 
 typedef enum trap_type {
   CHECK_TAPE_ROM,
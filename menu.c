@@ -52,6 +52,7 @@
 #include "peripherals/scld.h"
 #include "profile.h"
 #include "psg.h"
+#include "rewind.h"
 #include "rzx.h"
 #include "screenshot.h"
 #include "settings.h"
@@ -386,6 +387,19 @@ MENU_CALLBACK( menu_machine_nmi )
   event_add( 0, z80_nmi_event );
 }
 
+MENU_CALLBACK( menu_machine_rewind )
+{
+  ui_widget_finish();
+
+  if( !rewind_available() ) return;
+
+  fuse_emulation_pause();
+
+  rewind_frames( 5 * 50 );
+
+  fuse_emulation_unpause();
+}
+
 MENU_CALLBACK( menu_machine_multifaceredbutton )
 {
   ui_widget_finish();
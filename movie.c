@@ -32,6 +32,9 @@
 #include <unistd.h>
 
 #include <libspectrum.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 #ifdef HAVE_ZLIB_H
 #define ZLIB_CONST
 #include <zlib.h>
@@ -47,6 +50,7 @@
 #include "screenshot.h"
 #include "settings.h"
 #include "sound.h"
+#include "timer/timer.h"
 #include "ui/ui.h"
 
 #undef MOVIE_DEBUG_PRINT
@@ -118,6 +122,10 @@
 int movie_recording = 0;
 static int movie_paused = 0;
 
+/* Set when a screen area has been dropped, so the next frame must start with
+   the whole screen */
+static int movie_resync = 0;
+
 static int frame_no, slice_no;
 
 static FILE *of = NULL;	/* out file */
@@ -126,7 +134,6 @@ static libspectrum_byte head[8];
 static int freq = 0;
 static char stereo = 'M';
 static char format = '?';
-static int framesiz = 4;
 
 static libspectrum_byte sbuff[ 4096 ];
 #ifdef HAVE_ZLIB_H
@@ -141,6 +148,63 @@ static unsigned char alaw_table[2048 + 1] = { ALAW_ENC_TAB };
 void movie_start_frame( void );
 void movie_init_sound( int f, int s );
 
+/*
+  Everything after the file header is encoded by a writer thread where we
+  have one, so that the run length encoding and deflate() don't hold up the
+  emulation. The emulation thread just copies the changed screen areas and
+  the sound into a bounded queue of blocks, which the writer encodes in
+  order. When the queue is full, the emulation thread either waits or, if
+  movie_drop_when_busy is set, drops the screen area or sound; a dropped
+  screen area makes the next frame start with the whole screen.
+*/
+
+typedef enum movie_block_type {
+  MOVIE_BLOCK_DATA,	/* bytes to write as they are */
+  MOVIE_BLOCK_AREA,	/* a copy of a screen area to run length encode */
+  MOVIE_BLOCK_SOUND,	/* sound samples to encode */
+  MOVIE_BLOCK_STOP,	/* tells the writer thread to exit */
+} movie_block_type;
+
+typedef struct movie_block_t {
+  movie_block_type type;
+  int x, y, w, h;		/* MOVIE_BLOCK_AREA */
+  char format, stereo;		/* MOVIE_BLOCK_SOUND, as they were when */
+  int freq;			/* the sound was queued */
+  size_t length;		/* bytes of data used */
+  size_t size;			/* bytes of data allocated */
+  libspectrum_byte *data;
+} movie_block_t;
+
+#define MOVIE_QUEUE_BLOCKS 256
+#define MOVIE_QUEUE_BYTES ( 4 * 1024 * 1024 )
+
+/* The slots are reused, so their buffers only grow during a recording */
+static movie_block_t queue[ MOVIE_QUEUE_BLOCKS ];
+
+/* Is the writer thread running? If not, blocks are encoded as soon as they
+   are queued */
+static int writer_running = 0;
+
+static struct {
+  unsigned long blocks, dropped;
+  int max_depth;
+  size_t max_bytes;
+  double encode_time, max_encode_time;
+} movie_stats;
+
+#ifdef HAVE_PTHREAD
+static pthread_t writer_thread;
+
+/* The first queued block, how many are queued and the size of their data;
+   protected by queue_lock */
+static int queue_head = 0, queue_count = 0;
+static size_t queue_bytes = 0;
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_data = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_space = PTHREAD_COND_INITIALIZER;
+#endif			/* #ifdef HAVE_PTHREAD */
+
 static char
 get_timing( void )
 {
@@ -212,19 +276,20 @@ fwrite_compr( const void *b, size_t n, size_t m, FILE *f )
 #define fwrite_compr fwrite
 #endif	/* HAVE_ZLIB_H */
 
+/* Compress one plane of a w x h copy of part of display_last_screen */
 static void
-movie_compress_area( int x, int y, int w, int h, int s )
+movie_compress_area( const libspectrum_dword *area, int w, int h, int s )
 {
-  libspectrum_dword *dpoint, *dline;
+  const libspectrum_dword *dpoint, *dline;
   libspectrum_byte d, d1, *b;
   libspectrum_byte buff[ 960 ];
   int w0, h0, l;
 
-  dline = &display_last_screen[x + 40 * y];
+  dline = area;
   b = buff; l = -1;
   d1 = ( ( *dline >> s ) & 0xff ) + 1;		/* *d1 != dpoint :-) */
 
-  for( h0 = h; h0 > 0; h0--, dline += 40 ) {
+  for( h0 = h; h0 > 0; h0--, dline += w ) {
     dpoint = dline;
     for( w0 = w; w0 > 0; w0--, dpoint++) {
       d = ( *dpoint >> s ) & 0xff;	/* bitmask1 */
@@ -267,26 +332,266 @@ movie_compress_area( int x, int y, int w, int h, int s )
 
 /* abcdefghijkl... cc# where # mean cc + # c char*/
 
-void
-movie_add_area( int x, int y, int w, int h )
+static void
+encode_area( const movie_block_t *block )
 {
-  if( movie_paused ) {
-    movie_start_frame();
-    return;
-  }
+  const libspectrum_dword *area = (const libspectrum_dword*)block->data;
+  int w = block->w, h = block->h;
+
   head[0] = '$';			/* RLE compressed data... */
-  head[1] = x;
-  head[2] = y & 0xff;
-  head[3] = y >> 8;
+  head[1] = block->x;
+  head[2] = block->y & 0xff;
+  head[3] = block->y >> 8;
   head[4] = w;
   head[5] = h & 0xff;
   head[6] = h >> 8;
   fwrite_compr( head, 7, 1, of );
-  movie_compress_area( x, y, w, h, 0 );	/* Bitmap1 */
-  movie_compress_area( x, y, w, h, 8 );	/* Attrib/B2 */
+  movie_compress_area( area, w, h, 0 );	/* Bitmap1 */
+  movie_compress_area( area, w, h, 8 );	/* Attrib/B2 */
   if( fmf_screen == 'R' ) {
-    movie_compress_area( x, y, w, h, 16 );	/* HiRes attrib */
+    movie_compress_area( area, w, h, 16 );	/* HiRes attrib */
+  }
+}
+
+static void encode_sound( const movie_block_t *block );
+
+static void
+movie_encode_block( movie_block_t *block )
+{
+  switch( block->type ) {
+  case MOVIE_BLOCK_DATA:
+    fwrite_compr( block->data, block->length, 1, of );
+    break;
+  case MOVIE_BLOCK_AREA:
+    encode_area( block );
+    break;
+  case MOVIE_BLOCK_SOUND:
+    encode_sound( block );
+    break;
+  case MOVIE_BLOCK_STOP:
+    break;
+  }
+}
+
+#ifdef HAVE_PTHREAD
+
+static void*
+movie_writer( void *arg GCC_UNUSED )
+{
+  movie_block_t *block;
+  double start, elapsed;
+
+  pthread_mutex_lock( &queue_lock );
+
+  for(;;) {
+    while( !queue_count )
+      pthread_cond_wait( &queue_data, &queue_lock );
+
+    block = &queue[ queue_head ];
+    if( block->type == MOVIE_BLOCK_STOP ) break;
+
+    /* The emulation thread doesn't touch a block once it's queued, so we
+       can encode it without holding the lock */
+    pthread_mutex_unlock( &queue_lock );
+
+    start = timer_get_time();
+    movie_encode_block( block );
+    elapsed = timer_get_time() - start;
+
+    pthread_mutex_lock( &queue_lock );
+
+    movie_stats.encode_time += elapsed;
+    if( elapsed > movie_stats.max_encode_time )
+      movie_stats.max_encode_time = elapsed;
+
+    queue_head = ( queue_head + 1 ) % MOVIE_QUEUE_BLOCKS;
+    queue_count--;
+    queue_bytes -= block->length;
+    pthread_cond_signal( &queue_space );
+  }
+
+  queue_head = ( queue_head + 1 ) % MOVIE_QUEUE_BLOCKS;
+  queue_count--;
+
+  pthread_mutex_unlock( &queue_lock );
+
+  return NULL;
+}
+
+static void
+movie_writer_start( void )
+{
+  queue_head = queue_count = 0;
+  queue_bytes = 0;
+
+  /* If we can't start the thread, just encode everything as it comes */
+  writer_running = !pthread_create( &writer_thread, NULL, movie_writer, NULL );
+}
+
+/* Get the next free slot in the queue, waiting for the writer thread if the
+   queue is full. If `droppable' is set, the caller can cope with not getting
+   one and gets NULL instead of waiting when movie_drop_when_busy is set */
+static movie_block_t*
+movie_queue_slot( size_t length, int droppable )
+{
+  movie_block_t *block;
+
+  pthread_mutex_lock( &queue_lock );
+
+  /* A single block bigger than the whole queue is allowed once the queue has
+     emptied */
+  while( queue_count == MOVIE_QUEUE_BLOCKS ||
+         ( queue_count && queue_bytes + length > MOVIE_QUEUE_BYTES ) ) {
+    if( droppable && settings_current.movie_drop_when_busy ) {
+      movie_stats.dropped++;
+      pthread_mutex_unlock( &queue_lock );
+      return NULL;
+    }
+    pthread_cond_wait( &queue_space, &queue_lock );
   }
+
+  block = &queue[ ( queue_head + queue_count ) % MOVIE_QUEUE_BLOCKS ];
+
+  pthread_mutex_unlock( &queue_lock );
+
+  return block;
+}
+
+static void
+movie_queue_push( movie_block_t *block )
+{
+  pthread_mutex_lock( &queue_lock );
+
+  queue_count++;
+  queue_bytes += block->length;
+
+  if( block->type != MOVIE_BLOCK_STOP ) movie_stats.blocks++;
+  if( queue_count > movie_stats.max_depth )
+    movie_stats.max_depth = queue_count;
+  if( queue_bytes > movie_stats.max_bytes )
+    movie_stats.max_bytes = queue_bytes;
+
+  pthread_cond_signal( &queue_data );
+
+  pthread_mutex_unlock( &queue_lock );
+}
+
+/* Let the writer thread finish everything queued, then stop it */
+static void
+movie_writer_stop( void )
+{
+  movie_block_t *block;
+
+  if( !writer_running ) return;
+
+  block = movie_queue_slot( 0, 0 );
+  block->type = MOVIE_BLOCK_STOP;
+  block->length = 0;
+  movie_queue_push( block );
+
+  pthread_join( writer_thread, NULL );
+  writer_running = 0;
+}
+
+#else			/* #ifdef HAVE_PTHREAD */
+
+static void movie_writer_start( void ) {}
+static void movie_writer_stop( void ) {}
+
+static movie_block_t*
+movie_queue_slot( size_t length GCC_UNUSED, int droppable GCC_UNUSED )
+{
+  return &queue[0];
+}
+
+static void
+movie_queue_push( movie_block_t *block GCC_UNUSED )
+{
+}
+
+#endif			/* #ifdef HAVE_PTHREAD */
+
+/* Get a block with room for `length' bytes of data; see movie_queue_slot()
+   for when this returns NULL */
+static movie_block_t*
+movie_block_get( movie_block_type type, size_t length, int droppable )
+{
+  movie_block_t *block = &queue[0];
+
+  if( writer_running ) {
+    block = movie_queue_slot( length, droppable );
+    if( !block ) return NULL;
+  }
+
+  if( length > block->size ) {
+    block->data = libspectrum_renew( libspectrum_byte, block->data, length );
+    block->size = length;
+  }
+
+  block->type = type;
+  block->length = length;
+
+  return block;
+}
+
+/* Hand a filled in block to the writer thread, or encode it now if there
+   isn't one */
+static void
+movie_block_put( movie_block_t *block )
+{
+  double start, elapsed;
+
+  if( writer_running ) {
+    movie_queue_push( block );
+    return;
+  }
+
+  start = timer_get_time();
+  movie_encode_block( block );
+  elapsed = timer_get_time() - start;
+
+  movie_stats.blocks++;
+  movie_stats.encode_time += elapsed;
+  if( elapsed > movie_stats.max_encode_time )
+    movie_stats.max_encode_time = elapsed;
+}
+
+static void
+movie_add_data( const void *data, size_t length )
+{
+  movie_block_t *block = movie_block_get( MOVIE_BLOCK_DATA, length, 0 );
+
+  memcpy( block->data, data, length );
+  movie_block_put( block );
+}
+
+void
+movie_add_area( int x, int y, int w, int h )
+{
+  movie_block_t *block;
+  libspectrum_dword *area;
+  int i;
+
+  if( movie_paused ) {
+    movie_start_frame();
+    return;
+  }
+
+  block = movie_block_get( MOVIE_BLOCK_AREA,
+                           w * h * sizeof( libspectrum_dword ), 1 );
+  if( !block ) {
+    movie_resync = 1;
+    return;
+  }
+
+  block->x = x; block->y = y; block->w = w; block->h = h;
+
+  area = (libspectrum_dword*)block->data;
+  for( i = 0; i < h; i++ )
+    memcpy( area + i * w, &display_last_screen[ x + 40 * ( y + i ) ],
+            w * sizeof( libspectrum_dword ) );
+
+  movie_block_put( block );
   slice_no++;
 }
 
@@ -312,12 +617,17 @@ movie_start_fmf( const char *name )
     fwrite( "Z", 1, 1, of );		/* compressed */
   }
   if( fmf_compr != 0 ) {
+    /* Any level from 0 (stored) to 9 (smallest); anything else means zlib's
+       default */
+    int level = settings_current.movie_deflate_level;
+    if( level < 0 || level > 9 ) level = Z_DEFAULT_COMPRESSION;
+
     zstream.zalloc = Z_NULL;
     zstream.zfree = Z_NULL;
     zstream.opaque = Z_NULL;
     zstream.avail_in = 0;
     zstream.next_in = Z_NULL;
-    deflateInit( &zstream, fmf_compr );
+    deflateInit( &zstream, level );
   }
 #else	/* HAVE_ZLIB_H */
   fwrite( "U", 1, 1, of );		/* cannot be compressed */
@@ -333,6 +643,11 @@ movie_start_fmf( const char *name )
   head[6] = stereo;
   head[7] = '\n';	/* padding */
   fwrite( head, 8, 1, of );		/* write initial params */
+
+  memset( &movie_stats, 0, sizeof( movie_stats ) );
+  movie_resync = 0;
+  movie_writer_start();
+
   movie_add_area( 0, 0, 40, 240 );
 }
 
@@ -344,6 +659,8 @@ movie_start( const char *name )	/* some init, open file (name)*/
     name = "fuse.fmf";			/* fuse movie file */
 
   movie_start_fmf( name );
+  if( !of ) return;
+
   movie_recording = 1;
   ui_menu_activate( UI_MENU_ITEM_FILE_MOVIE_RECORDING, 1 );
   ui_menu_activate( UI_MENU_ITEM_FILE_MOVIE_PAUSE, 1 );
@@ -352,9 +669,12 @@ movie_start( const char *name )	/* some init, open file (name)*/
 void
 movie_stop( void )
 {
+  int i;
+
   if( !movie_paused && !movie_recording ) return;
 
-  fwrite_compr( "X", 1, 1, of );	/* End of Recording! */
+  movie_add_data( "X", 1 );	/* End of Recording! */
+  movie_writer_stop();
 #ifdef HAVE_ZLIB_H
   {
     if( fmf_compr != 0 ) {		/* close zlib */
@@ -371,6 +691,11 @@ movie_stop( void )
     }
   }
 #endif	/* HAVE_ZLIB_H */
+  for( i = 0; i < MOVIE_QUEUE_BLOCKS; i++ ) {
+    libspectrum_free( queue[i].data );
+    queue[i].data = NULL;
+    queue[i].size = 0;
+  }
   format = '?';
   if( of ) {
     fclose( of );
@@ -379,6 +704,18 @@ movie_stop( void )
 #ifdef MOVIE_DEBUG_PRINT
   fprintf( stderr, "Debug movie: saved %d.%d frame(.slice)\n", frame_no, slice_no );
 #endif 	/* MOVIE_DEBUG_PRINT */
+  if( settings_current.movie_stats ) {
+    printf( "%s: movie: %d frames, %lu blocks encoded, %lu dropped\n",
+            fuse_progname, frame_no, movie_stats.blocks,
+            movie_stats.dropped );
+    printf( "%s: movie: queue depth up to %d blocks, %lu KB\n",
+            fuse_progname, movie_stats.max_depth,
+            (unsigned long)( movie_stats.max_bytes / 1024 ) );
+    printf( "%s: movie: encoding %.3f ms/block on average, %.3f ms at most\n",
+            fuse_progname, movie_stats.blocks ?
+              1000 * movie_stats.encode_time / movie_stats.blocks : 0.0,
+            1000 * movie_stats.max_encode_time );
+  }
   movie_recording = 0;
   movie_paused = 0;
   ui_menu_activate( UI_MENU_ITEM_FILE_MOVIE_RECORDING, 0 );
@@ -407,7 +744,6 @@ movie_init_sound( int f, int s )
   format = option_enumerate_movie_movie_compr() == 2 ? 'A' : 'P';
   freq = f;
   stereo = ( s ? 'S' : 'M' );
-  framesiz = ( stereo == 'S' ? 2 : 1 ) * ( format == 'P' ? 2 : 1 );
 }
 
 static inline void
@@ -430,52 +766,80 @@ write_alaw( libspectrum_signed_word *buff, int len )
 }
 
 static void
-add_sound( libspectrum_signed_word *buff, int len )
+add_sound( const movie_block_t *block, libspectrum_signed_word *buff, int len )
 {
+  int size = ( block->stereo == 'S' ? 2 : 1 ) *
+             ( block->format == 'P' ? 2 : 1 );
+
   head[0] = 'S';	/* sound frame */
-  head[1] = format;	/* sound format */
-  head[2] = freq & 0xff;
-  head[3] = freq >> 8;
-  head[4] = stereo;
+  head[1] = block->format;	/* sound format */
+  head[2] = block->freq & 0xff;
+  head[3] = block->freq >> 8;
+  head[4] = block->stereo;
   len--;		/*len - 1*/
   head[5] = len & 0xff;
   head[6] = len >> 8;
   len++;		/* len :-) */
   fwrite_compr( head, 7, 1, of );	/* Sound frame */
-  if( format == 'P' )
-    fwrite_compr( buff, len * framesiz , 1, of );	/* write frame */
-  else if( format == 'A' )
-    write_alaw( buff, len * framesiz );
+  if( block->format == 'P' )
+    fwrite_compr( buff, len * size , 1, of );	/* write frame */
+  else if( block->format == 'A' )
+    write_alaw( buff, len * size );
 }
 
-void
-movie_add_sound( libspectrum_signed_word *buff, int len )
+static void
+encode_sound( const movie_block_t *block )
 {
+  libspectrum_signed_word *buff = (libspectrum_signed_word*)block->data;
+  int len = block->length / sizeof( libspectrum_signed_word );
+
   while( len ) {
-    if( stereo == 'S' ) {
-      add_sound( buff, len > 131072 ? 65536 : len >> 1 );
+    if( block->stereo == 'S' ) {
+      add_sound( block, buff, len > 131072 ? 65536 : len >> 1 );
       buff += len > 131072 ? 131072 : len;
       len -= len > 131072 ? 131072 : len;
     } else {
-      add_sound( buff, len > 65536 ? 65536 : len );
+      add_sound( block, buff, len > 65536 ? 65536 : len );
       buff += len > 65536 ? 65536 : len;
       len -= len > 65536 ? 65536 : len;
     }
   }
 }
 
+void
+movie_add_sound( libspectrum_signed_word *buff, int len )
+{
+  size_t length = len * sizeof( libspectrum_signed_word );
+  movie_block_t *block;
+
+  if( !len ) return;
+
+  /* Dropped sound just leaves a gap */
+  block = movie_block_get( MOVIE_BLOCK_SOUND, length, 1 );
+  if( !block ) return;
+
+  block->format = format;
+  block->stereo = stereo;
+  block->freq = freq;
+  memcpy( block->data, buff, length );
+  movie_block_put( block );
+}
+
 void
 movie_start_frame( void )
 {
+  libspectrum_byte frame_head[4];
+
   /* $ - ZX$, T - TX$, C - HiCol, R - HiRes */
-  head[0] = 'N';
-  head[1] = settings_current.frame_rate;
-  head[2] = get_screentype();
-  head[3] = get_timing();
-  fwrite_compr( head, 4, 1, of );	/* New frame! */
+  frame_head[0] = 'N';
+  frame_head[1] = settings_current.frame_rate;
+  frame_head[2] = get_screentype();
+  frame_head[3] = get_timing();
+  movie_add_data( frame_head, 4 );	/* New frame! */
   frame_no++;
-  if( movie_paused ) {
+  if( movie_paused || movie_resync ) {
     movie_paused = 0;
+    movie_resync = 0;
     movie_add_area( 0, 0, 40, 240 );
   }
 }
@@ -24,6 +24,8 @@
 
 #include <config.h>
 
+#include <string.h>
+
 #include <libspectrum.h>
 
 #include "debugger/debugger.h"
@@ -35,6 +37,7 @@
 #include "peripherals/ula.h"
 #include "rzx.h"
 #include "settings.h"
+#include "timer/timer.h"
 #include "ui/ui.h"
 
 /*
@@ -64,6 +67,35 @@ typedef struct periph_port_private_t {
 /* The list of currently active ports */
 static GSList *ports = NULL;
 
+/* All the ports which have the same set of port responses matching them
+   form one class; this holds the pre-resolved handlers for a class */
+typedef struct port_class_t {
+  /* Every port response which matches this class, in list order */
+  const periph_port_t **matches;
+  size_t match_count;
+
+  /* The subsets of the above with read and write handlers */
+  const periph_port_t **readers;
+  size_t reader_count;
+  const periph_port_t **writers;
+  size_t writer_count;
+
+  /* The next class in the same hash bucket, or -1 */
+  int next;
+} port_class_t;
+
+#define PORT_CLASS_HASH_SIZE 256
+
+/* The class for each of the 65536 ports */
+static libspectrum_word port_dispatch[ 0x10000 ];
+
+/* The classes themselves */
+static GArray *port_classes = NULL;
+
+/* Set whenever the list of active ports changes; the dispatch table is
+   then rebuilt on the next port access */
+static int port_dispatch_dirty = 1;
+
 /* The strings used for debugger events */
 static const char * const page_event_string = "page",
   * const unpage_event_string = "unpage";
@@ -80,6 +112,7 @@ port_register( periph_type type, const periph_port_t *port )
   private->port = *port;
 
   ports = g_slist_append( ports, private );
+  port_dispatch_dirty = 1;
 }
 
 /* Register a peripheral with the system */
@@ -136,6 +169,7 @@ periph_activate_type( periph_type type, int active )
     GSList *found;
     while( ( found = g_slist_find_custom( ports, GINT_TO_POINTER( type ), find_by_type ) ) != NULL )
       ports = g_slist_remove( ports, found->data );
+    port_dispatch_dirty = 1;
   }
 
   return 1;
@@ -231,6 +265,125 @@ set_types_inactive( void )
   g_hash_table_foreach( peripherals, set_type_inactive, NULL );
 }
 
+/* Free the handler lists of every port class */
+static void
+port_classes_free( void )
+{
+  size_t i;
+
+  if( !port_classes ) return;
+
+  for( i = 0; i < port_classes->len; i++ ) {
+    port_class_t *port_class = &g_array_index( port_classes, port_class_t, i );
+    libspectrum_free( port_class->matches );
+    libspectrum_free( port_class->readers );
+    libspectrum_free( port_class->writers );
+  }
+
+  g_array_set_size( port_classes, 0 );
+}
+
+/* Find the class with exactly the given set of matching port responses,
+   creating it if it doesn't already exist */
+static libspectrum_word
+port_class_get( const periph_port_t **matches, size_t match_count,
+                libspectrum_dword hash, int *buckets )
+{
+  port_class_t new_class;
+  size_t i;
+  int index;
+
+  for( index = buckets[ hash ]; index != -1;
+       index = g_array_index( port_classes, port_class_t, index ).next ) {
+    port_class_t *port_class = &g_array_index( port_classes, port_class_t,
+                                               index );
+    if( port_class->match_count == match_count &&
+        ( match_count == 0 ||
+          !memcmp( port_class->matches, matches,
+                   match_count * sizeof( *matches ) ) ) )
+      return index;
+  }
+
+  new_class.match_count = match_count;
+  new_class.matches = libspectrum_new( const periph_port_t*, match_count + 1 );
+  new_class.readers = libspectrum_new( const periph_port_t*, match_count + 1 );
+  new_class.writers = libspectrum_new( const periph_port_t*, match_count + 1 );
+  new_class.reader_count = new_class.writer_count = 0;
+
+  for( i = 0; i < match_count; i++ ) {
+    new_class.matches[i] = matches[i];
+    if( matches[i]->read )
+      new_class.readers[ new_class.reader_count++ ] = matches[i];
+    if( matches[i]->write )
+      new_class.writers[ new_class.writer_count++ ] = matches[i];
+  }
+
+  new_class.next = buckets[ hash ];
+  g_array_append_val( port_classes, new_class );
+  buckets[ hash ] = port_classes->len - 1;
+
+  return port_classes->len - 1;
+}
+
+/* Rebuild the port dispatch table from the list of active ports. Ports
+   which have the same set of responses share a class, so the table
+   needs only a few classes in practice */
+static void
+port_dispatch_rebuild( void )
+{
+  const periph_port_t **responses, **matches;
+  int buckets[ PORT_CLASS_HASH_SIZE ];
+  size_t i, response_count, match_count;
+  libspectrum_dword port, hash;
+  GSList *ptr;
+
+  if( !port_classes )
+    port_classes = g_array_new( FALSE, FALSE, sizeof( port_class_t ) );
+
+  port_classes_free();
+
+  for( i = 0; i < PORT_CLASS_HASH_SIZE; i++ ) buckets[i] = -1;
+
+  response_count = g_slist_length( ports );
+  responses = libspectrum_new( const periph_port_t*, response_count + 1 );
+  matches = libspectrum_new( const periph_port_t*, response_count + 1 );
+
+  for( i = 0, ptr = ports; ptr; i++, ptr = ptr->next ) {
+    periph_port_private_t *private = ptr->data;
+    responses[i] = &( private->port );
+  }
+
+  for( port = 0; port < 0x10000; port++ ) {
+
+    match_count = 0; hash = 0;
+
+    for( i = 0; i < response_count; i++ ) {
+      if( ( port & responses[i]->mask ) == responses[i]->value ) {
+        matches[ match_count++ ] = responses[i];
+        hash = hash * 31 + i + 1;
+      }
+    }
+
+    port_dispatch[ port ] =
+      port_class_get( matches, match_count, hash % PORT_CLASS_HASH_SIZE,
+                      buckets );
+  }
+
+  libspectrum_free( matches );
+  libspectrum_free( responses );
+
+  port_dispatch_dirty = 0;
+}
+
+/* Get the pre-resolved handlers for a port */
+static inline const port_class_t*
+port_class_lookup( libspectrum_word port )
+{
+  if( port_dispatch_dirty ) port_dispatch_rebuild();
+
+  return &g_array_index( port_classes, port_class_t, port_dispatch[ port ] );
+}
+
 /* Empty out the list of peripherals */
 void
 periph_clear( void )
@@ -238,6 +391,7 @@ periph_clear( void )
   g_slist_foreach( ports, free_peripheral, NULL );
   g_slist_free( ports );
   ports = NULL;
+  port_dispatch_dirty = 1;
   set_types_inactive();
 }
 
@@ -248,6 +402,13 @@ periph_end( void )
   g_slist_foreach( ports, free_peripheral, NULL );
   g_slist_free( ports );
   ports = NULL;
+  port_dispatch_dirty = 1;
+
+  if( port_classes ) {
+    port_classes_free();
+    g_array_free( port_classes, TRUE );
+    port_classes = NULL;
+  }
 
   g_hash_table_destroy( peripherals );
   peripherals = NULL;
@@ -257,23 +418,13 @@ periph_end( void )
  * The actual routines to read and write a port
  */
 
-/* Internal type used for passing to read_peripheral and write_peripheral */
-struct peripheral_data_t {
-
-  libspectrum_word port;
-
-  libspectrum_byte attached;
-  libspectrum_byte value;
-};
-
 /* Read a byte from a port, taking the appropriate time */
 libspectrum_byte
 readport( libspectrum_word port )
 {
   libspectrum_byte b;
 
-  ula_contend_port_early( port );
-  ula_contend_port_late( port );
+  ula_contend_port( port );
   b = readport_internal( port );
 
   /* Very ugly to put this here, but unless anything else needs this
@@ -288,30 +439,13 @@ readport( libspectrum_word port )
   return b;
 }
 
-/* Read a byte from a specific port response */
-static void
-read_peripheral( gpointer data, gpointer user_data )
-{
-  periph_port_private_t *private = data;
-  struct peripheral_data_t *callback_info = user_data;
-  libspectrum_byte last_attached;
-
-  periph_port_t *port = &( private->port );
-
-  if( port->read &&
-      ( ( callback_info->port & port->mask ) == port->value ) ) {
-    last_attached = callback_info->attached;
-    callback_info->value &= (   port->read( callback_info->port,
-					    &( callback_info->attached ) )
-			      | last_attached );
-  }
-}
-
 /* Read a byte from a port, taking no time */
 libspectrum_byte
 readport_internal( libspectrum_word port )
 {
-  struct peripheral_data_t callback_info;
+  const port_class_t *port_class;
+  libspectrum_byte attached, last_attached, value;
+  size_t i;
 
   /* Trigger the debugger if wanted */
   if( debugger_mode != DEBUGGER_MODE_INACTIVE )
@@ -337,21 +471,23 @@ readport_internal( libspectrum_word port )
   }
 
   /* If we're not doing RZX playback, get the byte normally */
-  callback_info.port = port;
-  callback_info.attached = 0x00;
-  callback_info.value = 0xff;
+  attached = 0x00;
+  value = 0xff;
 
-  g_slist_foreach( ports, read_peripheral, &callback_info );
+  port_class = port_class_lookup( port );
+  for( i = 0; i < port_class->reader_count; i++ ) {
+    last_attached = attached;
+    value &= port_class->readers[i]->read( port, &attached ) | last_attached;
+  }
 
-  if( callback_info.attached != 0xff )
-    callback_info.value =
-      periph_merge_floating_bus( callback_info.value, callback_info.attached,
-                                 machine_current->unattached_port() );
+  if( attached != 0xff )
+    value = periph_merge_floating_bus( value, attached,
+                                       machine_current->unattached_port() );
 
   /* If we're RZX recording, store this byte */
-  if( rzx_recording ) rzx_store_byte( callback_info.value );
+  if( rzx_recording ) rzx_store_byte( value );
 
-  return callback_info.value;
+  return value;
 }
 
 /* Merge the read value with the floating bus. Deliberately doesn't take
@@ -372,34 +508,20 @@ writeport( libspectrum_word port, libspectrum_byte b )
   ula_contend_port_late( port ); tstates++;
 }
 
-/* Write a byte to a specific port response */
-static void
-write_peripheral( gpointer data, gpointer user_data )
-{
-  periph_port_private_t *private = data;
-  struct peripheral_data_t *callback_info = user_data;
-
-  periph_port_t *port = &( private->port );
-  
-  if( port->write &&
-      ( ( callback_info->port & port->mask ) == port->value ) )
-    port->write( callback_info->port, callback_info->value );
-}
-
 /* Write a byte to a port, taking no time */
 void
 writeport_internal( libspectrum_word port, libspectrum_byte b )
 {
-  struct peripheral_data_t callback_info;
+  const port_class_t *port_class;
+  size_t i;
 
   /* Trigger the debugger if wanted */
   if( debugger_mode != DEBUGGER_MODE_INACTIVE )
     debugger_check( DEBUGGER_BREAKPOINT_TYPE_PORT_WRITE, port );
 
-  callback_info.port = port;
-  callback_info.value = b;
-  
-  g_slist_foreach( ports, write_peripheral, &callback_info );
+  port_class = port_class_lookup( port );
+  for( i = 0; i < port_class->writer_count; i++ )
+    port_class->writers[i]->write( port, b );
 }
 
 /*
@@ -512,6 +634,124 @@ periph_postcheck( void )
   return needs_hard_reset;
 }
 
+/* Check that the dispatch table gives exactly the same port responses, in
+   the same order, as walking the list of active ports */
+int
+periph_dispatch_unittest( void )
+{
+  libspectrum_dword port;
+  size_t reader, writer;
+  GSList *ptr;
+
+  for( port = 0; port < 0x10000; port++ ) {
+
+    const port_class_t *port_class = port_class_lookup( port );
+
+    reader = writer = 0;
+
+    for( ptr = ports; ptr; ptr = ptr->next ) {
+      periph_port_private_t *private = ptr->data;
+      const periph_port_t *response = &( private->port );
+
+      if( ( port & response->mask ) != response->value ) continue;
+
+      if( response->read ) {
+        if( reader >= port_class->reader_count ||
+            port_class->readers[ reader ] != response ) {
+          printf( "%s: port dispatch test: bad reader for port 0x%04x\n",
+                  fuse_progname, port );
+          return 1;
+        }
+        reader++;
+      }
+
+      if( response->write ) {
+        if( writer >= port_class->writer_count ||
+            port_class->writers[ writer ] != response ) {
+          printf( "%s: port dispatch test: bad writer for port 0x%04x\n",
+                  fuse_progname, port );
+          return 1;
+        }
+        writer++;
+      }
+    }
+
+    if( reader != port_class->reader_count ||
+        writer != port_class->writer_count ) {
+      printf( "%s: port dispatch test: extra handlers for port 0x%04x\n",
+              fuse_progname, port );
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* Time finding the handlers for a port with the dispatch table against
+   walking the list of active ports as used to be done, along with the
+   cost of rebuilding the table */
+void
+periph_dispatch_benchmark( void )
+{
+  const libspectrum_dword lookups = 4000000, rebuilds = 20;
+  libspectrum_dword i, seed, handlers_list, handlers_table;
+  double start, list_time, table_time, rebuild_time;
+  libspectrum_word port;
+  GSList *ptr;
+
+  start = timer_get_time();
+  for( i = 0; i < rebuilds; i++ ) port_dispatch_rebuild();
+  rebuild_time = timer_get_time() - start;
+
+  seed = 1; handlers_list = 0;
+  start = timer_get_time();
+
+  for( i = 0; i < lookups; i++ ) {
+    seed = seed * 1103515245 + 12345;
+    port = seed >> 16;
+
+    for( ptr = ports; ptr; ptr = ptr->next ) {
+      periph_port_private_t *private = ptr->data;
+      const periph_port_t *response = &( private->port );
+
+      if( ( port & response->mask ) != response->value ) continue;
+      if( response->read ) handlers_list++;
+      if( response->write ) handlers_list++;
+    }
+  }
+
+  list_time = timer_get_time() - start;
+
+  seed = 1; handlers_table = 0;
+  start = timer_get_time();
+
+  for( i = 0; i < lookups; i++ ) {
+    const port_class_t *port_class;
+
+    seed = seed * 1103515245 + 12345;
+    port = seed >> 16;
+
+    port_class = port_class_lookup( port );
+    handlers_table += port_class->reader_count + port_class->writer_count;
+  }
+
+  table_time = timer_get_time() - start;
+  if( table_time <= 0 ) table_time = 1e-9;
+
+  printf( "%s: port benchmark: %u port responses in %u classes\n",
+          fuse_progname, g_slist_length( ports ), port_classes->len );
+  printf( "%s: port benchmark: list walk %.2f ns/port, "
+          "dispatch table %.2f ns/port (%.1f times faster)\n",
+          fuse_progname, list_time / lookups * 1e9,
+          table_time / lookups * 1e9, list_time / table_time );
+  printf( "%s: port benchmark: table rebuild %.3f ms\n", fuse_progname,
+          rebuild_time / rebuilds * 1e3 );
+
+  if( handlers_list != handlers_table )
+    printf( "%s: port benchmark: table and list disagree\n",
+            fuse_progname );
+}
+
 /* Register debugger page/unpage events for a peripheral */
 void
 periph_register_paging_events( const char *type_string, int *page_event,
@@ -171,6 +171,10 @@ void periph_disable_optional( void );
 void periph_register_paging_events( const char *type_string, int *page_event,
 				    int *unpage_event );
 
+int periph_dispatch_unittest( void );
+
+void periph_dispatch_benchmark( void );
+
 libspectrum_byte periph_merge_floating_bus( libspectrum_byte value,
                                             libspectrum_byte attached,
                                             libspectrum_byte floating_bus );
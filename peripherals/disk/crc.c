@@ -70,6 +70,16 @@ crc_fdc( libspectrum_word crc, libspectrum_byte data )
 	     0xffff;
 }
 
+libspectrum_word
+crc_fdc_block( libspectrum_word crc, const libspectrum_byte *data, size_t len )
+{
+  while( len-- )
+    crc = ( ( crc << 8 ) ^ crc_fdc_table[( ( crc >> 8 ) ^ *data++ ) & 0xff] ) &
+          0xffff;
+
+  return crc;
+}
+
 libspectrum_signed_dword
 crc_udi( libspectrum_signed_dword crc, libspectrum_byte data )
 {
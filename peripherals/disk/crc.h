@@ -24,6 +24,8 @@
 #define FUSE_CRC_H
 
 libspectrum_word crc_fdc( libspectrum_word crc, libspectrum_byte data );
+libspectrum_word crc_fdc_block( libspectrum_word crc,
+                                const libspectrum_byte *data, size_t len );
 libspectrum_signed_dword crc_udi( libspectrum_signed_dword crc, libspectrum_byte data );
 
 #endif /* FUSE_CRC_H */
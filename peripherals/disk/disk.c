@@ -104,8 +104,45 @@ typedef struct buffer_t {		/* to store buffer data */
   size_t index;
 } buffer_t;
 
+/* An image file which some tracks have still to be decoded from */
+typedef struct disk_source_t {
+  utils_file file;
+  long *offset;		/* where each track starts in the file, or -1 */
+  int pending;		/* number of tracks still to be decoded */
+} disk_source_t;
+
 void disk_update_tlens( disk_t *d );
 
+static int
+track_pending( const disk_t *d, int idx )
+{
+  return d->source != NULL && d->source->offset[ idx ] != -1;
+}
+
+static void
+source_release( disk_t *d )
+{
+  if( d->source == NULL )
+    return;
+
+  utils_close_file( &d->source->file );
+  libspectrum_free( d->source->offset );
+  libspectrum_free( d->source );
+  d->source = NULL;
+}
+
+/* Decode every track still to be decoded, and let go of the image file */
+static void
+source_decode_all( disk_t *d )
+{
+  int i;
+
+  for( i = 0; d->source != NULL && i < d->sides * d->cylinders; i++ )
+    if( track_pending( d, i ) ) disk_decode_track( d, i );
+
+  source_release( d );
+}
+
 const char *
 disk_strerror( int error )
 {
@@ -155,30 +192,140 @@ position_context_restore( disk_t *d, const disk_position_context_t *c )
   d->i      = c->i;
 }
 
+/* Is there an ID address mark at byte `i' of the current track? That's
+   0xfe with a clock mark, or after 0xa1 with a clock mark. Weak data after
+   0xa1 counts too, as a controller may read it as 0xfe. The track is
+   circular, so the 0xa1 may be the last byte of it */
 static int
-id_read( disk_t *d, int *head, int *track, int *sector, int *length )
+id_mark_at( const disk_t *d, int i, int bpt )
 {
-  int a1mark = 0;
+  int prev = i ? i - 1 : bpt - 1;
+  int a1mark = d->track[ prev ] == 0xa1 && bitmap_test( d->clocks, prev );
 
-  while( d->i < d->bpt ) {
-    if( d->track[ d->i ] == 0xa1 && 
-	bitmap_test( d->clocks, d->i ) ) {		/* 0xa1 with clock */
-      a1mark = 1;
-    } else if( d->track[ d->i ] == 0xfe && 
-	( bitmap_test( d->clocks, d->i ) ||		/* 0xfe with clock */
-	  a1mark ) ) {						/* or 0xfe with 0xa1 */
-      d->i++;
-      *track  = d->track[ d->i++ ];
-      *head   = d->track[ d->i++ ];
-      *sector = d->track[ d->i++ ];
-      *length = d->track[ d->i++ ];
-      d->i += 2;	/* skip CRC */
-      return 1;
-    } else {
-      a1mark = 0;
+  if( d->track[ i ] == 0xfe )
+    return bitmap_test( d->clocks, i ) || a1mark;
+
+  return a1mark && bitmap_test( d->weak, i );
+}
+
+static void
+track_ids_build( disk_t *d, disk_track_ids_t *t )
+{
+  int bpt = d->track[-3] + 256 * d->track[-2];
+  int i;
+  disk_id_t *id;
+
+  t->count = 0;
+  for( i = 0; i < bpt; i++ ) {
+    if( !id_mark_at( d, i, bpt ) )
+      continue;
+
+    if( t->count == t->size ) {
+      t->size = t->size ? 2 * t->size : 32;
+      t->ids = libspectrum_renew( disk_id_t, t->ids, t->size );
     }
-    d->i++;
+    id = &t->ids[ t->count++ ];
+
+    id->mark = i;
+    for( id->sync = i;
+         id->sync > 0 && bitmap_test( d->clocks, id->sync - 1 ); id->sync-- )
+      ;
+    id->c = d->track[ ( i + 1 ) % bpt ];
+    id->h = d->track[ ( i + 2 ) % bpt ];
+    id->r = d->track[ ( i + 3 ) % bpt ];
+    id->n = d->track[ ( i + 4 ) % bpt ];
   }
+
+  t->valid = 1;
+}
+
+static int
+track_index( const disk_t *d )
+{
+  return ( d->track - d->data - 3 ) / d->tlen;
+}
+
+const disk_track_ids_t *
+disk_track_ids( disk_t *d )
+{
+  disk_track_ids_t *t;
+
+  if( d->track_ids == NULL )
+    d->track_ids = libspectrum_new0( disk_track_ids_t,
+                                     d->sides * d->cylinders );
+
+  t = &d->track_ids[ track_index( d ) ];
+  if( !t->valid ) track_ids_build( d, t );
+
+  return t;
+}
+
+int
+disk_track_ids_find( const disk_track_ids_t *ids, int pos )
+{
+  int lo = 0, hi = ids->count, mid;
+
+  while( lo < hi ) {
+    mid = ( lo + hi ) / 2;
+    if( ids->ids[ mid ].mark < pos )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+void
+disk_track_changed( disk_t *d )
+{
+  if( d->track_ids != NULL )
+    d->track_ids[ track_index( d ) ].valid = 0;
+}
+
+static void
+track_ids_invalidate( disk_t *d )
+{
+  int i;
+
+  if( d->track_ids == NULL )
+    return;
+
+  for( i = 0; i < d->sides * d->cylinders; i++ )
+    d->track_ids[i].valid = 0;
+}
+
+/* Would scanning the track from byte `from' find `id'? Unlike a
+   controller we don't go round past the end of the track, and so can't
+   see an 0xa1 before `from' either */
+static int
+id_readable( const disk_t *d, const disk_id_t *id, int from )
+{
+  return d->track[ id->mark ] == 0xfe &&
+         ( bitmap_test( d->clocks, id->mark ) || id->mark > from );
+}
+
+static int
+id_read( disk_t *d, int *head, int *track, int *sector, int *length )
+{
+  const disk_track_ids_t *t = disk_track_ids( d );
+  const disk_id_t *id;
+  int i;
+
+  for( i = disk_track_ids_find( t, d->i ); i < t->count; i++ ) {
+    id = &t->ids[i];
+    if( !id_readable( d, id, d->i ) )
+      continue;
+
+    *track  = id->c;
+    *head   = id->h;
+    *sector = id->r;
+    *length = id->n;
+    d->i = id->mark + 7;	/* skip the ID and its CRC */
+    return 1;
+  }
+
+  d->i = d->i > d->bpt ? d->i : d->bpt;
   return 0;
 }
 
@@ -209,12 +356,17 @@ datamark_read( disk_t *d, int *deleted )
 static int
 id_seek( disk_t *d, int sector )
 {
-  int h, t, s, b;
-  d->i = 0;	/* start of the track */
-  while( id_read( d, &h, &t, &s, &b ) ) {
-    if( s == sector )
+  const disk_track_ids_t *t = disk_track_ids( d );
+  int i;
+
+  for( i = 0; i < t->count; i++ ) {
+    if( t->ids[i].r == sector && id_readable( d, &t->ids[i], 0 ) ) {
+      d->i = t->ids[i].mark + 7;	/* skip the ID and its CRC */
       return 1;
+    }
   }
+
+  d->i = d->bpt;
   return 0;
 }
 
@@ -317,28 +469,37 @@ guess_track_geom( disk_t *d, int head, int track, int *sector_base,
   return r;
 }
 
+static void
+update_track_mode( disk_t *d )
+{
+  int j, bpt;
+  int mfm = 0, fm = 0, weak = 0;
+
+  bpt = d->track[-3] + 256 * d->track[-2];
+  for( j = DISK_CLEN( bpt ) - 1; j >= 0; j-- ) {
+    mfm  |= ~d->fm[j];
+    fm   |= d->fm[j];
+    weak |= d->weak[j];
+  }
+  if( mfm && !fm ) d->track[-1] = 0x00;
+  if( !mfm && fm ) d->track[-1] = 0x01;
+  if( mfm &&  fm ) d->track[-1] = 0x02;
+  if( weak ) {
+    d->track[-1] |= 0x80;
+    d->have_weak = 1;
+  }
+}
+
+/* tracks still to be decoded are done by disk_decode_track() */
 static void
 update_tracks_mode( disk_t *d )
 {
-  int i, j, bpt;
-  int mfm, fm, weak;
+  int i;
 
   for( i = 0; i < d->cylinders * d->sides; i++ ) {
+    if( track_pending( d, i ) ) continue;
     DISK_SET_TRACK_IDX( d, i );
-    mfm = 0, fm = 0, weak = 0;
-    bpt = d->track[-3] + 256 * d->track[-2];
-    for( j = DISK_CLEN( bpt ) - 1; j >= 0; j-- ) {
-      mfm  |= ~d->fm[j];
-      fm   |= d->fm[j];
-      weak |= d->weak[j];
-    }
-    if( mfm && !fm ) d->track[-1] = 0x00;
-    if( !mfm && fm ) d->track[-1] = 0x01;
-    if( mfm &&  fm ) d->track[-1] = 0x02;
-    if( weak ) {
-      d->track[-1] |= 0x80;
-      d->have_weak = 1;
-    }
+    update_track_mode( d );
   }
 }
 
@@ -693,10 +854,19 @@ trackgen( disk_t *d, buffer_t *buffer, int head, int track,
 void
 disk_close( disk_t *d )
 {
+  int i;
+
   if( d->data != NULL ) {
     libspectrum_free( d->data );
     d->data = NULL;
   }
+  source_release( d );
+  if( d->track_ids != NULL ) {
+    for( i = 0; i < d->sides * d->cylinders; i++ )
+      libspectrum_free( d->track_ids[i].ids );
+    libspectrum_free( d->track_ids );
+    d->track_ids = NULL;
+  }
   if( d->filename != NULL ) {
     libspectrum_free( d->filename );
     d->filename = NULL;
@@ -746,6 +916,8 @@ disk_alloc( disk_t *d )
   if( dlen == 0 ) return d->status = DISK_GEOM;
 
   d->data = libspectrum_new0( libspectrum_byte, dlen );
+  d->track_ids = NULL;
+  d->source = NULL;
 
   return d->status = DISK_OK;
 }
@@ -797,6 +969,8 @@ int disk_preformat( disk_t *d )
   buffer.file.length = 0;
   buffer.index = 0;
 
+  track_ids_invalidate( d );
+
   if( d->sides == 2 ) {
     if( trackgen( d, &buffer, 1, 0, 0xff, 1, 128,
                   NO_PREINDEX, GAP_MINIMAL_MFM, NO_INTERLEAVE, 0xff ) )
@@ -886,56 +1060,64 @@ udi_pack_tracks( disk_t *d )
     tmp += tlen;
     /* copy clock if needed */
     if( tmp != d->clocks )
-      memcpy( tmp, d->clocks, clen );
+      memmove( tmp, d->clocks, clen );
     if( ttyp == 0x00 || ttyp == 0x01 ) continue;
     tmp += clen;
     if( ttyp & 0x02 ) {		/* copy FM marks */
       if( tmp != d->fm )
-        memcpy( tmp, d->fm, clen );
+        memmove( tmp, d->fm, clen );
       tmp += clen;
     }
     if( ! ( ttyp & 0x80 ) ) continue;
     if( tmp != d->weak )		/* copy WEAK marks*/
-      memcpy( tmp, d->weak, clen );
+      memmove( tmp, d->weak, clen );
   }
 }
 
 static void
-udi_unpack_tracks( disk_t *d )
+udi_unpack_track( disk_t *d )
 {
-  int i, tlen, clen, ttyp;
+  int tlen, clen, ttyp;
   libspectrum_byte *tmp;
   libspectrum_byte mask[] = { 0xff, 0x80, 0xc0, 0xe0, 0xf0, 0xf8, 0xfc, 0xfe };
 
+  tmp = d->track;
+  ttyp = tmp[-1];
+  tlen = tmp[-3] + 256 * tmp[-2];
+  clen = DISK_CLEN( tlen );
+  tmp += tlen;
+  if( ttyp & 0x80 ) tmp += clen;
+  if( ttyp & 0x02 ) tmp += clen;
+  if( ( ttyp & 0x80 ) ) {	/* copy WEAK marks*/
+    if( tmp != d->weak )
+      memmove( d->weak, tmp, clen );
+    tmp -= clen;
+  } else {			/* clear WEAK marks*/
+    memset( d->weak, 0, clen );
+  }
+  if( ttyp & 0x02 ) {		/* copy FM marks */
+    if( tmp != d->fm )
+      memmove( d->fm, tmp, clen );
+    tmp -= clen;
+  } else {			/* set/clear FM marks*/
+    memset( d->fm, ttyp & 0x01 ? 0xff : 0, clen );
+    if( tlen % 8 ) {		/* adjust last byte */
+      d->fm[clen - 1] &= mask[ tlen % 8 ];
+    }
+  }
+  /* copy clock if needed */
+  if( tmp != d->clocks )
+    memmove( d->clocks, tmp, clen );
+}
+
+static void
+udi_unpack_tracks( disk_t *d )
+{
+  int i;
+
   for( i = 0; i < d->sides * d->cylinders; i++ ) {
     DISK_SET_TRACK_IDX( d, i );
-    tmp = d->track;
-    ttyp = tmp[-1];
-    tlen = tmp[-3] + 256 * tmp[-2];
-    clen = DISK_CLEN( tlen );
-    tmp += tlen;
-    if( ttyp & 0x80 ) tmp += clen;
-    if( ttyp & 0x02 ) tmp += clen;
-    if( ( ttyp & 0x80 ) ) {	/* copy WEAK marks*/
-      if( tmp != d->weak )
-        memcpy( d->weak, tmp, clen );
-      tmp -= clen;
-    } else {			/* clear WEAK marks*/
-      memset( d->weak, 0, clen );
-    }
-    if( ttyp & 0x02 ) {		/* copy FM marks */
-      if( tmp != d->fm )
-        memcpy( d->fm, tmp, clen );
-      tmp -= clen;
-    } else {			/* set/clear FM marks*/
-      memset( d->fm, ttyp & 0x01 ? 0xff : 0, clen );
-      if( tlen % 8 ) {		/* adjust last byte */
-        d->fm[clen - 1] &= mask[ tlen % 8 ];
-      }
-    }
-    /* copy clock if needed */
-    if( tmp != d->clocks )
-      memcpy( d->clocks, tmp, clen );
+    udi_unpack_track( d );
   }
 }
 
@@ -946,40 +1128,47 @@ udi_unpack_tracks( disk_t *d )
 					( type & 0x02 ? 1 : 0 ) + \
 					( type & 0x80 ? 1 : 0 ) ) )
 
+/* uncompress the current track, using `data' as scratch space */
 static int
-udi_uncompress_tracks( disk_t *d )
+udi_uncompress_track( disk_t *d, libspectrum_byte **data, size_t *data_size )
 {
-  int i;
-  libspectrum_byte *data = NULL;
 #ifdef LIBSPECTRUM_SUPPORTS_ZLIB_COMPRESSION
-  size_t data_size = 0;
   int bpt, tlen, clen, ttyp;
 #endif			/* #ifdef LIBSPECTRUM_SUPPORTS_ZLIB_COMPRESSION */
 
-  for( i = 0; i < d->sides * d->cylinders; i++ ) {
-    DISK_SET_TRACK_IDX( d, i );
-    if( d->track[-1] != 0xf0 ) continue;	/* if not compressed */
+  if( d->track[-1] != 0xf0 ) return DISK_OK;	/* if not compressed */
 
 #ifndef LIBSPECTRUM_SUPPORTS_ZLIB_COMPRESSION
-    /* if libspectrum cannot support */
-    return d->status = DISK_UNSUP;
+  /* if libspectrum cannot support */
+  return d->status = DISK_UNSUP;
 #else 			/* #ifndef LIBSPECTRUM_SUPPORTS_ZLIB_COMPRESSION */
-    clen = d->track[-3] + 256 * d->track[-2] + 1;
-    ttyp = d->track[0];				/* compressed track type   */
-    bpt = d->track[1] + 256 * d->track[2];	/* compressed track len... */
-    tlen = UDI_TLEN( ttyp, bpt );
-    d->track[-1] = ttyp;
-    d->track[-3] = d->track[1];
-    d->track[-2] = d->track[2];
-    if( udi_read_compressed( d->track + 3, clen, tlen, &data, &data_size ) ) {
-      if( data ) libspectrum_free( data );
-      return d->status = DISK_UNSUP;
-    }
-    memcpy( d->track, data, tlen );		/* read track */
+  clen = d->track[-3] + 256 * d->track[-2] + 1;
+  ttyp = d->track[0];				/* compressed track type   */
+  bpt = d->track[1] + 256 * d->track[2];	/* compressed track len... */
+  tlen = UDI_TLEN( ttyp, bpt );
+  d->track[-1] = ttyp;
+  d->track[-3] = d->track[1];
+  d->track[-2] = d->track[2];
+  if( udi_read_compressed( d->track + 3, clen, tlen, data, data_size ) )
+    return d->status = DISK_UNSUP;
+  memcpy( d->track, *data, tlen );		/* read track */
+  return DISK_OK;
 #endif			/* #ifndef LIBSPECTRUM_SUPPORTS_ZLIB_COMPRESSION */
+}
+
+static int
+udi_uncompress_tracks( disk_t *d )
+{
+  int i, error = DISK_OK;
+  libspectrum_byte *data = NULL;
+  size_t data_size = 0;
+
+  for( i = 0; i < d->sides * d->cylinders && !error; i++ ) {
+    DISK_SET_TRACK_IDX( d, i );
+    error = udi_uncompress_track( d, &data, &data_size );
   }
   if( data ) libspectrum_free( data );
-  return DISK_OK;
+  return error;
 }
 
 #ifdef LIBSPECTRUM_SUPPORTS_ZLIB_COMPRESSION
@@ -1014,12 +1203,79 @@ udi_compress_tracks( disk_t *d )
 }
 #endif			/* #ifdef LIBSPECTRUM_SUPPORTS_ZLIB_COMPRESSION */
 
+#ifdef LIBSPECTRUM_SUPPORTS_ZLIB_COMPRESSION
+static const int udi_compression = 1;
+#else			/* #ifdef LIBSPECTRUM_SUPPORTS_ZLIB_COMPRESSION */
+static const int udi_compression = 0;	/* report unsupported tracks on open */
+#endif			/* #ifdef LIBSPECTRUM_SUPPORTS_ZLIB_COMPRESSION */
+
+/* length of the UDI record at the current position of `buffer', not
+   counting the 3 byte header of an ordinary track */
+static int
+udi_record_len( buffer_t *buffer )
+{
+  int ttyp = buff[0], tlen = buff[1] + 256 * buff[2];
+
+  if( ttyp == 0x83 )				/* multiple read */
+    return ( tlen & 0xfff8 ) * ( tlen & 0x07 );
+  if( ttyp == 0xf0 )				/* compressed */
+    return tlen + 4;
+  return UDI_TLEN( ttyp, tlen );
+}
+
+/* move past a track and any multiple read records after it */
+static void
+udi_skip_track( buffer_t *buffer, size_t eof )
+{
+  buffseek( buffer, 3 + udi_record_len( buffer ), SEEK_CUR );
+  while( buffer->index < eof && buff[0] == 0x83 )
+    buffseek( buffer, udi_record_len( buffer ), SEEK_CUR );
+}
+
+/* read a track and any multiple read records after it into track `idx' */
+static int
+udi_read_track( buffer_t *buffer, disk_t *d, int idx, size_t eof )
+{
+  libspectrum_byte *weak, *data = NULL;
+  size_t data_size = 0;
+  int tlen, error;
+
+  DISK_SET_TRACK_IDX( d, idx );
+  memset( d->track, 0x4e, d->bpt );		/* fillup */
+  tlen = udi_record_len( buffer );		/* read track + clocks */
+  d->track[-1] = buff[0];
+  d->track[-3] = buff[1];
+  d->track[-2] = buff[2];
+  buffer->index += 3;
+  buffread( d->track, tlen, buffer );		/* first read data */
+
+  weak = d->weak;
+  while( buffer->index < eof && buff[0] == 0x83 ) {	/* multiple read */
+    d->weak = weak + buff[3] + 256 * buff[4];	/* add offset to weak */
+    tlen = ( buff[1] + 256 * buff[2] ) >> 3;	/* weak len in bytes */
+    for( tlen--; tlen >= 0; tlen-- )
+      d->weak[tlen] = 0xff;
+    buffseek( buffer, udi_record_len( buffer ), SEEK_CUR );
+  }
+
+  error = udi_uncompress_track( d, &data, &data_size );
+  if( data ) libspectrum_free( data );
+  if( error ) return error;
+
+  DISK_SET_TRACK_IDX( d, idx );
+  udi_unpack_track( d );
+
+  return DISK_OK;
+}
+
 static int
 open_udi( buffer_t *buffer, disk_t *d )
 {
   int i, bpt, ttyp, tlen, error;
   size_t eof;
   libspectrum_dword crc;
+  disk_source_t *source;
+  int lazy = settings_current.disk_lazy_load, weak = 0;
 
   crc = ~(libspectrum_dword) 0;
 
@@ -1059,14 +1315,18 @@ open_udi( buffer_t *buffer, disk_t *d )
       i--; bpt = 0;					/* not a real track */
       tlen = buff[1] + 256 * buff[2];		/* current track len... */
       tlen = ( tlen & 0xfff8 ) * ( tlen & 0x07 );
+      weak = 1;
     } else if( ttyp == 0xf0 ) {			/* compressed track */
       if( buffavail( buffer ) < 7 )
         return d->status = DISK_OPEN;
       bpt = buff[4] + 256 * buff[5];
       tlen = 7 + buff[1] + 256 * buff[2];
+      if( buff[3] & 0x80 ) weak = 1;
+      lazy = lazy && udi_compression;
     } else {
       bpt = buff[1] + 256 * buff[2];		/* current track len... */
       tlen = 3 + UDI_TLEN( ttyp, bpt );
+      if( ttyp & 0x80 ) weak = 1;
     }
     if( bpt > d->bpt )
       d->bpt = bpt;
@@ -1085,38 +1345,28 @@ open_udi( buffer_t *buffer, disk_t *d )
   d->bpt = bpt;		/* restore the maximal byte per track */
   buffer->index = 16;
 
-  for( i = 0; buffer->index < eof; i++ ) {
-    DISK_SET_TRACK_IDX( d, i );
-    ttyp = buff[0];
-    bpt = buff[1] + 256 * buff[2];		/* current track len... */
-
-    memset( d->track, 0x4e, d->bpt );		/* fillup */
-						/* read track + clocks */
-    if( ttyp == 0x83 ) {			/* multiple read */
-      i--;					/* not a real track */
-      DISK_SET_TRACK_IDX( d, i );		/* back to previouse track */
-      d->weak += buff[3] + 256 * buff[4];	/* add offset to weak */
-      tlen = ( buff[1] + 256 * buff[2] ) >> 3;	/* weak len in bytes */
-      for( tlen--; tlen >= 0; tlen-- )
-        d->weak[tlen] = 0xff;
-      tlen = buff[1] + 256 * buff[2];		/* current track len... */
-      tlen = ( tlen & 0xfff8 ) * ( tlen & 0x07 );
-      buffseek( buffer, tlen, SEEK_CUR );
-    } else {
-      if( ttyp == 0xf0 )			/* compressed */
-        tlen = bpt + 4;
-      else
-        tlen = UDI_TLEN( ttyp, bpt );
-      d->track[-1] = ttyp;
-      d->track[-3] = buff[1];
-      d->track[-2] = buff[2];
-      buffer->index += 3;
-      buffread( d->track, tlen, buffer );	/* first read data */
+  if( lazy ) {			/* just note where the tracks are */
+    source = libspectrum_new( disk_source_t, 1 );
+    source->offset = libspectrum_new( long, d->sides * d->cylinders );
+    source->pending = 0;
+    for( i = 0; i < d->sides * d->cylinders; i++ )
+      source->offset[i] = -1;
+    for( i = 0; buffer->index < eof && i < d->sides * d->cylinders; i++ ) {
+      source->offset[i] = buffer->index;
+      source->pending++;
+      udi_skip_track( buffer, eof );
     }
+    source->file = buffer->file;
+    buffer->file.buffer = NULL;			/* the disk has it now */
+    d->source = source;
+    d->have_weak = weak;
+    return d->status = DISK_OK;
+  }
+
+  for( i = 0; buffer->index < eof && i < d->sides * d->cylinders; i++ ) {
+    error = udi_read_track( buffer, d, i, eof );
+    if( error ) return error;
   }
-  error = udi_uncompress_tracks( d );
-  if( error ) return error;
-  udi_unpack_tracks( d );
 
   return d->status = DISK_OK;
 }
@@ -2068,6 +2318,15 @@ open_td0( buffer_t *buffer, disk_t *d, int preindex )
   return d->status = DISK_OK;
 }
 
+static void
+update_track_tlen( disk_t *d )
+{
+  if( d->track[-3] + 256 * d->track[-2] == 0 ) {
+    d->track[-3] = d->bpt & 0xff;
+    d->track[-2] = ( d->bpt >> 8 ) & 0xff;
+  }
+}
+
 /* update tracks TLEN */
 void
 disk_update_tlens( disk_t *d )
@@ -2075,14 +2334,45 @@ disk_update_tlens( disk_t *d )
   int i;
 
   for( i = 0; i < d->sides * d->cylinders; i++ ) {	/* check tracks */
+    if( track_pending( d, i ) ) continue;
     DISK_SET_TRACK_IDX( d, i );
-    if( d->track[-3] + 256 * d->track[-2] == 0 ) {
-      d->track[-3] = d->bpt & 0xff;
-      d->track[-2] = ( d->bpt >> 8 ) & 0xff;
-    }
+    update_track_tlen( d );
   }
 }
 
+void
+disk_decode_track( disk_t *d, int idx )
+{
+  disk_source_t *source = d->source;
+  buffer_t buffer;
+  int bpt;
+
+  if( !track_pending( d, idx ) )
+    return;
+
+  buffer.file = source->file;
+  buffer.index = source->offset[ idx ];
+  source->offset[ idx ] = -1;		/* so DISK_SET_TRACK_IDX() leaves it be */
+
+  if( udi_read_track( &buffer, d, idx, source->file.length - 4 ) ) {
+    ui_error( UI_ERROR_WARNING, "cannot decode track %d of '%s'", idx,
+              d->filename );
+    DISK_SET_TRACK_IDX( d, idx );	/* leave it unformatted */
+    bpt = d->bpt;
+    memset( d->track, 0, bpt + 3 * DISK_CLEN( bpt ) );
+    d->track[-1] = 0x00;
+    d->track[-3] = bpt & 0xff;
+    d->track[-2] = ( bpt >> 8 ) & 0xff;
+  }
+
+  DISK_SET_TRACK_IDX( d, idx );
+  update_track_tlen( d );
+  update_track_mode( d );
+
+  if( --source->pending == 0 )
+    source_release( d );
+}
+
 /* open a disk image file, read and convert to our format
  * if preindex != 0 we generate preindex gap if needed
  */
@@ -2102,7 +2392,12 @@ disk_open2( disk_t *d, const char *filename, int preindex )
     d->wrprot = 0;
 #endif			/* #ifdef GEKKO */
 
-  if( utils_read_file( filename, &buffer.file ) )
+  /* A lazily loaded image keeps its buffer until every track has been
+     decoded, so it mustn't be a mapping: the file could be truncated or
+     rewritten under us in the meantime */
+  if( settings_current.disk_lazy_load ?
+      utils_read_file( filename, &buffer.file ) :
+      utils_map_file( filename, &buffer.file ) )
     return d->status = DISK_OPEN;
 
   buffer.index = 0;
@@ -2164,7 +2459,8 @@ disk_open2( disk_t *d, const char *filename, int preindex )
     utils_close_file( &buffer.file );
     return d->status;
   }
-  utils_close_file( &buffer.file );
+  if( buffer.file.buffer != NULL )	/* unless tracks are decoded later */
+    utils_close_file( &buffer.file );
   d->dirty = 0;
   disk_update_tlens( d );
   update_tracks_mode( d );
@@ -2194,6 +2490,9 @@ disk_merge_sides( disk_t *d, disk_t *d1, disk_t *d2, int autofill )
   d->bpt = d1->bpt;
   d->density = DISK_DENS_AUTO;
 
+  source_decode_all( d1 );	/* the tracks are copied wholesale below */
+  source_decode_all( d2 );
+
   if( disk_alloc( d ) != DISK_OK )
     return d->status;
 
@@ -2276,8 +2575,8 @@ disk_open( disk_t *d, const char *filename, int preindex, int merge_disks )
   }
   if( g != 4 )
     return d->status = disk_open2( d, filename, preindex );
-  d1.data = NULL; d1.flag = d->flag;
-  d2.data = NULL; d2.flag = d->flag;
+  d1.data = NULL; d1.flag = d->flag; d1.track_ids = NULL; d1.source = NULL;
+  d2.data = NULL; d2.flag = d->flag; d2.track_ids = NULL; d2.source = NULL;
   filename2 = utils_safe_strdup( filename );
   *(filename2 + pos) = c;
 
@@ -2841,6 +3140,8 @@ disk_write( disk_t *d, const char *filename )
   libspectrum_byte *t, *c, *f, *w;
   int idx;
 
+  source_decode_all( d );	/* we may be about to overwrite the image */
+
   if( ( file = fopen( filename, "wb" ) ) == NULL )
     return d->status = DISK_WRFILE;
 
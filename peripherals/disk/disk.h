@@ -84,6 +84,21 @@ typedef enum disk_dens_t {
   DISK_HD,		/* 12500 bpt*/
 } disk_dens_t;
 
+/* An ID address mark found on a track */
+typedef struct disk_id_t {
+  int sync;		/* first byte of the clock marked run ending at the mark */
+  int mark;		/* the 0xfe address mark */
+  libspectrum_byte c, h, r, n;	/* cylinder, head, sector and length code */
+} disk_id_t;
+
+/* Every ID on a track, sorted by position */
+typedef struct disk_track_ids_t {
+  int valid;		/* 0 if the track has changed since it was indexed */
+  int count;
+  int size;		/* allocated length of `ids' */
+  disk_id_t *ids;
+} disk_track_ids_t;
+
 typedef struct disk_t {
   char *filename;	/* original filename */
   int sides;		/* 1 or 2 */
@@ -104,6 +119,9 @@ typedef struct disk_t {
   int i;			/* index for track and clocks */
   disk_type_t type;		/* DISK_UDI, ... */
   disk_dens_t density;		/* DISK_SD DISK_DD, or DISK_HD */
+  disk_track_ids_t *track_ids;	/* ID index of every track, built on demand */
+  struct disk_source_t *source;	/* image file some tracks are still to be
+				   decoded from, or NULL */
 } disk_t;
 
 /* every track data:
@@ -118,6 +136,7 @@ TRACK_LEN TYPE TRACK......DATA CLOCK..MARKS MF..MARKS WEAK..MARKS
 #define DISK_CLEN( bpt ) ( ( bpt ) / 8 + ( ( bpt ) % 8 ? 1 : 0 ) )
 
 #define DISK_SET_TRACK_IDX( d, idx ) \
+   if( d->source != NULL ) disk_decode_track( d, idx ); \
    d->track = d->data + 3 + ( idx ) * d->tlen; \
    d->clocks = d->track  + d->bpt; \
    d->fm     = d->clocks + DISK_CLEN( d->bpt ); \
@@ -163,5 +182,19 @@ int disk_preformat( disk_t *d );
 /* close a disk and free buffers
 */
 void disk_close( disk_t *d );
+/* decode track `idx' from the image file if that hasn't been done yet;
+   DISK_SET_TRACK_IDX() does this for us
+*/
+void disk_decode_track( disk_t *d, int idx );
+/* return the ID index of the current track, (re)building it if needed
+*/
+const disk_track_ids_t *disk_track_ids( disk_t *d );
+/* return the first ID in `ids' with its address mark at or after `pos',
+   or ids->count if there is none
+*/
+int disk_track_ids_find( const disk_track_ids_t *ids, int pos );
+/* the current track has been written, so its ID index is out of date
+*/
+void disk_track_changed( disk_t *d );
 
 #endif /* FUSE_DISK_H */
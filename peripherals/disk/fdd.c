@@ -25,12 +25,16 @@
 
 #include <config.h>
 
+#include <stdio.h>
+#include <string.h>
+
 #include <libspectrum.h>
 
 #include "bitmap.h"
 #include "compat.h"
 #include "event.h"
 #include "fdd.h"
+#include "fuse.h"
 #include "infrastructure/startup_manager.h"
 #include "machine.h"
 #include "spectrum.h"
@@ -75,6 +79,10 @@ static int index_event;
 
 static int fdd_motor = 0; /* to manage 'disk' icon */
 
+/* State for the generator used to garble weak data; it just needs to be
+   quick and give different results on each read */
+static libspectrum_dword fdd_weak_seed = 0x2545f491;
+
 static int
 fdd_init_events( void *context )
 {
@@ -133,6 +141,7 @@ fdd_set_data( fdd_t *d, int fact )
   }
 
   DISK_SET_TRACK( &d->disk, head, d->c_cylinder );
+  d->plain_end = 0;
   d->c_bpt = d->disk.track[-3] + 256 * d->disk.track[-2];
   if( fact > 0 ) {
     /* this generate a bpt/fact +-10% triangular distribution skip in bytes 
@@ -347,6 +356,59 @@ fdd_step( fdd_t *d, fdd_dir_t direction )
   if( d->loaded && d->selected ) d->dskchg = 1;
 }
 
+static inline int
+fdd_weak_random( void )
+{
+  fdd_weak_seed ^= fdd_weak_seed << 13;
+  fdd_weak_seed ^= fdd_weak_seed >> 17;
+  fdd_weak_seed ^= fdd_weak_seed << 5;
+
+  return fdd_weak_seed >> 8;
+}
+
+/* Can bytes actually be transferred to or from the disk? */
+static inline int
+fdd_data_ready( fdd_t *d )
+{
+  return d->selected && d->ready && d->loadhead && d->disk.track != NULL;
+}
+
+/* Set d->plain_end to the end of the run of bytes from d->disk.i with no
+   clock mark or weak data and the same FM mark. Whole bitmap bytes are
+   checked at once where possible. The run only ever covers bytes ahead of
+   the head, so must be dropped whenever it goes back to the start of the
+   track or moves to another one */
+static void
+fdd_find_plain_run( fdd_t *d )
+{
+  disk_t *disk = &d->disk;
+  int i = disk->i, fm;
+
+  if( bitmap_test( disk->clocks, i ) || bitmap_test( disk->weak, i ) ) {
+    d->plain_end = i;
+    return;
+  }
+
+  fm = bitmap_test( disk->fm, i ) ? 1 : 0;
+  d->plain_marks = fm;
+
+  for( i++; i < d->c_bpt; ) {
+    if( !( i % 8 ) && i + 8 <= d->c_bpt ) {
+      if( !disk->clocks[ i / 8 ] && !disk->weak[ i / 8 ] &&
+          disk->fm[ i / 8 ] == ( fm ? 0xff : 0x00 ) ) {
+        i += 8;
+        continue;
+      }
+    }
+    if( bitmap_test( disk->clocks, i ) || bitmap_test( disk->weak, i ) ||
+        ( bitmap_test( disk->fm, i ) ? 1 : 0 ) != fm )
+      break;
+    i++;
+  }
+
+  d->plain_end = i;
+}
+
 /* read/write next byte from/to sector */
 static int
 fdd_read_write_data( fdd_t *d, fdd_write_t write )
@@ -355,6 +417,7 @@ fdd_read_write_data( fdd_t *d, fdd_write_t write )
     if( d->loaded && d->motoron ) {			/* spin the disk */
       if( d->disk.i >= d->c_bpt ) {		/* next data byte */
         d->disk.i = 0;
+        d->plain_end = 0;
       }
       if( !write )
         d->data = 0x100;				/* no data */
@@ -366,6 +429,7 @@ fdd_read_write_data( fdd_t *d, fdd_write_t write )
 
   if( d->disk.i >= d->c_bpt ) {		/* next data byte */
     d->disk.i = 0;
+    d->plain_end = 0;
   }
   if( write ) {
     if( d->disk.wrprot ) {
@@ -392,17 +456,27 @@ fdd_read_write_data( fdd_t *d, fdd_write_t write )
     bitmap_reset( d->disk.weak, d->disk.i );
 #endif
     d->disk.dirty = 1;
+    d->plain_end = 0;
+    disk_track_changed( &d->disk );
   } else {	/* read */
-    d->data = d->disk.track[ d->disk.i ];
-    if( bitmap_test( d->disk.clocks, d->disk.i ) )
-      d->data |= 0xff00;
-    d->marks = 0;
-    if( bitmap_test( d->disk.fm, d->disk.i ) )
-      d->marks |= 0x01;
-    if( bitmap_test( d->disk.weak, d->disk.i ) ) {
-      d->marks |= 0x02;
-      /* mess up data byte */
-      d->data &= rand() % 0xff, d->data |= rand() % 0xff;
+    if( d->disk.i >= d->plain_end ) fdd_find_plain_run( d );
+
+    if( d->disk.i < d->plain_end ) {	/* ordinary data */
+      d->data = d->disk.track[ d->disk.i ];
+      d->marks = d->plain_marks;
+    } else {
+      d->data = d->disk.track[ d->disk.i ];
+      if( bitmap_test( d->disk.clocks, d->disk.i ) )
+        d->data |= 0xff00;
+      d->marks = 0;
+      if( bitmap_test( d->disk.fm, d->disk.i ) )
+        d->marks |= 0x01;
+      if( bitmap_test( d->disk.weak, d->disk.i ) ) {
+        d->marks |= 0x02;
+        /* mess up data byte */
+        d->data &= fdd_weak_random() % 0xff;
+        d->data |= fdd_weak_random() % 0xff;
+      }
     }
   }
   d->disk.i++;
@@ -418,6 +492,42 @@ fdd_read_data( fdd_t *d )
   return fdd_read_write_data( d, FDD_READ );
 }
 
+int
+fdd_read_block( fdd_t *d, libspectrum_byte *buffer, int len )
+{
+  int n;
+
+  while( len > 0 ) {
+    if( !fdd_data_ready( d ) ) {
+      fdd_read_data( d );
+      *buffer++ = d->data; len--;
+      continue;
+    }
+
+    if( d->disk.i >= d->c_bpt ) d->disk.i = d->plain_end = 0;
+    if( d->disk.i >= d->plain_end ) fdd_find_plain_run( d );
+
+    n = d->plain_end - d->disk.i;
+    if( n <= 0 ) {			/* a mark or weak data */
+      fdd_read_data( d );
+      *buffer++ = d->data; len--;
+      continue;
+    }
+
+    if( n > len ) n = len;
+    memcpy( buffer, d->disk.track + d->disk.i, n );
+    buffer += n; len -= n;
+
+    d->disk.i += n;
+    d->data = d->disk.track[ d->disk.i - 1 ];
+    d->marks = d->plain_marks;
+    d->index = d->disk.i >= d->c_bpt ? 1 : 0;
+    d->status = FDD_OK;
+  }
+
+  return d->status;
+}
+
 /* write next byte to sector */
 int
 fdd_write_data( fdd_t *d )
@@ -425,6 +535,112 @@ fdd_write_data( fdd_t *d )
   return fdd_read_write_data( d, FDD_WRITE );
 }
 
+/* Set or clear bits `from' to `to' - 1 of a bitmap */
+static void
+fdd_bitmap_fill( libspectrum_byte *b, int from, int to, int set )
+{
+  for( ; from < to && from % 8; from++ )
+    set ? bitmap_set( b, from ) : bitmap_reset( b, from );
+
+  if( to - from >= 8 ) {
+    memset( b + from / 8, set ? 0xff : 0x00, ( to - from ) / 8 );
+    from += ( to - from ) & ~7;
+  }
+
+  for( ; from < to; from++ )
+    set ? bitmap_set( b, from ) : bitmap_reset( b, from );
+}
+
+int
+fdd_write_block( fdd_t *d, const libspectrum_byte *buffer, int len )
+{
+  disk_t *disk = &d->disk;
+  int n;
+
+  while( len > 0 ) {
+    if( !fdd_data_ready( d ) || disk->wrprot ) {
+      d->data = *buffer++; len--;
+      fdd_write_data( d );
+      continue;
+    }
+
+    if( disk->i >= d->c_bpt ) disk->i = 0;
+
+    n = d->c_bpt - disk->i;
+    if( n > len ) n = len;
+
+    memcpy( disk->track + disk->i, buffer, n );
+    fdd_bitmap_fill( disk->clocks, disk->i, disk->i + n, 0 );
+    fdd_bitmap_fill( disk->fm, disk->i, disk->i + n, d->marks & 0x01 );
+    fdd_bitmap_fill( disk->weak, disk->i, disk->i + n, 0 );
+    buffer += n; len -= n;
+
+    disk->i += n;
+    disk->dirty = 1;
+    d->plain_end = 0;
+    disk_track_changed( disk );
+    d->data = disk->track[ disk->i - 1 ];
+    d->index = disk->i >= d->c_bpt ? 1 : 0;
+    d->status = FDD_OK;
+  }
+
+  return d->status;
+}
+
+int
+fdd_skip_to_id( fdd_t *d )
+{
+  disk_t *disk = &d->disk;
+  const disk_track_ids_t *t;
+  int i, target;
+
+  if( !fdd_data_ready( d ) )
+    return 0;
+
+  if( disk->i >= d->c_bpt ) disk->i = d->plain_end = 0;
+
+  t = disk_track_ids( disk );
+  i = disk_track_ids_find( t, disk->i );
+  if( i < t->count ) {
+    target = t->ids[i].sync;
+  } else {
+    /* a sync run which goes round past the index hole must be read byte by
+       byte, as it may belong to an ID at the start of the track */
+    for( target = d->c_bpt;
+         target > disk->i && bitmap_test( disk->clocks, target - 1 );
+         target-- )
+      ;
+  }
+  if( target <= disk->i )
+    return 0;
+
+  i = target - disk->i;
+  disk->i = target;
+  d->data = disk->track[ target - 1 ];
+  if( bitmap_test( disk->clocks, target - 1 ) )
+    d->data |= 0xff00;
+  d->marks = bitmap_test( disk->fm, target - 1 ) ? 0x01 : 0x00;
+  d->index = target >= d->c_bpt ? 1 : 0;
+  d->status = FDD_OK;
+
+  return i;
+}
+
+libspectrum_dword
+fdd_tstates_since( fdd_t *d, int start )
+{
+  int bytes;
+
+  if( !d->disk.bpt )					/* a whole revolution */
+    return machine_current->timings.processor_speed / 5;
+
+  bytes = d->disk.i - start;
+  if( bytes < 0 ) bytes += d->c_bpt;		/* gone round the index hole */
+
+  return (libspectrum_qword)bytes * machine_current->timings.processor_speed /
+         ( 5 * d->disk.bpt );
+}
+
 void fdd_flip( fdd_t *d, int upsidedown )
 {
   if( !d->loaded )
@@ -450,6 +666,7 @@ fdd_wait_index_hole( fdd_t *d )
     return;
 
   d->disk.i = 0;
+  d->plain_end = 0;
   d->index = 1;
 }
 
@@ -475,3 +692,154 @@ fdd_event( libspectrum_dword last_tstates, int event,
 			 machine_current->timings.processor_speed / 1000,
 			 index_event, d );
 }
+
+/* Unit test support: check the byte at `i' on the current track of `d'
+   against what fdd_read_data() returned, ignoring the value of weak
+   bytes */
+static int
+unittest_check_byte( fdd_t *d, int i, int data, int marks, const char *what )
+{
+  disk_t *disk = &d->disk;
+  int want_data = disk->track[i], want_marks = 0;
+
+  if( bitmap_test( disk->clocks, i ) ) want_data |= 0xff00;
+  if( bitmap_test( disk->fm, i ) ) want_marks |= 0x01;
+  if( bitmap_test( disk->weak, i ) ) {
+    want_marks |= 0x02;
+    want_data = data;
+  }
+
+  if( data != want_data || marks != want_marks ) {
+    printf( "%s: fdd test: %s byte %d was 0x%04x/%d, expected 0x%04x/%d\n",
+            fuse_progname, what, i, data, marks, want_data, want_marks );
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Read `count' bytes from `start' a byte at a time, checking each one */
+static int
+unittest_check_track( fdd_t *d, int start, int count, const char *what )
+{
+  int pos, r = 0;
+
+  d->disk.i = start;
+  while( count-- && !r ) {
+    pos = d->disk.i < d->c_bpt ? d->disk.i : 0;
+    fdd_read_data( d );
+    r = unittest_check_byte( d, pos, d->data, d->marks, what );
+  }
+
+  return r;
+}
+
+/* Check that the runs of ordinary data found by fdd_find_plain_run() and
+   copied by fdd_read_block() give the same bytes as the byte at a time
+   path, that weak data is garbled differently on each read and that
+   writes are seen by later reads */
+int
+fdd_unittest( void )
+{
+  static const int chunks[] = { 1, 7, 64, 3, 513, 2 };
+  const int weak_start = 300, weak_length = 16;
+  libspectrum_byte buffer[ 1024 ];
+  fdd_t d;
+  disk_t *disk = &d.disk;
+  int i, n, pos, r = 0;
+
+  memset( &d, 0, sizeof( d ) );
+  if( disk_new( disk, 1, 40, DISK_DD, DISK_UDI ) != DISK_OK ) {
+    printf( "%s: fdd test: couldn't create a disk\n", fuse_progname );
+    return 1;
+  }
+
+  d.loaded = d.selected = d.ready = d.loadhead = d.motoron = 1;
+  fdd_set_data( &d, 0 );
+
+  /* Ordinary data, with a few clock marks, a run of FM bytes crossing
+     bitmap bytes, weak data and an FM mark right at the end of the track
+     so runs have to stop at the index hole */
+  for( i = 0; i < d.c_bpt; i++ ) {
+    disk->track[i] = i * 7 + 3;
+    bitmap_reset( disk->clocks, i );
+    bitmap_reset( disk->fm, i );
+    bitmap_reset( disk->weak, i );
+  }
+  for( i = 100; i < 103; i++ ) bitmap_set( disk->clocks, i );
+  for( i = 203; i < 261; i++ ) bitmap_set( disk->fm, i );
+  for( i = weak_start; i < weak_start + weak_length; i++ )
+    bitmap_set( disk->weak, i );
+  bitmap_set( disk->fm, d.c_bpt - 1 );
+
+  /* Byte at a time, twice round so the runs are found again after the
+     index hole */
+  r = unittest_check_track( &d, 0, 2 * d.c_bpt, "read" );
+
+  /* In blocks of various sizes, starting part way round so the blocks
+     end in different places and wrap round the index hole */
+  disk->i = 95;
+  for( n = 0, pos = 95; n < 3 * d.c_bpt && !r; ) {
+    int len = chunks[ ( n / 7 ) % ARRAY_SIZE( chunks ) ];
+
+    fdd_read_block( &d, buffer, len );
+    for( i = 0; i < len && !r; i++ ) {
+      int want = disk->track[ pos ];
+      if( !bitmap_test( disk->weak, pos ) && buffer[i] != want ) {
+        printf( "%s: fdd test: block byte %d was 0x%02x, expected 0x%02x\n",
+                fuse_progname, pos, buffer[i], want );
+        r = 1;
+      }
+      if( ++pos >= d.c_bpt ) pos = 0;
+    }
+    if( !r && disk->i != pos && !( pos == 0 && disk->i == d.c_bpt ) ) {
+      printf( "%s: fdd test: head at %d after a block, expected %d\n",
+              fuse_progname, disk->i, pos );
+      r = 1;
+    }
+    n += len;
+  }
+
+  /* Weak data must read differently each time */
+  if( !r ) {
+    disk->i = weak_start;
+    fdd_read_block( &d, buffer, weak_length );
+    disk->i = weak_start;
+    fdd_read_block( &d, buffer + weak_length, weak_length );
+    if( !memcmp( buffer, buffer + weak_length, weak_length ) ) {
+      printf( "%s: fdd test: weak data read the same twice\n",
+              fuse_progname );
+      r = 1;
+    }
+  }
+
+  /* Write a clock mark into the middle of a run which has already been
+     found, then FM data likewise, and check what's read back */
+  if( !r ) {
+    disk->i = 0;
+    fdd_read_data( &d );
+    disk->i = 50;
+    d.data = 0xffa1; d.marks = 0x00;
+    fdd_write_data( &d );
+    r = unittest_check_track( &d, 0, 100, "rewritten" );
+  }
+
+  if( !r ) {
+    disk->i = 0;
+    fdd_read_data( &d );
+    memset( buffer, 0x4e, 40 );
+    d.marks = 0x01;
+    fdd_write_block( &d, buffer, 40 );
+    r = unittest_check_track( &d, 0, 100, "rewritten" );
+  }
+
+  if( !r && ( disk->track[50] != 0xa1 || !bitmap_test( disk->clocks, 50 ) ||
+              disk->track[20] != 0x4e || !bitmap_test( disk->fm, 20 ) ) ) {
+    printf( "%s: fdd test: writes didn't reach the track\n", fuse_progname );
+    r = 1;
+  }
+
+  disk_close( disk );
+
+  return r;
+}
@@ -105,6 +105,8 @@ typedef struct fdd_t {
   int motoron;		/* motor on */
   int loadhead;		/* head loaded */
   int index_pulse;	/* 'second' index hole, for index status */
+  int plain_end;	/* bytes from disk.i up to here have no clock mark, */
+  int plain_marks;	/* are not weak and all have these marks */
 } fdd_t;
 
 typedef struct fdd_params_t {
@@ -147,6 +149,22 @@ int fdd_read_data( fdd_t *d );
    d->idx is set if we reach the 'index hole'.
 */
 int fdd_write_data( fdd_t *d );
+/* Read the next `len' bytes into `buffer', as if by fdd_read_data() but
+   without the clock marks. Runs of ordinary data are copied in one go */
+int fdd_read_block( fdd_t *d, libspectrum_byte *buffer, int len );
+/* Write the next `len' bytes from `buffer' without clock marks and with
+   the FM mark from d->marks, as if by fdd_write_data() */
+int fdd_write_block( fdd_t *d, const libspectrum_byte *buffer, int len );
+/* Spin the disk on to the sync bytes of the next ID address mark, or to
+   the index hole if there is no ID before it, when the bytes in between
+   cannot start an ID. Returns the number of bytes skipped, and sets
+   d->index and d->data as if they had been read by fdd_read_data() */
+int fdd_skip_to_id( fdd_t *d );
+/* Return the T-states taken for the disk to spin from byte `start' to the
+   current position of the head. This is exact to the byte, so even a
+   move of a few bytes takes a non-zero time and the controllers wait for
+   an event rather than carrying straight on */
+libspectrum_dword fdd_tstates_since( fdd_t *d, int start );
 /* set write protect status on loaded disk */
 void fdd_wrprot( fdd_t *d, int wrprot );
 /* to reach index hole */
@@ -154,4 +172,6 @@ void fdd_wait_index_hole( fdd_t *d );
 /* set floppy position ( upsidedown or not )*/
 void fdd_flip( fdd_t *d, int upsidedown );
 
+int fdd_unittest( void );
+
 #endif 	/* FUSE_FDD_H */
@@ -22,6 +22,8 @@
 
 #include <config.h>
 
+#include <string.h>
+
 #include <libspectrum.h>
 
 #include "crc.h"
@@ -167,6 +169,27 @@ crc_add( upd_fdc *f, fdd_t *d )
   f->crc = crc_fdc( f->crc, d->data & 0xff );
 }
 
+/* Scratch space for the GAP and filler bytes read and written in one go */
+static libspectrum_byte block_buffer[ 0x80 << MAX_SIZE_CODE ];
+
+/* Read `len' bytes, adding them to the CRC if `crc' is set */
+static void
+read_block( upd_fdc *f, fdd_t *d, int len, int crc )
+{
+  fdd_read_block( d, block_buffer, len );
+  if( crc ) f->crc = crc_fdc_block( f->crc, block_buffer, len );
+}
+
+/* Write `len' copies of `data' without clock marks, adding them to the CRC
+   if `crc' is set */
+static void
+write_fill( upd_fdc *f, fdd_t *d, libspectrum_byte data, int len, int crc )
+{
+  memset( block_buffer, data, len );
+  fdd_write_block( d, block_buffer, len );
+  if( crc ) f->crc = crc_fdc_block( f->crc, block_buffer, len );
+}
+
 /* 
    Read next ID into f->id_*
    return 0 if found an ID 
@@ -185,6 +208,12 @@ read_id( upd_fdc *f )
   f->id_mark = UPD_FDC_AM_NONE;
   i = f->rev;
   while( i == f->rev && d->ready ) {
+    /* in FM the bytes are read in pairs, so skipping ahead could change
+       which of them gets checked for the mark */
+    if( f->mf && fdd_skip_to_id( d ) && d->index ) {	/* no ID before the index */
+      f->rev--;
+      continue;
+    }
     fdd_read_data( d ); if( d->index ) f->rev--;
     crc_preset( f );
     if( f->mf ) {	/* double density (MFM) */
@@ -518,12 +547,9 @@ start_read_id( upd_fdc *f )
     	0 : f->current_drive->disk.i;			/* start position */
     if( read_id( f ) != 2 )
       f->rev = 0;
-    i = f->current_drive->disk.bpt ? 
-      ( f->current_drive->disk.i - i ) * 200 / f->current_drive->disk.bpt : 200;
+    i = fdd_tstates_since( f->current_drive, i );	/* time to get here */
     if( i > 0 ) {
-      event_add_with_data( tstates + i *		/* i * 1/20 revolution */
-			 machine_current->timings.processor_speed / 1000,
-			 fdc_event, f );
+      event_add_with_data( tstates + i, fdc_event, f );
       return;
     }
   }
@@ -556,12 +582,9 @@ start_read_diag( upd_fdc *f )
     	0 : f->current_drive->disk.i;			/* start position */
     if( read_id( f ) != 2 )
       f->rev = 0;
-    i = f->current_drive->disk.bpt ? 
-      ( f->current_drive->disk.i - i ) * 200 / f->current_drive->disk.bpt : 200;
+    i = fdd_tstates_since( f->current_drive, i );	/* time to get here */
     if( i > 0 ) {
-      event_add_with_data( tstates + i *		/* i * 1/20 revolution */
-			 machine_current->timings.processor_speed / 1000,
-			 fdc_event, f );
+      event_add_with_data( tstates + i, fdc_event, f );
       return;
     }
   }
@@ -626,12 +649,9 @@ multi_track_next:
         f->rev = 0;
       else
         f->id_mark = UPD_FDC_AM_NONE;
-      i = f->current_drive->disk.bpt ? 
-          ( f->current_drive->disk.i - i ) * 200 / f->current_drive->disk.bpt : 200;
+      i = fdd_tstates_since( f->current_drive, i );	/* time to get here */
       if( i > 0 ) {
-        event_add_with_data( tstates + i *		/* i * 1/20 revolution */
-			     machine_current->timings.processor_speed / 1000,
-			     fdc_event, f );
+        event_add_with_data( tstates + i, fdc_event, f );
         return;
       }
     }
@@ -719,12 +739,9 @@ multi_track_next:
         f->rev = 0;
       else
         f->id_mark = UPD_FDC_AM_NONE;
-      i = f->current_drive->disk.bpt ? 
-          ( f->current_drive->disk.i - i ) * 200 / f->current_drive->disk.bpt : 200;
+      i = fdd_tstates_since( f->current_drive, i );	/* time to get here */
       if( i > 0 ) {
-        event_add_with_data( tstates + i *		/* i * 1/20 revolution */
-			     machine_current->timings.processor_speed / 1000,
-			     fdc_event, f );
+        event_add_with_data( tstates + i, fdc_event, f );
         return;
       }
     }
@@ -735,15 +752,9 @@ multi_track_next:
       goto abort_write_data;
     }
 
-    for( i = 11; i > 0; i-- )	/* "delay" 11 GAP byte */
-      fdd_read_data( d );
-    if( f->mf )					/* MFM */
-      for( i = 11; i > 0; i-- )	/* "delay" another 11 GAP byte */
-	fdd_read_data( d );
+    read_block( f, d, f->mf ? 22 : 11, 0 );	/* "delay" 11/22 GAP byte */
 
-    d->data = 0x00;
-    for( i = f->mf ? 12 : 6; i > 0; i-- )	/* write 6/12 zero */
-      fdd_write_data( d );
+    write_fill( f, d, 0x00, f->mf ? 12 : 6, 0 );	/* write 6/12 zero */
     crc_preset( f );
     if( f->mf ) {				/* MFM */
       d->data = 0xffa1;
@@ -791,15 +802,8 @@ start_write_id( upd_fdc *f )
   int i;
   fdd_t *d = f->current_drive;
 
-  d->data = f->mf ? 0x4e : 0xff;
-  for( i = 40; i > 0; i-- )	/* write 40 GAP byte */
-    fdd_write_data( d );
-  if( f->mf )					/* MFM */
-    for( i = 40; i > 0; i-- )	/* write another 40 GAP byte */
-      fdd_write_data( d );
-  d->data = 0x00;
-  for( i = f->mf ? 12 : 6; i > 0; i-- )	/* write 6/12 zero */
-    fdd_write_data( d );
+  write_fill( f, d, f->mf ? 0x4e : 0xff, f->mf ? 80 : 40, 0 );	/* GAP */
+  write_fill( f, d, 0x00, f->mf ? 12 : 6, 0 );	/* write 6/12 zero */
   crc_preset( f );
   if( f->mf ) {				/* MFM */
     d->data = 0xffc2;
@@ -810,12 +814,7 @@ start_write_id( upd_fdc *f )
   d->data = 0x00fc | ( f->mf ? 0x0000 : 0xff00 );	/* write index mark */
   fdd_write_data( d );
 
-  d->data = f->mf ? 0x4e : 0xff;	/* postindex GAP */
-  for( i = 26; i > 0; i-- )	/* write 26 GAP byte */
-    fdd_write_data( d );
-  if( f->mf )					/* MFM */
-    for( i = 24; i > 0; i-- )	/* write another 24 GAP byte */
-      fdd_write_data( d );
+  write_fill( f, d, f->mf ? 0x4e : 0xff, f->mf ? 50 : 26, 0 ); /* postindex GAP */
 
   f->main_status |= UPD_FDC_MAIN_DATAREQ | UPD_FDC_MAIN_DATA_WRITE;
   f->data_offset = 0;
@@ -934,9 +933,9 @@ upd_fdc_read_data( upd_fdc *f )
 
     r = d->data & 0xff;
     if( f->data_offset == f->rlen ) {	/* send only rlen byte to host */
-      while( f->data_offset < f->sector_length ) {
-	fdd_read_data( d ); crc_add( f, d );
-	f->data_offset++;
+      if( f->data_offset < f->sector_length ) {
+        read_block( f, d, f->sector_length - f->data_offset, 1 );
+        f->data_offset = f->sector_length;
       }
     }
     if( ( f->cmd->id == UPD_CMD_READ_DIAG || f->cmd->id == UPD_CMD_READ_DATA )
@@ -1043,15 +1042,8 @@ upd_fdc_write_data( upd_fdc *f, libspectrum_byte data )
         d->data = f->crc & 0xff;
         fdd_write_data( d );			/* write crc2 */
 
-        d->data = f->mf ? 0x4e : 0xff;
-        for( i = 11; i > 0; i-- )	/* write 11 GAP byte */
-          fdd_write_data( d );
-        if( f->mf )					/* MFM */
-          for( i = 11; i > 0; i-- )	/* write another 11 GAP byte */
-	    fdd_write_data( d );
-        d->data = 0x00;
-        for( i = f->mf ? 12 : 6; i > 0; i-- )	/* write 6/12 zero */
-          fdd_write_data( d );
+        write_fill( f, d, f->mf ? 0x4e : 0xff, f->mf ? 22 : 11, 0 ); /* GAP */
+        write_fill( f, d, 0x00, f->mf ? 12 : 6, 0 );	/* write 6/12 zero */
         crc_preset( f );
         if( f->mf ) {				/* MFM */
           d->data = 0xffa1;
@@ -1062,19 +1054,13 @@ upd_fdc_write_data( upd_fdc *f, libspectrum_byte data )
         d->data = 0x00fb | ( f->mf ? 0x0000 : 0xff00 );	/* write data mark */
         fdd_write_data( d ); crc_add( f, d );
 	
-    	d->data =  f->data_register[4];	/* write filler byte */
-	for( i = f->rlen; i > 0; i-- ) {
-          fdd_write_data( d ); crc_add( f, d );
-	}
+	write_fill( f, d, f->data_register[4], f->rlen, 1 ); /* filler byte */
         d->data = f->crc >> 8;
         fdd_write_data( d );			/* write crc1 */
         d->data = f->crc & 0xff;
         fdd_write_data( d );			/* write crc2 */
 
-        d->data = f->mf ? 0x4e : 0xff;
-	for( i = f->data_register[3]; i > 0; i-- ) {	/* GAP */
-          fdd_write_data( d );
-	}
+	write_fill( f, d, f->mf ? 0x4e : 0xff, f->data_register[3], 0 ); /* GAP */
         f->data_offset = 0;
 	f->data_register[2]--;		/* prepare next sector */
       }
@@ -1102,10 +1088,9 @@ upd_fdc_write_data( upd_fdc *f, libspectrum_byte data )
       fdd_write_data( d ); crc_add( f, d );
     
       if( f->data_offset == f->rlen ) {	/* read only rlen byte from host */
-        d->data = 0x00;
-        while( f->data_offset < f->sector_length ) {	/* fill with 0x00 */
-	  fdd_read_data( d ); crc_add( f, d );
-	  f->data_offset++;
+        if( f->data_offset < f->sector_length ) {	/* fill with 0x00 */
+          read_block( f, d, f->sector_length - f->data_offset, 1 );
+          f->data_offset = f->sector_length;
         }
       }
       if( f->data_offset == f->sector_length ) {	/* write the CRC */
@@ -27,6 +27,8 @@
 
 #include <config.h>
 
+#include <string.h>
+
 #include <libspectrum.h>
 
 #include "crc.h"
@@ -224,6 +226,10 @@ read_id( wd_fdc *f )
     return 1;
 
   while( i == f->rev ) { /* **FIXME d->motoron? */
+    if( fdd_skip_to_id( d ) && d->index ) {	/* no ID before the index */
+      f->rev--;
+      continue;
+    }
     crc_preset( f );
     if( f->dden ) {	/* double density (MFM) */
       fdd_read_data( d );
@@ -411,11 +417,9 @@ wd_fdc_seek_verify_read_id( wd_fdc *f )
 	}
       } else
         f->id_mark = WD_FDC_AM_NONE;
-      i = d->disk.bpt ? ( d->disk.i - i ) * 200 / d->disk.bpt : 200;
+      i = fdd_tstates_since( d, i );	/* time to get here */
       if( i > 0 ) {
-        event_add_with_data( tstates + i *		/* i * 1/20 revolution */
-			   machine_current->timings.processor_speed / 1000,
-			   fdc_event, f );
+        event_add_with_data( tstates + i, fdc_event, f );
         return;
       } else if( f->id_mark != WD_FDC_AM_NONE )
         break;
@@ -555,6 +559,7 @@ wd_fdc_type_ii_seek( wd_fdc *f )
 {
   libspectrum_byte b = f->command_register;
   fdd_t *d = f->current_drive;
+  libspectrum_byte gap[12];
   int i;
 
   event_remove_type( fdc_event );
@@ -570,12 +575,9 @@ wd_fdc_type_ii_seek( wd_fdc *f )
       } else {
         f->id_mark = WD_FDC_AM_NONE;
       }
-      i = d->disk.bpt ?
-	( d->disk.i - i ) * 200 / d->disk.bpt : 200;
+      i = fdd_tstates_since( d, i );	/* time to get here */
       if( i > 0 ) {
-        event_add_with_data( tstates + i *		/* i * 1/20 revolution */
-			     machine_current->timings.processor_speed / 1000,
-			     fdc_event, f );
+        event_add_with_data( tstates + i, fdc_event, f );
         return;
       } else if( f->id_mark != WD_FDC_AM_NONE ) {
 	break;
@@ -611,17 +613,14 @@ wd_fdc_type_ii_seek( wd_fdc *f )
 
   } else {
     f->ddam = b & 0x01;
-    for( i = 11; i > 0; i-- )	/* "delay" 11 GAP byte */
-      fdd_read_data( d );
+    fdd_read_block( d, gap, 11 );	/* "delay" 11 GAP byte */
     wd_fdc_set_datarq( f );
     f->data_offset = 0;
     if( f->dden )
-      for( i = 11; i > 0; i-- )	/* "delay" another 11 GAP byte */
-	fdd_read_data( d );
+      fdd_read_block( d, gap, 11 );	/* "delay" another 11 GAP byte */
 
-    d->data = 0x00;
-    for( i = f->dden ? 12 : 6; i > 0; i-- )	/* write 6/12 zero */
-      fdd_write_data( d );
+    memset( gap, 0x00, 12 );
+    fdd_write_block( d, gap, f->dden ? 12 : 6 );	/* write 6/12 zero */
     crc_preset( f );
     if( f->dden ) {				/* MFM */
       d->data = 0xffa1;
@@ -725,12 +724,9 @@ wd_fdc_type_iii( wd_fdc *f )
       while( f->rev ) {
         i = d->disk.i >= d->disk.bpt ? 0 : d->disk.i;	/* start position */
         read_id( f );
-        i = d->disk.bpt ?
-	    ( d->disk.i - i ) * 200 / d->disk.bpt : 200;
+        i = fdd_tstates_since( d, i );	/* time to get here */
 	if( i > 0 ) {
-          event_add_with_data( tstates + i *		/* i * 1/20 revolution */
-			       machine_current->timings.processor_speed / 1000,
-			       fdc_event, f );
+          event_add_with_data( tstates + i, fdc_event, f );
           return;
 	} else if( f->id_mark != WD_FDC_AM_NONE )
 	  break;
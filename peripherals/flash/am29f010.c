@@ -25,6 +25,7 @@
 
 #include "am29f010.h"
 #include "fuse.h"
+#include "rewind.h"
 #include "ui/ui.h"
 
 #define SIZE_OF_FLASH_ROM 0x20000 /* 128kB */
@@ -67,12 +68,15 @@ flash_am29f010_init( flash_am29f010_t *self, libspectrum_byte *memory )
 static void
 flash_am29f010_chip_erase( flash_am29f010_t *self )
 {
+  rewind_memory_write_block( self->memory, SIZE_OF_FLASH_ROM );
   memset( self->memory, 0xff, SIZE_OF_FLASH_ROM );
 }
 
 static void
 flash_am29f010_sector_erase( flash_am29f010_t *self, libspectrum_byte page )
 {
+  rewind_memory_write_block( self->memory + ( page * SIZE_OF_FLASH_PAGE ),
+                             SIZE_OF_FLASH_PAGE );
   memset( self->memory + ( page * SIZE_OF_FLASH_PAGE ), 0xff, SIZE_OF_FLASH_PAGE );
 }
 
@@ -80,6 +84,7 @@ static void
 flash_am29f010_program( flash_am29f010_t *self, libspectrum_byte page, libspectrum_word address, libspectrum_byte b )
 {
   libspectrum_dword flash_offset = page * SIZE_OF_FLASH_PAGE + address;
+  rewind_memory_write( self->memory + flash_offset );
   self->memory[ flash_offset ] = b;
 }
 
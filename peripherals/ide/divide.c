@@ -32,6 +32,7 @@
 #include "ide.h"
 #include "infrastructure/startup_manager.h"
 #include "machine.h"
+#include "memory_pages.h"
 #include "module.h"
 #include "periph.h"
 #include "settings.h"
@@ -311,7 +312,7 @@ divide_to_snapshot( libspectrum_snap *snap )
 
   libspectrum_snap_set_divide_pages( snap, DIVIDE_PAGES );
 
-  for( i = 0; i < DIVIDE_PAGES; i++ ) {
+  for( i = 0; i < DIVIDE_PAGES && memory_snapshot_ram; i++ ) {
 
     buffer = libspectrum_new( libspectrum_byte, DIVIDE_PAGE_LENGTH );
 
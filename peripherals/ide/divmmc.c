@@ -32,6 +32,7 @@
 #include "ide.h"
 #include "infrastructure/startup_manager.h"
 #include "machine.h"
+#include "memory_pages.h"
 #include "module.h"
 #include "periph.h"
 #include "settings.h"
@@ -345,7 +346,7 @@ divmmc_to_snapshot( libspectrum_snap *snap )
 
   libspectrum_snap_set_divmmc_pages( snap, DIVMMC_PAGES );
 
-  for( i = 0; i < DIVMMC_PAGES; i++ ) {
+  for( i = 0; i < DIVMMC_PAGES && memory_snapshot_ram; i++ ) {
 
     buffer = libspectrum_new( libspectrum_byte, DIVMMC_PAGE_LENGTH );
 
@@ -31,6 +31,7 @@
 #include "divxxx.h"
 #include "machine.h"
 #include "periph.h"
+#include "rewind.h"
 
 static const libspectrum_byte DIVXXX_CONTROL_CONMEM = 0x80;
 static const libspectrum_byte DIVXXX_CONTROL_MAPRAM = 0x40;
@@ -190,8 +191,10 @@ divxxx_reset( divxxx_t *divxxx, int hard_reset )
     divxxx->control = 0;
 
     if( divxxx->ram ) {
-      for( i = 0; i < divxxx->ram_page_count; i++ )
+      for( i = 0; i < divxxx->ram_page_count; i++ ) {
+        rewind_memory_write_block( divxxx->ram[i], DIVXXX_PAGE_LENGTH );
         memset( divxxx->ram[i], 0, DIVXXX_PAGE_LENGTH );
+      }
     }
   } else {
     divxxx->control &= DIVXXX_CONTROL_MAPRAM;
@@ -219,6 +222,9 @@ divxxx_activate( divxxx_t *divxxx )
       }
     }
 
+    rewind_register_memory( memory,
+                            divxxx->ram_page_count * DIVXXX_PAGE_LENGTH );
+
     divxxx->eprom = memory_pool_allocate_persistent( DIVXXX_PAGE_LENGTH, 1 );
     memset( divxxx->eprom, 0xff, DIVXXX_PAGE_LENGTH );
     for( i = 0; i < MEMORY_PAGES_IN_8K; i++ ) {
@@ -36,6 +36,7 @@
 #include "memory_pages.h"
 #include "module.h"
 #include "periph.h"
+#include "rewind.h"
 #include "settings.h"
 #include "ui/ui.h"
 #include "unittests/unittests.h"
@@ -546,7 +547,7 @@ zxatasp_to_snapshot( libspectrum_snap *snap )
 
   libspectrum_snap_set_zxatasp_pages( snap, ZXATASP_PAGES );
 
-  for( i = 0; i < ZXATASP_PAGES; i++ ) {
+  for( i = 0; i < ZXATASP_PAGES && memory_snapshot_ram; i++ ) {
 
     buffer = libspectrum_new( libspectrum_byte, ZXATASP_PAGE_LENGTH );
 
@@ -564,6 +565,7 @@ zxatasp_activate( void )
       memory_pool_allocate_persistent( ZXATASP_PAGES * ZXATASP_PAGE_LENGTH, 1 );
     for( i = 0; i < ZXATASP_PAGES; i++ )
       ZXATASPMEM[i] = memory + i * ZXATASP_PAGE_LENGTH;
+    rewind_register_memory( memory, ZXATASP_PAGES * ZXATASP_PAGE_LENGTH );
     memory_allocated = 1;
   }
 }
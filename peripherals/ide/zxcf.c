@@ -36,6 +36,7 @@
 #include "memory_pages.h"
 #include "module.h"
 #include "periph.h"
+#include "rewind.h"
 #include "settings.h"
 #include "ui/ui.h"
 #include "unittests/unittests.h"
@@ -324,7 +325,7 @@ zxcf_to_snapshot( libspectrum_snap *snap )
   libspectrum_snap_set_zxcf_memctl( snap, last_memctl );
   libspectrum_snap_set_zxcf_pages( snap, ZXCF_PAGES );
 
-  for( i = 0; i < ZXCF_PAGES; i++ ) {
+  for( i = 0; i < ZXCF_PAGES && memory_snapshot_ram; i++ ) {
 
     buffer = libspectrum_new( libspectrum_byte, ZXCF_PAGE_LENGTH );
 
@@ -342,6 +343,7 @@ zxcf_activate( void )
       memory_pool_allocate_persistent( ZXCF_PAGES * ZXCF_PAGE_LENGTH, 1 );
     for( i = 0; i < ZXCF_PAGES; i++ )
       ZXCFMEM[i] = memory + i * ZXCF_PAGE_LENGTH;
+    rewind_register_memory( memory, ZXCF_PAGES * ZXCF_PAGE_LENGTH );
     memory_allocated = 1;
   }
 }
@@ -27,11 +27,22 @@
 #include <config.h>
 
 #include <pthread.h>
+#include <stdio.h>
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
 #include "fuse.h"
+#include "timer/timer.h"
 #include "ui/ui.h"
 #include "w5100.h"
 #include "w5100_internals.h"
@@ -83,6 +94,63 @@ nic_w5100_reset( nic_w5100_t *self )
     nic_w5100_socket_reset( &self->socket[i] );
 }
 
+#ifdef W5100_USE_POLL
+
+/* Slot 0 is the self-pipe and slot i + 1 is socket i. Each socket updates its
+   own slot only when its state has changed, so there's nothing to rebuild on
+   a typical wakeup */
+static void*
+w5100_io_thread( void *arg )
+{
+  nic_w5100_t *self = arg;
+  struct pollfd fds[5];
+  int i;
+
+  fds[0].fd = compat_socket_selfpipe_get_read_fd( self->selfpipe );
+  fds[0].events = POLLIN;
+
+  for( i = 0; i < 4; i++ ) {
+    fds[i + 1].fd = -1;
+    fds[i + 1].events = 0;
+  }
+
+  while( !self->stop_io_thread ) {
+    int active;
+
+    for( i = 0; i < 4; i++ )
+      nic_w5100_socket_update_poll( &self->socket[i], &fds[i + 1] );
+
+    /* A socket closed after it was added to the set just comes back with
+       POLLNVAL, and is dropped from the set on the next time round */
+
+    nic_w5100_debug( "w5100: io thread poll\n" );
+
+    active = poll( fds, 5, -1 );
+
+    nic_w5100_debug( "w5100: io thread wake; %d active\n", active );
+
+    if( active > 0 ) {
+      if( fds[0].revents ) {
+        nic_w5100_debug( "w5100: discarding selfpipe data\n" );
+        compat_socket_selfpipe_discard_data( self->selfpipe );
+      }
+
+      for( i = 0; i < 4; i++ )
+        if( fds[i + 1].revents )
+          nic_w5100_socket_process_poll( &self->socket[i], &fds[i + 1] );
+    }
+    else if( active == -1 && compat_socket_get_error() != EINTR ) {
+      nic_w5100_debug( "w5100: poll returned unexpected errno %d: %s\n",
+                       compat_socket_get_error(),
+                       compat_socket_get_strerror() );
+    }
+  }
+
+  return NULL;
+}
+
+#else                           /* #ifdef W5100_USE_POLL */
+
 static void*
 w5100_io_thread( void *arg )
 {
@@ -139,6 +207,8 @@ w5100_io_thread( void *arg )
   return NULL;
 }
 
+#endif                          /* #ifdef W5100_USE_POLL */
+
 nic_w5100_t*
 nic_w5100_alloc( void )
 {
@@ -358,6 +428,182 @@ nic_w5100_to_snapshot( nic_w5100_t *self )
   return data;
 }
 
+/* Loopback throughput benchmark: echo data off a local server through
+   socket 0, driving the chip through its registers as Spectranet software
+   would, and report the rate the emulated Spectrum sees */
+
+#define W5100_BENCHMARK_BYTES ( 4 * 1024 * 1024 )
+#define W5100_BENCHMARK_CHUNK 0x400
+#define W5100_BENCHMARK_TIMEOUT 10.0
+
+static void*
+w5100_benchmark_echo( void *arg )
+{
+  compat_socket_t fd = *(compat_socket_t*)arg;
+  char buffer[0x800];
+  ssize_t length, sent, bytes;
+
+  while( ( length = recv( fd, buffer, sizeof( buffer ), 0 ) ) > 0 ) {
+    for( sent = 0; sent < length; sent += bytes ) {
+      bytes = send( fd, buffer + sent, length - sent, 0 );
+      if( bytes <= 0 ) return NULL;
+    }
+  }
+
+  return NULL;
+}
+
+static libspectrum_word
+w5100_benchmark_read_word( nic_w5100_t *self, libspectrum_word reg )
+{
+  return nic_w5100_read( self, reg ) << 8 | nic_w5100_read( self, reg + 1 );
+}
+
+static void
+w5100_benchmark_write_word( nic_w5100_t *self, libspectrum_word reg,
+                            libspectrum_word value )
+{
+  nic_w5100_write( self, reg, value >> 8 );
+  nic_w5100_write( self, reg + 1, value & 0xff );
+}
+
+/* Push W5100_BENCHMARK_BYTES round the echo server on the far end of socket
+   0, keeping up to a transmit buffer's worth in flight; returns the number
+   of bytes which came back intact */
+static unsigned long
+w5100_benchmark_run( nic_w5100_t *self )
+{
+  libspectrum_byte pattern[W5100_BENCHMARK_CHUNK];
+  libspectrum_word tx_wr = 0, rx_rd = 0, rsr;
+  unsigned long sent = 0, received = 0;
+  double last_progress = timer_get_time();
+  int i;
+
+  for( i = 0; i < W5100_BENCHMARK_CHUNK; i++ ) pattern[i] = i * 7 + 1;
+
+  while( received < W5100_BENCHMARK_BYTES ) {
+
+    if( sent < W5100_BENCHMARK_BYTES &&
+        w5100_benchmark_read_word( self, 0x400 + W5100_SOCKET_TX_FSR0 ) >=
+          W5100_BENCHMARK_CHUNK ) {
+      for( i = 0; i < W5100_BENCHMARK_CHUNK; i++ )
+        nic_w5100_write( self, 0x4000 + ( ( tx_wr + i ) & 0x7ff ),
+                         pattern[i] );
+      tx_wr += W5100_BENCHMARK_CHUNK;
+      w5100_benchmark_write_word( self, 0x400 + W5100_SOCKET_TX_WR0, tx_wr );
+      nic_w5100_write( self, 0x400 + W5100_SOCKET_CR,
+                       W5100_SOCKET_COMMAND_SEND );
+      sent += W5100_BENCHMARK_CHUNK;
+    }
+
+    rsr = w5100_benchmark_read_word( self, 0x400 + W5100_SOCKET_RX_RSR0 );
+
+    if( rsr ) {
+      for( i = 0; i < rsr; i++ ) {
+        libspectrum_byte b =
+          nic_w5100_read( self, 0x6000 + ( ( rx_rd + i ) & 0x7ff ) );
+        if( b != pattern[ ( received + i ) % W5100_BENCHMARK_CHUNK ] )
+          return received + i;
+      }
+      rx_rd += rsr;
+      received += rsr;
+      w5100_benchmark_write_word( self, 0x400 + W5100_SOCKET_RX_RD0, rx_rd );
+      nic_w5100_write( self, 0x400 + W5100_SOCKET_CR,
+                       W5100_SOCKET_COMMAND_RECV );
+      last_progress = timer_get_time();
+    }
+    else if( timer_get_time() - last_progress > W5100_BENCHMARK_TIMEOUT ) {
+      break;
+    }
+  }
+
+  return received;
+}
+
+void
+nic_w5100_benchmark( void )
+{
+  nic_w5100_t *self;
+  compat_socket_t listener, echo_fd = compat_socket_invalid;
+  struct sockaddr_in sa;
+  socklen_t sa_length = sizeof( sa );
+  pthread_t echo_thread;
+  unsigned long received = 0;
+  double start, elapsed;
+  int i;
+
+  compat_socket_networking_init();
+
+  memset( &sa, 0, sizeof( sa ) );
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+  listener = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+  if( listener == compat_socket_invalid ||
+      bind( listener, (struct sockaddr*)&sa, sizeof( sa ) ) == -1 ||
+      listen( listener, 1 ) == -1 ||
+      getsockname( listener, (struct sockaddr*)&sa, &sa_length ) == -1 ) {
+    printf( "%s: spectranet benchmark: couldn't start echo server\n",
+            fuse_progname );
+    if( listener != compat_socket_invalid ) compat_socket_close( listener );
+    compat_socket_networking_end();
+    return;
+  }
+
+  self = nic_w5100_alloc();
+
+  /* Open socket 0 and connect it to the echo server. The connection is
+     queued on the listening socket, so it can be accepted afterwards */
+  nic_w5100_write( self, 0x400 + W5100_SOCKET_MR,
+                   W5100_SOCKET_MODE_TCP | 0x20 );
+  nic_w5100_write( self, 0x400 + W5100_SOCKET_CR, W5100_SOCKET_COMMAND_OPEN );
+  for( i = 0; i < 4; i++ )
+    nic_w5100_write( self, 0x400 + W5100_SOCKET_DIPR0 + i,
+                     ( (libspectrum_byte*)&sa.sin_addr.s_addr )[i] );
+  for( i = 0; i < 2; i++ )
+    nic_w5100_write( self, 0x400 + W5100_SOCKET_DPORT0 + i,
+                     ( (libspectrum_byte*)&sa.sin_port )[i] );
+  nic_w5100_write( self, 0x400 + W5100_SOCKET_CR,
+                   W5100_SOCKET_COMMAND_CONNECT );
+
+  if( nic_w5100_read( self, 0x400 + W5100_SOCKET_SR ) ==
+        W5100_SOCKET_STATE_ESTABLISHED )
+    echo_fd = accept( listener, NULL, NULL );
+
+  if( echo_fd == compat_socket_invalid ||
+      pthread_create( &echo_thread, NULL, w5100_benchmark_echo, &echo_fd ) ) {
+    printf( "%s: spectranet benchmark: couldn't connect to echo server\n",
+            fuse_progname );
+    if( echo_fd != compat_socket_invalid ) compat_socket_close( echo_fd );
+    nic_w5100_free( self );
+    compat_socket_close( listener );
+    compat_socket_networking_end();
+    return;
+  }
+
+  start = timer_get_time();
+  received = w5100_benchmark_run( self );
+  elapsed = timer_get_time() - start;
+  if( elapsed <= 0 ) elapsed = 1e-6;
+
+  /* Closing our end makes the echo server see end of file */
+  nic_w5100_write( self, 0x400 + W5100_SOCKET_CR, W5100_SOCKET_COMMAND_CLOSE );
+  pthread_join( echo_thread, NULL );
+
+  nic_w5100_free( self );
+  compat_socket_close( echo_fd );
+  compat_socket_close( listener );
+  compat_socket_networking_end();
+
+  if( received < W5100_BENCHMARK_BYTES )
+    printf( "%s: spectranet benchmark: failed after %lu bytes\n",
+            fuse_progname, received );
+  else
+    printf( "%s: spectranet benchmark: %lu KB echoed in %.3f s, %.1f KB/s\n",
+            fuse_progname, received / 1024, elapsed,
+            received / 1024.0 / elapsed );
+}
+
 void
 nic_w5100_debug( const char *format, ... )
 {
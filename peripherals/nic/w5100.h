@@ -42,4 +42,6 @@ void nic_w5100_write( nic_w5100_t *self, libspectrum_word reg, libspectrum_byte
 void nic_w5100_from_snapshot( nic_w5100_t *self, libspectrum_byte *data );
 libspectrum_byte* nic_w5100_to_snapshot( nic_w5100_t *self );
 
+void nic_w5100_benchmark( void );
+
 #endif                          /* #ifndef FUSE_W5100_H */
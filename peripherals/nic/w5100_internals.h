@@ -33,6 +33,34 @@
 #include <sys/select.h>
 #endif
 
+/* Use poll() with a persistent set of descriptors in the I/O thread where we
+   have it; otherwise rebuild the fd_sets for select() on every wakeup */
+#if defined( HAVE_POLL ) && defined( HAVE_POLL_H ) && !defined( WIN32 )
+#define W5100_USE_POLL 1
+#include <poll.h>
+#endif
+
+/* The registers which the I/O thread can change are published in a couple of
+   words so the emulation thread can read them without taking the socket
+   lock; see w5100_socket_release_lock(). This follows sound/sfifo.h */
+#if defined( __STDC_VERSION__ ) && __STDC_VERSION__ >= 201112L && \
+    !defined( __STDC_NO_ATOMICS__ )
+#include <stdatomic.h>
+typedef atomic_uint w5100_atomic_t;
+#define W5100_LOAD_ACQUIRE(x) atomic_load_explicit(&(x), memory_order_acquire)
+#define W5100_STORE_RELEASE(x, v) \
+  atomic_store_explicit(&(x), (v), memory_order_release)
+#elif defined( __GNUC__ ) && \
+      ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 7 ) )
+typedef unsigned int w5100_atomic_t;
+#define W5100_LOAD_ACQUIRE(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define W5100_STORE_RELEASE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#else
+typedef volatile unsigned int w5100_atomic_t;
+#define W5100_LOAD_ACQUIRE(x) (x)
+#define W5100_STORE_RELEASE(x, v) ((x) = (v))
+#endif
+
 typedef enum w5100_socket_mode {
   W5100_SOCKET_MODE_CLOSED = 0x00,
   W5100_SOCKET_MODE_TCP,
@@ -83,6 +111,16 @@ enum w5100_socket_registers {
   W5100_SOCKET_RX_RD1,
 };
 
+enum w5100_socket_command {
+  W5100_SOCKET_COMMAND_OPEN = 1 << 0,
+  W5100_SOCKET_COMMAND_LISTEN = 1 << 1,
+  W5100_SOCKET_COMMAND_CONNECT = 1 << 2,
+  W5100_SOCKET_COMMAND_DISCON = 1 << 3,
+  W5100_SOCKET_COMMAND_CLOSE = 1 << 4,
+  W5100_SOCKET_COMMAND_SEND = 1 << 5,
+  W5100_SOCKET_COMMAND_RECV = 1 << 6,
+};
+
 typedef struct nic_w5100_socket_t {
 
   int id; /* For debug use only */
@@ -124,10 +162,19 @@ typedef struct nic_w5100_socket_t {
   int datagram_count;
 
   /* Flag used to indicate that a socket has been closed since we started
-     waiting for it in a select() call and therefore the socket should no
-     longer be used */
+     waiting for it in a select() or poll() call and therefore the socket
+     should no longer be used */
   int ok_for_io;
 
+  /* Set whenever something happens which may change the events the I/O
+     thread should wait for on this socket */
+  w5100_atomic_t poll_dirty;
+
+  /* Sn_SR | Sn_IR << 8 and Sn_RX_RSR | Sn_TX_RR << 16, as of the last time
+     the lock was released */
+  w5100_atomic_t status;
+  w5100_atomic_t sizes;
+
   pthread_mutex_t lock;     /* Mutex for this socket */
 
 } nic_w5100_socket_t;
@@ -161,6 +208,13 @@ void nic_w5100_socket_add_to_sets( nic_w5100_socket_t *socket, fd_set *readfds,
 void nic_w5100_socket_process_io( nic_w5100_socket_t *socket, fd_set readfds,
   fd_set writefds );
 
+#ifdef W5100_USE_POLL
+void nic_w5100_socket_update_poll( nic_w5100_socket_t *socket,
+  struct pollfd *pfd );
+void nic_w5100_socket_process_poll( nic_w5100_socket_t *socket,
+  const struct pollfd *pfd );
+#endif
+
 /* Debug routines */
 
 /* Define this to spew debugging info to stdout */
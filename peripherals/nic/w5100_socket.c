@@ -45,16 +45,6 @@
 #include "w5100.h"
 #include "w5100_internals.h"
 
-enum w5100_socket_command {
-  W5100_SOCKET_COMMAND_OPEN = 1 << 0,
-  W5100_SOCKET_COMMAND_LISTEN = 1 << 1,
-  W5100_SOCKET_COMMAND_CONNECT = 1 << 2,
-  W5100_SOCKET_COMMAND_DISCON = 1 << 3,
-  W5100_SOCKET_COMMAND_CLOSE = 1 << 4,
-  W5100_SOCKET_COMMAND_SEND = 1 << 5,
-  W5100_SOCKET_COMMAND_RECV = 1 << 6,
-};
-
 static void
 w5100_socket_init_common( nic_w5100_socket_t *socket )
 {
@@ -70,6 +60,9 @@ nic_w5100_socket_init( nic_w5100_socket_t *socket, int which )
 {
   socket->id = which;
   w5100_socket_init_common( socket );
+  W5100_STORE_RELEASE( socket->poll_dirty, 1 );
+  W5100_STORE_RELEASE( socket->status, 0 );
+  W5100_STORE_RELEASE( socket->sizes, 0 );
   pthread_mutex_init( &socket->lock, NULL );
 }
 
@@ -95,13 +88,28 @@ w5100_socket_acquire_lock( nic_w5100_socket_t *socket )
 static void
 w5100_socket_release_lock( nic_w5100_socket_t *socket )
 {
-  int error = pthread_mutex_unlock( &socket->lock );
+  int error;
+
+  /* Publish anything which may have changed while we held the lock for
+     nic_w5100_socket_read() */
+  W5100_STORE_RELEASE( socket->status, socket->state | socket->ir << 8 );
+  W5100_STORE_RELEASE( socket->sizes, socket->rx_rsr | socket->tx_rr << 16 );
+
+  error = pthread_mutex_unlock( &socket->lock );
   if( error ) {
     nic_w5100_debug( "%s:%d: error %d unlocking mutex for socket %d\n", __FILE__, __LINE__, error, socket->id );
     fuse_abort();
   }
 }
 
+/* Ask the I/O thread to look again at what it should wait for on this
+   socket. This must be done before waking the I/O thread */
+static void
+w5100_socket_changed( nic_w5100_socket_t *socket )
+{
+  W5100_STORE_RELEASE( socket->poll_dirty, 1 );
+}
+
 static void
 w5100_socket_clean( nic_w5100_socket_t *socket )
 {
@@ -132,6 +140,7 @@ nic_w5100_socket_reset( nic_w5100_socket_t *socket )
   socket->state = W5100_SOCKET_STATE_CLOSED;
 
   w5100_socket_clean( socket );
+  w5100_socket_changed( socket );
 
   w5100_socket_release_lock( socket );
 }
@@ -299,6 +308,7 @@ w5100_socket_connect( nic_w5100_t *self, nic_w5100_socket_t *socket )
 
     socket->ir |= 1 << 0;
     socket->state = W5100_SOCKET_STATE_ESTABLISHED;
+    compat_socket_selfpipe_wake( self->selfpipe );
   }
 }
 
@@ -368,6 +378,8 @@ w5100_write_socket_cr( nic_w5100_t *self, nic_w5100_socket_t *socket, libspectru
 {
   nic_w5100_debug( "w5100: writing 0x%02x to S%d_CR\n", b, socket->id );
 
+  w5100_socket_changed( socket );
+
   switch( b ) {
     case W5100_SOCKET_COMMAND_OPEN:
       w5100_socket_open( socket );
@@ -403,6 +415,7 @@ w5100_write_socket_port( nic_w5100_t *self, nic_w5100_socket_t *socket, int whic
   socket->port[which] = b;
   if( ++socket->bind_count == 2 ) {
     if( socket->state == W5100_SOCKET_STATE_UDP && !socket->socket_bound ) {
+      w5100_socket_changed( socket );
       if( w5100_socket_bind_port( self, socket ) ) {
         socket->bind_count = 0;
         return;
@@ -422,7 +435,14 @@ nic_w5100_socket_read( nic_w5100_t *self, libspectrum_word reg )
   libspectrum_word fsr;
   libspectrum_byte b;
 
-  w5100_socket_acquire_lock( socket );
+  /* Everything the I/O thread can change is read from the values published
+     when the lock was last released, so polling the status registers never
+     has to wait for the I/O thread. The other fields are written only by
+     this thread */
+  unsigned int status = W5100_LOAD_ACQUIRE( socket->status );
+  unsigned int sizes = W5100_LOAD_ACQUIRE( socket->sizes );
+  libspectrum_word tx_rr = sizes >> 16;
+  libspectrum_word rx_rsr = sizes & 0xffff;
 
   switch( socket_reg ) {
     case W5100_SOCKET_MR:
@@ -430,11 +450,11 @@ nic_w5100_socket_read( nic_w5100_t *self, libspectrum_word reg )
       nic_w5100_debug( "w5100: reading 0x%02x from S%d_MR\n", b, socket->id );
       break;
     case W5100_SOCKET_IR:
-      b = socket->ir;
+      b = status >> 8;
       nic_w5100_debug( "w5100: reading 0x%02x from S%d_IR\n", b, socket->id );
       break;
     case W5100_SOCKET_SR:
-      b = socket->state;
+      b = status & 0xff;
       nic_w5100_debug( "w5100: reading 0x%02x from S%d_SR\n", b, socket->id );
       break;
     case W5100_SOCKET_PORT0: case W5100_SOCKET_PORT1:
@@ -443,13 +463,13 @@ nic_w5100_socket_read( nic_w5100_t *self, libspectrum_word reg )
       break;
     case W5100_SOCKET_TX_FSR0: case W5100_SOCKET_TX_FSR1:
       reg_offset = socket_reg - W5100_SOCKET_TX_FSR0;
-      fsr = 0x0800 - (socket->tx_wr - socket->tx_rr);
+      fsr = 0x0800 - (socket->tx_wr - tx_rr);
       b = ( fsr >> ( 8 * ( 1 - reg_offset ) ) ) & 0xff;
       nic_w5100_debug( "w5100: reading 0x%02x from S%d_TX_FSR%d\n", b, socket->id, reg_offset );
       break;
     case W5100_SOCKET_TX_RR0: case W5100_SOCKET_TX_RR1:
       reg_offset = socket_reg - W5100_SOCKET_TX_RR0;
-      b = ( socket->tx_rr >> ( 8 * ( 1 - reg_offset ) ) ) & 0xff;
+      b = ( tx_rr >> ( 8 * ( 1 - reg_offset ) ) ) & 0xff;
       nic_w5100_debug( "w5100: reading 0x%02x from S%d_TX_RR%d\n", b, socket->id, reg_offset );
       break;
     case W5100_SOCKET_TX_WR0: case W5100_SOCKET_TX_WR1:
@@ -459,7 +479,7 @@ nic_w5100_socket_read( nic_w5100_t *self, libspectrum_word reg )
       break;
     case W5100_SOCKET_RX_RSR0: case W5100_SOCKET_RX_RSR1:
       reg_offset = socket_reg - W5100_SOCKET_RX_RSR0;
-      b = ( socket->rx_rsr >> ( 8 * ( 1 - reg_offset ) ) ) & 0xff;
+      b = ( rx_rsr >> ( 8 * ( 1 - reg_offset ) ) ) & 0xff;
       nic_w5100_debug( "w5100: reading 0x%02x from S%d_RX_RSR%d\n", b, socket->id, reg_offset );
       break;
     case W5100_SOCKET_RX_RD0: case W5100_SOCKET_RX_RD1:
@@ -473,8 +493,6 @@ nic_w5100_socket_read( nic_w5100_t *self, libspectrum_word reg )
       break;
   }
 
-  w5100_socket_release_lock( socket );
-
   return b;
 }
 
@@ -540,6 +558,9 @@ nic_w5100_socket_read_rx_buffer( nic_w5100_t *self, libspectrum_word reg )
 {
   nic_w5100_socket_t *socket = &self->socket[(reg - 0x6000) / 0x0800];
   int offset = reg & 0x7ff;
+  /* No lock needed: the I/O thread only ever fills the part of the buffer
+     beyond Sn_RX_RSR, and the new data is published with Sn_RX_RSR once it
+     has all been copied in */
   libspectrum_byte b = socket->rx_buffer[offset];
   nic_w5100_debug( "w5100: reading 0x%02x from socket %d rx buffer offset 0x%03x\n", b, socket->id, offset );
   return b;
@@ -554,6 +575,24 @@ nic_w5100_socket_write_tx_buffer( nic_w5100_t *self, libspectrum_word reg, libsp
   socket->tx_buffer[offset] = b;
 }
 
+static int
+w5100_socket_wants_read( nic_w5100_socket_t *socket )
+{
+  /* We can process a UDP read if we're in a UDP state and there are at least
+     9 bytes free in our buffer (8 byte UDP header and 1 byte of actual
+     data). */
+  int udp_read = socket->state == W5100_SOCKET_STATE_UDP &&
+    0x800 - socket->rx_rsr >= 9;
+  /* We can process a TCP read if we're in the established state and have
+     any room in our buffer (no header necessary for TCP). */
+  int tcp_read = socket->state == W5100_SOCKET_STATE_ESTABLISHED &&
+    0x800 - socket->rx_rsr >= 1;
+
+  int tcp_listen = socket->state == W5100_SOCKET_STATE_LISTEN;
+
+  return udp_read || tcp_read || tcp_listen;
+}
+
 void
 nic_w5100_socket_add_to_sets( nic_w5100_socket_t *socket, fd_set *readfds,
   fd_set *writefds, int *max_fd )
@@ -561,21 +600,9 @@ nic_w5100_socket_add_to_sets( nic_w5100_socket_t *socket, fd_set *readfds,
   w5100_socket_acquire_lock( socket );
 
   if( socket->fd != compat_socket_invalid ) {
-    /* We can process a UDP read if we're in a UDP state and there are at least
-       9 bytes free in our buffer (8 byte UDP header and 1 byte of actual
-       data). */
-    int udp_read = socket->state == W5100_SOCKET_STATE_UDP &&
-      0x800 - socket->rx_rsr >= 9;
-    /* We can process a TCP read if we're in the established state and have
-       any room in our buffer (no header necessary for TCP). */
-    int tcp_read = socket->state == W5100_SOCKET_STATE_ESTABLISHED &&
-      0x800 - socket->rx_rsr >= 1;
-
-    int tcp_listen = socket->state == W5100_SOCKET_STATE_LISTEN;
-
     socket->ok_for_io = 1;
 
-    if( udp_read || tcp_read || tcp_listen ) {
+    if( w5100_socket_wants_read( socket ) ) {
       FD_SET( socket->fd, readfds );
       if( socket->fd > *max_fd )
         *max_fd = socket->fd;
@@ -760,6 +787,29 @@ w5100_socket_process_tcp_write( nic_w5100_socket_t *socket )
                      compat_socket_get_strerror() );
 }
 
+static void
+w5100_socket_process_ready( nic_w5100_socket_t *socket, int readable,
+  int writable )
+{
+  if( readable ) {
+    if( socket->state == W5100_SOCKET_STATE_LISTEN )
+      w5100_socket_process_accept( socket );
+    else
+      w5100_socket_process_read( socket );
+  }
+
+  if( writable ) {
+    if( socket->state == W5100_SOCKET_STATE_UDP ) {
+      w5100_socket_process_udp_write( socket );
+    }
+    else if( socket->state == W5100_SOCKET_STATE_ESTABLISHED ) {
+      w5100_socket_process_tcp_write( socket );
+    }
+  }
+
+  w5100_socket_changed( socket );
+}
+
 void
 nic_w5100_socket_process_io( nic_w5100_socket_t *socket, fd_set readfds,
   fd_set writefds )
@@ -768,23 +818,65 @@ nic_w5100_socket_process_io( nic_w5100_socket_t *socket, fd_set readfds,
 
   /* Process only if we're an open socket, and we haven't been closed and
      re-opened since the select() started */
-  if( socket->fd != compat_socket_invalid && socket->ok_for_io ) {
-    if( FD_ISSET( socket->fd, &readfds ) ) {
-      if( socket->state == W5100_SOCKET_STATE_LISTEN )
-        w5100_socket_process_accept( socket );
-      else
-        w5100_socket_process_read( socket );
-    }
+  if( socket->fd != compat_socket_invalid && socket->ok_for_io )
+    w5100_socket_process_ready( socket, FD_ISSET( socket->fd, &readfds ),
+                                FD_ISSET( socket->fd, &writefds ) );
 
-    if( FD_ISSET( socket->fd, &writefds ) ) {
-      if( socket->state == W5100_SOCKET_STATE_UDP ) {
-        w5100_socket_process_udp_write( socket );
-      }
-      else if( socket->state == W5100_SOCKET_STATE_ESTABLISHED ) {
-        w5100_socket_process_tcp_write( socket );
-      }
-    }
+  w5100_socket_release_lock( socket );
+}
+
+#ifdef W5100_USE_POLL
+
+/* Update this socket's entry in the I/O thread's poll() set. The entry is
+   left alone unless something has changed since it was last set up */
+void
+nic_w5100_socket_update_poll( nic_w5100_socket_t *socket, struct pollfd *pfd )
+{
+  if( !W5100_LOAD_ACQUIRE( socket->poll_dirty ) ) return;
+
+  w5100_socket_acquire_lock( socket );
+
+  W5100_STORE_RELEASE( socket->poll_dirty, 0 );
+
+  pfd->fd = -1;
+  pfd->events = 0;
+
+  if( socket->fd != compat_socket_invalid ) {
+    socket->ok_for_io = 1;
+
+    if( w5100_socket_wants_read( socket ) ) pfd->events |= POLLIN;
+    if( socket->write_pending ) pfd->events |= POLLOUT;
+
+    /* poll() ignores negative descriptors, so there's no need to remove
+       idle sockets from the set */
+    if( pfd->events ) pfd->fd = socket->fd;
+
+    nic_w5100_debug( "w5100: polling socket %d with fd %d for events 0x%x\n",
+                     socket->id, socket->fd, pfd->events );
+  }
+
+  w5100_socket_release_lock( socket );
+}
+
+void
+nic_w5100_socket_process_poll( nic_w5100_socket_t *socket,
+  const struct pollfd *pfd )
+{
+  w5100_socket_acquire_lock( socket );
+
+  /* As for select(), process only if we haven't been closed and re-opened
+     since the poll() started. If we were waiting to read, a hangup or error
+     is handled by the read, which will see the end of file or the error */
+  if( socket->fd != compat_socket_invalid && socket->ok_for_io &&
+      socket->fd == pfd->fd ) {
+    int readable = ( pfd->events & POLLIN ) &&
+      ( pfd->revents & ( POLLIN | POLLHUP | POLLERR ) );
+    w5100_socket_process_ready( socket, readable, pfd->revents & POLLOUT );
   }
+  else
+    w5100_socket_changed( socket );
 
   w5100_socket_release_lock( socket );
 }
+
+#endif                          /* #ifdef W5100_USE_POLL */
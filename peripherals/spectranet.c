@@ -26,6 +26,7 @@
 
 #include <string.h>
 
+#include "benchmark.h"
 #include "compat.h"
 #include "debugger/debugger.h"
 #include "flash/am29f010.h"
@@ -36,6 +37,7 @@
 #include "nic/w5100.h"
 #include "periph.h"
 #include "peripherals/ula.h"
+#include "rewind.h"
 #include "settings.h"
 #include "spectranet.h"
 #include "ui/ui.h"
@@ -235,6 +237,7 @@ spectranet_activate( void )
     }
 
     flash_am29f010_init( flash_rom, rom );
+    rewind_register_memory( rom, SPECTRANET_ROM_LENGTH );
 
     /* Pages 0x40 to 0x47 are the W5100 registers - handled in readbyte()
        and writebyte() */
@@ -251,6 +254,8 @@ spectranet_activate( void )
       }
     }
 
+    rewind_register_memory( ram, SPECTRANET_RAM_LENGTH );
+
     spectranet_memory_allocated = 1;
 
     spectranet_map_page( 0, 0x00 );
@@ -299,12 +304,14 @@ spectranet_from_snapshot( libspectrum_snap *snap )
     nic_w5100_from_snapshot( w5100,
       libspectrum_snap_spectranet_w5100( snap, 0 ) );
 
-    memcpy(
-      spectranet_full_map[SPECTRANET_ROM_BASE * MEMORY_PAGES_IN_4K].page,
-      libspectrum_snap_spectranet_flash( snap, 0 ), SPECTRANET_ROM_LENGTH );
-    memcpy(
-      spectranet_full_map[SPECTRANET_RAM_BASE * MEMORY_PAGES_IN_4K].page,
-      libspectrum_snap_spectranet_ram( snap, 0 ), SPECTRANET_RAM_LENGTH );
+    if( libspectrum_snap_spectranet_flash( snap, 0 ) )
+      memcpy(
+        spectranet_full_map[SPECTRANET_ROM_BASE * MEMORY_PAGES_IN_4K].page,
+        libspectrum_snap_spectranet_flash( snap, 0 ), SPECTRANET_ROM_LENGTH );
+    if( libspectrum_snap_spectranet_ram( snap, 0 ) )
+      memcpy(
+        spectranet_full_map[SPECTRANET_RAM_BASE * MEMORY_PAGES_IN_4K].page,
+        libspectrum_snap_spectranet_ram( snap, 0 ), SPECTRANET_RAM_LENGTH );
   }
 }
 
@@ -340,6 +347,9 @@ spectranet_to_snapshot( libspectrum_snap *snap )
   libspectrum_snap_set_spectranet_w5100( snap, 0,
     nic_w5100_to_snapshot( w5100 ) );
 
+  /* The rewind buffer keeps track of the flash and RAM itself */
+  if( !memory_snapshot_ram ) return;
+
   snap_buffer = libspectrum_new( libspectrum_byte, SPECTRANET_ROM_LENGTH );
 
   src = spectranet_full_map[SPECTRANET_ROM_BASE * MEMORY_PAGES_IN_4K].page;
@@ -451,6 +461,9 @@ spectranet_init( void *context )
   w5100 = nic_w5100_alloc();
   flash_rom = flash_am29f010_alloc();
 
+  benchmark_register( &settings_current.benchmark_spectranet, NULL,
+                      nic_w5100_benchmark );
+
   return 0;
 }
 
@@ -25,6 +25,8 @@
 
 #include <config.h>
 
+#include <string.h>
+
 #include <libspectrum.h>
 
 #include "compat.h"
@@ -48,6 +50,36 @@ static libspectrum_byte last_byte;
 
 libspectrum_byte ula_contention[ ULA_CONTENTION_SIZE ];
 libspectrum_byte ula_contention_no_mreq[ ULA_CONTENTION_SIZE ];
+libspectrum_dword ula_contention_tstates;
+
+/* Ports are split into four classes: bit 0 is set if the high byte of
+   the port is in contended memory, and bit 1 if the port is read or
+   written by the ULA. For each class, the total delay of a port read
+   and the delay of the second half of a port write, indexed by the
+   tstate at which they start */
+#define PORT_CLASS_CONTENDED 1
+#define PORT_CLASS_ULA 2
+
+/* The most tstates a port read can take */
+#define PORT_LOOKAHEAD 32
+
+static libspectrum_byte port_read_delay[ 4 ][ ULA_CONTENTION_SIZE ];
+static libspectrum_byte port_late_delay[ 4 ][ ULA_CONTENTION_SIZE ];
+
+/* Everything the contention arrays depend on. They are only rebuilt
+   when this changes, not on every reset */
+typedef struct contention_key_t {
+  spectrum_contention_delay_function contend_delay;
+  spectrum_contention_delay_function contend_delay_no_mreq;
+  libspectrum_dword line_time;
+  libspectrum_word tstates_per_line;
+  libspectrum_word left_border;
+  libspectrum_word horizontal_screen;
+  libspectrum_dword tstates_per_frame;
+} contention_key_t;
+
+static contention_key_t contention_key;
+static int contention_key_valid = 0;
 
 /* What to return if no other input pressed; depends on the last byte
    output to the ULA; see CSS FAQ | Technical Information | Port #FE
@@ -198,6 +230,9 @@ ula_read( libspectrum_word port, libspectrum_byte *attached )
 static void
 ula_write( libspectrum_word port GCC_UNUSED, libspectrum_byte b )
 {
+  if( tape_recording && ( ( b ^ last_byte ) & 0x8 ) )
+    tape_record_edge( tstates, b & 0x8 );
+
   last_byte = b;
 
   display_set_lores_border( b & 0x07 );
@@ -256,11 +291,151 @@ ula_to_snapshot( libspectrum_snap *snap )
   libspectrum_snap_set_issue2( snap, settings_current.issue2 );
 }  
 
+/* The delay without MREQ at 'time', allowing for port accesses which
+   run off the end of the array */
+static libspectrum_dword
+no_mreq_delay( libspectrum_dword time )
+{
+  return time < ULA_CONTENTION_SIZE ? ula_contention_no_mreq[ time ] : 0;
+}
+
+static libspectrum_dword
+early_delay( int port_class, libspectrum_dword time )
+{
+  libspectrum_dword start = time;
+
+  if( port_class & PORT_CLASS_CONTENDED ) time += no_mreq_delay( time );
+  time++;
+
+  return time - start;
+}
+
+static libspectrum_dword
+late_delay( int port_class, libspectrum_dword time )
+{
+  libspectrum_dword start = time;
+
+  if( port_class & PORT_CLASS_ULA ) {
+
+    time += no_mreq_delay( time ); time += 2;
+
+  } else {
+
+    if( port_class & PORT_CLASS_CONTENDED ) {
+      time += no_mreq_delay( time ); time++;
+      time += no_mreq_delay( time ); time++;
+      time += no_mreq_delay( time );
+    } else {
+      time += 2;
+    }
+
+  }
+
+  return time - start;
+}
+
+static void
+port_contention_calculate( libspectrum_dword start, libspectrum_dword end )
+{
+  libspectrum_dword time, early;
+  int port_class;
+
+  for( port_class = 1; port_class < 4; port_class++ ) {
+    for( time = start; time < end; time++ ) {
+      early = early_delay( port_class, time );
+      port_read_delay[ port_class ][ time ] =
+        early + late_delay( port_class, time + early );
+      port_late_delay[ port_class ][ time ] = late_delay( port_class, time );
+    }
+  }
+}
+
+static void
+port_contention_setup( void )
+{
+  libspectrum_dword line = machine_current->timings.tstates_per_line;
+  libspectrum_dword time, length;
+  int port_class;
+
+  /* Nothing to look up for uncontended ports which aren't the ULA's */
+  memset( port_read_delay[0], 3, ULA_CONTENTION_SIZE );
+  memset( port_late_delay[0], 2, ULA_CONTENTION_SIZE );
+
+  /* The delays for a line's worth of port accesses depend only on the
+     contention during that line and the next PORT_LOOKAHEAD tstates. If
+     that's the same as for the previous line, so are the delays */
+  port_contention_calculate( 0, line );
+
+  for( time = line; time < ULA_CONTENTION_SIZE; time += length ) {
+    length = ULA_CONTENTION_SIZE - time < line ?
+             ULA_CONTENTION_SIZE - time : line;
+
+    if( time + line + PORT_LOOKAHEAD > ULA_CONTENTION_SIZE ||
+        memcmp( &ula_contention_no_mreq[ time ],
+                &ula_contention_no_mreq[ time - line ],
+                line + PORT_LOOKAHEAD ) ) {
+      port_contention_calculate( time, time + length );
+      continue;
+    }
+
+    for( port_class = 1; port_class < 4; port_class++ ) {
+      memcpy( &port_read_delay[ port_class ][ time ],
+              &port_read_delay[ port_class ][ time - line ], length );
+      memcpy( &port_late_delay[ port_class ][ time ],
+              &port_late_delay[ port_class ][ time - line ], length );
+    }
+  }
+}
+
+/* Set up the contention arrays for the current machine and timings. Only
+   the tables for the last timings are kept, so switching from one machine
+   to another and back rebuilds them each time; that takes well under a
+   millisecond, which isn't worth keeping several sets of tables around
+   for */
+void
+ula_contention_setup( void )
+{
+  contention_key_t key;
+  libspectrum_dword length;
+
+  memset( &key, 0, sizeof( key ) );
+  key.contend_delay = machine_current->ram.contend_delay;
+  key.contend_delay_no_mreq = machine_current->ram.contend_delay_no_mreq;
+  key.line_time = machine_current->line_times[ 0 ];
+  key.tstates_per_line = machine_current->timings.tstates_per_line;
+  key.left_border = machine_current->timings.left_border;
+  key.horizontal_screen = machine_current->timings.horizontal_screen;
+  key.tstates_per_frame = machine_current->timings.tstates_per_frame;
+
+  if( contention_key_valid &&
+      !memcmp( &key, &contention_key, sizeof( key ) ) ) return;
+
+  length = key.tstates_per_frame;
+  if( length > ULA_CONTENTION_SIZE ) length = ULA_CONTENTION_SIZE;
+
+  spectrum_contention_fill( ula_contention, length, key.contend_delay );
+  spectrum_contention_fill( ula_contention_no_mreq, length,
+                            key.contend_delay_no_mreq );
+  port_contention_setup();
+
+  contention_key = key;
+  contention_key_valid = 1;
+}
+
+static int
+port_class( libspectrum_word port )
+{
+  return
+    ( memory_map_read[ port >> MEMORY_PAGE_SIZE_LOGARITHM ].contended ?
+      PORT_CLASS_CONTENDED : 0 ) |
+    ( machine_current->ram.port_from_ula( port ) ? PORT_CLASS_ULA : 0 );
+}
+
 void
 ula_contend_port_early( libspectrum_word port )
 {
   if( memory_map_read[ port >> MEMORY_PAGE_SIZE_LOGARITHM ].contended )
-    tstates += ula_contention_no_mreq[ tstates ];
+    ula_contend( ula_contention_no_mreq );
    
   tstates++;
 }
@@ -268,19 +443,19 @@ ula_contend_port_early( libspectrum_word port )
 void
 ula_contend_port_late( libspectrum_word port )
 {
-  if( machine_current->ram.port_from_ula( port ) ) {
-
-    tstates += ula_contention_no_mreq[ tstates ]; tstates += 2;
+  libspectrum_byte delay = port_late_delay[ port_class( port ) ][ tstates ];
 
-  } else {
+  /* Two of these T-states are the I/O cycle itself */
+  tstates += delay; ula_contention_tstates += delay - 2;
+}
 
-    if( memory_map_read[ port >> MEMORY_PAGE_SIZE_LOGARITHM ].contended ) {
-      tstates += ula_contention_no_mreq[ tstates ]; tstates++;
-      tstates += ula_contention_no_mreq[ tstates ]; tstates++;
-      tstates += ula_contention_no_mreq[ tstates ];
-    } else {
-      tstates += 2;
-    }
+/* The same as ula_contend_port_early() followed by
+   ula_contend_port_late() */
+void
+ula_contend_port( libspectrum_word port )
+{
+  libspectrum_byte delay = port_read_delay[ port_class( port ) ][ tstates ];
 
-  }
+  /* Three of these T-states are the I/O cycle itself */
+  tstates += delay; ula_contention_tstates += delay - 3;
 }
@@ -32,13 +32,30 @@ extern libspectrum_byte ula_contention[ ULA_CONTENTION_SIZE ];
 /* And how much when it is inactive */
 extern libspectrum_byte ula_contention_no_mreq[ ULA_CONTENTION_SIZE ];
 
+/* The number of T-states the Z80 has been held up by contention. This is
+   only kept for the profiler and wraps, so only differences mean
+   anything */
+extern libspectrum_dword ula_contention_tstates;
+
+/* Apply the delay from one of the contention tables at the current time.
+   Only used once an access is known to be contended, so uncontended
+   accesses don't pay for the count */
+#define ula_contend( table ) \
+  do { \
+    libspectrum_byte ula_delay = (table)[ tstates ]; \
+    tstates += ula_delay; ula_contention_tstates += ula_delay; \
+  } while( 0 )
+
 void ula_register_startup( void );
 
 libspectrum_byte ula_last_byte( void );
 
 libspectrum_byte ula_tape_level( void );
 
+void ula_contention_setup( void );
+
 void ula_contend_port_early( libspectrum_word port );
 void ula_contend_port_late( libspectrum_word port );
+void ula_contend_port( libspectrum_word port );
 
 #endif			/* #ifndef FUSE_ULA_H */
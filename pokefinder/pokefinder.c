@@ -23,19 +23,58 @@
 
 #include <config.h>
 
+#include <stdio.h>
 #include <string.h>
 
 #include <libspectrum.h>
 
+#include "fuse.h"
 #include "machine.h"
 #include "memory_pages.h"
 #include "pokefinder.h"
 #include "spectrum.h"
 
-libspectrum_byte pokefinder_possible[ MEMORY_PAGES_IN_16K * SPECTRUM_RAM_PAGES ][ MEMORY_PAGE_SIZE ];
-libspectrum_byte pokefinder_impossible[ MEMORY_PAGES_IN_16K * SPECTRUM_RAM_PAGES ][ MEMORY_PAGE_SIZE / 8 ];
+#define POKEFINDER_PAGES ( MEMORY_PAGES_IN_16K * SPECTRUM_RAM_PAGES )
+
+/* Locations are examined in groups of 32, which is one 32-bit word of
+   the `impossible' bitmap */
+#define GROUP_SIZE 32
+
+/* Once this few locations remain, searches walk a list of them rather
+   than the whole of RAM */
+#define LIST_THRESHOLD 4096
+
+libspectrum_byte pokefinder_possible[ POKEFINDER_PAGES ][ MEMORY_PAGE_SIZE ];
+libspectrum_byte pokefinder_impossible[ POKEFINDER_PAGES ][ MEMORY_PAGE_SIZE / 8 ];
 size_t pokefinder_count;
 
+/* The remaining locations, as page * MEMORY_PAGE_SIZE + offset in
+   ascending order; only valid if candidates_valid is set */
+static libspectrum_dword candidates[ LIST_THRESHOLD ];
+static size_t candidate_count;
+static int candidates_valid;
+
+static size_t list_threshold = LIST_THRESHOLD;
+
+typedef enum search_type {
+
+  SEARCH_RANGE,			/* Between 'low' and 'high' inclusive */
+  SEARCH_INCREMENTED,
+  SEARCH_DECREMENTED,
+  SEARCH_CHANGED,
+  SEARCH_UNCHANGED,
+  SEARCH_WORD,			/* This and the next byte hold 'word' */
+
+} search_type;
+
+typedef struct search_t {
+
+  search_type type;
+  libspectrum_byte low, high;
+  libspectrum_word word;
+
+} search_t;
+
 void
 pokefinder_clear( void )
 {
@@ -43,80 +82,461 @@ pokefinder_clear( void )
 
   max_page = MEMORY_PAGES_IN_16K * machine_current->ram.valid_pages;
   pokefinder_count = 0;
-  for( page = 0; page < MEMORY_PAGES_IN_16K * SPECTRUM_RAM_PAGES; ++page )
+  for( page = 0; page < POKEFINDER_PAGES; ++page )
     if( page < max_page && memory_map_ram[page].writable ) {
       pokefinder_count += MEMORY_PAGE_SIZE;
       memcpy( pokefinder_possible[page], memory_map_ram[page].page, MEMORY_PAGE_SIZE );
       memset( pokefinder_impossible[page], 0, MEMORY_PAGE_SIZE / 8 );
     } else
       memset( pokefinder_impossible[page], 255, MEMORY_PAGE_SIZE / 8 );
+
+  candidates_valid = 0;
 }
 
-int
-pokefinder_search( libspectrum_byte value )
+static libspectrum_dword
+load_mask( const libspectrum_byte *bitmap )
 {
-  size_t page, offset;
+  return bitmap[0] | bitmap[1] << 8 | bitmap[2] << 16 |
+         (libspectrum_dword)bitmap[3] << 24;
+}
 
-  for( page = 0; page < MEMORY_PAGES_IN_16K * SPECTRUM_RAM_PAGES; page++ ) {
-    memory_page *mapping = &memory_map_ram[ page ];
+static void
+store_mask( libspectrum_byte *bitmap, libspectrum_dword mask )
+{
+  bitmap[0] = mask; bitmap[1] = mask >> 8;
+  bitmap[2] = mask >> 16; bitmap[3] = mask >> 24;
+}
 
-    for( offset = 0; offset < MEMORY_PAGE_SIZE; offset++ ) {
-      if( pokefinder_impossible[page][offset/8] & 1 << (offset & 7) ) continue;
+static size_t
+count_bits( libspectrum_dword mask )
+{
+  size_t count = 0;
 
-      if( mapping->page[offset] != value ) {
-	pokefinder_impossible[page][offset/8] |= 1 << (offset & 7);
-	pokefinder_count--;
-      }
+  for( ; mask; mask &= mask - 1 ) count++;
+
+  return count;
+}
+
+/* Bit n of the result is set if bytes n of 'a' and 'b' differ. Each
+   eight bytes are compared as one 64-bit word: XOR leaves a non-zero
+   byte wherever they differ, the top bit of each byte is then set if
+   any of its bits are, and a multiply gathers the top bits together */
+static libspectrum_dword
+differ_mask( const libspectrum_byte *a, const libspectrum_byte *b )
+{
+  const libspectrum_qword low7 = 0x7f7f7f7f7f7f7f7fULL;
+  libspectrum_qword x, y, diff;
+  libspectrum_dword mask = 0;
+  int i;
+
+  for( i = 0; i < GROUP_SIZE; i += 8 ) {
+    memcpy( &x, &a[i], sizeof( x ) );
+    memcpy( &y, &b[i], sizeof( y ) );
+
+    diff = x ^ y;
+    diff = ( ( ( diff & low7 ) + low7 ) | diff ) & ~low7;
+
+#ifdef WORDS_BIGENDIAN
+    mask |= (libspectrum_dword)
+      ( ( ( diff >> 7 ) * 0x8040201008040201ULL ) >> 56 ) << i;
+#else			/* #ifdef WORDS_BIGENDIAN */
+    mask |= (libspectrum_dword)
+      ( ( ( diff >> 7 ) * 0x0102040810204080ULL ) >> 56 ) << i;
+#endif			/* #ifdef WORDS_BIGENDIAN */
+  }
+
+  return mask;
+}
+
+/* Does the location at 'offset' within 'page' pass 'search'? */
+static int
+passes( const search_t *search, size_t page, size_t offset )
+{
+  libspectrum_byte now = memory_map_ram[ page ].page[ offset ];
+  libspectrum_byte before = pokefinder_possible[ page ][ offset ];
+  libspectrum_byte next;
+
+  switch( search->type ) {
+
+  case SEARCH_RANGE:
+    return now >= search->low && now <= search->high;
+
+  case SEARCH_INCREMENTED: return now > before;
+  case SEARCH_DECREMENTED: return now < before;
+  case SEARCH_CHANGED: return now != before;
+  case SEARCH_UNCHANGED: return now == before;
+
+  case SEARCH_WORD:
+    /* Values may run across 2K pages, but not 16K ones */
+    if( offset + 1 < MEMORY_PAGE_SIZE ) {
+      next = memory_map_ram[ page ].page[ offset + 1 ];
+    } else if( ( page + 1 ) % MEMORY_PAGES_IN_16K ) {
+      next = memory_map_ram[ page + 1 ].page[ 0 ];
+    } else {
+      return 0;
     }
+    return ( now | next << 8 ) == search->word;
+
   }
 
   return 0;
 }
 
-int
-pokefinder_incremented( void )
+/* Returns a mask of the locations in the group starting at 'offset'
+   within 'page' which fail 'search'; only the locations in 'live' need
+   be correct */
+static libspectrum_dword
+group_fails( const search_t *search, size_t page, size_t offset,
+             libspectrum_dword live )
+{
+  const libspectrum_byte *now = &memory_map_ram[ page ].page[ offset ];
+  libspectrum_byte value[ GROUP_SIZE ];
+  libspectrum_dword fails = 0, bit;
+  size_t i;
+
+  switch( search->type ) {
+
+  case SEARCH_RANGE:
+    if( search->low != search->high ) break;
+    memset( value, search->low, GROUP_SIZE );
+    return differ_mask( now, value );
+
+  case SEARCH_CHANGED:
+    return ~differ_mask( now, &pokefinder_possible[ page ][ offset ] );
+
+  case SEARCH_UNCHANGED:
+    return differ_mask( now, &pokefinder_possible[ page ][ offset ] );
+
+  case SEARCH_WORD:
+    /* The last group in a page needs the next page */
+    if( offset + GROUP_SIZE >= MEMORY_PAGE_SIZE ) break;
+    memset( value, search->word & 0xff, GROUP_SIZE );
+    fails = differ_mask( now, value );
+    memset( value, search->word >> 8, GROUP_SIZE );
+    return fails | differ_mask( now + 1, value );
+
+  default:
+    break;
+
+  }
+
+  /* Otherwise, one location at a time */
+  for( i = 0; live; i++, live >>= 1 ) {
+    bit = (libspectrum_dword)1 << i;
+    if( ( live & 1 ) && !passes( search, page, offset + i ) ) fails |= bit;
+  }
+
+  return fails;
+}
+
+static void
+build_candidates( void )
+{
+  size_t page, offset, i;
+  libspectrum_dword live;
+
+  candidate_count = 0;
+
+  for( page = 0; page < POKEFINDER_PAGES; page++ ) {
+    for( offset = 0; offset < MEMORY_PAGE_SIZE; offset += GROUP_SIZE ) {
+      live = ~load_mask( &pokefinder_impossible[ page ][ offset / 8 ] );
+      for( i = 0; live; i++, live >>= 1 )
+        if( live & 1 )
+          candidates[ candidate_count++ ] =
+            page * MEMORY_PAGE_SIZE + offset + i;
+    }
+  }
+
+  candidates_valid = 1;
+}
+
+/* Search through every location in RAM */
+static void
+search_all( const search_t *search )
 {
   size_t page, offset;
+  libspectrum_dword live, fails;
+  libspectrum_byte *bitmap;
 
-  for( page = 0; page < MEMORY_PAGES_IN_16K * SPECTRUM_RAM_PAGES; page++ ) {
-    memory_page *mapping = &memory_map_ram[ page ];
+  for( page = 0; page < POKEFINDER_PAGES; page++ ) {
+    for( offset = 0; offset < MEMORY_PAGE_SIZE; offset += GROUP_SIZE ) {
+      bitmap = &pokefinder_impossible[ page ][ offset / 8 ];
 
-    for( offset = 0; offset < MEMORY_PAGE_SIZE; offset++ ) {
-      if( pokefinder_impossible[page][offset/8] & 1 << (offset & 7) ) continue;
+      live = ~load_mask( bitmap );
+      if( !live ) continue;
 
-      if( mapping->page[offset] > pokefinder_possible[page][offset] ) {
-        pokefinder_possible[page][offset] = mapping->page[offset];
-      } else {
-	pokefinder_impossible[page][offset/8] |= 1 << (offset & 7);
-	pokefinder_count--;
+      fails = group_fails( search, page, offset, live ) & live;
+      if( fails ) {
+        store_mask( bitmap, ~live | fails );
+        pokefinder_count -= count_bits( fails );
       }
 
+      /* Remember the current values for the next search */
+      if( fails != live )
+        memcpy( &pokefinder_possible[ page ][ offset ],
+                &memory_map_ram[ page ].page[ offset ], GROUP_SIZE );
     }
   }
+}
+
+/* Search through just the locations in the candidate list */
+static void
+search_candidates( const search_t *search )
+{
+  size_t i, kept, page, offset;
+  libspectrum_dword location;
+
+  for( i = 0, kept = 0; i < candidate_count; i++ ) {
+    location = candidates[i];
+    page = location / MEMORY_PAGE_SIZE;
+    offset = location % MEMORY_PAGE_SIZE;
+
+    if( passes( search, page, offset ) ) {
+      pokefinder_possible[ page ][ offset ] =
+        memory_map_ram[ page ].page[ offset ];
+      candidates[ kept++ ] = location;
+    } else {
+      pokefinder_impossible[ page ][ offset / 8 ] |= 1 << ( offset & 7 );
+      pokefinder_count--;
+    }
+  }
+
+  candidate_count = kept;
+}
+
+static int
+search( const search_t *search )
+{
+  if( candidates_valid ) {
+    search_candidates( search );
+  } else {
+    search_all( search );
+    if( pokefinder_count <= list_threshold ) build_candidates();
+  }
 
   return 0;
 }
 
+/* Keep only the locations which contain 'value' */
+int
+pokefinder_search( libspectrum_byte value )
+{
+  return pokefinder_search_range( value, 0 );
+}
+
+/* Keep only the locations within 'tolerance' of 'value' */
+int
+pokefinder_search_range( libspectrum_byte value, libspectrum_byte tolerance )
+{
+  search_t s;
+
+  s.type = SEARCH_RANGE;
+  s.low = value > tolerance ? value - tolerance : 0;
+  s.high = 0xff - value > tolerance ? value + tolerance : 0xff;
+
+  return search( &s );
+}
+
+/* Keep only the locations which, with the following location, contain
+   'value' stored low byte first */
+int
+pokefinder_search_word( libspectrum_word value )
+{
+  search_t s;
+
+  s.type = SEARCH_WORD;
+  s.word = value;
+
+  return search( &s );
+}
+
+static int
+search_type_only( search_type type )
+{
+  search_t s;
+
+  s.type = type;
+
+  return search( &s );
+}
+
+/* The remaining searches compare each location with its value at the
+   previous search */
+
+int
+pokefinder_incremented( void )
+{
+  return search_type_only( SEARCH_INCREMENTED );
+}
+
 int
 pokefinder_decremented( void )
 {
-  size_t page, offset;
+  return search_type_only( SEARCH_DECREMENTED );
+}
 
-  for( page = 0; page < MEMORY_PAGES_IN_16K * SPECTRUM_RAM_PAGES; page++ ) {
-    memory_page *mapping = &memory_map_ram[ page ];
+int
+pokefinder_changed( void )
+{
+  return search_type_only( SEARCH_CHANGED );
+}
 
-    for( offset = 0; offset < MEMORY_PAGE_SIZE; offset++ ) {
-      if( pokefinder_impossible[page][offset/8] & 1 << (offset & 7) ) continue;
+int
+pokefinder_unchanged( void )
+{
+  return search_type_only( SEARCH_UNCHANGED );
+}
 
-      if( mapping->page[offset] < pokefinder_possible[page][offset] ) {
-        pokefinder_possible[page][offset] = mapping->page[offset];
+/* The bitmap the unit tests expect after each search */
+static libspectrum_byte ( *expected )[ MEMORY_PAGE_SIZE / 8 ];
+
+/* Run 'search' and check it removed just the locations which the simple
+   location at a time test says it should */
+static int
+unittest_search( const char *name, const search_t *s )
+{
+  size_t page, offset, count = 0;
+  int impossible;
+
+  for( page = 0; page < POKEFINDER_PAGES; page++ ) {
+    memcpy( expected[ page ], pokefinder_impossible[ page ],
+            MEMORY_PAGE_SIZE / 8 );
+    for( offset = 0; offset < MEMORY_PAGE_SIZE; offset++ ) {
+      if( expected[ page ][ offset / 8 ] & 1 << ( offset & 7 ) ) continue;
+      if( passes( s, page, offset ) ) {
+        count++;
       } else {
-	pokefinder_impossible[page][offset/8] |= 1 << (offset & 7);
-	pokefinder_count--;
+        expected[ page ][ offset / 8 ] |= 1 << ( offset & 7 );
       }
+    }
+  }
+
+  search( s );
 
+  for( page = 0; page < POKEFINDER_PAGES; page++ ) {
+    for( offset = 0; offset < MEMORY_PAGE_SIZE; offset++ ) {
+      impossible = pokefinder_impossible[ page ][ offset / 8 ] &
+                   1 << ( offset & 7 );
+      if( !impossible != !( expected[ page ][ offset / 8 ] &
+                            1 << ( offset & 7 ) ) ) {
+        printf( "%s: pokefinder %s: page %lu offset 0x%03lx is %s\n",
+                fuse_progname, name, (unsigned long)page,
+                (unsigned long)offset, impossible ? "missing" : "extra" );
+        return 1;
+      }
+      if( !impossible && pokefinder_possible[ page ][ offset ] !=
+                         memory_map_ram[ page ].page[ offset ] ) {
+        printf( "%s: pokefinder %s: page %lu offset 0x%03lx "
+                "not updated\n", fuse_progname, name, (unsigned long)page,
+                (unsigned long)offset );
+        return 1;
+      }
     }
   }
 
+  if( pokefinder_count != count ) {
+    printf( "%s: pokefinder %s: %lu locations, expected %lu\n",
+            fuse_progname, name, (unsigned long)pokefinder_count,
+            (unsigned long)count );
+    return 1;
+  }
+
   return 0;
 }
+
+/* Alter every 'step'th byte of the test area by 'delta' */
+static void
+unittest_alter( libspectrum_byte *ram, size_t step, int delta )
+{
+  size_t i;
+
+  for( i = 0; i < MEMORY_PAGE_SIZE; i += step ) ram[i] += delta;
+}
+
+static int
+unittest_run( size_t page )
+{
+  libspectrum_byte *ram = memory_map_ram[ page ].page;
+  search_t s;
+  size_t i;
+  int r = 0;
+
+  /* A byte search, then each of the comparisons with the previous
+     values */
+  for( i = 0; i < MEMORY_PAGE_SIZE; i++ ) ram[i] = i & 0x0f;
+  pokefinder_clear();
+
+  s.type = SEARCH_RANGE; s.low = 1; s.high = 5;
+  r += unittest_search( "range", &s );
+
+  unittest_alter( ram, 3, 1 );
+  s.type = SEARCH_INCREMENTED;
+  r += unittest_search( "incremented", &s );
+
+  unittest_alter( ram, 2, -1 );
+  s.type = SEARCH_DECREMENTED;
+  r += unittest_search( "decremented", &s );
+
+  s.type = SEARCH_UNCHANGED;
+  r += unittest_search( "unchanged", &s );
+
+  unittest_alter( ram, 4, 7 );
+  s.type = SEARCH_CHANGED;
+  r += unittest_search( "changed", &s );
+
+  /* 16-bit values, including one across the end of a 2K page */
+  ram[ 40 ] = 0x34; ram[ 41 ] = 0x12;
+  ram[ MEMORY_PAGE_SIZE - 1 ] = 0x34;
+  memory_map_ram[ page + 1 ].page[0] = 0x12;
+  pokefinder_clear();
+
+  s.type = SEARCH_WORD; s.word = 0x1234;
+  r += unittest_search( "word", &s );
+
+  s.type = SEARCH_RANGE; s.low = s.high = 0x34;
+  r += unittest_search( "byte", &s );
+
+  if( !r && pokefinder_count < 2 ) {
+    printf( "%s: pokefinder word: test values not found\n",
+            fuse_progname );
+    r++;
+  }
+
+  return r;
+}
+
+int
+pokefinder_unittest( void )
+{
+  libspectrum_byte saved[ 2 ][ MEMORY_PAGE_SIZE ];
+  size_t page;
+  int r = 0;
+
+  /* Use the first writable 16K page */
+  for( page = 0;
+       page < MEMORY_PAGES_IN_16K * machine_current->ram.valid_pages;
+       page += MEMORY_PAGES_IN_16K )
+    if( memory_map_ram[ page ].writable ) break;
+  if( page >= MEMORY_PAGES_IN_16K * machine_current->ram.valid_pages )
+    return 0;
+
+  expected = libspectrum_malloc_n( POKEFINDER_PAGES, sizeof( *expected ) );
+
+  memcpy( saved[0], memory_map_ram[ page ].page, MEMORY_PAGE_SIZE );
+  memcpy( saved[1], memory_map_ram[ page + 1 ].page, MEMORY_PAGE_SIZE );
+
+  /* Once searching the whole of RAM every time, and once switching to
+   the candidate list when possible */
+  list_threshold = 0;
+  r += unittest_run( page );
+  list_threshold = LIST_THRESHOLD;
+  r += unittest_run( page );
+
+  memcpy( memory_map_ram[ page ].page, saved[0], MEMORY_PAGE_SIZE );
+  memcpy( memory_map_ram[ page + 1 ].page, saved[1], MEMORY_PAGE_SIZE );
+  pokefinder_clear();
+
+  libspectrum_free( expected );
+
+  return r;
+}
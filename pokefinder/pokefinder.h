@@ -32,7 +32,14 @@ extern size_t pokefinder_count;
 
 void pokefinder_clear( void );
 int pokefinder_search( libspectrum_byte value );
+int pokefinder_search_range( libspectrum_byte value,
+                             libspectrum_byte tolerance );
+int pokefinder_search_word( libspectrum_word value );
 int pokefinder_incremented( void );
 int pokefinder_decremented( void );
+int pokefinder_changed( void );
+int pokefinder_unchanged( void );
+
+int pokefinder_unittest( void );
 
 #endif				/* #ifndef FUSE_POKEFINDER_H */
@@ -30,6 +30,7 @@
 #include "machine.h"
 #include "memory_pages.h"
 #include "pokemem.h"
+#include "rewind.h"
 #include "spectrum.h"
 #include "utils.h"
 
@@ -410,6 +411,7 @@ pokemem_poke_activate( gpointer data, gpointer user_data )
   } else {
     address &= 0x3fff;
     poke->restore = RAM[ bank ][ address ];
+    rewind_ram_write( bank, address );
     RAM[ bank ][ address ] = value;
   }
 }
@@ -438,6 +440,7 @@ pokemem_poke_deactivate( gpointer data, gpointer user_data GCC_UNUSED )
   if( bank == 8 ) {
     writebyte_internal( address, value );
   } else {
+    rewind_ram_write( bank, address & 0x3fff );
     RAM[ bank ][ address & 0x3fff ] = value;
   }
 
@@ -30,16 +30,66 @@
 
 #include "event.h"
 #include "infrastructure/startup_manager.h"
+#include "memory_pages.h"
 #include "module.h"
+#include "peripherals/ula.h"
 #include "profile.h"
 #include "ui/ui.h"
+#include "utils.h"
 #include "z80/z80.h"
 
 int profile_active = 0;
 
-static int total_tstates[ 0x10000 ];
-static libspectrum_word profile_last_pc;
-static libspectrum_dword profile_last_tstates;
+/* Where an instruction lives: the page it was executed from and its offset
+   within that page, so the same Z80 address in different banks is kept
+   separate */
+typedef struct profile_location_t {
+  int source;
+  int page_num;
+  libspectrum_word offset;
+} profile_location_t;
+
+/* The statistics for one location */
+typedef struct profile_entry_t {
+  profile_location_t location;
+  libspectrum_word address;	/* The Z80 address it was last executed at */
+  libspectrum_dword executions;
+  libspectrum_qword tstates;
+  libspectrum_qword contention;	/* Of the T-states, those lost to contention */
+} profile_entry_t;
+
+/* One node of the call tree: a function as called via a particular chain
+   of callers */
+typedef struct profile_node_t {
+  profile_location_t function;	/* The entry point of the function */
+  libspectrum_word address;	/* The Z80 address of the entry point */
+  libspectrum_qword tstates;	/* T-states spent in the function itself */
+  struct profile_node_t *parent, *children, *next;
+} profile_node_t;
+
+/* Deeper calls than this are counted against the deepest function; this
+   stops code which discards return addresses growing the tree forever */
+#define PROFILE_MAX_DEPTH 256
+
+/* What the last instruction could have done to the call stack */
+typedef enum profile_flow_t {
+  PROFILE_FLOW_NONE,
+  PROFILE_FLOW_CALL,
+  PROFILE_FLOW_RETURN,
+} profile_flow_t;
+
+static GHashTable *profile_entries = NULL;
+static profile_entry_t *profile_last_entry;
+static libspectrum_dword profile_last_tstates, profile_last_contention;
+
+static profile_node_t *profile_root = NULL, *profile_current;
+static size_t profile_depth, profile_overflow;
+
+/* The pending stack effect of the last instruction: the flow is taken
+   unless execution carries on at profile_fall_through */
+static profile_flow_t profile_flow;
+static int profile_flow_always;
+static libspectrum_word profile_fall_through;
 
 static void profile_from_snapshot( libspectrum_snap *snap GCC_UNUSED );
 
@@ -70,17 +120,199 @@ profile_register_startup( void )
                             NULL );
 }
 
+static guint
+location_hash( gconstpointer key )
+{
+  const profile_location_t *location = key;
+
+  return ( location->source * 0x3f + location->page_num ) * 0x10000 +
+    location->offset;
+}
+
+static gboolean
+location_equal( gconstpointer a1, gconstpointer b1 )
+{
+  const profile_location_t *a = a1, *b = b1;
+
+  return a->source == b->source && a->page_num == b->page_num &&
+    a->offset == b->offset;
+}
+
+static void
+get_location( libspectrum_word address, profile_location_t *location )
+{
+  const memory_page *mapping =
+    &memory_map_read[ address >> MEMORY_PAGE_SIZE_LOGARITHM ];
+
+  location->source = mapping->source;
+  location->page_num = mapping->page_num;
+  location->offset = mapping->offset + ( address & MEMORY_PAGE_SIZE_MASK );
+}
+
+static profile_entry_t*
+get_entry( libspectrum_word address )
+{
+  profile_location_t location;
+  profile_entry_t *entry;
+
+  get_location( address, &location );
+
+  entry = g_hash_table_lookup( profile_entries, &location );
+  if( !entry ) {
+    entry = libspectrum_new( profile_entry_t, 1 );
+    entry->location = location;
+    entry->executions = 0;
+    entry->tstates = 0;
+    entry->contention = 0;
+    g_hash_table_insert( profile_entries, &entry->location, entry );
+  }
+
+  entry->address = address;
+
+  return entry;
+}
+
+static profile_node_t*
+node_new( profile_node_t *parent, libspectrum_word address )
+{
+  profile_node_t *node = libspectrum_new( profile_node_t, 1 );
+
+  get_location( address, &node->function );
+  node->address = address;
+  node->tstates = 0;
+  node->parent = parent;
+  node->children = NULL;
+  node->next = NULL;
+
+  return node;
+}
+
+static void
+node_free( profile_node_t *node )
+{
+  while( node ) {
+    profile_node_t *next = node->next;
+    node_free( node->children );
+    libspectrum_free( node );
+    node = next;
+  }
+}
+
+/* Enter the function at the given address from the current one */
+static void
+call_enter( libspectrum_word address )
+{
+  profile_location_t location;
+  profile_node_t *child;
+
+  if( profile_depth >= PROFILE_MAX_DEPTH ) {
+    profile_overflow++;
+    return;
+  }
+
+  get_location( address, &location );
+
+  for( child = profile_current->children; child; child = child->next )
+    if( location_equal( &child->function, &location ) ) break;
+
+  if( !child ) {
+    child = node_new( profile_current, address );
+    child->next = profile_current->children;
+    profile_current->children = child;
+  }
+
+  profile_current = child;
+  profile_depth++;
+}
+
+static void
+call_return( void )
+{
+  if( profile_overflow ) {
+    profile_overflow--;
+  } else if( profile_current->parent ) {
+    profile_current = profile_current->parent;
+    profile_depth--;
+  }
+}
+
+/* Apply the stack effect of the last instruction, now that we know it
+   continued at 'pc' */
+static void
+resolve_flow( libspectrum_word pc )
+{
+  if( profile_flow == PROFILE_FLOW_NONE ) return;
+
+  if( profile_flow_always || pc != profile_fall_through ) {
+    if( profile_flow == PROFILE_FLOW_CALL ) {
+      call_enter( pc );
+    } else {
+      call_return();
+    }
+  }
+
+  profile_flow = PROFILE_FLOW_NONE;
+}
+
+/* Work out whether the instruction at 'pc' is a call or return */
+static void
+decode_flow( libspectrum_word pc )
+{
+  libspectrum_byte opcode = readbyte_internal( pc );
+
+  profile_flow_always = 0;
+
+  if( opcode == 0xcd ) {				/* CALL nn */
+    profile_flow = PROFILE_FLOW_CALL; profile_flow_always = 1;
+  } else if( ( opcode & 0xc7 ) == 0xc4 ) {		/* CALL cc,nn */
+    profile_flow = PROFILE_FLOW_CALL; profile_fall_through = pc + 3;
+  } else if( ( opcode & 0xc7 ) == 0xc7 ) {		/* RST n */
+    profile_flow = PROFILE_FLOW_CALL; profile_flow_always = 1;
+  } else if( opcode == 0xc9 ) {			/* RET */
+    profile_flow = PROFILE_FLOW_RETURN; profile_flow_always = 1;
+  } else if( ( opcode & 0xc7 ) == 0xc0 ) {		/* RET cc */
+    profile_flow = PROFILE_FLOW_RETURN; profile_fall_through = pc + 1;
+  } else if( opcode == 0xed &&
+             ( readbyte_internal( pc + 1 ) & 0xc7 ) == 0x45 ) {
+    /* RETN and RETI */
+    profile_flow = PROFILE_FLOW_RETURN; profile_flow_always = 1;
+  } else {
+    profile_flow = PROFILE_FLOW_NONE;
+  }
+}
+
 static void
 init_profiling_counters( void )
 {
-  profile_last_pc = z80.pc.w;
+  profile_last_entry = NULL;
   profile_last_tstates = tstates;
+  profile_last_contention = ula_contention_tstates;
+  profile_flow = PROFILE_FLOW_NONE;
+
+  profile_current = profile_root;
+  profile_depth = profile_overflow = 0;
+}
+
+static void
+profile_free( void )
+{
+  if( profile_entries ) {
+    g_hash_table_destroy( profile_entries );
+    profile_entries = NULL;
+  }
+
+  node_free( profile_root );
+  profile_root = NULL;
 }
 
 void
 profile_start( void )
 {
-  memset( total_tstates, 0, sizeof( total_tstates ) );
+  profile_free();
+
+  profile_entries = g_hash_table_new_full( location_hash, location_equal,
+                                           NULL, libspectrum_free );
+  profile_root = node_new( NULL, z80.pc.w );
 
   profile_active = 1;
   init_profiling_counters();
@@ -96,10 +328,35 @@ profile_start( void )
 void
 profile_map( libspectrum_word pc )
 {
-  total_tstates[ profile_last_pc ] += tstates - profile_last_tstates;
+  libspectrum_dword elapsed = tstates - profile_last_tstates;
+
+  if( profile_last_entry ) {
+    profile_last_entry->tstates += elapsed;
+    profile_last_entry->contention +=
+      ula_contention_tstates - profile_last_contention;
+  }
+  profile_current->tstates += elapsed;
+
+  resolve_flow( pc );
 
-  profile_last_pc = z80.pc.w;
+  profile_last_entry = get_entry( pc );
+  profile_last_entry->executions++;
   profile_last_tstates = tstates;
+  profile_last_contention = ula_contention_tstates;
+
+  decode_flow( pc );
+}
+
+/* Called when the Z80 accepts an interrupt, with PC still holding the
+   address the interrupted code will return to */
+void
+profile_interrupt( void )
+{
+  resolve_flow( z80.pc.w );
+
+  /* The handler is entered wherever PC next points */
+  profile_flow = PROFILE_FLOW_CALL;
+  profile_flow_always = 1;
 }
 
 void
@@ -113,14 +370,122 @@ profile_frame( libspectrum_dword frame_length )
 static void
 profile_from_snapshot( libspectrum_snap *snap GCC_UNUSED )
 {
-  init_profiling_counters();
+  if( profile_active ) init_profiling_counters();
+}
+
+static void
+get_entries( gpointer key GCC_UNUSED, gpointer value, gpointer user_data )
+{
+  profile_entry_t ***next = user_data;
+
+  *( *next )++ = value;
+}
+
+static int
+compare_entries( const void *a1, const void *b1 )
+{
+  const profile_entry_t *a = *(const profile_entry_t* const*)a1,
+    *b = *(const profile_entry_t* const*)b1;
+
+  if( a->address != b->address ) return a->address < b->address ? -1 : 1;
+  if( a->location.source != b->location.source )
+    return a->location.source - b->location.source;
+  return a->location.page_num - b->location.page_num;
+}
+
+/* Write one line for each location which took any time: the Z80 address,
+   T-states, executions, memory source, page number, offset in the page
+   and the T-states lost to contention. Code run from several pages at
+   the same address gets one line for each page */
+static void
+write_flat_map( FILE *f )
+{
+  profile_entry_t **entries, **next;
+  size_t i, count;
+
+  count = g_hash_table_size( profile_entries );
+  if( !count ) return;
+
+  entries = next = libspectrum_new( profile_entry_t*, count );
+  g_hash_table_foreach( profile_entries, get_entries, &next );
+  qsort( entries, count, sizeof( *entries ), compare_entries );
+
+  for( i = 0; i < count; i++ ) {
+    const profile_entry_t *entry = entries[i];
+
+    if( !entry->tstates ) continue;
+
+    fprintf( f, "0x%04x,%lu,%lu,%s,%d,0x%04x,%lu\n", entry->address,
+             (unsigned long)entry->tstates, (unsigned long)entry->executions,
+             memory_source_description( entry->location.source ),
+             entry->location.page_num, entry->location.offset,
+             (unsigned long)entry->contention );
+  }
+
+  libspectrum_free( entries );
+}
+
+/* Write the call tree in the "folded" format used by flame graph tools:
+   one line per call stack, giving the T-states spent in the innermost
+   function */
+static void
+write_folded_node( FILE *f, const profile_node_t *node, char *stack,
+                   size_t length, size_t size )
+{
+  const profile_node_t *child;
+
+  if( node->parent ) {
+    int written =
+      snprintf( stack + length, size - length, "%s0x%04x (%s %d:0x%04x)",
+                length ? ";" : "", node->address,
+                memory_source_description( node->function.source ),
+                node->function.page_num, node->function.offset );
+    if( written > 0 ) length += written;
+    if( length >= size ) length = size - 1;
+  }
+
+  if( node->tstates )
+    fprintf( f, "%s %lu\n", length ? stack : "[top level]",
+             (unsigned long)node->tstates );
+
+  for( child = node->children; child; child = child->next )
+    write_folded_node( f, child, stack, length, size );
+
+  stack[ length ] = '\0';
+}
+
+static void
+write_call_graph( const char *filename )
+{
+  const size_t size = ( PROFILE_MAX_DEPTH + 1 ) * 64;
+  char *folded_filename, *stack;
+  FILE *f;
+
+  folded_filename = libspectrum_new( char, strlen( filename ) + 8 );
+  sprintf( folded_filename, "%s.folded", filename );
+
+  f = fopen( folded_filename, "w" );
+  if( !f ) {
+    ui_error( UI_ERROR_ERROR, "unable to open call graph '%s' for writing",
+	      folded_filename );
+    libspectrum_free( folded_filename );
+    return;
+  }
+
+  stack = libspectrum_new( char, size );
+  stack[0] = '\0';
+
+  write_folded_node( f, profile_root, stack, 0, size );
+
+  libspectrum_free( stack );
+  fclose( f );
+  libspectrum_free( folded_filename );
 }
 
 void
 profile_finish( const char *filename )
 {
   FILE *f;
-  size_t i;
 
   f = fopen( filename, "w" );
   if( !f ) {
@@ -129,17 +494,14 @@ profile_finish( const char *filename )
     return;
   }
 
-  for( i = 0; i < 0x10000; i++ ) {
-
-    if( !total_tstates[ i ] ) continue;
-
-    fprintf( f, "0x%04lx,%d\n", (unsigned long)i, total_tstates[ i ] );
-
-  }
+  write_flat_map( f );
 
   fclose( f );
 
+  write_call_graph( filename );
+
   profile_active = 0;
+  profile_free();
 
   /* Again, schedule an event to ensure this change is picked up by
      the main loop */
@@ -25,13 +25,26 @@
 
 #include <config.h>
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "display.h"
 #include "fuse.h"
 #include "rectangle.h"
-#include "settings.h"
+#include "timer/timer.h"
 #include "ui/ui.h"
 
+/* The fixed cost of handing one more rectangle to the UI, in chunk-lines
+   (one chunk-line is 8 pixels). Two rectangles are replaced by their
+   bounding box whenever that redraws no more than this many extra
+   chunk-lines */
+#define RECTANGLE_MERGE_COST 32
+
+/* How many of the following rectangles (in top to bottom order) are
+   considered as merge partners for each rectangle */
+#define RECTANGLE_MERGE_WINDOW 16
+
 /* Those rectangles which were modified on the last line to be displayed */
 static struct rectangle *rectangle_active = NULL;
 static size_t rectangle_active_count = 0, rectangle_active_allocated = 0;
@@ -40,6 +53,17 @@ static size_t rectangle_active_count = 0, rectangle_active_allocated = 0;
 struct rectangle *rectangle_inactive = NULL;
 size_t rectangle_inactive_count = 0, rectangle_inactive_allocated = 0;
 
+/* What rectangle_coalesce() did to the last frame, and to all frames */
+struct rectangle_stats rectangle_stats_last, rectangle_stats_total;
+
+/* The input to rectangle_coalesce() for every frame since
+   rectangle_trace_start(), for replaying in rectangle_benchmark() */
+static int trace_active = 0;
+static struct rectangle *trace = NULL;
+static size_t trace_count = 0, trace_allocated = 0;
+static size_t *trace_frames = NULL;
+static size_t trace_frame_count = 0, trace_frames_allocated = 0;
+
 /* Add the rectangle { x, line, w, 1 } to the list of rectangles to be
    redrawn, either by extending an existing rectangle or creating a
    new one */
@@ -150,7 +174,7 @@ rectangle_end_line( int y )
     /* Skip if this rectangle was updated this line */
     if( rectangle_active[i].y + rectangle_active[i].h == y + 1 ) continue;
 
-    if ( settings_current.frame_rate > 1 &&
+    if ( display_frame_skip() > 1 &&
 	 compare_and_merge_rectangles( &rectangle_active[i] ) ) {
 
       /* Mark the active rectangle as done */
@@ -187,3 +211,317 @@ rectangle_end_line( int y )
 
   rectangle_active_count = ptr - rectangle_active;
 }
+
+/* Make room for at least `count' inactive rectangles */
+static void
+inactive_reserve( size_t count )
+{
+  if( count <= rectangle_inactive_allocated ) return;
+
+  rectangle_inactive =
+    libspectrum_renew( struct rectangle, rectangle_inactive, count );
+  rectangle_inactive_allocated = count;
+}
+
+static int
+compare_rectangles( const void *a, const void *b )
+{
+  const struct rectangle *ra = a, *rb = b;
+
+  if( ra->y != rb->y ) return ra->y - rb->y;
+  return ra->x - rb->x;
+}
+
+/* One pass of the coalescer over `rects', which must be sorted top to
+   bottom. Each rectangle absorbs any of the next RECTANGLE_MERGE_WINDOW
+   rectangles if their bounding box redraws at most `threshold' more
+   chunk-lines than the two separately. Returns the new number of
+   rectangles, and sets `merged' if anything changed */
+static size_t
+coalesce_pass( struct rectangle *rects, size_t count, int threshold,
+               int *merged )
+{
+  size_t i, j, seen;
+  struct rectangle *ptr;
+
+  for( i = 0; i < count; i++ ) {
+    struct rectangle *a = &rects[i];
+
+    if( !a->h ) continue;
+
+    for( j = i + 1, seen = 0;
+         j < count && seen < RECTANGLE_MERGE_WINDOW;
+         j++ ) {
+      struct rectangle *b = &rects[j], u;
+
+      if( !b->h ) continue;
+
+      /* Everything from here down is too far below to be worth it: the
+         gap alone would be at least one chunk wide */
+      if( b->y - ( a->y + a->h ) > threshold ) break;
+
+      seen++;
+
+      /* The list is sorted, so a->y <= b->y and the order is preserved
+         when b is folded into a */
+      u.x = MIN( a->x, b->x );
+      u.y = a->y;
+      u.w = MAX( a->x + a->w, b->x + b->w ) - u.x;
+      u.h = MAX( a->y + a->h, b->y + b->h ) - u.y;
+
+      if( u.w * u.h - a->w * a->h - b->w * b->h <= threshold ) {
+        *a = u;
+        b->h = 0;
+        *merged = 1;
+      }
+    }
+  }
+
+  for( i = 0, ptr = rects; i < count; i++ ) {
+    if( rects[i].h == 0 ) continue;
+    *ptr = rects[i]; ptr++;
+  }
+
+  return ptr - rects;
+}
+
+static void
+trace_frame( void )
+{
+  if( trace_frame_count == trace_frames_allocated ) {
+    trace_frames_allocated =
+      trace_frames_allocated ? 2 * trace_frames_allocated : 256;
+    trace_frames =
+      libspectrum_renew( size_t, trace_frames, trace_frames_allocated );
+  }
+  trace_frames[ trace_frame_count++ ] = trace_count;
+
+  if( trace_count + rectangle_inactive_count > trace_allocated ) {
+    trace_allocated = 2 * ( trace_count + rectangle_inactive_count );
+    trace = libspectrum_renew( struct rectangle, trace, trace_allocated );
+  }
+  if( rectangle_inactive_count ) {
+    memcpy( &trace[ trace_count ], rectangle_inactive,
+            rectangle_inactive_count * sizeof( *trace ) );
+    trace_count += rectangle_inactive_count;
+  }
+}
+
+/* Reduce the inactive list to a small set of rectangles covering the same
+   area. Neighbouring rectangles are merged when the overdraw costs less
+   than drawing them separately; if that still leaves more than
+   RECTANGLE_MAX, the acceptable overdraw is doubled until it doesn't */
+void
+rectangle_coalesce( void )
+{
+  size_t i, count = rectangle_inactive_count;
+  int threshold = RECTANGLE_MERGE_COST, merged;
+  libspectrum_qword area = 0;
+
+  if( trace_active ) trace_frame();
+
+  for( i = 0; i < count; i++ )
+    area += rectangle_inactive[i].w * rectangle_inactive[i].h;
+
+  rectangle_stats_last.frames = 1;
+  rectangle_stats_last.rects_in = count;
+  rectangle_stats_last.pixels_dirty = 8 * area;
+
+  if( count > 1 ) {
+    qsort( rectangle_inactive, count, sizeof( *rectangle_inactive ),
+           compare_rectangles );
+
+    while( 1 ) {
+      do {
+        merged = 0;
+        count = coalesce_pass( rectangle_inactive, count, threshold, &merged );
+      } while( merged );
+
+      if( count <= RECTANGLE_MAX ) break;
+      threshold *= 2;
+    }
+
+    rectangle_inactive_count = count;
+
+    for( i = 0, area = 0; i < count; i++ )
+      area += rectangle_inactive[i].w * rectangle_inactive[i].h;
+  }
+
+  rectangle_stats_last.rects_out = count;
+  rectangle_stats_last.pixels_drawn = 8 * area;
+
+  rectangle_stats_total.frames++;
+  rectangle_stats_total.rects_in += rectangle_stats_last.rects_in;
+  rectangle_stats_total.rects_out += count;
+  rectangle_stats_total.pixels_dirty += rectangle_stats_last.pixels_dirty;
+  rectangle_stats_total.pixels_drawn += rectangle_stats_last.pixels_drawn;
+}
+
+/* Start recording the input to rectangle_coalesce() */
+void
+rectangle_trace_start( void )
+{
+  trace_count = 0;
+  trace_frame_count = 0;
+  trace_active = 1;
+}
+
+/* Replay the frames recorded since rectangle_trace_start() through the
+   coalescer, and print how long it took and how well it did */
+void
+rectangle_benchmark( void )
+{
+  const int passes = 20;
+  struct rectangle_stats saved, replay;
+  double start, elapsed, frames;
+  size_t frame;
+  int pass;
+
+  trace_active = 0;
+
+  if( !trace_frame_count ) {
+    printf( "%s: rectangle benchmark: no frames displayed\n", fuse_progname );
+    return;
+  }
+
+  /* Keep the replayed frames out of the running totals */
+  saved = rectangle_stats_total;
+  memset( &rectangle_stats_total, 0, sizeof( rectangle_stats_total ) );
+
+  start = timer_get_time();
+
+  for( pass = 0; pass < passes; pass++ ) {
+    for( frame = 0; frame < trace_frame_count; frame++ ) {
+      size_t begin = trace_frames[ frame ];
+      size_t end = frame + 1 < trace_frame_count ?
+                   trace_frames[ frame + 1 ] : trace_count;
+
+      inactive_reserve( end - begin );
+      memcpy( rectangle_inactive, &trace[ begin ],
+              ( end - begin ) * sizeof( *trace ) );
+      rectangle_inactive_count = end - begin;
+
+      rectangle_coalesce();
+    }
+
+    if( pass == 0 ) replay = rectangle_stats_total;
+  }
+
+  elapsed = timer_get_time() - start;
+
+  rectangle_inactive_count = 0;
+  rectangle_stats_total = saved;
+
+  frames = replay.frames;
+  printf( "%s: rectangle benchmark: %lu frames, %.3f us/frame\n",
+          fuse_progname, (unsigned long)replay.frames,
+          elapsed * 1e6 / passes / frames );
+  printf( "%s: rectangle benchmark: %.1f rectangles/frame in, %.1f out\n",
+          fuse_progname, replay.rects_in / frames, replay.rects_out / frames );
+  printf( "%s: rectangle benchmark: %.0f pixels/frame dirty, %.0f drawn "
+          "(overdraw %.3f)\n", fuse_progname, replay.pixels_dirty / frames,
+          replay.pixels_drawn / frames,
+          replay.pixels_dirty ?
+            (double)replay.pixels_drawn / replay.pixels_dirty : 1.0 );
+
+  libspectrum_free( trace ); trace = NULL;
+  trace_count = trace_allocated = 0;
+  libspectrum_free( trace_frames ); trace_frames = NULL;
+  trace_frame_count = trace_frames_allocated = 0;
+}
+
+/* Run the coalescer over `count' rectangles from `rects' and check every
+   chunk they covered is still covered, and that at most `expected'
+   rectangles came out */
+static int
+coalesce_test( const char *name, const struct rectangle *rects, size_t count,
+               size_t expected )
+{
+  static libspectrum_byte
+    covered[ DISPLAY_SCREEN_HEIGHT ][ DISPLAY_SCREEN_WIDTH_COLS ];
+  size_t i;
+  int x, y, r = 0;
+
+  memset( covered, 0, sizeof( covered ) );
+
+  inactive_reserve( count );
+  memcpy( rectangle_inactive, rects, count * sizeof( *rects ) );
+  rectangle_inactive_count = count;
+
+  rectangle_coalesce();
+
+  if( rectangle_inactive_count > expected ) {
+    fprintf( stderr, "%s: rectangle: %s: %lu rectangles, expected %lu\n",
+             fuse_progname, name, (unsigned long)rectangle_inactive_count,
+             (unsigned long)expected );
+    r++;
+  }
+
+  for( i = 0; i < rectangle_inactive_count; i++ ) {
+    const struct rectangle *ptr = &rectangle_inactive[i];
+    for( y = ptr->y; y < ptr->y + ptr->h; y++ )
+      for( x = ptr->x; x < ptr->x + ptr->w; x++ )
+        covered[y][x] = 1;
+  }
+
+  for( i = 0; i < count; i++ ) {
+    for( y = rects[i].y; y < rects[i].y + rects[i].h; y++ )
+      for( x = rects[i].x; x < rects[i].x + rects[i].w; x++ )
+        if( !covered[y][x] ) {
+          fprintf( stderr, "%s: rectangle: %s: chunk %d,%d not redrawn\n",
+                   fuse_progname, name, x, y );
+          rectangle_inactive_count = 0;
+          return r + 1;
+        }
+  }
+
+  rectangle_inactive_count = 0;
+
+  return r;
+}
+
+int
+rectangle_unittest( void )
+{
+  struct rectangle *rects;
+  struct rectangle_stats saved = rectangle_stats_total;
+  size_t i, count;
+  int x, y, r = 0;
+
+  rects = libspectrum_new( struct rectangle,
+                           DISPLAY_SCREEN_HEIGHT * DISPLAY_SCREEN_WIDTH_COLS );
+
+  /* A sprite moving diagonally leaves a staircase of short rectangles which
+     should become its bounding box */
+  for( i = 0; i < 16; i++ ) {
+    rects[i].x = 3 + i; rects[i].y = 40 + i;
+    rects[i].w = 2; rects[i].h = 1;
+  }
+  r += coalesce_test( "staircase", rects, 16, 1 );
+
+  /* Small updates far apart aren't worth joining */
+  rects[0].x =  0; rects[0].y =   0; rects[0].w = 1; rects[0].h = 8;
+  rects[1].x = 39; rects[1].y =   0; rects[1].w = 1; rects[1].h = 8;
+  rects[2].x =  0; rects[2].y = 200; rects[2].w = 1; rects[2].h = 8;
+  rects[3].x = 39; rects[3].y = 200; rects[3].w = 1; rects[3].h = 8;
+  r += coalesce_test( "corners", rects, 4, 4 );
+  if( rectangle_stats_last.rects_out != 4 ||
+      rectangle_stats_last.pixels_drawn != rectangle_stats_last.pixels_dirty ) {
+    fprintf( stderr, "%s: rectangle: corners: merged unnecessarily\n",
+             fuse_progname );
+    r++;
+  }
+
+  /* A full screen checkerboard must be brought under the limit */
+  for( y = 0, count = 0; y < DISPLAY_SCREEN_HEIGHT; y++ )
+    for( x = y & 1; x < DISPLAY_SCREEN_WIDTH_COLS; x += 2, count++ ) {
+      rects[ count ].x = x; rects[ count ].y = y;
+      rects[ count ].w = 1; rects[ count ].h = 1;
+    }
+  r += coalesce_test( "checkerboard", rects, count, RECTANGLE_MAX );
+
+  libspectrum_free( rects );
+  rectangle_stats_total = saved;
+
+  return r;
+}
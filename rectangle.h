@@ -26,14 +26,36 @@
 #ifndef FUSE_RECTANGLE_H
 #define FUSE_RECTANGLE_H
 
+#include <libspectrum.h>
+
 /* Used for grouping screen writes together */
 struct rectangle { int x,y; int w,h; };
 
+/* The most rectangles rectangle_coalesce() will leave for a frame; the UIs
+   fall back to redrawing the whole screen somewhere above this */
+#define RECTANGLE_MAX 128
+
+/* What rectangle_coalesce() did. Pixels are unscaled, and counted once for
+   each rectangle covering them */
+struct rectangle_stats {
+  size_t frames;
+  size_t rects_in, rects_out;
+  libspectrum_qword pixels_dirty, pixels_drawn;
+};
+
+extern struct rectangle_stats rectangle_stats_last, rectangle_stats_total;
+
 /* Those rectangles which weren't modified on the last line to be displayed */
 extern struct rectangle *rectangle_inactive;
 extern size_t rectangle_inactive_count, rectangle_inactive_allocated;
 
 void rectangle_add( int y, int x, int w );
 void rectangle_end_line( int y );
+void rectangle_coalesce( void );
+
+void rectangle_trace_start( void );
+void rectangle_benchmark( void );
+
+int rectangle_unittest( void );
 
 #endif				/* #ifndef FUSE_RECTANGLE_H */
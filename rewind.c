@@ -0,0 +1,645 @@
+/* rewind.c: frame-granularity rewind buffer
+   Copyright (c) 2026 Fuse contributors
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+/* The rewind buffer keeps a checkpoint for each of the last few thousand
+   frames. Main RAM is not copied wholesale: instead, the first write to
+   each 2 KB chunk in a frame saves the chunk's previous contents, and at
+   the end of the frame those saved chunks are XORed with the current
+   contents and run-length encoded. Each checkpoint therefore holds the
+   machine state (a libspectrum_snap without the RAM pages) plus an undo
+   record for the RAM changes made in the following frame. Rewinding
+   applies the undo records newest first and then restores the state.
+
+   The larger blocks of peripheral RAM and flash (DivIDE, DivMMC, ZXATASP,
+   ZXCF and Spectranet) are registered via rewind_register_memory() and
+   kept in the undo records in the same way, as chunks numbered after
+   those of main RAM. Other peripheral memory, and any custom ROMs, are
+   still copied into each checkpoint's state, and each checkpoint is
+   charged for them when checking the memory cap. */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined( HAVE_MALLOC_H ) && defined( HAVE_MALLOC_USABLE_SIZE )
+#include <malloc.h>
+#endif
+
+#include <libspectrum.h>
+
+#include "fuse.h"
+#include "infrastructure/startup_manager.h"
+#include "machine.h"
+#include "memory_pages.h"
+#include "rewind.h"
+#include "rzx.h"
+#include "settings.h"
+#include "snapshot.h"
+#include "spectrum.h"
+
+/* Ten minutes of frames at 50 Hz */
+#define REWIND_MAX_CHECKPOINTS ( 10 * 60 * 50 )
+
+/* An upper bound on the memory used by a libspectrum_snap itself, for
+   when we can't measure it */
+#define REWIND_STATE_COST 16384
+
+/* The number of 2 KB chunks of main RAM */
+#define REWIND_CHUNKS ( SPECTRUM_RAM_PAGES * MEMORY_PAGES_IN_16K )
+
+/* Runs of this many unchanged bytes end a literal run in the encoding */
+#define REWIND_MIN_SKIP 4
+
+typedef struct rewind_checkpoint_t {
+
+  libspectrum_snap *snap;	/* Machine state, without main RAM */
+  size_t snap_cost;		/* The memory used by `snap' */
+
+  libspectrum_byte *undo;	/* Encoded changes to RAM in the next frame */
+  size_t undo_length;
+
+} rewind_checkpoint_t;
+
+/* A block of peripheral memory tracked in the undo records */
+typedef struct rewind_memory_t {
+
+  libspectrum_byte *memory;
+  size_t length;
+  size_t first_chunk;		/* The number of its first chunk */
+
+} rewind_memory_t;
+
+int rewind_active = 0;
+
+/* The ring of checkpoints; the newest one is still collecting its undo
+   record in `saved_chunks' */
+static rewind_checkpoint_t *ring;
+static size_t ring_start, ring_count;
+static size_t ring_bytes;
+static libspectrum_machine ring_machine;
+
+/* The memory used by a libspectrum_snap with nothing attached to it,
+   measured when the buffer first starts */
+static size_t state_cost = REWIND_STATE_COST;
+
+/* The registered peripheral memory, and the number of chunks including
+   those of main RAM. Chunk numbers are stored as 16-bit words in the undo
+   records, which leaves plenty of room */
+static GArray *registered_memory;
+static size_t chunk_count;
+
+/* Contents at the last checkpoint of each chunk written since then */
+static libspectrum_byte *saved_chunks;
+static libspectrum_byte *chunk_saved;
+static libspectrum_word *dirty_chunks;
+static size_t dirty_count;
+
+/* Make room for `count' more chunks, returning the number of the first */
+static size_t
+add_chunks( size_t count )
+{
+  size_t first = chunk_count;
+
+  chunk_count += count;
+
+  chunk_saved = libspectrum_renew( libspectrum_byte, chunk_saved,
+                                   chunk_count );
+  memset( chunk_saved + first, 0, count );
+  dirty_chunks = libspectrum_renew( libspectrum_word, dirty_chunks,
+                                    chunk_count );
+  if( saved_chunks )
+    saved_chunks = libspectrum_renew( libspectrum_byte, saved_chunks,
+                                      chunk_count * MEMORY_PAGE_SIZE );
+
+  return first;
+}
+
+static void
+main_ram_chunks( void )
+{
+  if( !chunk_count ) add_chunks( REWIND_CHUNKS );
+}
+
+static int
+rewind_init( void *context GCC_UNUSED )
+{
+  main_ram_chunks();
+  return 0;
+}
+
+static void
+rewind_end( void )
+{
+  rewind_reset();
+  libspectrum_free( ring ); ring = NULL;
+  libspectrum_free( saved_chunks ); saved_chunks = NULL;
+  libspectrum_free( chunk_saved ); chunk_saved = NULL;
+  libspectrum_free( dirty_chunks ); dirty_chunks = NULL;
+  chunk_count = 0;
+
+  if( registered_memory ) {
+    g_array_free( registered_memory, TRUE );
+    registered_memory = NULL;
+  }
+}
+
+void
+rewind_register_startup( void )
+{
+  startup_manager_module dependencies[] = { STARTUP_MANAGER_MODULE_SETUID };
+  startup_manager_register( STARTUP_MANAGER_MODULE_REWIND, dependencies,
+                            ARRAY_SIZE( dependencies ), rewind_init, NULL,
+                            rewind_end );
+}
+
+static libspectrum_byte*
+chunk_memory( size_t chunk )
+{
+  size_t i;
+
+  if( chunk < REWIND_CHUNKS )
+    return &RAM[ chunk / MEMORY_PAGES_IN_16K ]
+               [ ( chunk % MEMORY_PAGES_IN_16K ) * MEMORY_PAGE_SIZE ];
+
+  for( i = 0; i < registered_memory->len; i++ ) {
+    rewind_memory_t *block =
+      &g_array_index( registered_memory, rewind_memory_t, i );
+
+    if( chunk < block->first_chunk + block->length / MEMORY_PAGE_SIZE )
+      return block->memory + ( chunk - block->first_chunk ) * MEMORY_PAGE_SIZE;
+  }
+
+  return NULL;
+}
+
+static rewind_checkpoint_t*
+checkpoint( size_t n )
+{
+  return &ring[ ( ring_start + n ) % REWIND_MAX_CHECKPOINTS ];
+}
+
+/* The memory used by a snapshot without main RAM or registered peripheral
+   memory. Any custom ROMs and the other ROM and RAM of active peripherals
+   are still copied into the snapshot */
+static size_t
+snap_cost( libspectrum_snap *snap )
+{
+  size_t cost = state_cost;
+  int i;
+
+  if( libspectrum_snap_custom_rom( snap ) ) {
+    for( i = 0; i < libspectrum_snap_custom_rom_pages( snap ); i++ )
+      cost += libspectrum_snap_rom_length( snap, i );
+  }
+
+  /* The 8 KB EPROM; the RAM is registered */
+  if( libspectrum_snap_divide_active( snap ) ) cost += 0x2000;
+  if( libspectrum_snap_divmmc_active( snap ) ) cost += 0x2000;
+
+  if( libspectrum_snap_interface2_active( snap ) ) cost += 0x4000;
+  if( libspectrum_snap_beta_active( snap ) ) cost += 0x4000;
+  if( libspectrum_snap_plusd_active( snap ) ) cost += 0x2000 + 0x2000;
+  if( libspectrum_snap_opus_active( snap ) ) cost += 0x2000 + 0x0800;
+  if( libspectrum_snap_disciple_active( snap ) )
+    cost += libspectrum_snap_disciple_rom_length( snap, 0 ) + 0x2000;
+  if( libspectrum_snap_didaktik80_active( snap ) )
+    cost += libspectrum_snap_didaktik80_rom_length( snap, 0 ) + 0x0800;
+
+  cost += libspectrum_snap_interface1_rom_length( snap, 0 );
+  cost += libspectrum_snap_usource_rom_length( snap, 0 );
+  cost += libspectrum_snap_multiface_ram_length( snap, 0 );
+
+  for( i = 0; i < 8; i++ ) {
+    if( libspectrum_snap_dock_cart( snap, i ) ) cost += 0x2000;
+    if( libspectrum_snap_exrom_cart( snap, i ) ) cost += 0x2000;
+  }
+
+  return cost;
+}
+
+static size_t
+checkpoint_cost( const rewind_checkpoint_t *point )
+{
+  return point->snap_cost + point->undo_length;
+}
+
+static void
+checkpoint_free( rewind_checkpoint_t *point )
+{
+  ring_bytes -= checkpoint_cost( point );
+  if( point->snap ) libspectrum_snap_free( point->snap );
+  libspectrum_free( point->undo );
+  point->snap = NULL; point->snap_cost = 0;
+  point->undo = NULL; point->undo_length = 0;
+}
+
+static void
+clear_saved_chunks( void )
+{
+  size_t i;
+
+  for( i = 0; i < dirty_count; i++ ) chunk_saved[ dirty_chunks[i] ] = 0;
+  dirty_count = 0;
+}
+
+void
+rewind_reset( void )
+{
+  while( ring_count ) {
+    checkpoint_free( checkpoint( --ring_count ) );
+  }
+  ring_start = 0;
+  clear_saved_chunks();
+  rewind_active = 0;
+}
+
+size_t
+rewind_available( void )
+{
+  return ring_count ? ring_count - 1 : 0;
+}
+
+static void
+save_chunk( size_t chunk )
+{
+  if( chunk_saved[ chunk ] ) return;
+
+  memcpy( saved_chunks + chunk * MEMORY_PAGE_SIZE, chunk_memory( chunk ),
+          MEMORY_PAGE_SIZE );
+  chunk_saved[ chunk ] = 1;
+  dirty_chunks[ dirty_count++ ] = chunk;
+}
+
+void
+rewind_ram_write_chunk( int page_num, libspectrum_word offset )
+{
+  save_chunk( page_num * MEMORY_PAGES_IN_16K +
+              ( offset >> MEMORY_PAGE_SIZE_LOGARITHM ) );
+}
+
+void
+rewind_register_memory( libspectrum_byte *memory, size_t length )
+{
+  rewind_memory_t block;
+
+  main_ram_chunks();
+
+  if( !registered_memory )
+    registered_memory = g_array_new( FALSE, FALSE, sizeof( block ) );
+
+  block.memory = memory;
+  block.length = length;
+  block.first_chunk = add_chunks( length / MEMORY_PAGE_SIZE );
+
+  g_array_append_val( registered_memory, block );
+}
+
+void
+rewind_memory_write_chunk( const libspectrum_byte *address )
+{
+  size_t i;
+
+  if( !registered_memory ) return;
+
+  for( i = 0; i < registered_memory->len; i++ ) {
+    rewind_memory_t *block =
+      &g_array_index( registered_memory, rewind_memory_t, i );
+
+    if( address >= block->memory && address < block->memory + block->length ) {
+      save_chunk( block->first_chunk +
+                  ( address - block->memory ) / MEMORY_PAGE_SIZE );
+      return;
+    }
+  }
+}
+
+void
+rewind_memory_write_block( const libspectrum_byte *memory, size_t length )
+{
+  size_t offset;
+
+  if( !rewind_active ) return;
+
+  for( offset = 0; offset < length; offset += MEMORY_PAGE_SIZE )
+    rewind_memory_write_chunk( memory + offset );
+}
+
+static void
+put_word( libspectrum_byte **ptr, libspectrum_word value )
+{
+  *(*ptr)++ = value & 0xff;
+  *(*ptr)++ = value >> 8;
+}
+
+static libspectrum_word
+get_word( const libspectrum_byte **ptr )
+{
+  libspectrum_word value = (*ptr)[0] | ( (*ptr)[1] << 8 );
+  *ptr += 2;
+  return value;
+}
+
+/* Encode the XOR of the old and current contents of `chunk' as a series of
+   (skip, literal count, literal bytes) runs covering the whole chunk */
+static libspectrum_byte*
+encode_chunk( libspectrum_byte *out, libspectrum_word chunk )
+{
+  const libspectrum_byte *old = saved_chunks + chunk * MEMORY_PAGE_SIZE;
+  const libspectrum_byte *now = chunk_memory( chunk );
+  size_t pos = 0;
+
+  put_word( &out, chunk );
+
+  while( pos < MEMORY_PAGE_SIZE ) {
+    size_t skip_start = pos, literal_start, zeros;
+
+    while( pos < MEMORY_PAGE_SIZE && old[ pos ] == now[ pos ] ) pos++;
+
+    literal_start = pos; zeros = 0;
+    while( pos < MEMORY_PAGE_SIZE && zeros < REWIND_MIN_SKIP ) {
+      zeros = old[ pos ] == now[ pos ] ? zeros + 1 : 0;
+      pos++;
+    }
+    pos -= zeros;
+
+    put_word( &out, literal_start - skip_start );
+    put_word( &out, pos - literal_start );
+    for( ; literal_start < pos; literal_start++ )
+      *out++ = old[ literal_start ] ^ now[ literal_start ];
+  }
+
+  return out;
+}
+
+/* Turn the chunks saved during the last frame into the newest checkpoint's
+   undo record */
+static void
+close_checkpoint( rewind_checkpoint_t *point )
+{
+  libspectrum_byte *buffer, *ptr;
+  size_t i;
+
+  if( !dirty_count ) return;
+
+  /* Worst case is a run header for every fifth byte */
+  buffer = libspectrum_new( libspectrum_byte,
+                            dirty_count * ( 2 * MEMORY_PAGE_SIZE + 2 ) );
+
+  for( i = 0, ptr = buffer; i < dirty_count; i++ )
+    ptr = encode_chunk( ptr, dirty_chunks[i] );
+
+  ring_bytes -= checkpoint_cost( point );
+  point->undo_length = ptr - buffer;
+  point->undo = libspectrum_renew( libspectrum_byte, buffer,
+                                   point->undo_length );
+  ring_bytes += checkpoint_cost( point );
+
+  clear_saved_chunks();
+}
+
+/* Apply an undo record, taking RAM back to the state it was in when the
+   checkpoint was made */
+static void
+apply_undo( const rewind_checkpoint_t *point )
+{
+  const libspectrum_byte *ptr = point->undo,
+    *end = point->undo + point->undo_length;
+
+  while( ptr < end ) {
+    libspectrum_byte *data = chunk_memory( get_word( &ptr ) );
+    size_t pos = 0;
+
+    while( pos < MEMORY_PAGE_SIZE ) {
+      size_t literal;
+
+      pos += get_word( &ptr );
+      literal = get_word( &ptr );
+      for( ; literal; literal-- ) data[ pos++ ] ^= *ptr++;
+    }
+  }
+}
+
+/* The memory used by a libspectrum_snap itself, which libspectrum doesn't
+   tell us, so measure it where the C library can */
+static size_t
+measure_state_cost( void )
+{
+#if defined( HAVE_MALLOC_H ) && defined( HAVE_MALLOC_USABLE_SIZE )
+  libspectrum_snap *snap = libspectrum_snap_alloc();
+  size_t cost = malloc_usable_size( snap );
+
+  libspectrum_snap_free( snap );
+
+  return cost;
+#else
+  return REWIND_STATE_COST;
+#endif
+}
+
+static void
+start( void )
+{
+  if( !ring ) {
+    ring = libspectrum_new0( rewind_checkpoint_t, REWIND_MAX_CHECKPOINTS );
+    state_cost = measure_state_cost();
+  }
+  if( !saved_chunks )
+    saved_chunks = libspectrum_new( libspectrum_byte,
+                                    chunk_count * MEMORY_PAGE_SIZE );
+
+  ring_machine = machine_current->machine;
+  rewind_active = 1;
+}
+
+void
+rewind_frame( void )
+{
+  rewind_checkpoint_t *point;
+  size_t cap = (size_t)settings_current.rewind_memory * 1024 * 1024;
+
+  if( !cap || rzx_recording || rzx_playback ) {
+    if( ring_count || rewind_active ) rewind_reset();
+    return;
+  }
+
+  /* Any history belongs to a different machine */
+  if( ring_count && machine_current->machine != ring_machine )
+    rewind_reset();
+
+  if( !rewind_active ) start();
+
+  if( ring_count ) close_checkpoint( checkpoint( ring_count - 1 ) );
+
+  while( ring_count &&
+         ( ring_count == REWIND_MAX_CHECKPOINTS || ring_bytes > cap ) ) {
+    checkpoint_free( checkpoint( 0 ) );
+    ring_start = ( ring_start + 1 ) % REWIND_MAX_CHECKPOINTS;
+    ring_count--;
+  }
+
+  point = checkpoint( ring_count++ );
+  point->snap = libspectrum_snap_alloc();
+
+  memory_snapshot_ram = 0;
+  snapshot_copy_to( point->snap );
+  memory_snapshot_ram = 1;
+
+  point->snap_cost = snap_cost( point->snap );
+  ring_bytes += checkpoint_cost( point );
+}
+
+int
+rewind_frames( size_t frames )
+{
+  rewind_checkpoint_t *point;
+  size_t i, target;
+  int error;
+
+  if( !ring_count ) return 1;
+
+  if( frames >= ring_count ) frames = ring_count - 1;
+  target = ring_count - 1 - frames;
+
+  /* RAM first goes back to the newest checkpoint using the chunks saved
+     this frame, and then further back through the older undo records */
+  for( i = 0; i < dirty_count; i++ )
+    memcpy( chunk_memory( dirty_chunks[i] ),
+            saved_chunks + dirty_chunks[i] * MEMORY_PAGE_SIZE,
+            MEMORY_PAGE_SIZE );
+  clear_saved_chunks();
+
+  for( i = ring_count - 1; i > target; i-- ) {
+    apply_undo( checkpoint( i - 1 ) );
+    checkpoint_free( checkpoint( i ) );
+  }
+  ring_count = target + 1;
+
+  point = checkpoint( target );
+  ring_bytes -= checkpoint_cost( point );
+  libspectrum_free( point->undo );
+  point->undo = NULL; point->undo_length = 0;
+  ring_bytes += checkpoint_cost( point );
+
+  /* Restoring the state resets the machine, which must not be recorded as
+     changes to RAM */
+  rewind_active = 0;
+  error = snapshot_copy_from( point->snap );
+  rewind_active = 1;
+
+  return error;
+}
+
+static int
+assert_byte( libspectrum_word address, libspectrum_byte expected )
+{
+  libspectrum_byte actual = readbyte_internal( address );
+
+  if( actual != expected ) {
+    fprintf( stderr, "%s: rewind: 0x%04x is 0x%02x, expected 0x%02x\n",
+             fuse_progname, address, actual, expected );
+    return 1;
+  }
+
+  return 0;
+}
+
+static int
+assert_peripheral_byte( const libspectrum_byte *memory, size_t offset,
+                        libspectrum_byte expected )
+{
+  if( memory[ offset ] != expected ) {
+    fprintf( stderr,
+             "%s: rewind: peripheral 0x%04lx is 0x%02x, expected 0x%02x\n",
+             fuse_progname, (unsigned long)offset, memory[ offset ],
+             expected );
+    return 1;
+  }
+
+  return 0;
+}
+
+static void
+write_peripheral_byte( libspectrum_byte *memory, size_t offset,
+                       libspectrum_byte b )
+{
+  rewind_memory_write( memory + offset );
+  memory[ offset ] = b;
+}
+
+int
+rewind_unittest( void )
+{
+  int r = 0;
+  int old_memory = settings_current.rewind_memory;
+  libspectrum_byte old_6801, old_7003;
+  libspectrum_word address;
+  static libspectrum_byte peripheral[ 2 * MEMORY_PAGE_SIZE ];
+
+  rewind_register_memory( peripheral, sizeof( peripheral ) );
+
+  settings_current.rewind_memory = 1;
+  rewind_reset();
+
+  write_peripheral_byte( peripheral, 0x0801, 0x55 );
+  writebyte_internal( 0x6000, 0x11 );
+  writebyte_internal( 0x6800, 0x22 );
+  old_6801 = readbyte_internal( 0x6801 );
+  old_7003 = readbyte_internal( 0x7003 );
+  rewind_frame();
+
+  writebyte_internal( 0x6000, 0x33 );
+  write_peripheral_byte( peripheral, 0x0801, 0x66 );
+  for( address = 0x7000; address < 0x7100; address += 3 )
+    writebyte_internal( address, ~address & 0xff );
+  rewind_frame();
+
+  writebyte_internal( 0x6000, 0x44 );
+  writebyte_internal( 0x6801, ~old_6801 );
+  write_peripheral_byte( peripheral, 0x0801, 0x77 );
+  write_peripheral_byte( peripheral, 0x0002, 0x88 );
+
+  if( rewind_available() != 1 ) {
+    fprintf( stderr, "%s: rewind: %lu frames available, expected 1\n",
+             fuse_progname, (unsigned long)rewind_available() );
+    r++;
+  }
+
+  r += rewind_frames( 0 );
+  r += assert_byte( 0x6000, 0x33 );
+  r += assert_byte( 0x6801, old_6801 );
+  r += assert_byte( 0x7003, 0xfc );
+  r += assert_peripheral_byte( peripheral, 0x0801, 0x66 );
+  r += assert_peripheral_byte( peripheral, 0x0002, 0x00 );
+
+  r += rewind_frames( 1 );
+  r += assert_byte( 0x6000, 0x11 );
+  r += assert_byte( 0x6800, 0x22 );
+  r += assert_byte( 0x7003, old_7003 );
+  r += assert_peripheral_byte( peripheral, 0x0801, 0x55 );
+
+  settings_current.rewind_memory = old_memory;
+  rewind_reset();
+
+  return r;
+}
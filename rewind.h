@@ -0,0 +1,83 @@
+/* rewind.h: frame-granularity rewind buffer
+   Copyright (c) 2026 Fuse contributors
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+#ifndef FUSE_REWIND_H
+#define FUSE_REWIND_H
+
+#include <libspectrum.h>
+
+/* Is the rewind buffer recording? If so, the first write to each 2 KB chunk
+   of RAM in a frame must be reported via rewind_ram_write() */
+extern int rewind_active;
+
+void rewind_register_startup( void );
+
+/* Take a checkpoint at the end of a frame */
+void rewind_frame( void );
+
+/* Called before the first write in a frame to RAM page `page_num' at
+   `offset' */
+void rewind_ram_write_chunk( int page_num, libspectrum_word offset );
+
+/* Called before writing to RAM page `page_num' at `offset' */
+static inline void
+rewind_ram_write( int page_num, libspectrum_word offset )
+{
+  if( rewind_active ) rewind_ram_write_chunk( page_num, offset );
+}
+
+/* Keep changes to the `length' bytes of peripheral memory at `memory' in
+   the undo records rather than copying it into every checkpoint. The
+   memory must stay allocated for the rest of the run, writes to it must be
+   reported via rewind_memory_write() and the peripheral must not copy it
+   into snapshots while memory_snapshot_ram is cleared */
+void rewind_register_memory( libspectrum_byte *memory, size_t length );
+
+/* Called before the first write in a frame to `address' in peripheral
+   memory; does nothing if it wasn't registered */
+void rewind_memory_write_chunk( const libspectrum_byte *address );
+
+/* Called before writing to peripheral memory at `address' */
+static inline void
+rewind_memory_write( const libspectrum_byte *address )
+{
+  if( rewind_active ) rewind_memory_write_chunk( address );
+}
+
+/* Called before writing to all `length' bytes at `memory' */
+void rewind_memory_write_block( const libspectrum_byte *memory,
+                                size_t length );
+
+/* Return to the checkpoint `frames' frames before the most recent one */
+int rewind_frames( size_t frames );
+
+/* How many frames we can currently rewind */
+size_t rewind_available( void );
+
+/* Throw away all history, eg after something has changed memory behind
+   our back */
+void rewind_reset( void );
+
+int rewind_unittest( void );
+
+#endif			/* #ifndef FUSE_REWIND_H */
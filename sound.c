@@ -28,6 +28,10 @@
 
 #include <config.h>
 
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
 #include "fuse.h"
 #include "infrastructure/startup_manager.h"
 #include "machine.h"
@@ -39,6 +43,9 @@
 #include "timer/timer.h"
 #include "ui/ui.h"
 #include "sound/blipbuffer.h"
+#ifdef SOUND_FIFO
+#include "sound/sfifo.h"
+#endif
 
 /* Do we have any of our sound devices available? */
 
@@ -69,13 +76,23 @@ static int sound_channels;
 
 static unsigned int ay_tone_levels[16];
 
-static unsigned int ay_tone_tick[3], ay_tone_high[3], ay_noise_tick;
-static unsigned int ay_tone_cycles, ay_env_cycles;
-static unsigned int ay_env_internal_tick, ay_env_tick;
-static unsigned int ay_tone_period[3], ay_noise_period, ay_env_period;
+/* The state of the AY tone, noise and envelope generators */
+typedef struct ay_generator_t {
+
+  int rng, noise_toggle;
+  int env_first, env_rev, env_counter;
+
+  unsigned int tone_tick[3], tone_high[3], noise_tick;
+  unsigned int tone_cycles, env_cycles;
+  unsigned int env_internal_tick, env_tick;
+  unsigned int tone_period[3], noise_period, env_period;
+
+  /* Local copy of the AY registers */
+  libspectrum_byte registers[16];
 
-/* Local copy of the AY registers */
-static libspectrum_byte sound_ay_registers[16];
+} ay_generator_t;
+
+static ay_generator_t ay = { 1, 0, 1, 0, 15 };
 
 struct ay_change_tag
 {
@@ -170,11 +187,11 @@ sound_ay_init( void )
   for( f = 0; f < 16; f++ )
     ay_tone_levels[f] = ( levels[f] * AMPL_AY_TONE + 0x8000 ) / 0xffff;
 
-  ay_noise_tick = ay_noise_period = 0;
-  ay_env_internal_tick = ay_env_tick = ay_env_period = 0;
-  ay_tone_cycles = ay_env_cycles = 0;
+  ay.noise_tick = ay.noise_period = 0;
+  ay.env_internal_tick = ay.env_tick = ay.env_period = 0;
+  ay.tone_cycles = ay.env_cycles = 0;
   for( f = 0; f < 3; f++ )
-    ay_tone_tick[f] = ay_tone_high[f] = 0, ay_tone_period[f] = 1;
+    ay.tone_tick[f] = ay.tone_high[f] = 0, ay.tone_period[f] = 1;
 
   ay_change_count = 0;
 }
@@ -192,6 +209,10 @@ sound_ay_init( void )
 static int
 is_in_sound_enabled_range( void )
 {
+  /* Benchmark runs and turbo mode are unthrottled, so never produce sound;
+     this also skips the beeper and AY synthesis entirely */
+  if( settings_current.benchmark > 0 || settings_current.turbo ) return 0;
+
   return settings_current.emulation_speed >= MIN_SPEED_PERCENTAGE &&
     settings_current.emulation_speed <= MAX_SPEED_PERCENTAGE;
 }
@@ -378,6 +399,34 @@ sound_end( void )
   }
 }
 
+#ifdef SOUND_FIFO
+
+/* Print the FIFO statistics if requested; called by the backend once its
+   consumer has stopped. The latency figures cover only the time samples
+   spend queued in the FIFO, not the sound card's own buffering */
+void
+sound_fifo_report( struct sfifo_t *fifo, int bytes_per_second )
+{
+  const sfifo_stats_t *stats = sfifo_stats( fifo );
+  double mean_fill;
+
+  if( !settings_current.sound_stats || !stats->reads || !bytes_per_second )
+    return;
+
+  mean_fill = stats->fill_total / stats->reads;
+
+  printf( "%s: sound: %lu reads, %lu underruns, %lu waits for space\n",
+          fuse_progname, stats->reads, stats->underruns, stats->full_waits );
+  printf( "%s: sound: FIFO fill %d-%d bytes (mean %.0f) of %d\n",
+          fuse_progname, stats->fill_min, stats->fill_max, mean_fill,
+          fifo->size - 1 );
+  printf( "%s: sound: FIFO latency %.1f ms mean, %.1f ms max\n",
+          fuse_progname, mean_fill * 1000 / bytes_per_second,
+          (double)stats->fill_max * 1000 / bytes_per_second );
+}
+
+#endif				/* #ifdef SOUND_FIFO */
+
 void
 sound_register_startup( void )
 {
@@ -386,20 +435,76 @@ sound_register_startup( void )
                             ARRAY_SIZE( dependencies ), NULL, NULL, sound_end );
 }
 
+/* bitmasks for envelope */
+#define AY_ENV_CONT	8
+#define AY_ENV_ATTACK	4
+#define AY_ENV_ALT	2
+#define AY_ENV_HOLD	1
+
+/* the AY steps down the external clock by 16 for tone and noise
+   generators */
+#define AY_CLOCK_DIVISOR 16
+/* all Spectrum models and clones with an AY seem to count down the
+   master clock by 2 to drive the AY */
+#define AY_CLOCK_RATIO 2
+
+/* Spectrum tstates per step of the generators */
+#define AY_TICK_TSTATES ( AY_CLOCK_DIVISOR * AY_CLOCK_RATIO )
+
+/* Level changes are logged here rather than sent to the Blip buffers when
+   the unit test is comparing the two generators */
+struct ay_edge_tag
+{
+  libspectrum_dword tstates;
+  int chan, level;
+};
+
+static struct ay_edge_tag *ay_edge_log;
+static size_t ay_edge_log_count, ay_edge_log_size;
+
+static void
+ay_output( int chan, libspectrum_dword f, int level )
+{
+  if( ay_edge_log ) {
+    if( ay_edge_log_count < ay_edge_log_size ) {
+      ay_edge_log[ ay_edge_log_count ].tstates = f;
+      ay_edge_log[ ay_edge_log_count ].chan = chan;
+      ay_edge_log[ ay_edge_log_count ].level = level;
+    }
+    ay_edge_log_count++;
+    return;
+  }
+
+  switch( chan ) {
+  case 0:
+    blip_synth_update( ay_a_synth, f, level );
+    if( ay_a_synth_r ) blip_synth_update( ay_a_synth_r, f, level );
+    break;
+  case 1:
+    blip_synth_update( ay_b_synth, f, level );
+    if( ay_b_synth_r ) blip_synth_update( ay_b_synth_r, f, level );
+    break;
+  case 2:
+    blip_synth_update( ay_c_synth, f, level );
+    if( ay_c_synth_r ) blip_synth_update( ay_c_synth_r, f, level );
+    break;
+  }
+}
+
 static inline void
 ay_do_tone( int level, unsigned int tone_count, int *var, int chan )
 {
   *var = 0;
 
-  ay_tone_tick[ chan ] += tone_count;
+  ay.tone_tick[ chan ] += tone_count;
 
-  if( ay_tone_tick[ chan ] >= ay_tone_period[ chan ] ) {
-    ay_tone_tick[ chan ] -= ay_tone_period[ chan ];
-    ay_tone_high[ chan ] = !ay_tone_high[ chan ];
+  if( ay.tone_tick[ chan ] >= ay.tone_period[ chan ] ) {
+    ay.tone_tick[ chan ] -= ay.tone_period[ chan ];
+    ay.tone_high[ chan ] = !ay.tone_high[ chan ];
   }
 
   if( level ) {
-    if( ay_tone_high[ chan ] )
+    if( ay.tone_high[ chan ] )
       *var = level;
     else {
       *var = 0;
@@ -407,221 +512,350 @@ ay_do_tone( int level, unsigned int tone_count, int *var, int chan )
   }
 }
 
-/* bitmasks for envelope */
-#define AY_ENV_CONT	8
-#define AY_ENV_ATTACK	4
-#define AY_ENV_ALT	2
-#define AY_ENV_HOLD	1
+static void
+ay_register_write( int reg, libspectrum_byte val )
+{
+  int r;
+
+  ay.registers[ reg ] = val;
+
+  /* fix things as needed for some register changes */
+  switch ( reg ) {
+  case 0: case 1: case 2: case 3: case 4: case 5:
+    r = reg >> 1;
+    /* a zero-len period is the same as 1 */
+    ay.tone_period[r] = ( ay.registers[ reg & ~1 ] |
+                          ( ay.registers[ reg | 1 ] & 15 ) << 8 );
+    if( !ay.tone_period[r] )
+      ay.tone_period[r]++;
+
+    /* important to get this right, otherwise e.g. Ghouls 'n' Ghosts
+     * has really scratchy, horrible-sounding vibrato.
+     */
+    if( ay.tone_tick[r] >= ay.tone_period[r] * 2 )
+      ay.tone_tick[r] %= ay.tone_period[r] * 2;
+    break;
+  case 6:
+    ay.noise_tick = 0;
+    ay.noise_period = ( ay.registers[ reg ] & 31 );
+    break;
+  case 11: case 12:
+    ay.env_period = ay.registers[11] | ( ay.registers[12] << 8 );
+    break;
+  case 13:
+    ay.env_internal_tick = ay.env_tick = ay.env_cycles = 0;
+    ay.env_first = 1;
+    ay.env_rev = 0;
+    ay.env_counter = ( ay.registers[13] & AY_ENV_ATTACK ) ? 0 : 15;
+    break;
+  }
+}
 
-/* the AY steps down the external clock by 16 for tone and noise
-   generators */
-#define AY_CLOCK_DIVISOR 16
-/* all Spectrum models and clones with an AY seem to count down the
-   master clock by 2 to drive the AY */
-#define AY_CLOCK_RATIO 2
+/* One 1/16th-of-period step of the envelope */
+static void
+ay_env_step( int envshape )
+{
+  /* do a 1/16th-of-period incr/decr if needed */
+  if( ay.env_first ||
+      ( ( envshape & AY_ENV_CONT ) && !( envshape & AY_ENV_HOLD ) ) ) {
+    if( ay.env_rev )
+      ay.env_counter -= ( envshape & AY_ENV_ATTACK ) ? 1 : -1;
+    else
+      ay.env_counter += ( envshape & AY_ENV_ATTACK ) ? 1 : -1;
+    if( ay.env_counter < 0 )
+      ay.env_counter = 0;
+    if( ay.env_counter > 15 )
+      ay.env_counter = 15;
+  }
+
+  ay.env_internal_tick++;
+  while( ay.env_internal_tick >= 16 ) {
+    ay.env_internal_tick -= 16;
+
+    /* end of cycle */
+    if( !( envshape & AY_ENV_CONT ) )
+      ay.env_counter = 0;
+    else {
+      if( envshape & AY_ENV_HOLD ) {
+        if( ay.env_first && ( envshape & AY_ENV_ALT ) )
+          ay.env_counter = ( ay.env_counter ? 0 : 15 );
+      } else {
+        /* non-hold */
+        if( envshape & AY_ENV_ALT )
+          ay.env_rev = !ay.env_rev;
+        else
+          ay.env_counter = ( envshape & AY_ENV_ATTACK ) ? 0 : 15;
+      }
+    }
 
+    ay.env_first = 0;
+  }
+}
+
+/* One step of the noise generator */
 static void
-sound_ay_overlay( void )
+ay_noise_step( void )
+{
+  if( ( ay.rng & 1 ) ^ ( ( ay.rng & 2 ) ? 1 : 0 ) )
+    ay.noise_toggle = !ay.noise_toggle;
+
+  /* rng is 17-bit shift reg, bit 0 is output.
+   * input is bit 0 xor bit 3.
+   */
+  if( ay.rng & 1 ) {
+    ay.rng ^= 0x24000;
+  }
+  ay.rng >>= 1;
+}
+
+/* Run the generators for one AY tick at `f' tstates into the frame */
+static void
+ay_tick( libspectrum_dword f, int *last_chan )
 {
-  static int rng = 1;
-  static int noise_toggle = 0;
-  static int env_first = 1, env_rev = 0, env_counter = 15;
   int tone_level[3];
   int mixer, envshape;
   int g, level;
-  libspectrum_dword f;
-  struct ay_change_tag *change_ptr = ay_change;
-  int changes_left = ay_change_count;
-  int reg, r;
-  int chan1, chan2, chan3;
-  int last_chan1 = 0, last_chan2 = 0, last_chan3 = 0;
+  int chan[3];
   unsigned int tone_count, noise_count;
 
-  /* If no AY chip, don't produce any AY sound (!) */
-  if( !( periph_is_active( PERIPH_TYPE_FULLER) ||
-         periph_is_active( PERIPH_TYPE_MELODIK ) ||
-         machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_AY ) )
-    return;
+  /* the tone level if no enveloping is being used */
+  for( g = 0; g < 3; g++ )
+    tone_level[g] = ay_tone_levels[ ay.registers[ 8 + g ] & 15 ];
 
-  for( f = 0; f < machine_current->timings.tstates_per_frame;
-       f+= AY_CLOCK_DIVISOR * AY_CLOCK_RATIO ) {
-    /* update ay registers. */
-    while( changes_left && f >= change_ptr->tstates ) {
-      sound_ay_registers[ reg = change_ptr->reg ] = change_ptr->val;
-      change_ptr++;
-      changes_left--;
+  /* envelope */
+  envshape = ay.registers[13];
+  level = ay_tone_levels[ ay.env_counter ];
 
-      /* fix things as needed for some register changes */
-      switch ( reg ) {
-      case 0: case 1: case 2: case 3: case 4: case 5:
-        r = reg >> 1;
-        /* a zero-len period is the same as 1 */
-        ay_tone_period[r] = ( sound_ay_registers[ reg & ~1 ] |
-                              ( sound_ay_registers[ reg | 1 ] & 15 ) << 8 );
-        if( !ay_tone_period[r] )
-          ay_tone_period[r]++;
-
-        /* important to get this right, otherwise e.g. Ghouls 'n' Ghosts
-         * has really scratchy, horrible-sounding vibrato.
-         */
-        if( ay_tone_tick[r] >= ay_tone_period[r] * 2 )
-          ay_tone_tick[r] %= ay_tone_period[r] * 2;
-        break;
-      case 6:
-        ay_noise_tick = 0;
-        ay_noise_period = ( sound_ay_registers[ reg ] & 31 );
-        break;
-      case 11: case 12:
-        ay_env_period =
-          sound_ay_registers[11] | ( sound_ay_registers[12] << 8 );
-        break;
-      case 13:
-        ay_env_internal_tick = ay_env_tick = ay_env_cycles = 0;
-        env_first = 1;
-        env_rev = 0;
-        env_counter = ( sound_ay_registers[13] & AY_ENV_ATTACK ) ? 0 : 15;
+  for( g = 0; g < 3; g++ )
+    if( ay.registers[ 8 + g ] & 16 )
+      tone_level[g] = level;
+
+  /* envelope output counter gets incr'd every 16 AY cycles. */
+  ay.env_cycles += AY_CLOCK_DIVISOR;
+  noise_count = 0;
+  while( ay.env_cycles >= 16 ) {
+    ay.env_cycles -= 16;
+    noise_count++;
+    ay.env_tick++;
+    while( ay.env_tick >= ay.env_period ) {
+      ay.env_tick -= ay.env_period;
+
+      ay_env_step( envshape );
+
+      /* don't keep trying if period is zero */
+      if( !ay.env_period )
         break;
-      }
     }
+  }
 
-    /* the tone level if no enveloping is being used */
-    for( g = 0; g < 3; g++ )
-      tone_level[g] = ay_tone_levels[ sound_ay_registers[ 8 + g ] & 15 ];
-
-    /* envelope */
-    envshape = sound_ay_registers[13];
-    level = ay_tone_levels[ env_counter ];
-
-    for( g = 0; g < 3; g++ )
-      if( sound_ay_registers[ 8 + g ] & 16 )
-        tone_level[g] = level;
-
-    /* envelope output counter gets incr'd every 16 AY cycles. */
-    ay_env_cycles += AY_CLOCK_DIVISOR;
-    noise_count = 0;
-    while( ay_env_cycles >= 16 ) {
-      ay_env_cycles -= 16;
-      noise_count++;
-      ay_env_tick++;
-      while( ay_env_tick >= ay_env_period ) {
-        ay_env_tick -= ay_env_period;
-
-        /* do a 1/16th-of-period incr/decr if needed */
-        if( env_first ||
-            ( ( envshape & AY_ENV_CONT ) && !( envshape & AY_ENV_HOLD ) ) ) {
-          if( env_rev )
-            env_counter -= ( envshape & AY_ENV_ATTACK ) ? 1 : -1;
-          else
-            env_counter += ( envshape & AY_ENV_ATTACK ) ? 1 : -1;
-          if( env_counter < 0 )
-            env_counter = 0;
-          if( env_counter > 15 )
-            env_counter = 15;
-        }
-
-        ay_env_internal_tick++;
-        while( ay_env_internal_tick >= 16 ) {
-          ay_env_internal_tick -= 16;
-
-          /* end of cycle */
-          if( !( envshape & AY_ENV_CONT ) )
-            env_counter = 0;
-          else {
-            if( envshape & AY_ENV_HOLD ) {
-              if( env_first && ( envshape & AY_ENV_ALT ) )
-                env_counter = ( env_counter ? 0 : 15 );
-            } else {
-              /* non-hold */
-              if( envshape & AY_ENV_ALT )
-                env_rev = !env_rev;
-              else
-                env_counter = ( envshape & AY_ENV_ATTACK ) ? 0 : 15;
-            }
-          }
-
-          env_first = 0;
-        }
-
-        /* don't keep trying if period is zero */
-        if( !ay_env_period )
-          break;
-      }
-    }
+  /* generate tone+noise... or neither.
+   * (if no tone/noise is selected, the chip just shoves the
+   * level out unmodified. This is used by some sample-playing
+   * stuff.)
+   */
+  mixer = ay.registers[7];
 
-    /* generate tone+noise... or neither.
-     * (if no tone/noise is selected, the chip just shoves the
-     * level out unmodified. This is used by some sample-playing
-     * stuff.)
-     */
-    chan1 = tone_level[0];
-    chan2 = tone_level[1];
-    chan3 = tone_level[2];
-    mixer = sound_ay_registers[7];
-
-    ay_tone_cycles += AY_CLOCK_DIVISOR;
-    tone_count = ay_tone_cycles >> 3;
-    ay_tone_cycles &= 7;
-
-    if( ( mixer & 1 ) == 0 ) {
-      level = chan1;
-      ay_do_tone( level, tone_count, &chan1, 0 );
-    }
-    if( ( mixer & 0x08 ) == 0 && noise_toggle )
-      chan1 = 0;
+  ay.tone_cycles += AY_CLOCK_DIVISOR;
+  tone_count = ay.tone_cycles >> 3;
+  ay.tone_cycles &= 7;
+
+  for( g = 0; g < 3; g++ ) {
+    chan[g] = tone_level[g];
 
-    if( ( mixer & 2 ) == 0 ) {
-      level = chan2;
-      ay_do_tone( level, tone_count, &chan2, 1 );
+    if( ( mixer & ( 1 << g ) ) == 0 ) {
+      level = chan[g];
+      ay_do_tone( level, tone_count, &chan[g], g );
     }
-    if( ( mixer & 0x10 ) == 0 && noise_toggle )
-      chan2 = 0;
+    if( ( mixer & ( 0x08 << g ) ) == 0 && ay.noise_toggle )
+      chan[g] = 0;
+  }
 
-    if( ( mixer & 4 ) == 0 ) {
-      level = chan3;
-      ay_do_tone( level, tone_count, &chan3, 2 );
+  for( g = 0; g < 3; g++ ) {
+    if( last_chan[g] != chan[g] ) {
+      ay_output( g, f, chan[g] );
+      last_chan[g] = chan[g];
     }
-    if( ( mixer & 0x20 ) == 0 && noise_toggle )
-      chan3 = 0;
+  }
+
+  /* update noise RNG/filter */
+  ay.noise_tick += noise_count;
+  while( ay.noise_tick >= ay.noise_period ) {
+    ay.noise_tick -= ay.noise_period;
+
+    ay_noise_step();
+
+    /* don't keep trying if period is zero */
+    if( !ay.noise_period )
+      break;
+  }
+}
+
+/* How many steps a generator with the given period and tick takes in the
+   next `ticks' AY ticks, updating the tick */
+static unsigned int
+ay_counter_advance( unsigned int *tick, unsigned int period,
+                    unsigned int ticks )
+{
+  unsigned int total;
+
+  /* a zero period steps once every tick */
+  if( !period ) {
+    *tick += ticks;
+    return ticks;
+  }
 
-    if( last_chan1 != chan1 ) {
-      blip_synth_update( ay_a_synth, f, chan1 );
-      if( ay_a_synth_r ) blip_synth_update( ay_a_synth_r, f, chan1 );
-      last_chan1 = chan1;
+  total = *tick + ticks;
+  *tick = total % period;
+  return total / period;
+}
+
+/* How many ticks, starting with the next, can pass before a generator with
+   the given period and tick next steps, including the tick it steps on */
+static unsigned int
+ay_counter_quiet( unsigned int tick, unsigned int period )
+{
+  return ( !period || tick + 1 >= period ) ? 1 : period - tick;
+}
+
+/* Work out how many ticks starting with the next one will produce no level
+   changes and have no effect on later output other than through their
+   counters. Returns 0 if the next tick must be run by ay_tick() */
+static unsigned int
+ay_quiet_ticks( const int *last_chan )
+{
+  int mixer = ay.registers[7];
+  int env_matters = 0, noise_matters = 0;
+  unsigned int quiet = UINT_MAX;
+  int g;
+
+  /* These always come back to zero at the end of a tick */
+  if( ay.tone_cycles || ay.env_cycles ) return 0;
+
+  for( g = 0; g < 3; g++ ) {
+    int reg = ay.registers[ 8 + g ];
+    int tone_on = ( mixer & ( 1 << g ) ) == 0;
+    int level = ay_tone_levels[ ( reg & 16 ) ? ay.env_counter : reg & 15 ];
+
+    if( tone_on ) {
+      unsigned int tick = ay.tone_tick[g], period = ay.tone_period[g];
+
+      /* The tone flips on the tick it reaches its period */
+      if( tick + 2 >= period ) return 0;
+      if( ( period - tick + 1 ) / 2 - 1 < quiet )
+        quiet = ( period - tick + 1 ) / 2 - 1;
+
+      if( ( reg & 16 ) && ay.tone_high[g] ) env_matters = 1;
+      if( !ay.tone_high[g] ) level = 0;
+    } else if( reg & 16 ) {
+      env_matters = 1;
     }
-    if( last_chan2 != chan2 ) {
-      blip_synth_update( ay_b_synth, f, chan2 );
-      if( ay_b_synth_r ) blip_synth_update( ay_b_synth_r, f, chan2 );
-      last_chan2 = chan2;
+
+    if( ( mixer & ( 0x08 << g ) ) == 0 ) {
+      if( level ) noise_matters = 1;
+      if( ay.noise_toggle ) level = 0;
     }
-    if( last_chan3 != chan3 ) {
-      blip_synth_update( ay_c_synth, f, chan3 );
-      if( ay_c_synth_r ) blip_synth_update( ay_c_synth_r, f, chan3 );
-      last_chan3 = chan3;
+
+    if( level != last_chan[g] ) return 0;
+  }
+
+  if( env_matters && ay_counter_quiet( ay.env_tick, ay.env_period ) < quiet )
+    quiet = ay_counter_quiet( ay.env_tick, ay.env_period );
+  if( noise_matters &&
+      ay_counter_quiet( ay.noise_tick, ay.noise_period ) < quiet )
+    quiet = ay_counter_quiet( ay.noise_tick, ay.noise_period );
+
+  return quiet;
+}
+
+/* Step the envelope `steps' times. Once its first cycle is done, a holding
+   envelope only counts, and a repeating one comes back to the same state
+   every 32 steps */
+static void
+ay_env_steps( unsigned int steps, int envshape )
+{
+  for( ; steps && ay.env_first; steps-- )
+    ay_env_step( envshape );
+
+  if( !( envshape & AY_ENV_CONT ) || ( envshape & AY_ENV_HOLD ) ) {
+    ay.env_internal_tick = ( ay.env_internal_tick + steps ) % 16;
+    return;
+  }
+
+  for( steps %= 32; steps; steps-- )
+    ay_env_step( envshape );
+}
+
+/* Run `ticks' quiet ticks, as found by ay_quiet_ticks() */
+static void
+ay_skip_ticks( unsigned int ticks )
+{
+  unsigned int steps;
+  int g;
+
+  for( g = 0; g < 3; g++ )
+    if( ( ay.registers[7] & ( 1 << g ) ) == 0 )
+      ay.tone_tick[g] += 2 * ticks;
+
+  steps = ay_counter_advance( &ay.env_tick, ay.env_period, ticks );
+  ay_env_steps( steps, ay.registers[13] );
+
+  steps = ay_counter_advance( &ay.noise_tick, ay.noise_period, ticks );
+  for( ; steps; steps-- )
+    ay_noise_step();
+}
+
+/* Generate the AY output for a frame. If `batched' is set, runs of ticks
+   which can't change the output are skipped over in one go; otherwise
+   every tick is run, which is kept as the reference for the unit test */
+static void
+ay_generate( libspectrum_dword frame_length, int batched )
+{
+  struct ay_change_tag *change_ptr = ay_change;
+  int changes_left = ay_change_count;
+  int last_chan[3] = { 0, 0, 0 };
+  libspectrum_dword f;
+
+  for( f = 0; f < frame_length; f += AY_TICK_TSTATES ) {
+    /* update ay registers. */
+    while( changes_left && f >= change_ptr->tstates ) {
+      ay_register_write( change_ptr->reg, change_ptr->val );
+      change_ptr++;
+      changes_left--;
     }
 
-    /* update noise RNG/filter */
-    ay_noise_tick += noise_count;
-    while( ay_noise_tick >= ay_noise_period ) {
-      ay_noise_tick -= ay_noise_period;
+    if( batched ) {
+      unsigned int ticks = ay_quiet_ticks( last_chan );
 
-      if( ( rng & 1 ) ^ ( ( rng & 2 ) ? 1 : 0 ) )
-        noise_toggle = !noise_toggle;
+      if( ticks ) {
+        libspectrum_dword limit = frame_length;
 
-      /* rng is 17-bit shift reg, bit 0 is output.
-       * input is bit 0 xor bit 3.
-       */
-      if( rng & 1 ) {
-        rng ^= 0x24000;
-      }
-      rng >>= 1;
+        if( changes_left && change_ptr->tstates < limit )
+          limit = change_ptr->tstates;
+        limit = ( limit - f + AY_TICK_TSTATES - 1 ) / AY_TICK_TSTATES;
+        if( limit < ticks ) ticks = limit;
 
-      /* don't keep trying if period is zero */
-      if( !ay_noise_period )
-        break;
+        ay_skip_ticks( ticks );
+        f += ( ticks - 1 ) * AY_TICK_TSTATES;
+        continue;
+      }
     }
+
+    ay_tick( f, last_chan );
   }
 }
 
+static void
+sound_ay_overlay( void )
+{
+  /* If no AY chip, don't produce any AY sound (!) */
+  if( !( periph_is_active( PERIPH_TYPE_FULLER) ||
+         periph_is_active( PERIPH_TYPE_MELODIK ) ||
+         machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_AY ) )
+    return;
+
+  ay_generate( machine_current->timings.tstates_per_frame, 1 );
+}
+
 /* don't make the change immediately; record it for later,
  * to be made by sound_frame() (via sound_ay_overlay()).
  */
@@ -651,8 +885,8 @@ sound_ay_reset( void )
   for( f = 0; f < 16; f++ )
     sound_ay_write( f, 0, 0 );
   for( f = 0; f < 3; f++ )
-    ay_tone_high[f] = 0;
-  ay_tone_cycles = ay_env_cycles = 0;
+    ay.tone_high[f] = 0;
+  ay.tone_cycles = ay.env_cycles = 0;
 }
 
 /*
@@ -745,3 +979,141 @@ sound_beeper( libspectrum_dword at_tstates, int on )
   if( sound_stereo_ay != SOUND_STEREO_AY_NONE )
     blip_synth_update( right_beeper_synth, at_tstates, val );
 }
+
+static libspectrum_dword ay_test_seed;
+
+static int
+ay_test_random( int range )
+{
+  ay_test_seed = ay_test_seed * 1103515245 + 12345;
+  return ( ay_test_seed >> 16 ) % range;
+}
+
+/* Queue up a frame's worth of pseudo-random AY register writes, biased
+   towards the short periods which make the generators work hardest */
+static void
+ay_test_changes( libspectrum_dword frame_length )
+{
+  int count = ay_test_random( 4 ) ? ay_test_random( 40 ) : 0;
+  libspectrum_dword when = 0;
+  int i, reg, val;
+
+  ay_change_count = 0;
+
+  for( i = 0; i < count; i++ ) {
+    when += ay_test_random( frame_length / count );
+    reg = ay_test_random( 14 );
+
+    switch( reg ) {
+    case 1: case 3: case 5: val = ay_test_random( 4 ); break;
+    case 6: val = ay_test_random( 32 ); break;
+    case 7: val = ay_test_random( 64 ); break;
+    case 8: case 9: case 10: val = ay_test_random( 32 ); break;
+    case 11: val = ay_test_random( 40 ); break;
+    case 12: val = ay_test_random( 8 ) ? 0 : ay_test_random( 4 ); break;
+    case 13: val = ay_test_random( 16 ); break;
+    default: val = ay_test_random( 256 ); break;
+    }
+
+    sound_ay_write( reg, val, when );
+  }
+}
+
+static size_t
+ay_test_run( int batched, libspectrum_dword seed, int frames,
+             libspectrum_dword frame_length, struct ay_edge_tag *log,
+             size_t log_size )
+{
+  int i;
+
+  ay_edge_log = log;
+  ay_edge_log_size = log_size;
+  ay_edge_log_count = 0;
+  ay_test_seed = seed;
+
+  for( i = 0; i < frames; i++ ) {
+    ay_test_changes( frame_length );
+    ay_generate( frame_length, batched );
+  }
+
+  ay_edge_log = NULL;
+
+  return ay_edge_log_count;
+}
+
+/* Check that skipping quiet runs of ticks produces exactly the same level
+   changes and final generator state as running every tick */
+int
+sound_ay_unittest( void )
+{
+  const int frames = 25;
+  const libspectrum_dword frame_length = 70908;
+  ay_generator_t saved = ay, start = { 1, 0, 1, 0, 15 }, reference;
+  unsigned int saved_levels[16];
+  int saved_count = ay_change_count;
+  struct ay_change_tag *saved_changes;
+  struct ay_edge_tag *log_reference, *log_batched;
+  size_t size, count_reference, count_batched, i;
+  libspectrum_dword seed;
+  int r = 0;
+
+  saved_changes = libspectrum_new( struct ay_change_tag, AY_CHANGE_MAX );
+  memcpy( saved_changes, ay_change, sizeof( ay_change ) );
+
+  size = frames * 3 * ( frame_length / AY_TICK_TSTATES + 1 );
+  log_reference = libspectrum_new( struct ay_edge_tag, size );
+  log_batched = libspectrum_new( struct ay_edge_tag, size );
+
+  memcpy( saved_levels, ay_tone_levels, sizeof( ay_tone_levels ) );
+  for( i = 0; i < 16; i++ ) ay_tone_levels[i] = i * 0x100 + 1;
+  ay_tone_levels[0] = 0;
+  for( i = 0; i < 3; i++ ) start.tone_period[i] = 1;
+
+  for( seed = 1; seed <= 8; seed++ ) {
+
+    ay = start;
+    count_reference = ay_test_run( 0, seed, frames, frame_length,
+                                   log_reference, size );
+    reference = ay;
+
+    ay = start;
+    count_batched = ay_test_run( 1, seed, frames, frame_length, log_batched,
+                                 size );
+
+    if( count_reference != count_batched ) {
+      fprintf( stderr, "%s: AY seed %lu: %lu level changes, expected %lu\n",
+               fuse_progname, (unsigned long)seed,
+               (unsigned long)count_batched, (unsigned long)count_reference );
+      r++;
+      continue;
+    }
+
+    for( i = 0; i < count_reference; i++ ) {
+      if( log_reference[i].tstates != log_batched[i].tstates ||
+          log_reference[i].chan != log_batched[i].chan ||
+          log_reference[i].level != log_batched[i].level ) {
+        fprintf( stderr, "%s: AY seed %lu: level change %lu differs\n",
+                 fuse_progname, (unsigned long)seed, (unsigned long)i );
+        r++;
+        break;
+      }
+    }
+
+    if( memcmp( &reference, &ay, sizeof( ay ) ) ) {
+      fprintf( stderr, "%s: AY seed %lu: generator state differs\n",
+               fuse_progname, (unsigned long)seed );
+      r++;
+    }
+  }
+
+  libspectrum_free( log_batched );
+  libspectrum_free( log_reference );
+
+  ay = saved;
+  memcpy( ay_tone_levels, saved_levels, sizeof( ay_tone_levels ) );
+  memcpy( ay_change, saved_changes, sizeof( ay_change ) );
+  ay_change_count = saved_count;
+  libspectrum_free( saved_changes );
+
+  return r;
+}
@@ -40,6 +40,7 @@ void sound_covox_write( libspectrum_word port, libspectrum_byte val );
 void sound_frame( void );
 void sound_beeper( libspectrum_dword at_tstates, int on );
 libspectrum_dword sound_get_effective_processor_speed( void );
+int sound_ay_unittest( void );
 
 extern int sound_enabled;
 extern int sound_framesiz;
@@ -64,4 +65,8 @@ int sound_lowlevel_init( const char *device, int *freqptr, int *stereoptr );
 void sound_lowlevel_end( void );
 void sound_lowlevel_frame( libspectrum_signed_word *data, int len );
 
+/* For the callback-driven backends which feed the sound card from a FIFO */
+struct sfifo_t;
+void sound_fifo_report( struct sfifo_t *fifo, int bytes_per_second );
+
 #endif				/* #ifndef FUSE_SOUND_H */
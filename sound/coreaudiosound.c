@@ -20,6 +20,7 @@
 #include <config.h>
 
 #include <errno.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <AssertMacros.h>
@@ -238,6 +239,8 @@ sound_lowlevel_end( void )
     ui_error( UI_ERROR_ERROR, "AudioComponentInstanceDispose=%ld", (long)err );
   }
 
+  sound_fifo_report( &sound_fifo, deviceFormat.mSampleRate *
+                                  deviceFormat.mBytesPerFrame );
   sfifo_flush( &sound_fifo );
   sfifo_close( &sound_fifo );
 }
@@ -256,7 +259,7 @@ sound_lowlevel_frame( libspectrum_signed_word *data, int len )
     if( ( i = sfifo_write( &sound_fifo, bytes, len ) ) < 0 ) {
       break;
     } else if( !i ) {
-      usleep( 10000 );
+      sfifo_wait_space( &sound_fifo, len, 10 );
     }
     bytes += i;
     len -= i;
@@ -280,10 +283,6 @@ sound_lowlevel_frame( libspectrum_signed_word *data, int len )
   }
 }
 
-#ifndef MIN
-#define MIN(a,b)    (((a) < (b)) ? (a) : (b))
-#endif
-
 /* This is the audio processing callback. */
 OSStatus coreaudiowrite( void *inRefCon,
                          AudioUnitRenderActionFlags *ioActionFlags,
@@ -296,22 +295,13 @@ OSStatus coreaudiowrite( void *inRefCon,
   int len = deviceFormat.mBytesPerFrame * inNumberFrames;
   uint8_t* out = ioData->mBuffers[0].mData;
 
-  /* Try to only read an even number of bytes so as not to fragment a sample */
-  len = MIN( len, sfifo_used( &sound_fifo ) );
-  len &= sound_stereo_ay != SOUND_STEREO_AY_NONE ? 0xfffc : 0xfffe;
-
-  /* Read input_size bytes from fifo into sound stream */
-  while( ( f = sfifo_read( &sound_fifo, out, len ) ) > 0 ) {
-    out += f;
-    len -= f;
-  }
+  /* Read only whole samples so as not to fragment one */
+  f = sfifo_read_frames( &sound_fifo, out, len,
+                         sound_stereo_ay != SOUND_STEREO_AY_NONE ? 4 : 2 );
+  if( f < 0 ) f = 0;
 
   /* If we ran out of sound, make do with silence :( */
-  if( f < 0 ) {
-    for( f=0; f<len; f++ ) {
-      *out++ = 0;
-    }
-  }
+  memset( out + f, 0, len - f );
 
   return noErr;
 }
@@ -46,6 +46,9 @@ sfifo_t sound_fifo;
 /* Records sound writer status information */
 static int audio_output_started;
 
+/* For the latency statistics */
+static int bytes_per_second;
+
 int
 sound_lowlevel_init( const char *device, int *freqptr, int *stereoptr )
 {
@@ -148,6 +151,8 @@ sound_lowlevel_init( const char *device, int *freqptr, int *stereoptr )
     return 1;
   }
 
+  bytes_per_second = received.freq * received.channels * 2;
+
   /* wait to run sound until we have some sound to play */
   audio_output_started = 0;
 
@@ -161,6 +166,7 @@ sound_lowlevel_end( void )
   SDL_LockAudio();
   SDL_CloseAudio();
   SDL_QuitSubSystem( SDL_INIT_AUDIO );
+  sound_fifo_report( &sound_fifo, bytes_per_second );
   sfifo_flush( &sound_fifo );
   sfifo_close( &sound_fifo );
 }
@@ -179,7 +185,7 @@ sound_lowlevel_frame( libspectrum_signed_word *data, int len )
     if( ( i = sfifo_write( &sound_fifo, bytes, len ) ) < 0 ) {
       break;
     } else if (!i) {
-      SDL_Delay(10);
+      sfifo_wait_space( &sound_fifo, len, 10 );
     }
     bytes += i;
     len -= i;
@@ -195,25 +201,12 @@ sound_lowlevel_frame( libspectrum_signed_word *data, int len )
   }
 }
 
-#ifndef MIN
-#define MIN(a,b)    (((a) < (b)) ? (a) : (b))
-#endif
-
 /* Write len samples from fifo into stream */
 void
 sdlwrite( void *userdata, Uint8 *stream, int len )
 {
-  int f;
-
-  /* Try to only read an even number of bytes so as not to fragment a sample */
-  len = MIN( len, sfifo_used( &sound_fifo ) );
-  len &= sound_stereo_ay ? 0xfffc : 0xfffe;
-
-  /* Read input_size bytes from fifo into sound stream */
-  while( ( f = sfifo_read( &sound_fifo, stream, len ) ) > 0 ) {
-    stream += f;
-    len -= f;
-  }
+  /* Read only whole samples so as not to fragment one */
+  sfifo_read_frames( &sound_fifo, stream, len, sound_stereo_ay ? 4 : 2 );
 
   /* If we ran out of sound, do nothing else as SDL has prefilled
      the output buffer with silence :( */
@@ -1,6 +1,6 @@
 /*
 ------------------------------------------------------------
-	SFIFO 1.3
+	SFIFO 1.4
 ------------------------------------------------------------
  * Simple portable lock-free FIFO
  * (c) 2000-2002, David Olofson
@@ -20,16 +20,16 @@ TODO:
 
 #include <config.h>
 
-#ifdef __KERNEL__
-#	include	<linux/string.h>
-#	include	<asm/uaccess.h>
-#	include	<linux/malloc.h>
-#	define	malloc(x)	kmalloc(x, GFP_KERNEL)
-#	define	free(x, y)	kfree_s(x, y)
+#include <string.h>
+#include <stdlib.h>
+#define	free(x, y)	free(x)
+
+#ifdef HAVE_PTHREAD
+#include <sys/time.h>
+#elif defined( _WIN32 )
+#include <windows.h>
 #else
-#	include	<string.h>
-#	include	<stdlib.h>
-#	define	free(x, y)	free(x)
+#include <unistd.h>
 #endif
 
 #include "sfifo.h"
@@ -73,6 +73,11 @@ int sfifo_init(sfifo_t *f, int size)
 	if( 0 == (f->buffer = malloc(f->size)) )
 		return -ENOMEM;
 
+#ifdef HAVE_PTHREAD
+	pthread_mutex_init(&f->lock, NULL);
+	pthread_cond_init(&f->space, NULL);
+#endif
+
 	return 0;
 }
 
@@ -81,8 +86,16 @@ int sfifo_init(sfifo_t *f, int size)
  */
 void sfifo_close(sfifo_t *f)
 {
-	if(f->buffer)
-		free(f->buffer, f->size);
+	if(!f->buffer)
+		return;
+
+	free(f->buffer, f->size);
+	f->buffer = NULL;
+
+#ifdef HAVE_PTHREAD
+	pthread_cond_destroy(&f->space);
+	pthread_mutex_destroy(&f->lock);
+#endif
 }
 
 /*
@@ -91,8 +104,28 @@ void sfifo_close(sfifo_t *f)
 void sfifo_flush(sfifo_t *f)
 {
 	/* Reset positions */
-	f->readpos = 0;
-	f->writepos = 0;
+	SFIFO_STORE_RELEASE(f->readpos, 0);
+	SFIFO_STORE_RELEASE(f->writepos, 0);
+}
+
+/*
+ * Wake a writer sleeping in sfifo_wait_space(), if there is one
+ */
+static void sfifo_wake_writer(sfifo_t *f)
+{
+	/*
+	 * Pairs with the fence in sfifo_wait_space(): either we see
+	 * 'waiting' set, or the writer sees our new read position.
+	 */
+	SFIFO_FENCE();
+	if(!SFIFO_LOAD_RELAXED(f->waiting))
+		return;
+
+#ifdef HAVE_PTHREAD
+	pthread_mutex_lock(&f->lock);
+	pthread_cond_signal(&f->space);
+	pthread_mutex_unlock(&f->lock);
+#endif
 }
 
 /*
@@ -116,7 +149,7 @@ int sfifo_write(sfifo_t *f, const void *_buf, int len)
 	else
 		total = len;
 
-	i = f->writepos;
+	i = SFIFO_LOAD_RELAXED(f->writepos);
 	if(i + len > f->size)
 	{
 		memcpy(f->buffer + i, buf, f->size - i);
@@ -125,50 +158,11 @@ int sfifo_write(sfifo_t *f, const void *_buf, int len)
 		i = 0;
 	}
 	memcpy(f->buffer + i, buf, len);
-	f->writepos = i + len;
+	SFIFO_STORE_RELEASE(f->writepos, (i + len) & SFIFO_SIZEMASK(f));
 
 	return total;
 }
 
-#ifdef __KERNEL__
-/*
- * Write bytes to a FIFO from a user space buffer
- * Return number of bytes written, or an error code
- */
-int sfifo_write_user(sfifo_t *f, const void *buf, int len)
-{
-	int total;
-	int i;
-
-	if(!f->buffer)
-		return -ENODEV;	/* No buffer! */
-
-	/* total = len = min(space, len) */
-	total = sfifo_space(f);
-	if(len > total)
-		len = total;
-	else
-		total = len;
-
-	i = f->writepos;
-	if(i + len > f->size)
-	{
-		if(f->size - i)
-		{
-			if(copy_from_user(f->buffer + i, buf, f->size - i))
-				return -EFAULT;
-			buf += f->size - i;
-			len -= f->size - i;
-		}
-		i = 0;
-	}
-	if(copy_from_user(f->buffer + i, buf, len))
-		return -EFAULT;
-	f->writepos = i + len;
-
-	return total;
-}
-#endif
 
 /*
  * Read bytes from a FIFO
@@ -191,7 +185,7 @@ int sfifo_read(sfifo_t *f, void *_buf, int len)
 	else
 		total = len;
 
-	i = f->readpos;
+	i = SFIFO_LOAD_RELAXED(f->readpos);
 	if(i + len > f->size)
 	{
 		memcpy(buf, f->buffer + i, f->size - i);
@@ -200,50 +194,109 @@ int sfifo_read(sfifo_t *f, void *_buf, int len)
 		i = 0;
 	}
 	memcpy(buf, f->buffer + i, len);
-	f->readpos = i + len;
+	SFIFO_STORE_RELEASE(f->readpos, (i + len) & SFIFO_SIZEMASK(f));
+
+	if(total)
+		sfifo_wake_writer(f);
 
 	return total;
 }
 
-#ifdef __KERNEL__
 /*
- * Read bytes from a FIFO into a user space buffer
+ * Read whole frames from a FIFO, keeping statistics
  * Return number of bytes read, or an error code
  */
-int sfifo_read_user(sfifo_t *f, void *buf, int len)
+int sfifo_read_frames(sfifo_t *f, void *buf, int len, int frame_bytes)
 {
-	int total;
-	int i;
+	sfifo_stats_t *stats = &f->stats;
+	int used;
 
 	if(!f->buffer)
 		return -ENODEV;	/* No buffer! */
 
-	/* total = len = min(used, len) */
-	total = sfifo_used(f);
-	if(len > total)
-		len = total;
-	else
-		total = len;
+	used = sfifo_used(f);
 
-	i = f->readpos;
-	if(i + len > f->size)
+	if(!stats->reads || used < stats->fill_min)
+		stats->fill_min = used;
+	if(used > stats->fill_max)
+		stats->fill_max = used;
+	stats->fill_total += used;
+	stats->reads++;
+
+	if(used < len)
+	{
+		stats->underruns++;
+		len = used;
+	}
+	len -= len % frame_bytes;
+
+	return sfifo_read(f, buf, len);
+}
+
+#if !defined( HAVE_PTHREAD )
+static void sfifo_nap(void)
+{
+#ifdef _WIN32
+	Sleep(1);
+#else
+	usleep(1000);
+#endif
+}
+#endif
+
+/*
+ * Wait for room in a FIFO
+ * Return non-zero if 'len' bytes can now be written
+ */
+int sfifo_wait_space(sfifo_t *f, int len, int timeout_ms)
+{
+	if(!f->buffer)
+		return 0;
+
+	/* Never wait for more than the FIFO can hold */
+	if(len > f->size - 1)
+		len = f->size - 1;
+
+	if(sfifo_space(f) >= len)
+		return 1;
+
+	f->stats.full_waits++;
+
+#ifdef HAVE_PTHREAD
 	{
-		if(f->size - i)
+		struct timeval now;
+		struct timespec deadline;
+		int error = 0;
+
+		gettimeofday(&now, NULL);
+		deadline.tv_sec = now.tv_sec + timeout_ms / 1000;
+		deadline.tv_nsec = now.tv_usec * 1000L +
+			(timeout_ms % 1000) * 1000000L;
+		if(deadline.tv_nsec >= 1000000000L)
 		{
-			if(copy_to_user(buf, f->buffer + i, f->size - i))
-				return -EFAULT;
-			buf += f->size - i;
-			len -= f->size - i;
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
 		}
-		i = 0;
+
+		pthread_mutex_lock(&f->lock);
+		SFIFO_STORE_RELAXED(f->waiting, 1);
+		SFIFO_FENCE();
+		/* Give up on a timeout or any other error (e.g. EINVAL) */
+		while(sfifo_space(f) < len && !error)
+			error = pthread_cond_timedwait(&f->space, &f->lock,
+						       &deadline);
+		SFIFO_STORE_RELAXED(f->waiting, 0);
+		pthread_mutex_unlock(&f->lock);
 	}
-	if(copy_to_user(buf, f->buffer + i, len))
-		return -EFAULT;
-	f->readpos = i + len;
+#else
+	/* No way to be woken, so poll at a finer grain than callers used to */
+	for(; timeout_ms > 0 && sfifo_space(f) < len; timeout_ms--)
+		sfifo_nap();
+#endif
 
-	return total;
+	return sfifo_space(f) >= len;
 }
-#endif
+
 
 #ifdef _SFIFO_TEST_
 void *sender(void *arg)
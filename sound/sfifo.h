@@ -1,6 +1,6 @@
 /*
 ------------------------------------------------------------
-	SFIFO 1.3
+	SFIFO 1.4
 ------------------------------------------------------------
  * Simple portable lock-free FIFO
  * (c) 2000-2002, David Olofson
@@ -30,6 +30,13 @@
  *	would result in memory thrashing. (Amazing that
  *	I've manage to use this to the extent I have
  *	without running into this... *heh*)
+ *
+ * 1.4:	(Fuse) Read and write positions are published with
+ *	acquire/release atomics rather than relying on 'int'
+ *	being atomic and the compiler not reordering the
+ *	buffer copies. Added a blocking wait for space so
+ *	producers need not poll, and fill/underrun statistics.
+ *	The Linux kernel space interface has been dropped.
  */
 
 #ifndef	_SFIFO_H_
@@ -41,29 +48,87 @@ extern "C" {
 
 #include <errno.h>
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 /*------------------------------------------------
 	"Private" stuff
 ------------------------------------------------*/
 /*
  * Porting note:
- *	Reads and writes of a variable of this type in memory
- *	must be *atomic*! 'int' is *not* atomic on all platforms.
- *	A safe type should be used, and  sfifo should limit the
- *	maximum buffer size accordingly.
+ *	The read and write positions are each written by only
+ *	one side and read by the other, so a load-acquire and
+ *	store-release pair is all the synchronisation needed.
+ *	Without C11 atomics or the GCC __atomic builtins we
+ *	fall back to plain volatile accesses, which is what
+ *	sfifo always used to do.
  */
+#if defined( __STDC_VERSION__ ) && __STDC_VERSION__ >= 201112L && \
+    !defined( __STDC_NO_ATOMICS__ )
+#include <stdatomic.h>
+typedef atomic_int sfifo_atomic_t;
+#define	SFIFO_LOAD_ACQUIRE(x)	atomic_load_explicit(&(x), memory_order_acquire)
+#define	SFIFO_LOAD_RELAXED(x)	atomic_load_explicit(&(x), memory_order_relaxed)
+#define	SFIFO_STORE_RELEASE(x, v) \
+	atomic_store_explicit(&(x), (v), memory_order_release)
+#define	SFIFO_STORE_RELAXED(x, v) \
+	atomic_store_explicit(&(x), (v), memory_order_relaxed)
+#define	SFIFO_FENCE()		atomic_thread_fence(memory_order_seq_cst)
+#elif defined( __GNUC__ ) && \
+      ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 7 ) )
 typedef int sfifo_atomic_t;
+#define	SFIFO_LOAD_ACQUIRE(x)	__atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define	SFIFO_LOAD_RELAXED(x)	__atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define	SFIFO_STORE_RELEASE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#define	SFIFO_STORE_RELAXED(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define	SFIFO_FENCE()		__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+typedef volatile int sfifo_atomic_t;
+#define	SFIFO_LOAD_ACQUIRE(x)	(x)
+#define	SFIFO_LOAD_RELAXED(x)	(x)
+#define	SFIFO_STORE_RELEASE(x, v) ((x) = (v))
+#define	SFIFO_STORE_RELAXED(x, v) ((x) = (v))
+#define	SFIFO_FENCE()
+#endif
+
 #ifdef __TURBOC__
 #	define	SFIFO_MAX_BUFFER_SIZE	0x7fff
 #else /* Kludge: Assume 32 bit platform */
 #	define	SFIFO_MAX_BUFFER_SIZE	0x7fffffff
 #endif
 
+/*
+ * Statistics. The consumer side fields are only written by
+ * the reader and the producer side ones only by the writer,
+ * so they need no locking; read them once both sides have
+ * stopped.
+ */
+typedef struct sfifo_stats_t
+{
+	/* Consumer side, updated by sfifo_read_frames() */
+	unsigned long reads;		/* Number of reads */
+	unsigned long underruns;	/* Reads which found too little data */
+	int fill_min;			/* Bytes queued at the start of a read */
+	int fill_max;
+	double fill_total;		/* For the mean fill level */
+
+	/* Producer side, updated by sfifo_wait_space() */
+	unsigned long full_waits;	/* Times the writer found no room */
+} sfifo_stats_t;
+
 typedef struct sfifo_t
 {
 	char *buffer;
 	int size;			/* Number of bytes */
 	sfifo_atomic_t readpos;		/* Read position */
 	sfifo_atomic_t writepos;	/* Write position */
+	sfifo_atomic_t waiting;		/* Writer blocked in sfifo_wait_space() */
+#ifdef HAVE_PTHREAD
+	pthread_mutex_t lock;		/* Protect 'space' */
+	pthread_cond_t space;		/* Signalled when the reader frees room */
+#endif
+	sfifo_stats_t stats;
 } sfifo_t;
 
 #define SFIFO_SIZEMASK(x)	((x)->size - 1)
@@ -77,20 +142,25 @@ void sfifo_close(sfifo_t *f);
 void sfifo_flush(sfifo_t *f);
 int sfifo_write(sfifo_t *f, const void *buf, int len);
 int sfifo_read(sfifo_t *f, void *buf, int len);
-#define sfifo_used(x)	(((x)->writepos - (x)->readpos) & SFIFO_SIZEMASK(x))
-#define sfifo_space(x)	((x)->size - 1 - sfifo_used(x))
 
+/*
+ * Read as many whole 'frame_bytes' sized frames as are available,
+ * up to 'len' bytes, and record fill level and underrun statistics.
+ * Return number of bytes read, or an error code.
+ */
+int sfifo_read_frames(sfifo_t *f, void *buf, int len, int frame_bytes);
 
-/*------------------------------------------------
-	Linux kernel space interface
-------------------------------------------------*/
-#ifdef __KERNEL__
-int sfifo_write_user(sfifo_t *f, const void *buf, int len);
-int sfifo_read_user(sfifo_t *f, void *buf, int len);
-#else
-#	define	sfifo_write_user	sfifo_write
-#	define	sfifo_read_user		sfifo_read
-#endif
+/*
+ * Block until at least 'len' bytes of space are available or
+ * 'timeout_ms' milliseconds have passed. Return non-zero if the
+ * space is available.
+ */
+int sfifo_wait_space(sfifo_t *f, int len, int timeout_ms);
+
+#define sfifo_used(x)	((SFIFO_LOAD_ACQUIRE((x)->writepos) - \
+			  SFIFO_LOAD_ACQUIRE((x)->readpos)) & SFIFO_SIZEMASK(x))
+#define sfifo_space(x)	((x)->size - 1 - sfifo_used(x))
+#define sfifo_stats(x)	(&(x)->stats)
 
 #ifdef __cplusplus
 };
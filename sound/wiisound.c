@@ -24,6 +24,7 @@
 
 #include "fuse.h"
 #include "sfifo.h"
+#include "sound.h"
 
 #include <gccore.h>
 #include <ogc/audio.h>
@@ -36,6 +37,9 @@ int samplerate;
 int streamstate;
 sfifo_t sound_fifo;
 
+/* For the latency statistics */
+static int bytes_per_second;
+
 #define BUFSIZE 16384
 u8 dmabuf[BUFSIZE<<1] ATTRIBUTE_ALIGN(32);
 int dmalen = BUFSIZE;
@@ -68,6 +72,7 @@ sound_lowlevel_init( const char *device, int *freqptr, int *stereoptr )
   }
 
   sfifo_init( &sound_fifo, BUFSIZE );
+  bytes_per_second = *freqptr * 4;
   *stereoptr = 1;
   
   AUDIO_Init( NULL );
@@ -87,9 +92,10 @@ sound_lowlevel_init( const char *device, int *freqptr, int *stereoptr )
 void
 sound_lowlevel_end( void )
 {
+  AUDIO_StopDMA();
+  sound_fifo_report( &sound_fifo, bytes_per_second );
   sfifo_flush( &sound_fifo );
   sfifo_close( &sound_fifo );
-  AUDIO_StopDMA();
 }
 
 void
@@ -104,7 +110,7 @@ sound_lowlevel_frame(libspectrum_signed_word *data, int len)
     if( ( i = sfifo_write( &sound_fifo, bytes, len ) ) < 0 ) 
       break;
     else if( !i )
-      usleep(10000);
+      sfifo_wait_space( &sound_fifo, len, 10 );
     bytes += i;
     len -= i;
   }
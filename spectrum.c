@@ -23,8 +23,11 @@
 
 #include <config.h>
 
+#include <string.h>
+
 #include <libspectrum.h>
 
+#include "benchmark.h"
 #include "compat.h"
 #include "debugger/debugger.h"
 #include "display.h"
@@ -40,6 +43,7 @@
 #include "phantom_typist.h"
 #include "psg.h"
 #include "profile.h"
+#include "rewind.h"
 #include "rzx.h"
 #include "settings.h"
 #include "sound.h"
@@ -147,6 +151,7 @@ spectrum_frame( void )
   frame_length = rzx_playback ? tstates
 			      : machine_current->timings.tstates_per_frame;
 
+  if( tape_recording ) tape_record_frame( frame_length );
   event_frame( frame_length );
   debugger_breakpoint_reduce_tstates( frame_length );
   tstates -= frame_length;
@@ -169,6 +174,9 @@ spectrum_frame( void )
 
   frames_since_reset++;
 
+  if( benchmark_active ) benchmark_frame( frame_length );
+  rewind_frame();
+
   return 0;
 }
 
@@ -226,6 +234,43 @@ spectrum_contend_delay_76543210( libspectrum_dword time )
   return contend_delay_common( time, contention_pattern_76543210, 4 );
 }
 
+/* Fill in 'table' with the value of 'contend_delay' for each of the
+   first 'length' tstates. For the delay functions above, the delay
+   depends only on whether the line is one of the screen lines and on
+   the position within the line, so only the first screen line need be
+   worked out; the others are copies of it */
+void
+spectrum_contention_fill( libspectrum_byte *table, libspectrum_dword length,
+                          spectrum_contention_delay_function contend_delay )
+{
+  libspectrum_dword tstates_per_line, start, end, time;
+
+  if( contend_delay != spectrum_contend_delay_none &&
+      contend_delay != spectrum_contend_delay_65432100 &&
+      contend_delay != spectrum_contend_delay_76543210 ) {
+    for( time = 0; time < length; time++ )
+      table[ time ] = contend_delay( time );
+    return;
+  }
+
+  memset( table, 0, length );
+  if( contend_delay == spectrum_contend_delay_none ) return;
+
+  tstates_per_line = machine_current->timings.tstates_per_line;
+  start = machine_current->line_times[ 0 ] +
+          DISPLAY_BORDER_HEIGHT * tstates_per_line;
+  end = start + DISPLAY_HEIGHT * tstates_per_line;
+  if( end > length ) end = length;
+  if( start >= end ) return;
+
+  for( time = start; time < end && time < start + tstates_per_line; time++ )
+    table[ time ] = contend_delay( time );
+
+  for( ; time < end; time += tstates_per_line )
+    memcpy( &table[ time ], &table[ start ],
+            end - time < tstates_per_line ? end - time : tstates_per_line );
+}
+
 /* What happens if we read from an unattached port? */
 libspectrum_byte
 spectrum_unattached_port( void )
@@ -72,6 +72,10 @@ libspectrum_byte spectrum_contend_delay_none( libspectrum_dword time );
 libspectrum_byte spectrum_contend_delay_65432100( libspectrum_dword time );
 libspectrum_byte spectrum_contend_delay_76543210( libspectrum_dword time );
 
+void
+spectrum_contention_fill( libspectrum_byte *table, libspectrum_dword length,
+                          spectrum_contention_delay_function contend_delay );
+
 libspectrum_byte spectrum_unattached_port( void );
 libspectrum_byte spectrum_unattached_port_none( void );
 
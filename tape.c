@@ -78,7 +78,6 @@ static const char * const microphone_variable_name = "microphone";
 
 /* Spectrum events */
 int tape_edge_event;
-static int record_event;
 static int tape_mic_off_event;
 
 static libspectrum_dword next_tape_edge_tstates;
@@ -89,9 +88,6 @@ static int tape_autoload( libspectrum_machine hardware );
 static int trap_load_block( libspectrum_tape_block *block );
 static int tape_play( int autoplay );
 static void make_name( unsigned char *name, const unsigned char *data );
-static void
-tape_event_record_sample( libspectrum_dword last_tstates, int type,
-			  void *user_data );
 static void tape_stop_mic_off( libspectrum_dword last_tstates, int type,
                                void *user_data );
 
@@ -124,8 +120,6 @@ tape_init( void *context )
 
   tape_edge_event = event_register( next_edge, "Tape edge" );
   tape_mic_off_event = event_register( tape_stop_mic_off, "Tape stop MIC off" );
-  record_event = event_register( tape_event_record_sample,
-				 "Tape sample record" );
 
   tape_modified = 0;
 
@@ -733,14 +727,21 @@ tape_present( void )
   return libspectrum_tape_present( tape );
 }
 
+/* Recording samples the MIC level every tstates_per_sample tstates, as if
+   at 44.1kHz, and stores the number of samples at each level in an RLE pulse
+   block. Rather than actually sampling, we are told about each change of
+   level by ula_write() and work out which samples it affects then */
+
 typedef struct
 {
   libspectrum_byte *tape_buffer;
   libspectrum_dword tape_buffer_size;
   libspectrum_dword tape_buffer_used;
   int tstates_per_sample;
-  int last_level;
-  int last_level_count;
+  int last_level;		/* The level seen by the last sample */
+  int last_level_count;		/* How many samples have seen it */
+  int level;			/* The current level */
+  libspectrum_dword next_sample; /* When the next sample is due */
 } tape_rec_state;
 
 int tape_recording = 0;
@@ -759,11 +760,9 @@ tape_record_start( void )
 					  rec_state.tape_buffer_size);
   rec_state.tape_buffer_used = 0;
 
-  /* start scheduling events that record into a buffer that we
-     start allocating here */
-  event_add( tstates + rec_state.tstates_per_sample, record_event );
+  rec_state.next_sample = tstates + rec_state.tstates_per_sample;
 
-  rec_state.last_level = ula_tape_level();
+  rec_state.level = rec_state.last_level = ula_tape_level();
   rec_state.last_level_count = 1;
 
   tape_recording = 1;
@@ -790,11 +789,18 @@ write_rec_buffer( libspectrum_byte *tape_buffer,
   return tape_buffer_used;
 }
 
-void
-tape_event_record_sample( libspectrum_dword last_tstates, int type,
-			  void *user_data )
+/* Take all the samples due before `when'; they all see the current level */
+static void
+record_samples( libspectrum_dword when )
 {
-  if( rec_state.last_level != (ula_tape_level()) ) {
+  libspectrum_dword samples;
+
+  if( rec_state.next_sample >= when ) return;
+
+  samples = ( when - rec_state.next_sample - 1 ) /
+            rec_state.tstates_per_sample + 1;
+
+  if( rec_state.last_level != rec_state.level ) {
     /* put a sample into the recording buffer */
     rec_state.tape_buffer_used =
       write_rec_buffer( rec_state.tape_buffer,
@@ -802,7 +808,7 @@ tape_event_record_sample( libspectrum_dword last_tstates, int type,
                         rec_state.last_level_count );
 
     rec_state.last_level_count = 0;
-    rec_state.last_level = ula_tape_level();
+    rec_state.last_level = rec_state.level;
     /* make sure we can still fit a dword and a flag byte in the buffer */
     if( rec_state.tape_buffer_used+5 >= rec_state.tape_buffer_size ) {
       rec_state.tape_buffer_size = rec_state.tape_buffer_size*2;
@@ -812,10 +818,26 @@ tape_event_record_sample( libspectrum_dword last_tstates, int type,
     }
   }
 
-  rec_state.last_level_count++;
+  rec_state.last_level_count += samples;
+  rec_state.next_sample += samples * rec_state.tstates_per_sample;
+}
 
-  /* schedule next timer */
-  event_add( last_tstates + rec_state.tstates_per_sample, record_event );
+/* The MIC level changed to `level' at `when'; a sample due at the same time
+   sees the new level */
+void
+tape_record_edge( libspectrum_dword when, int level )
+{
+  record_samples( when );
+  rec_state.level = level;
+}
+
+/* Called at the end of each frame, before the frame's tstates are taken off
+   the current time */
+void
+tape_record_frame( libspectrum_dword frame_length )
+{
+  record_samples( frame_length );
+  rec_state.next_sample -= frame_length;
 }
 
 int
@@ -823,15 +845,14 @@ tape_record_stop( void )
 {
   libspectrum_tape_block* block;
 
-  /* put last sample into the recording buffer */
+  /* take any samples due up to now, and put the last run of samples into
+     the recording buffer */
+  record_samples( tstates + 1 );
   rec_state.tape_buffer_used = write_rec_buffer( rec_state.tape_buffer,
                                                  rec_state.tape_buffer_used,
                                                  rec_state.last_level_count );
 
-  /* stop scheduling events and turn buffer into a block and
-     pop into the current tape */
-  event_remove_type( record_event );
-
+  /* turn buffer into a block and pop into the current tape */
   block = libspectrum_tape_block_alloc( LIBSPECTRUM_TAPE_BLOCK_RLE_PULSE );
 
   libspectrum_tape_block_set_scale( block, rec_state.tstates_per_sample );
@@ -58,6 +58,8 @@ int tape_present( void );
 
 void tape_record_start( void );
 int tape_record_stop( void );
+void tape_record_edge( libspectrum_dword when, int level );
+void tape_record_frame( libspectrum_dword frame_length );
 
 /* Call a user-supplied function for every block in the current tape */
 int
@@ -23,6 +23,7 @@
 
 #include <config.h>
 
+#include "benchmark.h"
 #include "event.h"
 #include "infrastructure/startup_manager.h"
 #include "movie.h"
@@ -57,6 +58,9 @@ static double start_time;
 
 static const int TEN_MS = 10;
 
+/* The value of the turbo setting the last time we looked at it */
+static int turbo;
+
 int timer_event;
 
 static void timer_frame( libspectrum_dword last_tstates, int event GCC_UNUSED,
@@ -132,6 +136,8 @@ timer_init( void *context )
 {
   start_time = timer_get_time(); if( start_time < 0 ) return 1;
 
+  turbo = settings_current.turbo;
+
   timer_event = event_register( timer_frame, "Timer" );
 
   event_add( 0, timer_event );
@@ -167,16 +173,10 @@ extern sfifo_t sound_fifo;
 static void
 timer_frame_callback_sound( libspectrum_dword last_tstates )
 {
-  for(;;) {
-
-    /* Sleep while fifo is full */
-    if( sfifo_space( &sound_fifo ) < sound_framesiz ) {
-      timer_sleep( TEN_MS );
-    } else {
-      break;
-    }
-
-  }
+  /* Sleep while fifo is full; the sound callback wakes us as soon as it
+     has made room */
+  while( !sfifo_wait_space( &sound_fifo, sound_framesiz, TEN_MS ) )
+    ;
 
   event_add( last_tstates + machine_current->timings.tstates_per_frame,
              timer_event );
@@ -212,6 +212,18 @@ timer_stop_fastloading( void )
   }
 }
 
+/* Turbo mode produces no sound, so when it's switched on or off turn sound
+   off or back on, and reset the speed counter */
+static void
+timer_turbo_changed( void )
+{
+  turbo = settings_current.turbo;
+
+  sound_pause();
+  sound_unpause();
+  timer_estimate_reset();
+}
+
 int
 timer_fastloading_active( void )
 {
@@ -225,14 +237,17 @@ timer_frame( libspectrum_dword last_tstates, int event GCC_UNUSED,
   double current_time, difference;
   long tstates;
 
+  if( settings_current.turbo != turbo ) timer_turbo_changed();
+
   if( sound_enabled && settings_current.sound ) {
     timer_frame_callback_sound( last_tstates );
     return;
   }
 
-  /* If we're fastloading, just schedule another check in a frame's time
-     and do nothing else */
-  if( settings_current.fastload && timer_fastloading_active() ) {
+  /* If we're fastloading, benchmarking or in turbo mode, just schedule
+     another check in a frame's time and do nothing else */
+  if( benchmark_active || settings_current.turbo ||
+      ( settings_current.fastload && timer_fastloading_active() ) ) {
 
     libspectrum_dword next_check_time =
       last_tstates + machine_current->timings.tstates_per_frame;
@@ -463,75 +463,34 @@ uidisplay_putpixel( int x, int y, int colour )
   }
 }
 
-/* Print the 8 pixels in `data' using ink colour `ink' and paper
-   colour `paper' to the screen at ( (8*x) , y ) */
+/* Print the `count' chunks of 8 pixels in `data' starting at
+   ( (8*x) , y ) */
 void
-uidisplay_plot8( int x, int y, libspectrum_byte data,
-                libspectrum_byte ink, libspectrum_byte paper )
+uidisplay_plot8_run( int x, int y, int count, const libspectrum_byte *data,
+                     const libspectrum_byte *ink,
+                     const libspectrum_byte *paper )
 {
-  x <<= 3;
-
   if( machine_current->timex ) {
-    int i;
-
-    x <<= 1; y <<= 1;
-    for( i=0; i<2; i++,y++ ) {
-      fbdisplay_image[y][x+ 0] = ( data & 0x80 ) ? ink : paper;
-      fbdisplay_image[y][x+ 1] = ( data & 0x80 ) ? ink : paper;
-      fbdisplay_image[y][x+ 2] = ( data & 0x40 ) ? ink : paper;
-      fbdisplay_image[y][x+ 3] = ( data & 0x40 ) ? ink : paper;
-      fbdisplay_image[y][x+ 4] = ( data & 0x20 ) ? ink : paper;
-      fbdisplay_image[y][x+ 5] = ( data & 0x20 ) ? ink : paper;
-      fbdisplay_image[y][x+ 6] = ( data & 0x10 ) ? ink : paper;
-      fbdisplay_image[y][x+ 7] = ( data & 0x10 ) ? ink : paper;
-      fbdisplay_image[y][x+ 8] = ( data & 0x08 ) ? ink : paper;
-      fbdisplay_image[y][x+ 9] = ( data & 0x08 ) ? ink : paper;
-      fbdisplay_image[y][x+10] = ( data & 0x04 ) ? ink : paper;
-      fbdisplay_image[y][x+11] = ( data & 0x04 ) ? ink : paper;
-      fbdisplay_image[y][x+12] = ( data & 0x02 ) ? ink : paper;
-      fbdisplay_image[y][x+13] = ( data & 0x02 ) ? ink : paper;
-      fbdisplay_image[y][x+14] = ( data & 0x01 ) ? ink : paper;
-      fbdisplay_image[y][x+15] = ( data & 0x01 ) ? ink : paper;
-    }
+    x <<= 4; y <<= 1;
   } else {
-    fbdisplay_image[y][x+ 0] = ( data & 0x80 ) ? ink : paper;
-    fbdisplay_image[y][x+ 1] = ( data & 0x40 ) ? ink : paper;
-    fbdisplay_image[y][x+ 2] = ( data & 0x20 ) ? ink : paper;
-    fbdisplay_image[y][x+ 3] = ( data & 0x10 ) ? ink : paper;
-    fbdisplay_image[y][x+ 4] = ( data & 0x08 ) ? ink : paper;
-    fbdisplay_image[y][x+ 5] = ( data & 0x04 ) ? ink : paper;
-    fbdisplay_image[y][x+ 6] = ( data & 0x02 ) ? ink : paper;
-    fbdisplay_image[y][x+ 7] = ( data & 0x01 ) ? ink : paper;
+    x <<= 3;
   }
+
+  uidisplay_plot_run16( &fbdisplay_image[y][x], DISPLAY_SCREEN_WIDTH, NULL,
+                        count, data, ink, paper, 0 );
 }
 
-/* Print the 16 pixels in `data' using ink colour `ink' and paper
-   colour `paper' to the screen at ( (16*x) , y ) */
+/* Print the `count' chunks of 16 pixels in `data' starting at
+   ( (16*x) , y ) */
 void
-uidisplay_plot16( int x, int y, libspectrum_word data,
-                 libspectrum_byte ink, libspectrum_byte paper )
+uidisplay_plot16_run( int x, int y, int count, const libspectrum_byte *data,
+                      const libspectrum_byte *ink,
+                      const libspectrum_byte *paper )
 {
-  int i;
   x <<= 4; y <<= 1;
 
-  for( i=0; i<2; i++,y++ ) {
-    fbdisplay_image[y][x+ 0] = ( data & 0x8000 ) ? ink : paper;
-    fbdisplay_image[y][x+ 1] = ( data & 0x4000 ) ? ink : paper;
-    fbdisplay_image[y][x+ 2] = ( data & 0x2000 ) ? ink : paper;
-    fbdisplay_image[y][x+ 3] = ( data & 0x1000 ) ? ink : paper;
-    fbdisplay_image[y][x+ 4] = ( data & 0x0800 ) ? ink : paper;
-    fbdisplay_image[y][x+ 5] = ( data & 0x0400 ) ? ink : paper;
-    fbdisplay_image[y][x+ 6] = ( data & 0x0200 ) ? ink : paper;
-    fbdisplay_image[y][x+ 7] = ( data & 0x0100 ) ? ink : paper;
-    fbdisplay_image[y][x+ 8] = ( data & 0x0080 ) ? ink : paper;
-    fbdisplay_image[y][x+ 9] = ( data & 0x0040 ) ? ink : paper;
-    fbdisplay_image[y][x+10] = ( data & 0x0020 ) ? ink : paper;
-    fbdisplay_image[y][x+11] = ( data & 0x0010 ) ? ink : paper;
-    fbdisplay_image[y][x+12] = ( data & 0x0008 ) ? ink : paper;
-    fbdisplay_image[y][x+13] = ( data & 0x0004 ) ? ink : paper;
-    fbdisplay_image[y][x+14] = ( data & 0x0002 ) ? ink : paper;
-    fbdisplay_image[y][x+15] = ( data & 0x0001 ) ? ink : paper;
-  }
+  uidisplay_plot_run16( &fbdisplay_image[y][x], DISPLAY_SCREEN_WIDTH, NULL,
+                        count, data, ink, paper, 1 );
 }
 
 void
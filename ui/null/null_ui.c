@@ -239,15 +239,15 @@ uidisplay_init( int width, int height )
 }
 
 void
-uidisplay_plot16( int x, int y, libspectrum_word data,
-    libspectrum_byte ink, libspectrum_byte paper )
+uidisplay_plot16_run( int x, int y, int count, const libspectrum_byte *data,
+    const libspectrum_byte *ink, const libspectrum_byte *paper )
 {
   /* Do nothing */
 }
 
 void
-uidisplay_plot8( int x, int y, libspectrum_byte data,
-    libspectrum_byte ink, libspectrum_byte paper )
+uidisplay_plot8_run( int x, int y, int count, const libspectrum_byte *data,
+    const libspectrum_byte *ink, const libspectrum_byte *paper )
 {
   /* Do nothing */
 }
@@ -27,10 +27,12 @@
 
 #include <config.h>
 
+#include <stdio.h>
 #include <string.h>
 
 #include <libspectrum.h>
 
+#include "fuse.h"
 #include "scaler.h"
 #include "scaler_internals.h"
 #include "settings.h"
@@ -102,7 +104,7 @@ static const struct scaler_info available_scalers[] = {
     scaler_TV3x_16,       scaler_TV3x_32,       NULL                },
   { "TV 4x",	       "tv4x",	     SCALER_FLAGS_NONE,        4.0,
     scaler_TV4x_16,       scaler_TV4x_32,       NULL                },
-  { "Timex TV",	       "timextv",    SCALER_FLAGS_NONE,        1.0, 
+  { "Timex TV",	       "timextv",    SCALER_FLAGS_SERIAL,      1.0, 
     scaler_TimexTV_16,    scaler_TimexTV_32,    NULL                },
   { "Dot Matrix",      "dotmatrix",  SCALER_FLAGS_EXPAND,      2.0,
     scaler_DotMatrix_16,  scaler_DotMatrix_32,  expand_dotmatrix    },
@@ -280,3 +282,109 @@ expand_dotmatrix( int *x GCC_UNUSED, int *y GCC_UNUSED, int *w GCC_UNUSED,
   (*y)-=y_mod;
   (*h)+=y_mod;
 }
+
+/* Fill a 32-bit image with something that looks a bit like a Spectrum
+   screen: blocks of two colours with varied pixel patterns. The pixels are
+   written a byte at a time so the image is the same on any host */
+void
+scaler_test_image( libspectrum_dword *image, int width, int height )
+{
+  static const libspectrum_byte palette[8][3] = {
+    { 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0xcd },
+    { 0xcd, 0x00, 0x00 }, { 0xcd, 0x00, 0xcd },
+    { 0x00, 0xcd, 0x00 }, { 0x00, 0xcd, 0xcd },
+    { 0xcd, 0xcd, 0x00 }, { 0xcd, 0xcd, 0xcd }
+  };
+  libspectrum_dword seed = 0x2468ace0;
+  int x, y;
+
+  for( y = 0; y < height; y++ ) {
+    for( x = 0; x < width; x++ ) {
+      int block = ( y / 8 ) * 41 + x / 8;
+      int ink = block % 8, paper = ( block / 8 + 3 ) % 8;
+      libspectrum_byte *pixel = (libspectrum_byte*)&image[ y * width + x ];
+      const libspectrum_byte *colour;
+
+      seed = seed * 1103515245 + 12345;
+      colour = ( seed >> 28 ) & 1 ? palette[ ink ] : palette[ paper ];
+
+      pixel[0] = colour[0]; pixel[1] = colour[1]; pixel[2] = colour[2];
+      pixel[3] = 0;
+    }
+  }
+}
+
+static libspectrum_dword
+scaler_hash( const libspectrum_byte *data, size_t length,
+             libspectrum_dword hash )
+{
+  while( length-- ) { hash ^= *data++; hash *= 16777619; }
+  return hash;
+}
+
+/* Check the 32-bit HQ scalers still give exactly the output of the original
+   one pixel at a time implementation, and that the output for a pixel
+   doesn't depend on where in a strip it falls */
+int
+scaler_hq_unittest( void )
+{
+  static const libspectrum_dword golden[3] = {
+    0x9bb59d40, 0x41668f76, 0x2a284227
+  };
+  libspectrum_dword *src, *dst, *narrow_dst;
+  libspectrum_dword src_pitch = SCALER_TEST_SRC_WIDTH * 4;
+  libspectrum_dword dst_pitch = 4 * SCALER_TEST_WIDTH * 4;
+  size_t dst_size = 4 * SCALER_TEST_WIDTH * 4 * SCALER_TEST_HEIGHT;
+  const libspectrum_byte *src_start;
+  int factor, y, r = 0;
+
+  src = libspectrum_new( libspectrum_dword,
+                         SCALER_TEST_SRC_WIDTH * SCALER_TEST_SRC_HEIGHT );
+  dst = libspectrum_new( libspectrum_dword, dst_size );
+  narrow_dst = libspectrum_new( libspectrum_dword, dst_size );
+
+  scaler_test_image( src, SCALER_TEST_SRC_WIDTH, SCALER_TEST_SRC_HEIGHT );
+  src_start = (const libspectrum_byte*)
+    ( src + SCALER_TEST_MARGIN * SCALER_TEST_SRC_WIDTH + SCALER_TEST_MARGIN );
+
+  for( factor = 2; factor <= 4; factor++ ) {
+    scaler_type scaler = SCALER_HQ2X + factor - 2;
+    ScalerProc *proc = scaler_get_proc32( scaler );
+    libspectrum_dword hash = 2166136261U;
+    size_t row_size = SCALER_TEST_WIDTH * factor * 4;
+
+    proc( src_start, src_pitch, (libspectrum_byte*)dst, dst_pitch,
+          SCALER_TEST_WIDTH, SCALER_TEST_HEIGHT );
+
+    for( y = 0; y < SCALER_TEST_HEIGHT * factor; y++ )
+      hash = scaler_hash( (libspectrum_byte*)dst + y * dst_pitch, row_size,
+                          hash );
+
+    if( hash != golden[ factor - 2 ] ) {
+      fprintf( stderr, "%s: scaler '%s' output has changed (hash 0x%08x)\n",
+               fuse_progname, scaler_name( scaler ), hash );
+      r++;
+    }
+
+    /* A width which leaves a few pixels over after whole SIMD blocks */
+    proc( src_start, src_pitch, (libspectrum_byte*)narrow_dst, dst_pitch,
+          SCALER_TEST_WIDTH - 3, SCALER_TEST_HEIGHT );
+
+    for( y = 0; y < SCALER_TEST_HEIGHT * factor; y++ ) {
+      if( memcmp( (libspectrum_byte*)dst + y * dst_pitch,
+                  (libspectrum_byte*)narrow_dst + y * dst_pitch,
+                  ( SCALER_TEST_WIDTH - 3 ) * factor * 4 ) ) {
+        fprintf( stderr, "%s: scaler '%s' output depends on width\n",
+                 fuse_progname, scaler_name( scaler ) );
+        r++;
+        break;
+      }
+    }
+  }
+
+  libspectrum_free( narrow_dst );
+  libspectrum_free( dst );
+  libspectrum_free( src );
+
+  return r;
+}
@@ -59,6 +59,7 @@ typedef enum scaler_type {
 typedef enum scaler_flags_t {
   SCALER_FLAGS_NONE        = 0,
   SCALER_FLAGS_EXPAND      = 1 << 0,
+  SCALER_FLAGS_SERIAL      = 1 << 1,	/* Must scale the whole area at once */
 } scaler_flags_t;
 
 typedef void ScalerProc( const libspectrum_byte *srcPtr,
@@ -92,4 +93,16 @@ scaler_expand_fn* scaler_get_expander( scaler_type scaler );
 
 int scaler_select_bitformat( libspectrum_dword BitFormat );
 
+/* Run the current scaler, splitting the work across several threads */
+void scaler_run16( const libspectrum_byte *srcPtr, libspectrum_dword srcPitch,
+                   libspectrum_byte *dstPtr, libspectrum_dword dstPitch,
+                   int width, int height );
+void scaler_run32( const libspectrum_byte *srcPtr, libspectrum_dword srcPitch,
+                   libspectrum_byte *dstPtr, libspectrum_dword dstPitch,
+                   int width, int height );
+void scaler_threads_register_startup( void );
+void scaler_benchmark( void );
+int scaler_threads_unittest( void );
+int scaler_hq_unittest( void );
+
 #endif
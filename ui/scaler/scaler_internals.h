@@ -67,4 +67,15 @@ DECLARE_SCALER(HQ2x);
 DECLARE_SCALER(HQ3x);
 DECLARE_SCALER(HQ4x);
 
+/* The area used for the scaler benchmark and unit tests, plus a margin for
+   the scalers which look beyond it */
+#define SCALER_TEST_WIDTH 320
+#define SCALER_TEST_HEIGHT 240
+#define SCALER_TEST_MARGIN 4
+
+#define SCALER_TEST_SRC_WIDTH ( SCALER_TEST_WIDTH + 2 * SCALER_TEST_MARGIN )
+#define SCALER_TEST_SRC_HEIGHT ( SCALER_TEST_HEIGHT + 2 * SCALER_TEST_MARGIN )
+
+void scaler_test_image( libspectrum_dword *image, int width, int height );
+
 #endif				/* #ifndef FUSE_SCALER_INTERNALS_H */
@@ -0,0 +1,425 @@
+/* scaler_threads.c: run the scalers across several threads
+   Copyright (c) 2026 Fuse contributors
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License along
+   with this program; if not, write to the Free Software Foundation, Inc.,
+   51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+   Author contact information:
+
+   E-mail: philip-fuse@shadowmagic.org.uk
+
+*/
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <libspectrum.h>
+
+#include "benchmark.h"
+#include "fuse.h"
+#include "infrastructure/startup_manager.h"
+#include "scaler.h"
+#include "scaler_internals.h"
+#include "settings.h"
+#include "timer/timer.h"
+
+/* The most threads we will ever use, including the emulator thread */
+#define SCALER_MAX_THREADS 8
+
+/* The number of source lines in each band. This is a multiple of 4 so that
+   scalers which use a pattern repeating every few lines (eg Dot Matrix) see
+   the same phase as when the whole area is scaled at once */
+#define SCALER_BAND_HEIGHT 16
+
+/* One call to a scaler, split into bands of SCALER_BAND_HEIGHT lines. The
+   bands need no explicit halo: the scalers read the lines either side of
+   the area they are asked for straight from the source image, which is
+   complete before we start */
+typedef struct scaler_job_t {
+
+  ScalerProc *proc;
+  const libspectrum_byte *src;
+  libspectrum_dword src_pitch;
+  libspectrum_byte *dst;
+  libspectrum_dword dst_pitch;
+  int width, height;
+  int scale;			/* Destination lines per source line */
+
+  int bands;
+  int next_band;		/* The next band to be claimed */
+  int bands_done;
+
+} scaler_job_t;
+
+/* Scale band `band' of `job' */
+static void
+scaler_run_band( const scaler_job_t *job, int band )
+{
+  int start = band * SCALER_BAND_HEIGHT;
+  int height = job->height - start;
+
+  if( height > SCALER_BAND_HEIGHT ) height = SCALER_BAND_HEIGHT;
+
+  job->proc( job->src + start * job->src_pitch, job->src_pitch,
+             job->dst + start * job->scale * job->dst_pitch, job->dst_pitch,
+             job->width, height );
+}
+
+#ifdef HAVE_PTHREAD
+
+/* The worker threads; the thread calling scaler_run16/32() also scales
+   bands, so there are at most SCALER_MAX_THREADS - 1 of these */
+static pthread_t workers[ SCALER_MAX_THREADS - 1 ];
+static int worker_count = 0;
+
+/* The number of threads the pool was last sized for. If some workers
+   couldn't be started this is more than worker_count + 1, and we stay
+   with the workers we have rather than trying again on every call */
+static int pool_threads = 1;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_available = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t work_done = PTHREAD_COND_INITIALIZER;
+
+/* The job currently being worked on, if any; protected by pool_lock */
+static scaler_job_t *current_job = NULL;
+
+/* Set to tell the workers to exit */
+static int pool_exiting = 0;
+
+/* Claim and scale bands of `job' until there are none left. Called, and
+   returns, with pool_lock held */
+static void
+scaler_work( scaler_job_t *job )
+{
+  while( job->next_band < job->bands ) {
+    int band = job->next_band++;
+
+    pthread_mutex_unlock( &pool_lock );
+    scaler_run_band( job, band );
+    pthread_mutex_lock( &pool_lock );
+
+    if( ++job->bands_done == job->bands )
+      pthread_cond_signal( &work_done );
+  }
+}
+
+static void*
+scaler_worker( void *arg GCC_UNUSED )
+{
+  pthread_mutex_lock( &pool_lock );
+
+  for(;;) {
+    while( !pool_exiting &&
+           ( !current_job || current_job->next_band >= current_job->bands ) )
+      pthread_cond_wait( &work_available, &pool_lock );
+
+    if( pool_exiting ) break;
+
+    scaler_work( current_job );
+  }
+
+  pthread_mutex_unlock( &pool_lock );
+
+  return NULL;
+}
+
+static void
+scaler_pool_stop( void )
+{
+  int i;
+
+  pool_threads = 1;
+
+  if( !worker_count ) return;
+
+  pthread_mutex_lock( &pool_lock );
+  pool_exiting = 1;
+  pthread_cond_broadcast( &work_available );
+  pthread_mutex_unlock( &pool_lock );
+
+  for( i = 0; i < worker_count; i++ )
+    pthread_join( workers[i], NULL );
+
+  worker_count = 0;
+  pool_exiting = 0;
+}
+
+/* Make sure we have `threads' threads in total, including this one */
+static void
+scaler_pool_resize( int threads )
+{
+  if( threads == pool_threads ) return;
+
+  scaler_pool_stop();
+
+  pool_threads = threads;
+
+  for( ; worker_count < threads - 1; worker_count++ ) {
+    if( pthread_create( &workers[ worker_count ], NULL, scaler_worker,
+                        NULL ) ) {
+      /* Just carry on with the threads we have */
+      break;
+    }
+  }
+}
+
+static void
+scaler_pool_run( scaler_job_t *job )
+{
+  pthread_mutex_lock( &pool_lock );
+
+  current_job = job;
+  pthread_cond_broadcast( &work_available );
+
+  scaler_work( job );
+
+  while( job->bands_done < job->bands )
+    pthread_cond_wait( &work_done, &pool_lock );
+
+  current_job = NULL;
+
+  pthread_mutex_unlock( &pool_lock );
+}
+
+#else				/* #ifdef HAVE_PTHREAD */
+
+static const int worker_count = 0;
+
+static void scaler_pool_stop( void ) {}
+static void scaler_pool_resize( int threads GCC_UNUSED ) {}
+
+static void
+scaler_pool_run( scaler_job_t *job )
+{
+  int band;
+
+  for( band = 0; band < job->bands; band++ ) scaler_run_band( job, band );
+}
+
+#endif				/* #ifdef HAVE_PTHREAD */
+
+/* Set once the pool has been shut down, so we don't start it again while
+   the UI is closing */
+static int pool_ended = 0;
+
+/* How many threads to use, from the scaler-threads setting */
+static int
+scaler_thread_count( void )
+{
+  int threads = settings_current.scaler_threads;
+
+  if( threads <= 0 ) {
+#if defined( HAVE_UNISTD_H ) && defined( _SC_NPROCESSORS_ONLN )
+    threads = sysconf( _SC_NPROCESSORS_ONLN );
+#endif
+    if( threads <= 0 ) threads = 1;
+  }
+
+  return threads > SCALER_MAX_THREADS ? SCALER_MAX_THREADS : threads;
+}
+
+/* Run `proc', which scales by `scaling_factor', over the given area using
+   `threads' threads */
+static void
+scaler_run_threads( ScalerProc *proc, float scaling_factor, int serial,
+                    const libspectrum_byte *srcPtr, libspectrum_dword srcPitch,
+                    libspectrum_byte *dstPtr, libspectrum_dword dstPitch,
+                    int width, int height, int threads )
+{
+  scaler_job_t job;
+
+  /* Only split the area if each line of the source maps onto a whole number
+     of lines of the destination and it's worth the effort */
+  if( serial || threads <= 1 || height < 2 * SCALER_BAND_HEIGHT ||
+      scaling_factor < 1 || scaling_factor != (int)scaling_factor ) {
+    proc( srcPtr, srcPitch, dstPtr, dstPitch, width, height );
+    return;
+  }
+
+  if( !pool_ended ) scaler_pool_resize( threads );
+
+  if( !worker_count ) {
+    proc( srcPtr, srcPitch, dstPtr, dstPitch, width, height );
+    return;
+  }
+
+  job.proc = proc;
+  job.src = srcPtr; job.src_pitch = srcPitch;
+  job.dst = dstPtr; job.dst_pitch = dstPitch;
+  job.width = width; job.height = height;
+  job.scale = scaling_factor;
+  job.bands = ( height + SCALER_BAND_HEIGHT - 1 ) / SCALER_BAND_HEIGHT;
+  job.next_band = job.bands_done = 0;
+
+  scaler_pool_run( &job );
+}
+
+/* Run the current scaler on 16-bit data, spreading the work across several
+   threads if possible. The output is identical to calling scaler_proc16 */
+void
+scaler_run16( const libspectrum_byte *srcPtr, libspectrum_dword srcPitch,
+              libspectrum_byte *dstPtr, libspectrum_dword dstPitch,
+              int width, int height )
+{
+  scaler_run_threads( scaler_proc16,
+                      scaler_get_scaling_factor( current_scaler ),
+                      scaler_get_flags( current_scaler ) & SCALER_FLAGS_SERIAL,
+                      srcPtr, srcPitch, dstPtr, dstPitch, width, height,
+                      scaler_thread_count() );
+}
+
+/* 32-bit version of scaler_run16() */
+void
+scaler_run32( const libspectrum_byte *srcPtr, libspectrum_dword srcPitch,
+              libspectrum_byte *dstPtr, libspectrum_dword dstPitch,
+              int width, int height )
+{
+  scaler_run_threads( scaler_proc32,
+                      scaler_get_scaling_factor( current_scaler ),
+                      scaler_get_flags( current_scaler ) & SCALER_FLAGS_SERIAL,
+                      srcPtr, srcPitch, dstPtr, dstPitch, width, height,
+                      scaler_thread_count() );
+}
+
+static int
+scaler_threads_init( void *context )
+{
+  benchmark_register( &settings_current.benchmark_scalers, NULL,
+                      scaler_benchmark );
+
+  return 0;
+}
+
+static void
+scaler_threads_end( void )
+{
+  scaler_pool_stop();
+  pool_ended = 1;
+}
+
+void
+scaler_threads_register_startup( void )
+{
+  startup_manager_register_no_dependencies(
+    STARTUP_MANAGER_MODULE_SCALER_THREADS, scaler_threads_init, NULL,
+    scaler_threads_end
+  );
+}
+
+/* Time each 32-bit scaler over a whole screen with 1, 2, 4 and 8 threads */
+void
+scaler_benchmark( void )
+{
+  const int frames = 50;
+  libspectrum_dword *src, *dst;
+  libspectrum_dword src_pitch = SCALER_TEST_SRC_WIDTH * 4;
+  libspectrum_dword dst_pitch = 4 * SCALER_TEST_WIDTH * 4;
+  scaler_type scaler;
+
+  src = libspectrum_new( libspectrum_dword,
+                         SCALER_TEST_SRC_WIDTH * SCALER_TEST_SRC_HEIGHT );
+  dst = libspectrum_new0( libspectrum_dword,
+                          4 * SCALER_TEST_WIDTH * 4 * SCALER_TEST_HEIGHT );
+  scaler_test_image( src, SCALER_TEST_SRC_WIDTH, SCALER_TEST_SRC_HEIGHT );
+
+  for( scaler = 0; scaler < SCALER_NUM; scaler++ ) {
+    ScalerProc *proc = scaler_get_proc32( scaler );
+    float factor = scaler_get_scaling_factor( scaler );
+    int serial = scaler_get_flags( scaler ) & SCALER_FLAGS_SERIAL;
+    int threads;
+
+    printf( "%s: scaler benchmark: %-22s", fuse_progname,
+            scaler_name( scaler ) );
+
+    for( threads = 1; threads <= SCALER_MAX_THREADS; threads <<= 1 ) {
+      double start = timer_get_time(), elapsed;
+      int frame;
+
+      for( frame = 0; frame < frames; frame++ )
+        scaler_run_threads(
+          proc, factor, serial,
+          (libspectrum_byte*)( src + SCALER_TEST_MARGIN * SCALER_TEST_SRC_WIDTH +
+                               SCALER_TEST_MARGIN ),
+          src_pitch, (libspectrum_byte*)dst, dst_pitch, SCALER_TEST_WIDTH,
+          SCALER_TEST_HEIGHT, threads
+        );
+
+      elapsed = timer_get_time() - start;
+      printf( " %7.3f", elapsed * 1000 / frames );
+    }
+
+    printf( " ms/frame at 1/2/4/8 threads\n" );
+  }
+
+  libspectrum_free( dst );
+  libspectrum_free( src );
+}
+
+/* Check that splitting the work between threads doesn't change the output
+   of any scaler */
+int
+scaler_threads_unittest( void )
+{
+  libspectrum_dword *src, *serial_dst, *threaded_dst;
+  const libspectrum_byte *src_start;
+  libspectrum_dword src_pitch = SCALER_TEST_SRC_WIDTH * 4;
+  libspectrum_dword dst_pitch = 4 * SCALER_TEST_WIDTH * 4;
+  size_t dst_size = 4 * SCALER_TEST_WIDTH * 4 * SCALER_TEST_HEIGHT;
+  scaler_type scaler;
+  int r = 0;
+
+  src = libspectrum_new( libspectrum_dword,
+                         SCALER_TEST_SRC_WIDTH * SCALER_TEST_SRC_HEIGHT );
+  serial_dst = libspectrum_new0( libspectrum_dword, dst_size );
+  threaded_dst = libspectrum_new0( libspectrum_dword, dst_size );
+  scaler_test_image( src, SCALER_TEST_SRC_WIDTH, SCALER_TEST_SRC_HEIGHT );
+  src_start = (const libspectrum_byte*)
+    ( src + SCALER_TEST_MARGIN * SCALER_TEST_SRC_WIDTH + SCALER_TEST_MARGIN );
+
+  for( scaler = 0; scaler < SCALER_NUM; scaler++ ) {
+    ScalerProc *proc = scaler_get_proc32( scaler );
+    float factor = scaler_get_scaling_factor( scaler );
+    int serial = scaler_get_flags( scaler ) & SCALER_FLAGS_SERIAL;
+
+    /* An odd height, so the last band is a short one */
+    proc( src_start, src_pitch, (libspectrum_byte*)serial_dst, dst_pitch,
+          SCALER_TEST_WIDTH, SCALER_TEST_HEIGHT - 3 );
+    scaler_run_threads( proc, factor, serial, src_start, src_pitch,
+                        (libspectrum_byte*)threaded_dst, dst_pitch,
+                        SCALER_TEST_WIDTH, SCALER_TEST_HEIGHT - 3, 4 );
+
+    if( memcmp( serial_dst, threaded_dst, dst_size * 4 ) ) {
+      fprintf( stderr, "%s: scaler '%s' differs when run in threads\n",
+               fuse_progname, scaler_name( scaler ) );
+      r++;
+    }
+  }
+
+  libspectrum_free( threaded_dst );
+  libspectrum_free( serial_dst );
+  libspectrum_free( src );
+
+  return r;
+}
@@ -28,6 +28,14 @@
 
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define SCALER_NEON 1
+#endif
+
 #include <libspectrum.h>
 
 #include "scaler.h"
@@ -1912,17 +1920,202 @@ FUNCTION( scaler_PalTV3x )( const libspectrum_byte *srcPtr,
   }
 }
 
+/* The HQ scalers. Rather than comparing each pixel with its neighbours
+   through YUV one at a time, the comparisons are made for a whole strip
+   of up to HQ_STRIP pixels of a row at once, giving for each pixel the
+   8-neighbour pattern which selects the case in scaler_hq?x.c, plus the
+   four comparisons between the edge neighbours which some cases use.
+
+   Each source pixel is converted to YUV just once per strip, rather than
+   once for each of the three rows it is a neighbour of */
+
+#define HQ_STRIP 256
+
+/* Y, U and V for one row of a strip, including the pixel either side */
+typedef struct hq_yuv_row {
+  libspectrum_signed_word y[ HQ_STRIP + 2 ];
+  libspectrum_signed_word u[ HQ_STRIP + 2 ];
+  libspectrum_signed_word v[ HQ_STRIP + 2 ];
+} hq_yuv_row;
+
+/* Bits in the edge comparison mask */
+#define HQ_EDGE_26 ( edges[i] & 0x01 )
+#define HQ_EDGE_68 ( edges[i] & 0x02 )
+#define HQ_EDGE_84 ( edges[i] & 0x04 )
+#define HQ_EDGE_42 ( edges[i] & 0x08 )
+
+static void
+hq_yuv_convert( const scaler_data_type *p, int n, hq_yuv_row *row )
+{
+  libspectrum_byte r, g, b;
+  int i;
+
+  for( i = 0; i < n + 2; i++ ) {
+#if SCALER_DATA_SIZE == 2
+    r = R_TO_R( p[ i - 1 ] );
+    g = G_TO_G( p[ i - 1 ] );
+    b = B_TO_B( p[ i - 1 ] );
+#else
+    r =   p[ i - 1 ] & redMask;
+    g = ( p[ i - 1 ] & greenMask ) >> 8;
+    b = ( p[ i - 1 ] & blueMask  ) >> 16;
+#endif
+    row->y[i] = RGB_TO_Y( r, g, b );
+    row->u[i] = RGB_TO_U( r, g, b );
+    row->v[i] = RGB_TO_V( r, g, b );
+  }
+}
+
+/* Does pixel `a' of row `ra' differ from pixel `b' of row `rb'? */
+#define HQ_ROW_DIFF( ra, a, rb, b ) \
+  HQ_YUVDIFF( (ra)->y[a], (ra)->u[a], (ra)->v[a], \
+              (rb)->y[b], (rb)->u[b], (rb)->v[b] )
+
+#ifdef __SSE2__
+
+/* Lanes set where the eight pixels of row `ra' starting at `a' differ from
+   those of `rb' starting at `b' */
+static inline __m128i
+hq_diff_sse2( const hq_yuv_row *ra, int a, const hq_yuv_row *rb, int b )
+{
+  const __m128i y1 = _mm_loadu_si128( (const __m128i*)( ra->y + a ) );
+  const __m128i u1 = _mm_loadu_si128( (const __m128i*)( ra->u + a ) );
+  const __m128i v1 = _mm_loadu_si128( (const __m128i*)( ra->v + a ) );
+  const __m128i y2 = _mm_loadu_si128( (const __m128i*)( rb->y + b ) );
+  const __m128i u2 = _mm_loadu_si128( (const __m128i*)( rb->u + b ) );
+  const __m128i v2 = _mm_loadu_si128( (const __m128i*)( rb->v + b ) );
+
+  /* No 16-bit abs() before SSSE3, but max( a - b, b - a ) does as well */
+  __m128i dy =
+    _mm_max_epi16( _mm_sub_epi16( y1, y2 ), _mm_sub_epi16( y2, y1 ) );
+  __m128i du =
+    _mm_max_epi16( _mm_sub_epi16( u1, u2 ), _mm_sub_epi16( u2, u1 ) );
+  __m128i dv =
+    _mm_max_epi16( _mm_sub_epi16( v1, v2 ), _mm_sub_epi16( v2, v1 ) );
+
+  return _mm_or_si128(
+    _mm_cmpgt_epi16( dy, _mm_set1_epi16( HQ_trY ) ),
+    _mm_or_si128( _mm_cmpgt_epi16( du, _mm_set1_epi16( HQ_trU ) ),
+                  _mm_cmpgt_epi16( dv, _mm_set1_epi16( HQ_trV ) ) )
+  );
+}
+
+#define HQ_SIMD_BIT( ra, a, rb, b, bit ) \
+  _mm_and_si128( hq_diff_sse2( ra, a, rb, b ), _mm_set1_epi16( bit ) )
+#define HQ_SIMD_OR( x, y ) _mm_or_si128( x, y )
+#define HQ_SIMD_STORE( dest, x ) \
+  _mm_storel_epi64( (__m128i*)( dest ), _mm_packus_epi16( x, x ) )
+typedef __m128i hq_simd_type;
+
+#elif defined( SCALER_NEON )
+
+static inline uint16x8_t
+hq_diff_neon( const hq_yuv_row *ra, int a, const hq_yuv_row *rb, int b )
+{
+  uint16x8_t dy = vcgtq_s16( vabdq_s16( vld1q_s16( ra->y + a ),
+                                        vld1q_s16( rb->y + b ) ),
+                             vdupq_n_s16( HQ_trY ) );
+  uint16x8_t du = vcgtq_s16( vabdq_s16( vld1q_s16( ra->u + a ),
+                                        vld1q_s16( rb->u + b ) ),
+                             vdupq_n_s16( HQ_trU ) );
+  uint16x8_t dv = vcgtq_s16( vabdq_s16( vld1q_s16( ra->v + a ),
+                                        vld1q_s16( rb->v + b ) ),
+                             vdupq_n_s16( HQ_trV ) );
+
+  return vorrq_u16( dy, vorrq_u16( du, dv ) );
+}
+
+#define HQ_SIMD_BIT( ra, a, rb, b, bit ) \
+  vandq_u16( hq_diff_neon( ra, a, rb, b ), vdupq_n_u16( bit ) )
+#define HQ_SIMD_OR( x, y ) vorrq_u16( x, y )
+#define HQ_SIMD_STORE( dest, x ) vst1_u8( dest, vmovn_u16( x ) )
+typedef uint16x8_t hq_simd_type;
+
+#endif				/* #ifdef __SSE2__ */
+
+/* Fill in the neighbour pattern and edge comparison mask for the `n'
+   pixels of `row'. Pixel `i' of the strip is at index `i + 1' in the rows
+   as they start with the pixel to the left of the strip */
+static void
+hq_patterns( const hq_yuv_row *above, const hq_yuv_row *row,
+             const hq_yuv_row *below, int n, libspectrum_byte *patterns,
+             libspectrum_byte *edges )
+{
+  int i = 0;
+
+#ifdef HQ_SIMD_STORE
+
+  for( ; i + 8 <= n; i += 8 ) {
+    hq_simd_type pattern, edge;
+
+    pattern = HQ_SIMD_OR(
+      HQ_SIMD_OR( HQ_SIMD_OR( HQ_SIMD_BIT( row, i + 1, above, i    , 0x01 ),
+                              HQ_SIMD_BIT( row, i + 1, above, i + 1, 0x02 ) ),
+                  HQ_SIMD_OR( HQ_SIMD_BIT( row, i + 1, above, i + 2, 0x04 ),
+                              HQ_SIMD_BIT( row, i + 1, row,   i    , 0x08 ) ) ),
+      HQ_SIMD_OR( HQ_SIMD_OR( HQ_SIMD_BIT( row, i + 1, row,   i + 2, 0x10 ),
+                              HQ_SIMD_BIT( row, i + 1, below, i    , 0x20 ) ),
+                  HQ_SIMD_OR( HQ_SIMD_BIT( row, i + 1, below, i + 1, 0x40 ),
+                              HQ_SIMD_BIT( row, i + 1, below, i + 2, 0x80 ) ) )
+    );
+
+    edge = HQ_SIMD_OR(
+      HQ_SIMD_OR( HQ_SIMD_BIT( above, i + 1, row,   i + 2, 0x01 ),
+                  HQ_SIMD_BIT( row,   i + 2, below, i + 1, 0x02 ) ),
+      HQ_SIMD_OR( HQ_SIMD_BIT( below, i + 1, row,   i    , 0x04 ),
+                  HQ_SIMD_BIT( row,   i    , above, i + 1, 0x08 ) )
+    );
+
+    HQ_SIMD_STORE( patterns + i, pattern );
+    HQ_SIMD_STORE( edges + i, edge );
+  }
+
+#endif				/* #ifdef HQ_SIMD_STORE */
+
+  for( ; i < n; i++ ) {
+    int pattern = 0, edge = 0;
+
+    if( HQ_ROW_DIFF( row, i + 1, above, i     ) ) pattern |= 0x01;
+    if( HQ_ROW_DIFF( row, i + 1, above, i + 1 ) ) pattern |= 0x02;
+    if( HQ_ROW_DIFF( row, i + 1, above, i + 2 ) ) pattern |= 0x04;
+    if( HQ_ROW_DIFF( row, i + 1, row,   i     ) ) pattern |= 0x08;
+    if( HQ_ROW_DIFF( row, i + 1, row,   i + 2 ) ) pattern |= 0x10;
+    if( HQ_ROW_DIFF( row, i + 1, below, i     ) ) pattern |= 0x20;
+    if( HQ_ROW_DIFF( row, i + 1, below, i + 1 ) ) pattern |= 0x40;
+    if( HQ_ROW_DIFF( row, i + 1, below, i + 2 ) ) pattern |= 0x80;
+
+    if( HQ_ROW_DIFF( above, i + 1, row,   i + 2 ) ) edge |= 0x01;
+    if( HQ_ROW_DIFF( row,   i + 2, below, i + 1 ) ) edge |= 0x02;
+    if( HQ_ROW_DIFF( below, i + 1, row,   i     ) ) edge |= 0x04;
+    if( HQ_ROW_DIFF( row,   i,     above, i + 1 ) ) edge |= 0x08;
+
+    patterns[i] = pattern;
+    edges[i] = edge;
+  }
+}
+
 #define prevline (-nextlineSrc)
 #define nextline nextlineSrc
-#define MOVE_B_TO_A(A,B) \
-		w[A] = w[B]; y[A] = y[B]; u[A] = u[B]; v[A] = v[B];
-#define MOVE_P_RIGHT \
-	MOVE_B_TO_A(1,2) \
-	MOVE_B_TO_A(4,5) \
-	MOVE_B_TO_A(7,8) \
-	MOVE_B_TO_A(2,3) \
-	MOVE_B_TO_A(5,6) \
-	MOVE_B_TO_A(8,9)
+
+/* Load the 3x3 block of pixels around `p' */
+#define HQ_LOAD_W \
+	w[1] = *(p + prevline - 1); \
+	w[2] = *(p + prevline); \
+	w[3] = *(p + prevline + 1); \
+	w[4] = *(p - 1); \
+	w[5] = *p; \
+	w[6] = *(p + 1); \
+	w[7] = *(p + nextline - 1); \
+	w[8] = *(p + nextline); \
+	w[9] = *(p + nextline + 1);
+
+/* Move the block one pixel right, `p' having already been incremented */
+#define HQ_MOVE_W_RIGHT \
+	w[1] = w[2]; w[4] = w[5]; w[7] = w[8]; \
+	w[2] = w[3]; w[5] = w[6]; w[8] = w[9]; \
+	w[3] = *(p + prevline + 1); \
+	w[6] = *(p + 1); \
+	w[9] = *(p + nextline + 1);
 
 void
 FUNCTION( scaler_HQ2x ) ( const libspectrum_byte *srcPtr,
@@ -1931,15 +2124,14 @@ FUNCTION( scaler_HQ2x ) ( const libspectrum_byte *srcPtr,
                           libspectrum_dword dstPitch,
                           int width, int height )
 {
-  int i, j, k, pattern;
+  int i, j, x, n, pattern;
   int nextlineSrc = srcPitch / sizeof( scaler_data_type );
   const scaler_data_type *p, *p0 = (const scaler_data_type *)srcPtr;
   int nextlineDst = dstPitch / sizeof( scaler_data_type );
   scaler_data_type *q, *q1, *qN, *qN1, *q0 = (scaler_data_type *)dstPtr;
   libspectrum_qword w[10];
-  
-  libspectrum_byte  r, g, b;
-  libspectrum_signed_dword y[10], u[10], v[10];
+  hq_yuv_row rows[3], *above, *row, *below, *next;
+  libspectrum_byte patterns[ HQ_STRIP ], edges[ HQ_STRIP ];
 
   /*   +----+----+----+
        |    |    |    |
@@ -1951,71 +2143,38 @@ FUNCTION( scaler_HQ2x ) ( const libspectrum_byte *srcPtr,
        |    |    |    |
        | w7 | w8 | w9 |
        +----+----+----+ */
-  for( j = 0; j < height; j++ ) {
-    p = p0;
-    q = q0; q1 = q + 1;
-    qN = q + nextlineDst; qN1 = qN + 1;
-    w[2] = *(p + prevline);
-    w[5] = *p;
-    w[8] = *(p + nextline);
-    w[1] = *(p + prevline - 1);
-    w[4] = *(p - 1);
-    w[7] = *(p + nextline - 1);
-    w[3] = *(p + prevline + 1);
-    w[6] = *(p + 1);
-    w[9] = *(p + nextline + 1);
-    for( k = 1; k <= 9; k++ ) {
-#if SCALER_DATA_SIZE == 2
-      r = R_TO_R( w[k] );
-      g = G_TO_G( w[k] );
-      b = B_TO_B( w[k] );
-#else
-      r =  w[k] & redMask;
-      g = (w[k] & greenMask) >> 8;
-      b = (w[k] & blueMask) >> 16;
-#endif
-      y[k] = RGB_TO_Y( r, g, b );
-      u[k] = RGB_TO_U( r, g, b );
-      v[k] = RGB_TO_V( r, g, b );
-    }
 
-    for( i = 0; i < width; i++ ) {
-      pattern = 0;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[1], u[1], v[1] ) ) pattern |= 0x01;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[2], u[2], v[2] ) ) pattern |= 0x02;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[3], u[3], v[3] ) ) pattern |= 0x04;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[4], u[4], v[4] ) ) pattern |= 0x08;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[6], u[6], v[6] ) ) pattern |= 0x10;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[7], u[7], v[7] ) ) pattern |= 0x20;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[8], u[8], v[8] ) ) pattern |= 0x40;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[9], u[9], v[9] ) ) pattern |= 0x80;
+  for( x = 0; x < width; x += HQ_STRIP ) {
+    n = MIN( width - x, HQ_STRIP );
+
+    above = &rows[0]; row = &rows[1]; below = &rows[2];
+    hq_yuv_convert( p0 + x + prevline, n, above );
+    hq_yuv_convert( p0 + x, n, row );
+
+    for( j = 0; j < height; j++ ) {
+      p = p0 + j * nextlineSrc + x;
+      q = q0 + j * ( nextlineDst << 1 ) + x * 2;
+      q1 = q + 1;
+      qN = q + nextlineDst; qN1 = qN + 1;
+
+      hq_yuv_convert( p + nextline, n, below );
+      hq_patterns( above, row, below, n, patterns, edges );
+
+      HQ_LOAD_W
+      for( i = 0; i < n; i++ ) {
+        pattern = patterns[i];
 
 #include "scaler_hq2x.c"
 
-      p++;
-      q  += 2; q1  += 2;
-      qN += 2; qN1 += 2;
-      MOVE_P_RIGHT
-      w[3] = *(p + prevline + 1);
-      w[6] = *(p + 1);
-      w[9] = *(p + nextline + 1);
-      for( k = 3; k <= 9; k += 3 ) {
-#if SCALER_DATA_SIZE == 2
-        r = R_TO_R( w[k] );
-        g = G_TO_G( w[k] );
-        b = B_TO_B( w[k] );
-#else
-        r =   w[k] & redMask;
-        g = ( w[k] & greenMask ) >> 8;
-        b = ( w[k] & blueMask  ) >> 16;
-#endif
-        y[k] = RGB_TO_Y( r, g, b );
-        u[k] = RGB_TO_U( r, g, b );
-        v[k] = RGB_TO_V( r, g, b );
+        p++;
+        q  += 2; q1  += 2;
+        qN += 2; qN1 += 2;
+        HQ_MOVE_W_RIGHT
       }
+
+      /* Move down a row, reusing the YUV values we already have */
+      next = above; above = row; row = below; below = next;
     }
-    p0 += nextlineSrc;
-    q0 += nextlineDst << 1;
   }
 }
 
@@ -2026,96 +2185,49 @@ FUNCTION( scaler_HQ3x ) ( const libspectrum_byte *srcPtr,
                           libspectrum_dword dstPitch,
                           int width, int height )
 {
-  int i, j, k, pattern;
+  int i, j, x, n, pattern;
   int nextlineSrc = srcPitch / sizeof( scaler_data_type );
   const scaler_data_type *p, *p0 = (const scaler_data_type *)srcPtr;
   int nextlineDst = dstPitch / sizeof( scaler_data_type );
-  scaler_data_type *q, *qN, *qNN, *q1, *qN1, *qNN1, *q2, *qN2, *qNN2, 
+  scaler_data_type *q, *qN, *qNN, *q1, *qN1, *qNN1, *q2, *qN2, *qNN2,
 		   *q0 = (scaler_data_type *)dstPtr;
   libspectrum_qword w[10];
-  
-  libspectrum_byte  r, g, b;
-  libspectrum_signed_dword y[10], u[10], v[10];
+  hq_yuv_row rows[3], *above, *row, *below, *next;
+  libspectrum_byte patterns[ HQ_STRIP ], edges[ HQ_STRIP ];
 
-  /*   +----+----+----+
-       |    |    |    |
-       | w1 | w2 | w3 |
-       +----+----+----+
-       |    |    |    |
-       | w4 | w5 | w6 |
-       +----+----+----+
-       |    |    |    |
-       | w7 | w8 | w9 |
-       +----+----+----+ */
-  for( j = 0; j < height; j++ ) {
-    p = p0;
-    q = q0;
-    q1 = q + 1; q2 = q + 2;
-    qN = q + nextlineDst; qN1 = qN + 1; qN2 = qN + 2;
-    qNN = qN + nextlineDst;  qNN1 = qNN + 1; qNN2 = qNN + 2;
-
-    w[2] = *(p + prevline);
-    w[5] = *p;
-    w[8] = *(p + nextline);
-    w[1] = *(p + prevline - 1);
-    w[4] = *(p - 1);
-    w[7] = *(p + nextline - 1);
-    w[3] = *(p + prevline + 1);
-    w[6] = *(p + 1);
-    w[9] = *(p + nextline + 1);
-    for( k = 1; k <= 9; k++ ) {
-#if SCALER_DATA_SIZE == 2
-      r = R_TO_R( w[k] );
-      g = G_TO_G( w[k] );
-      b = B_TO_B( w[k] );
-#else
-      r =  w[k] & redMask;
-      g = (w[k] & greenMask) >> 8;
-      b = (w[k] & blueMask) >> 16;
-#endif
-      y[k] = RGB_TO_Y( r, g, b );
-      u[k] = RGB_TO_U( r, g, b );
-      v[k] = RGB_TO_V( r, g, b );
-    }
+  for( x = 0; x < width; x += HQ_STRIP ) {
+    n = MIN( width - x, HQ_STRIP );
+
+    above = &rows[0]; row = &rows[1]; below = &rows[2];
+    hq_yuv_convert( p0 + x + prevline, n, above );
+    hq_yuv_convert( p0 + x, n, row );
 
-    for( i = 0; i < width; i++ ) {
-      pattern = 0;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[1], u[1], v[1] ) ) pattern |= 0x01;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[2], u[2], v[2] ) ) pattern |= 0x02;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[3], u[3], v[3] ) ) pattern |= 0x04;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[4], u[4], v[4] ) ) pattern |= 0x08;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[6], u[6], v[6] ) ) pattern |= 0x10;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[7], u[7], v[7] ) ) pattern |= 0x20;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[8], u[8], v[8] ) ) pattern |= 0x40;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[9], u[9], v[9] ) ) pattern |= 0x80;
+    for( j = 0; j < height; j++ ) {
+      p = p0 + j * nextlineSrc + x;
+      q = q0 + j * ( ( nextlineDst << 1 ) + nextlineDst ) + x * 3;
+      q1 = q + 1; q2 = q + 2;
+      qN = q + nextlineDst; qN1 = qN + 1; qN2 = qN + 2;
+      qNN = qN + nextlineDst; qNN1 = qNN + 1; qNN2 = qNN + 2;
+
+      hq_yuv_convert( p + nextline, n, below );
+      hq_patterns( above, row, below, n, patterns, edges );
+
+      HQ_LOAD_W
+      for( i = 0; i < n; i++ ) {
+        pattern = patterns[i];
 
 #include "scaler_hq3x.c"
 
-      p++;
-      q   += 3; q1   += 3; q2   += 3;
-      qN  += 3; qN1  += 3; qN2  += 3;
-      qNN += 3; qNN1 += 3; qNN2 += 3;
-      MOVE_P_RIGHT
-      w[3] = *(p + prevline + 1);
-      w[6] = *(p + 1);
-      w[9] = *(p + nextline + 1);
-      for( k = 3; k <= 9; k += 3 ) {
-#if SCALER_DATA_SIZE == 2
-        r = R_TO_R( w[k] );
-        g = G_TO_G( w[k] );
-        b = B_TO_B( w[k] );
-#else
-        r =   w[k] & redMask;
-        g = ( w[k] & greenMask ) >> 8;
-        b = ( w[k] & blueMask  ) >> 16;
-#endif
-        y[k] = RGB_TO_Y( r, g, b );
-        u[k] = RGB_TO_U( r, g, b );
-        v[k] = RGB_TO_V( r, g, b );
+        p++;
+        q   += 3; q1   += 3; q2   += 3;
+        qN  += 3; qN1  += 3; qN2  += 3;
+        qNN += 3; qNN1 += 3; qNN2 += 3;
+        HQ_MOVE_W_RIGHT
       }
+
+      /* Move down a row, reusing the YUV values we already have */
+      next = above; above = row; row = below; below = next;
     }
-    p0 += nextlineSrc;
-    q0 += ( nextlineDst << 1 ) + nextlineDst;
   }
 }
 
@@ -2126,7 +2238,7 @@ FUNCTION( scaler_HQ4x ) ( const libspectrum_byte *srcPtr,
                           libspectrum_dword dstPitch,
                           int width, int height )
 {
-  int i, j, k, pattern;
+  int i, j, x, n, pattern;
   int nextlineSrc = srcPitch / sizeof( scaler_data_type );
   const scaler_data_type *p, *p0 = (const scaler_data_type *)srcPtr;
   int nextlineDst = dstPitch / sizeof( scaler_data_type );
@@ -2136,90 +2248,44 @@ FUNCTION( scaler_HQ4x ) ( const libspectrum_byte *srcPtr,
                    *q3, *qN3, *qNN3, *qNNN3,
                    *q0 = (scaler_data_type *)dstPtr;
   libspectrum_qword w[10];
+  hq_yuv_row rows[3], *above, *row, *below, *next;
+  libspectrum_byte patterns[ HQ_STRIP ], edges[ HQ_STRIP ];
 
-  libspectrum_byte  r, g, b;
-  libspectrum_signed_dword y[10], u[10], v[10];
+  for( x = 0; x < width; x += HQ_STRIP ) {
+    n = MIN( width - x, HQ_STRIP );
 
-  /*   +----+----+----+
-       |    |    |    |
-       | w1 | w2 | w3 |
-       +----+----+----+
-       |    |    |    |
-       | w4 | w5 | w6 |
-       +----+----+----+
-       |    |    |    |
-       | w7 | w8 | w9 |
-       +----+----+----+ */
-  for( j = 0; j < height; j++ ) {
-    p = p0;
-    q = q0;
-    q1 = q + 1; q2 = q + 2; q3 = q + 3;
-    qN = q + nextlineDst; qN1 = qN + 1; qN2 = qN + 2; qN3 = qN + 3;
-    qNN = qN + nextlineDst; qNN1 = qNN + 1; qNN2 = qNN + 2; qNN3 = qNN + 3;
-    qNNN = qNN + nextlineDst; qNNN1 = qNNN + 1; qNNN2 = qNNN + 2; qNNN3 = qNNN + 3;
-
-    w[2] = *(p + prevline);
-    w[5] = *p;
-    w[8] = *(p + nextline);
-    w[1] = *(p + prevline - 1);
-    w[4] = *(p - 1);
-    w[7] = *(p + nextline - 1);
-    w[3] = *(p + prevline + 1);
-    w[6] = *(p + 1);
-    w[9] = *(p + nextline + 1);
-    for( k = 1; k <= 9; k++ ) {
-#if SCALER_DATA_SIZE == 2
-      r = R_TO_R( w[k] );
-      g = G_TO_G( w[k] );
-      b = B_TO_B( w[k] );
-#else
-      r =  w[k] & redMask;
-      g = (w[k] & greenMask) >> 8;
-      b = (w[k] & blueMask) >> 16;
-#endif
-      y[k] = RGB_TO_Y( r, g, b );
-      u[k] = RGB_TO_U( r, g, b );
-      v[k] = RGB_TO_V( r, g, b );
-    }
+    above = &rows[0]; row = &rows[1]; below = &rows[2];
+    hq_yuv_convert( p0 + x + prevline, n, above );
+    hq_yuv_convert( p0 + x, n, row );
+
+    for( j = 0; j < height; j++ ) {
+      p = p0 + j * nextlineSrc + x;
+      q = q0 + j * ( nextlineDst << 2 ) + x * 4;
+      q1 = q + 1; q2 = q + 2; q3 = q + 3;
+      qN = q + nextlineDst; qN1 = qN + 1; qN2 = qN + 2; qN3 = qN + 3;
+      qNN = qN + nextlineDst; qNN1 = qNN + 1; qNN2 = qNN + 2; qNN3 = qNN + 3;
+      qNNN = qNN + nextlineDst; qNNN1 = qNNN + 1; qNNN2 = qNNN + 2;
+      qNNN3 = qNNN + 3;
+
+      hq_yuv_convert( p + nextline, n, below );
+      hq_patterns( above, row, below, n, patterns, edges );
 
-    for( i = 0; i < width; i++ ) {
-      pattern = 0;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[1], u[1], v[1] ) ) pattern |= 0x01;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[2], u[2], v[2] ) ) pattern |= 0x02;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[3], u[3], v[3] ) ) pattern |= 0x04;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[4], u[4], v[4] ) ) pattern |= 0x08;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[6], u[6], v[6] ) ) pattern |= 0x10;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[7], u[7], v[7] ) ) pattern |= 0x20;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[8], u[8], v[8] ) ) pattern |= 0x40;
-      if( HQ_YUVDIFF( y[5], u[5], v[5], y[9], u[9], v[9] ) ) pattern |= 0x80;
+      HQ_LOAD_W
+      for( i = 0; i < n; i++ ) {
+        pattern = patterns[i];
 
 #include "scaler_hq4x.c"
 
-      p++;
-      q    += 4; q1    += 4; q2    += 4; q3    += 4;
-      qN   += 4; qN1   += 4; qN2   += 4; qN3   += 4;
-      qNN  += 4; qNN1  += 4; qNN2  += 4; qNN3  += 4;
-      qNNN += 4; qNNN1 += 4; qNNN2 += 4; qNNN3 += 4;
-      MOVE_P_RIGHT
-      w[3] = *(p + prevline + 1);
-      w[6] = *(p + 1);
-      w[9] = *(p + nextline + 1);
-      for( k = 3; k <= 9; k += 3 ) {
-#if SCALER_DATA_SIZE == 2
-        r = R_TO_R( w[k] );
-        g = G_TO_G( w[k] );
-        b = B_TO_B( w[k] );
-#else
-        r =   w[k] & redMask;
-        g = ( w[k] & greenMask ) >> 8;
-        b = ( w[k] & blueMask  ) >> 16;
-#endif
-        y[k] = RGB_TO_Y( r, g, b );
-        u[k] = RGB_TO_U( r, g, b );
-        v[k] = RGB_TO_V( r, g, b );
+        p++;
+        q    += 4; q1    += 4; q2    += 4; q3    += 4;
+        qN   += 4; qN1   += 4; qN2   += 4; qN3   += 4;
+        qNN  += 4; qNN1  += 4; qNN2  += 4; qNN3  += 4;
+        qNNN += 4; qNNN1 += 4; qNNN2 += 4; qNNN3 += 4;
+        HQ_MOVE_W_RIGHT
       }
+
+      /* Move down a row, reusing the YUV values we already have */
+      next = above; above = row; row = below; below = next;
     }
-    p0 += nextlineSrc;
-    q0 += ( nextlineDst << 2 );
   }
 }
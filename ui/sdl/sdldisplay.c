@@ -344,6 +344,17 @@ static int image_height;
 
 static int timex;
 
+/* When the scaler just multiplies pixels up (Normal, 2x, 3x) and nothing
+   else needs the unscaled image, the Spectrum display is drawn straight
+   onto sdldisplay_gc at its final size rather than into tmp_screen and
+   then copied across. tmp_screen is only brought up to date when
+   something (the widget UI, the virtual keyboard) needs it */
+static int sdldisplay_direct = 0;
+static int sdldisplay_direct_scale = 1;
+
+/* Have we locked sdldisplay_gc to draw straight onto it? */
+static int sdldisplay_direct_locked = 0;
+
 static void init_scalers( void );
 static int sdldisplay_allocate_colours( int numColours, Uint32 *colour_values,
                                         Uint32 *bw_values );
@@ -885,6 +896,152 @@ sdldisplay_find_best_fullscreen_scaler( void )
   }
 }
 
+/* Can we currently draw the display straight onto sdldisplay_gc? */
+static int
+sdldisplay_direct_possible( void )
+{
+  int scale = sdldisplay_current_size;
+
+  switch( current_scaler ) {
+  case SCALER_NORMAL:
+  case SCALER_DOUBLESIZE:
+  case SCALER_TRIPLESIZE:
+  case SCALER_TIMEX2X:
+    break;
+  default:
+    return 0;
+  }
+
+  if( ( timex ? 2 : 1 ) * scale > UIDISPLAY_MAX_EXPAND ) return 0;
+
+  if( !sdldisplay_gc || sdldisplay_gc->format->BytesPerPixel != 2 )
+    return 0;
+
+  /* The widget UI and the virtual keyboard draw over tmp_screen */
+  if( ui_widget_level >= 0 ) return 0;
+#if VKEYBOARD
+  if( vkeyboard_enabled ) return 0;
+#endif
+
+#ifdef MIYOO
+  /* Anything other than the full border is stretched from tmp_screen */
+  if( settings_current.od_fullscreen ||
+      strncmp( settings_current.od_border, "Full", 4 ) )
+    return 0;
+#elif defined( GCWZERO )
+  /* As is any other border, and the status line is drawn over it */
+  if( sdldisplay_current_od_border != Full || settings_current.statusbar )
+    return 0;
+#endif
+
+#ifdef GCWZERO
+  /* We'd only be drawing into one of the buffers */
+  if( sdldisplay_is_triple_buffer ) return 0;
+#endif
+
+  return 1;
+}
+
+/* Lock sdldisplay_gc, if it needs it, before drawing straight onto it.
+   It stays locked until the end of the frame */
+static void
+sdldisplay_direct_lock( void )
+{
+  if( sdldisplay_direct_locked || !SDL_MUSTLOCK( sdldisplay_gc ) ) return;
+
+  SDL_LockSurface( sdldisplay_gc );
+  sdldisplay_direct_locked = 1;
+}
+
+static void
+sdldisplay_direct_unlock( void )
+{
+  if( !sdldisplay_direct_locked ) return;
+
+  SDL_UnlockSurface( sdldisplay_gc );
+  sdldisplay_direct_locked = 0;
+}
+
+/* Where pixel ( x, y ) of the unscaled image is in whichever surface we are
+   currently drawing into, and that surface's pitch in pixels */
+static libspectrum_word*
+sdldisplay_pixel_address( int x, int y, int *pitch )
+{
+  if( sdldisplay_direct ) {
+    int scale = sdldisplay_direct_scale;
+
+    sdldisplay_direct_lock();
+
+    *pitch = sdldisplay_gc->pitch / sizeof( libspectrum_word );
+    return (libspectrum_word*)sdldisplay_gc->pixels +
+      ( y * scale + fullscreen_y_off ) * *pitch + x * scale + fullscreen_x_off;
+  }
+
+  *pitch = tmp_screen->pitch / sizeof( libspectrum_word );
+  return (libspectrum_word*)tmp_screen->pixels + ( y + 1 ) * *pitch + x + 1;
+}
+
+/* Bring the `w' by `h' area of tmp_screen at ( x, y ) of the unscaled image
+   up to date from sdldisplay_gc. As each pixel of the image was drawn as a
+   block of identical pixels, we need only take the top left one of each */
+static void
+sdldisplay_direct_to_tmp_screen( int x, int y, int w, int h )
+{
+  int i, j, gc_pitch, tmp_pitch;
+  int scale = sdldisplay_direct_scale;
+
+  sdldisplay_direct_lock();
+
+  gc_pitch = sdldisplay_gc->pitch / sizeof( libspectrum_word );
+  tmp_pitch = tmp_screen->pitch / sizeof( libspectrum_word );
+
+  for( j = y; j < y + h; j++ ) {
+    const libspectrum_word *src = (libspectrum_word*)sdldisplay_gc->pixels +
+      ( j * scale + fullscreen_y_off ) * gc_pitch + x * scale +
+      fullscreen_x_off;
+    libspectrum_word *dest =
+      (libspectrum_word*)tmp_screen->pixels + ( j + 1 ) * tmp_pitch + x + 1;
+
+    for( i = 0; i < w; i++ )
+      dest[i] = src[ i * scale ];
+  }
+}
+
+/* Stop drawing straight onto sdldisplay_gc, first bringing tmp_screen up to
+   date */
+static void
+sdldisplay_end_direct( void )
+{
+  if( !sdldisplay_direct ) return;
+
+  sdldisplay_direct_to_tmp_screen( 0, 0, image_width, image_height );
+  sdldisplay_direct_unlock();
+
+  sdldisplay_direct = 0;
+  sdldisplay_force_full_refresh = 1;
+}
+
+/* Switch between drawing into tmp_screen and straight onto sdldisplay_gc
+   if things have changed so that we should */
+static void
+sdldisplay_update_direct( void )
+{
+  int direct = sdldisplay_direct_possible();
+
+  if( direct == sdldisplay_direct ) return;
+
+  if( direct ) {
+    sdldisplay_direct = 1;
+    sdldisplay_direct_scale = sdldisplay_current_size;
+    sdldisplay_force_full_refresh = 1;
+
+    /* Nothing has been drawn onto sdldisplay_gc yet */
+    display_refresh_all();
+  } else {
+    sdldisplay_end_direct();
+  }
+}
+
 static int
 sdldisplay_load_gfx_mode( void )
 {
@@ -892,6 +1049,9 @@ sdldisplay_load_gfx_mode( void )
 
   sdldisplay_force_full_refresh = 1;
 
+  /* sdldisplay_gc is about to be replaced */
+  sdldisplay_direct_unlock();
+
   /* Free the old surface */
   if( tmp_screen ) {
     free( tmp_screen->pixels );
@@ -1104,6 +1264,9 @@ sdldisplay_load_gfx_mode( void )
   sdldisplay_allocate_colours_alpha( 16, colour_values_a, bw_values_a );
 #endif
 
+  sdldisplay_direct = sdldisplay_direct_possible();
+  sdldisplay_direct_scale = sdldisplay_current_size;
+
   /* Redraw the entire screen... */
   display_refresh_all();
 
@@ -1115,7 +1278,10 @@ void uidisplay_fullscreen (void)
 {
   if(!settings_current.od_fullscreen && strncmp(settings_current.od_border,"Full", 4 ) == 0)  
   {
-    SDL_BlitSurface(tmp_screen, NULL, sdldisplay_gc, NULL);
+    /* Skip tmp_screen's margin, so the image lines up with the one drawn
+       straight onto sdldisplay_gc */
+    SDL_Rect image = { 1, 1, image_width, image_height };
+    SDL_BlitSurface(tmp_screen, &image, sdldisplay_gc, NULL);
   } 
   else 
   {
@@ -1236,6 +1402,9 @@ uidisplay_frame_save( void )
     saved = NULL;
   }
 
+  /* The widget UI is about to draw into tmp_screen */
+  sdldisplay_end_direct();
+
   saved = SDL_ConvertSurface( tmp_screen, tmp_screen->format,
                               SDL_SWSURFACE );
 }
@@ -1270,6 +1439,11 @@ sdl_blit_icon( SDL_Surface **icon,
   r->x++;
   r->y++;
 
+  /* tmp_screen isn't kept up to date when drawing straight onto
+     sdldisplay_gc, but will show through any transparent parts of the
+     icon */
+  if( sdldisplay_direct ) sdldisplay_direct_to_tmp_screen( x, y, w, h );
+
   if( SDL_BlitSurface( icon[timex], NULL, tmp_screen, r ) ) return;
 
   /* Extend the dirty region by 1 pixel for scalers
@@ -1281,8 +1455,11 @@ sdl_blit_icon( SDL_Surface **icon,
   dst_h = h;
   dst_x = x * sdldisplay_current_size + fullscreen_x_off;
 
-#ifndef MIYOO
-  scaler_proc16(
+#ifdef MIYOO
+  /* Otherwise uidisplay_fullscreen() copies all of tmp_screen across */
+  if( sdldisplay_direct )
+#endif
+  scaler_run16(
 	(libspectrum_byte*)tmp_screen->pixels +
 			(x+1) * tmp_screen->format->BytesPerPixel +
 	                (y+1) * tmp_screen_pitch,
@@ -1292,7 +1469,6 @@ sdl_blit_icon( SDL_Surface **icon,
 			dst_y * dstPitch,
 	dstPitch, w, dst_h
   );
-#endif  
   
   if( num_rects == MAX_UPDATE_RECT ) {
     sdldisplay_force_full_refresh = 1;
@@ -1468,7 +1644,8 @@ sdl_icon_overlay( Uint32 tmp_screen_pitch, Uint32 dstPitch )
 void
 uidisplay_putpixel( int x, int y, int colour )
 {
-  libspectrum_word *dest_base, *dest;
+  libspectrum_word *dest;
+  int pitch, size, i, j;
 
 #if defined(VKEYBOARD) || defined(GCWZERO)
   if ( overlay_alpha_surface ) {
@@ -1485,25 +1662,17 @@ uidisplay_putpixel( int x, int y, int colour )
 
   if( machine_current->timex ) {
     x <<= 1; y <<= 1;
-    dest_base = dest =
-      (libspectrum_word*)( (libspectrum_byte*)tmp_screen->pixels +
-                           (x+1) * tmp_screen->format->BytesPerPixel +
-                           (y+1) * tmp_screen->pitch);
-
-    *(dest++) = palette_colour;
-    *(dest++) = palette_colour;
-    dest = (libspectrum_word*)
-      ( (libspectrum_byte*)dest_base + tmp_screen->pitch);
-    *(dest++) = palette_colour;
-    *(dest++) = palette_colour;
+    size = 2;
   } else {
-    dest =
-      (libspectrum_word*)( (libspectrum_byte*)tmp_screen->pixels +
-                           (x+1) * tmp_screen->format->BytesPerPixel +
-                           (y+1) * tmp_screen->pitch);
-
-    *dest = palette_colour;
+    size = 1;
   }
+
+  dest = sdldisplay_pixel_address( x, y, &pitch );
+  if( sdldisplay_direct ) size *= sdldisplay_direct_scale;
+
+  for( i = 0; i < size; i++, dest += pitch )
+    for( j = 0; j < size; j++ )
+      dest[j] = palette_colour;
 }
 
 #if defined(VKEYBOARD) || defined(GCWZERO)
@@ -1703,114 +1872,53 @@ uidisplay_vkeyboard_end( void ) {
 }
 #endif /* VKEYBOARD */
 
-/* Print the 8 pixels in `data' using ink colour `ink' and paper
-   colour `paper' to the screen at ( (8*x) , y ) */
-void
-uidisplay_plot8( int x, int y, libspectrum_byte data,
-	         libspectrum_byte ink, libspectrum_byte paper )
+/* Draw `count' chunks into tmp_screen, or straight onto sdldisplay_gc,
+   starting at pixel ( x, y ) of the unscaled image */
+static void
+sdldisplay_plot_run( int x, int y, int count, const libspectrum_byte *data,
+                     const libspectrum_byte *ink,
+                     const libspectrum_byte *paper, int hires )
 {
-  libspectrum_word *dest;
   Uint32 *palette_values = settings_current.bw_tv ? bw_values :
                            colour_values;
+  libspectrum_word palette[16], *dest;
+  int i, pitch;
 
-  Uint32 palette_ink = palette_values[ ink ];
-  Uint32 palette_paper = palette_values[ paper ];
+  for( i = 0; i < 16; i++ ) palette[i] = palette_values[i];
 
-  if( machine_current->timex ) {
-    int i;
-    libspectrum_word *dest_base;
+  dest = sdldisplay_pixel_address( x, y, &pitch );
 
-    x <<= 4; y <<= 1;
+  uidisplay_plot_run16_scaled( dest, pitch, palette, count, data, ink, paper,
+                               hires,
+                               sdldisplay_direct ? sdldisplay_direct_scale : 1 );
+}
 
-    dest_base =
-      (libspectrum_word*)( (libspectrum_byte*)tmp_screen->pixels +
-                           (x+1) * tmp_screen->format->BytesPerPixel +
-                           (y+1) * tmp_screen->pitch);
-
-    for( i=0; i<2; i++ ) {
-      dest = dest_base;
-
-      *(dest++) = ( data & 0x80 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x80 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x40 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x40 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x20 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x20 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x10 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x10 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x08 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x08 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x04 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x04 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x02 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x02 ) ? palette_ink : palette_paper;
-      *(dest++) = ( data & 0x01 ) ? palette_ink : palette_paper;
-      *dest     = ( data & 0x01 ) ? palette_ink : palette_paper;
-
-      dest_base = (libspectrum_word*)
-        ( (libspectrum_byte*)dest_base + tmp_screen->pitch);
-    }
+/* Print the `count' chunks of 8 pixels in `data' starting at
+   ( (8*x) , y ) */
+void
+uidisplay_plot8_run( int x, int y, int count, const libspectrum_byte *data,
+                     const libspectrum_byte *ink,
+                     const libspectrum_byte *paper )
+{
+  if( machine_current->timex ) {
+    x <<= 4; y <<= 1;
   } else {
     x <<= 3;
-
-    dest =
-      (libspectrum_word*)( (libspectrum_byte*)tmp_screen->pixels +
-                           (x+1) * tmp_screen->format->BytesPerPixel +
-                           (y+1) * tmp_screen->pitch);
-
-    *(dest++) = ( data & 0x80 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x40 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x20 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x10 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x08 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x04 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x02 ) ? palette_ink : palette_paper;
-    *dest     = ( data & 0x01 ) ? palette_ink : palette_paper;
   }
+
+  sdldisplay_plot_run( x, y, count, data, ink, paper, 0 );
 }
 
-/* Print the 16 pixels in `data' using ink colour `ink' and paper
-   colour `paper' to the screen at ( (16*x) , y ) */
+/* Print the `count' chunks of 16 pixels in `data' starting at
+   ( (16*x) , y ) */
 void
-uidisplay_plot16( int x, int y, libspectrum_word data,
-		  libspectrum_byte ink, libspectrum_byte paper )
+uidisplay_plot16_run( int x, int y, int count, const libspectrum_byte *data,
+                      const libspectrum_byte *ink,
+                      const libspectrum_byte *paper )
 {
-  libspectrum_word *dest_base, *dest;
-  int i;
-  Uint32 *palette_values = settings_current.bw_tv ? bw_values :
-                           colour_values;
-  Uint32 palette_ink = palette_values[ ink ];
-  Uint32 palette_paper = palette_values[ paper ];
   x <<= 4; y <<= 1;
 
-  dest_base =
-    (libspectrum_word*)( (libspectrum_byte*)tmp_screen->pixels +
-                         (x+1) * tmp_screen->format->BytesPerPixel +
-                         (y+1) * tmp_screen->pitch);
-
-  for( i=0; i<2; i++ ) {
-    dest = dest_base;
-
-    *(dest++) = ( data & 0x8000 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x4000 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x2000 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x1000 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0800 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0400 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0200 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0100 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0080 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0040 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0020 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0010 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0008 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0004 ) ? palette_ink : palette_paper;
-    *(dest++) = ( data & 0x0002 ) ? palette_ink : palette_paper;
-    *dest     = ( data & 0x0001 ) ? palette_ink : palette_paper;
-
-    dest_base = (libspectrum_word*)
-      ( (libspectrum_byte*)dest_base + tmp_screen->pitch);
-  }
+  sdldisplay_plot_run( x, y, count, data, ink, paper, 1 );
 }
 
 void
@@ -1840,6 +1948,8 @@ uidisplay_frame_end( void )
     fuse_abort();
   }
 
+  sdldisplay_update_direct();
+
 #if VKEYBOARD
   if ( vkeyboard_enabled )
     ui_widget_print_vkeyboard();
@@ -1869,16 +1979,34 @@ uidisplay_frame_end( void )
     updated_rects[0].h = image_height;
   }
 
-  if ( !(ui_widget_level >= 0) && num_rects == 0 && !sdl_status_updated )
+  if ( !(ui_widget_level >= 0) && num_rects == 0 && !sdl_status_updated ) {
+    sdldisplay_direct_unlock();
     return;
+  }
   
   //Miyoo va bien el fullscreen pero no el status bar
   #ifdef MIYOO
+  if( !sdldisplay_direct )
     uidisplay_fullscreen();
   #endif
 
   if( SDL_MUSTLOCK( sdldisplay_gc ) ) SDL_LockSurface( sdldisplay_gc );
 
+  /* The display has already been drawn at its final size, so all that's
+     left is to say where */
+  if( sdldisplay_direct ) {
+    int i;
+
+    for( i = 0; i < num_rects; i++ ) {
+      updated_rects[i].x =
+        updated_rects[i].x * sdldisplay_direct_scale + fullscreen_x_off;
+      updated_rects[i].y =
+        updated_rects[i].y * sdldisplay_direct_scale + fullscreen_y_off;
+      updated_rects[i].w *= sdldisplay_direct_scale;
+      updated_rects[i].h *= sdldisplay_direct_scale;
+    }
+  }
+
 
 
   //Miyoo 
@@ -1941,6 +2069,7 @@ uidisplay_frame_end( void )
   }
 
   if( SDL_MUSTLOCK( sdldisplay_gc ) ) SDL_UnlockSurface( sdldisplay_gc );
+  sdldisplay_direct_unlock();
 
   /* Finally, blit all our changes to the screen */
 #ifdef GCWZERO
@@ -1988,6 +2117,8 @@ uidisplay_end( void )
 
   display_ui_initialised = 0;
 
+  sdldisplay_direct_unlock();
+
   if ( tmp_screen ) {
     free( tmp_screen->pixels );
     SDL_FreeSurface( tmp_screen ); tmp_screen = NULL;
@@ -614,7 +614,7 @@ svgadisplay_update_rect_scale( int x, int y, int w, int h )
 
   y = y * image_scale >> 2;
   x = x * image_scale >> 2;
-  scaler_proc16(
+  scaler_run16(
         (libspectrum_byte *)&(rgb_image[yy + 2][xx + 1]),
         rgb_pitch * sizeof(rgb_image[0][0]),
         (libspectrum_byte *)&(scaled_image[y][x]),
@@ -715,90 +715,40 @@ uidisplay_putpixel( int x, int y, int colour )
   }
 }
 
-/* Print the 8 pixels in `data' using ink colour `ink' and paper
-   colour `paper' to the screen at ( (8*x) , y ) */
+/* Print the `count' chunks of 8 pixels in `data' starting at
+   ( (8*x) , y ) */
 void
-uidisplay_plot8( int x, int y, libspectrum_byte data,
-	         libspectrum_byte ink, libspectrum_byte paper )
+uidisplay_plot8_run( int x, int y, int count, const libspectrum_byte *data,
+                     const libspectrum_byte *ink,
+                     const libspectrum_byte *paper )
 {
-  libspectrum_word *dest;
-  libspectrum_word pi = svgadisplay_depth == 4 ? ink :
-			( settings_current.bw_tv ? pal_grey[ ink ] :
-                        	pal_colour[ ink ] );
-  libspectrum_word pp = svgadisplay_depth == 4 ? paper :
-			( settings_current.bw_tv ? pal_grey[ paper ] :
-                        	pal_colour[ paper ] );
+  const libspectrum_word *palette = svgadisplay_depth == 4 ? NULL :
+                     ( settings_current.bw_tv ? pal_grey : pal_colour );
 
   if( machine_current->timex ) {
-
     x <<= 4; y <<= 1;
-
-    dest = &(rgb_image[y + 2][x + 1]);
-
-    *(dest + rgb_pitch) = *dest = ( data & 0x80 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x80 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x40 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x40 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x20 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x20 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x10 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x10 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x08 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x08 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x04 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x04 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x02 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x02 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x01 ) ? pi : pp; dest++;
-    *(dest + rgb_pitch) = *dest = ( data & 0x01 ) ? pi : pp;
   } else {
     x <<= 3;
-
-    dest = &(rgb_image[y + 2][x + 1]);
-
-    *(dest++) = ( data & 0x80 ) ? pi : pp;
-    *(dest++) = ( data & 0x40 ) ? pi : pp;
-    *(dest++) = ( data & 0x20 ) ? pi : pp;
-    *(dest++) = ( data & 0x10 ) ? pi : pp;
-    *(dest++) = ( data & 0x08 ) ? pi : pp;
-    *(dest++) = ( data & 0x04 ) ? pi : pp;
-    *(dest++) = ( data & 0x02 ) ? pi : pp;
-    *dest     = ( data & 0x01 ) ? pi : pp;
   }
+
+  uidisplay_plot_run16( &rgb_image[y + 2][x + 1], rgb_pitch, palette, count,
+                        data, ink, paper, 0 );
 }
 
-/* Print the 16 pixels in `data' using ink colour `ink' and paper
-   colour `paper' to the screen at ( (16*x) , y ) */
+/* Print the `count' chunks of 16 pixels in `data' starting at
+   ( (16*x) , y ) */
 void
-uidisplay_plot16( int x, int y, libspectrum_word data,
-                 libspectrum_byte ink, libspectrum_byte paper )
+uidisplay_plot16_run( int x, int y, int count, const libspectrum_byte *data,
+                      const libspectrum_byte *ink,
+                      const libspectrum_byte *paper )
 {
-  libspectrum_word *dest;
-  libspectrum_word pi = svgadisplay_depth == 4 ? ink :
-			( settings_current.bw_tv ? pal_grey[ ink ] :
-                        	pal_colour[ ink ] );
-  libspectrum_word pp = svgadisplay_depth == 4 ? paper :
-			( settings_current.bw_tv ? pal_grey[ paper ] :
-                        	pal_colour[ paper ] );
+  const libspectrum_word *palette = svgadisplay_depth == 4 ? NULL :
+                     ( settings_current.bw_tv ? pal_grey : pal_colour );
+
   x <<= 4; y <<= 1;
 
-  dest = &(rgb_image[y + 2][x + 1]);
-  *(dest + rgb_pitch) = *dest = ( data & 0x8000 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x4000 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x2000 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x1000 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0800 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0400 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0200 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0100 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0080 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0040 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0020 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0010 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0008 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0004 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0002 ) ? pi : pp; dest++;
-  *(dest + rgb_pitch) = *dest = ( data & 0x0001 ) ? pi : pp;
+  uidisplay_plot_run16( &rgb_image[y + 2][x + 1], rgb_pitch, palette, count,
+                        data, ink, paper, 1 );
 }
 
 int svgadisplay_end( void )
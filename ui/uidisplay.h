@@ -51,9 +51,43 @@ int uidisplay_end(void);
 void uidisplay_spectrum_screen( const libspectrum_byte *screen, int border );
 
 void uidisplay_putpixel( int x, int y, int colour );
+
+/* Plot `count' consecutive chunks on line `y', starting at chunk `x'. Chunk
+   x+i uses colours ink[i] and paper[i]; for plot8 its 8 pixels are in
+   data[i], for plot16 its 16 pixels are in data[2*i] and data[2*i+1] */
+void uidisplay_plot8_run( int x, int y, int count,
+                          const libspectrum_byte *data,
+                          const libspectrum_byte *ink,
+                          const libspectrum_byte *paper );
+void uidisplay_plot16_run( int x, int y, int count,
+                           const libspectrum_byte *data,
+                           const libspectrum_byte *ink,
+                           const libspectrum_byte *paper );
+
+/* Single chunk versions of the above */
 void uidisplay_plot8( int x, int y, libspectrum_byte data, libspectrum_byte ink,
                       libspectrum_byte paper );
 void uidisplay_plot16( int x, int y, libspectrum_word data, libspectrum_byte ink,
                        libspectrum_byte paper);
 
+/* Bitplane to pixel expansion shared by the UIs' plot routines */
+#define UIDISPLAY_MAX_EXPAND 4
+
+void uidisplay_expand16( libspectrum_word *dest, const libspectrum_byte *data,
+                         const libspectrum_word *ink,
+                         const libspectrum_word *paper, int count, int scale );
+void uidisplay_plot_run16( libspectrum_word *dest, int pitch,
+                           const libspectrum_word *palette, int count,
+                           const libspectrum_byte *data,
+                           const libspectrum_byte *ink,
+                           const libspectrum_byte *paper, int hires );
+void uidisplay_plot_run16_scaled( libspectrum_word *dest, int pitch,
+                                  const libspectrum_word *palette, int count,
+                                  const libspectrum_byte *data,
+                                  const libspectrum_byte *ink,
+                                  const libspectrum_byte *paper, int hires,
+                                  int scale );
+
+int uidisplay_expand_unittest( void );
+
 #endif			/* #ifndef FUSE_UIDISPLAY_H */
@@ -54,7 +54,7 @@ widget_pokefinder_draw( void *data )
 #if VKEYBOARD
   vkeyboard_enabled = 1;
 #endif
-  widget_dialog_with_border( 1, 2, 30, 12 );
+  widget_dialog_with_border( 1, 2, 30, 13 );
   widget_printstring( 10, 16, WIDGET_COLOUR_TITLE, title );
   widget_printstring( 16, 24, WIDGET_COLOUR_FOREGROUND, "Possible: " );
   widget_printstring( 16, 32, WIDGET_COLOUR_FOREGROUND, "Value: " );
@@ -66,8 +66,10 @@ widget_pokefinder_draw( void *data )
   widget_printstring( 16, 88, WIDGET_COLOUR_FOREGROUND,
 		      "\x0AI\x01nc'd \x0A" "D\x01" "ec'd \x0AS\x01" "earch" );
   widget_printstring( 16, 96, WIDGET_COLOUR_FOREGROUND, "\x0AR\x01" "eset \x0A" "C\x01lose" );
+  widget_printstring( 16, 104, WIDGET_COLOUR_FOREGROUND,
+		      "\x0A" "A\x01ltered \x0AN\x01ot altered \x0AW\x01ord" );
 
-  widget_display_lines( 2, 12 );
+  widget_display_lines( 2, 13 );
 
   return 0;
 }
@@ -143,7 +145,7 @@ display_value( void )
   char buf[16];
 
   snprintf( buf, sizeof( buf ), "%d", value );
-  widget_rectangle( 72, 32, 24, 8, WIDGET_COLOUR_BACKGROUND );
+  widget_rectangle( 72, 32, 40, 8, WIDGET_COLOUR_BACKGROUND );
   widget_printstring( 72, 32, WIDGET_COLOUR_FOREGROUND, buf );
   widget_display_lines( 4, 1 );
 }
@@ -199,12 +201,30 @@ widget_pokefinder_keyhandler( input_key key )
     display_possible();
     break;
 
-  case INPUT_KEY_d:		/* Search for incremented */
+  case INPUT_KEY_d:		/* Search for decremented */
     pokefinder_decremented();
     update_possible();
     display_possible();
     break;
 
+  case INPUT_KEY_a:		/* Search for changed */
+    pokefinder_changed();
+    update_possible();
+    display_possible();
+    break;
+
+  case INPUT_KEY_n:		/* Search for unchanged */
+    pokefinder_unchanged();
+    update_possible();
+    display_possible();
+    break;
+
+  case INPUT_KEY_w:		/* Search for a 16-bit value */
+    pokefinder_search_word( value );
+    update_possible();
+    display_possible();
+    break;
+
   case INPUT_KEY_Return:
   case INPUT_KEY_KP_Enter:
   case INPUT_KEY_s:		/* Search */
@@ -274,7 +294,8 @@ widget_pokefinder_keyhandler( input_key key )
   case INPUT_KEY_7:
   case INPUT_KEY_8:
   case INPUT_KEY_9:
-    value = (value % 100) * 10 + key - INPUT_KEY_0;
+    value = (value * 10 + key - INPUT_KEY_0) % 100000;
+    if( value > 0xffff ) value %= 10000;
     display_value();
     break;
 
@@ -23,16 +23,171 @@
 
 #include <config.h>
 
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <libspectrum.h>
 
 #include "display.h"
+#include "fuse.h"
 #include "machine.h"
 #include "ui/uidisplay.h"
 
+/* The bit of the data byte which gives each output pixel, for one to four
+   output pixels per bit */
+static const libspectrum_word expand_bits_1[8] = {
+  0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+};
+
+static const libspectrum_word expand_bits_2[16] = {
+  0x80, 0x80, 0x40, 0x40, 0x20, 0x20, 0x10, 0x10,
+  0x08, 0x08, 0x04, 0x04, 0x02, 0x02, 0x01, 0x01
+};
+
+static const libspectrum_word expand_bits_3[24] = {
+  0x80, 0x80, 0x80, 0x40, 0x40, 0x40, 0x20, 0x20,
+  0x20, 0x10, 0x10, 0x10, 0x08, 0x08, 0x08, 0x04,
+  0x04, 0x04, 0x02, 0x02, 0x02, 0x01, 0x01, 0x01
+};
+
+static const libspectrum_word expand_bits_4[32] = {
+  0x80, 0x80, 0x80, 0x80, 0x40, 0x40, 0x40, 0x40,
+  0x20, 0x20, 0x20, 0x20, 0x10, 0x10, 0x10, 0x10,
+  0x08, 0x08, 0x08, 0x08, 0x04, 0x04, 0x04, 0x04,
+  0x02, 0x02, 0x02, 0x02, 0x01, 0x01, 0x01, 0x01
+};
+
+static const libspectrum_word *expand_bits[ UIDISPLAY_MAX_EXPAND + 1 ] = {
+  NULL, expand_bits_1, expand_bits_2, expand_bits_3, expand_bits_4
+};
+
+/* Expand the `count' bytes in `data' to 8 * `scale' pixels each at `dest',
+   using ink[i] for set bits and paper[i] for reset bits of data[i]. `scale'
+   must be between 1 and UIDISPLAY_MAX_EXPAND */
+void
+uidisplay_expand16( libspectrum_word *dest, const libspectrum_byte *data,
+                    const libspectrum_word *ink, const libspectrum_word *paper,
+                    int count, int scale )
+{
+  const libspectrum_word *bits = expand_bits[ scale ];
+  int i, j;
+
+#ifdef __SSE2__
+
+  __m128i bit_masks[ UIDISPLAY_MAX_EXPAND ];
+
+  for( j = 0; j < scale; j++ )
+    bit_masks[j] = _mm_loadu_si128( (const __m128i*)( bits + 8 * j ) );
+
+  for( i = 0; i < count; i++ ) {
+    __m128i d = _mm_set1_epi16( data[i] );
+    __m128i fg = _mm_set1_epi16( ink[i] );
+    __m128i bg = _mm_set1_epi16( paper[i] );
+
+    for( j = 0; j < scale; j++ ) {
+      __m128i mask = _mm_cmpeq_epi16( _mm_and_si128( d, bit_masks[j] ),
+                                      bit_masks[j] );
+      _mm_storeu_si128( (__m128i*)dest,
+                        _mm_or_si128( _mm_and_si128( mask, fg ),
+                                      _mm_andnot_si128( mask, bg ) ) );
+      dest += 8;
+    }
+  }
+
+#else
+
+  int n = 8 * scale;
+
+  for( i = 0; i < count; i++ ) {
+    libspectrum_word fg = ink[i], bg = paper[i], diff = fg ^ bg;
+
+    /* Branch-free select of ink or paper */
+    for( j = 0; j < n; j++ )
+      dest[j] = bg ^ ( diff & -(libspectrum_word)!!( data[i] & bits[j] ) );
+
+    dest += n;
+  }
+
+#endif
+}
+
+/* Draw a run of `count' chunks into a 16-bit image, with `dest' pointing at
+   the top left pixel of the run and `pitch' pixels from one line to the
+   next. Colours are mapped through `palette', or used directly if it is
+   NULL. In hi-res mode, `data' holds two bytes per chunk, most significant
+   first; otherwise on Timex machines each pixel is drawn twice. On Timex
+   machines the line is then repeated below itself */
+void
+uidisplay_plot_run16( libspectrum_word *dest, int pitch,
+                      const libspectrum_word *palette, int count,
+                      const libspectrum_byte *data,
+                      const libspectrum_byte *ink,
+                      const libspectrum_byte *paper, int hires )
+{
+  uidisplay_plot_run16_scaled( dest, pitch, palette, count, data, ink, paper,
+                               hires, 1 );
+}
+
+/* As uidisplay_plot_run16(), but with every pixel additionally drawn as a
+   `scale' x `scale' block, for UIs which draw straight into a scaled
+   output surface */
+void
+uidisplay_plot_run16_scaled( libspectrum_word *dest, int pitch,
+                             const libspectrum_word *palette, int count,
+                             const libspectrum_byte *data,
+                             const libspectrum_byte *ink,
+                             const libspectrum_byte *paper, int hires,
+                             int scale )
+{
+  libspectrum_word ink_pixels[ 2 * DISPLAY_SCREEN_WIDTH_COLS ];
+  libspectrum_word paper_pixels[ 2 * DISPLAY_SCREEN_WIDTH_COLS ];
+  int i, bytes_per_chunk = hires ? 2 : 1;
+  int expand = ( machine_current->timex && !hires ? 2 : 1 ) * scale;
+  int lines = ( machine_current->timex ? 2 : 1 ) * scale;
+  int length = count * bytes_per_chunk;
+
+  for( i = 0; i < length; i++ ) {
+    int chunk = i / bytes_per_chunk;
+    ink_pixels[i] = palette ? palette[ ink[ chunk ] ] : ink[ chunk ];
+    paper_pixels[i] = palette ? palette[ paper[ chunk ] ] : paper[ chunk ];
+  }
+
+  uidisplay_expand16( dest, data, ink_pixels, paper_pixels, length, expand );
+
+  for( i = 1; i < lines; i++ )
+    memcpy( dest + i * pitch, dest, length * 8 * expand * sizeof( *dest ) );
+}
+
+/* Print the 8 pixels in `data' using ink colour `ink' and paper
+   colour `paper' to the screen at ( (8*x) , y ) */
+void
+uidisplay_plot8( int x, int y, libspectrum_byte data, libspectrum_byte ink,
+                 libspectrum_byte paper )
+{
+  uidisplay_plot8_run( x, y, 1, &data, &ink, &paper );
+}
+
+/* Print the 16 pixels in `data' using ink colour `ink' and paper
+   colour `paper' to the screen at ( (16*x) , y ) */
+void
+uidisplay_plot16( int x, int y, libspectrum_word data, libspectrum_byte ink,
+                  libspectrum_byte paper )
+{
+  libspectrum_byte bytes[2];
+
+  bytes[0] = data >> 8; bytes[1] = data & 0xff;
+  uidisplay_plot16_run( x, y, 1, bytes, &ink, &paper );
+}
+
 void uidisplay_spectrum_screen( const libspectrum_byte *screen, int border )
 {
   int x,y;
-  libspectrum_byte attr, data; int ink, paper;
+  libspectrum_byte ink[ DISPLAY_WIDTH_COLS ], paper[ DISPLAY_WIDTH_COLS ];
+  libspectrum_byte data[ DISPLAY_WIDTH_COLS ];
 
   int scale = machine_current->timex ? 2 : 1;
 
@@ -55,19 +210,65 @@ void uidisplay_spectrum_screen( const libspectrum_byte *screen, int border )
     for( x=0; x < DISPLAY_WIDTH_COLS; x++ ) {
 
       /* Get the attribute byte */
-      attr = screen[ display_attr_start[y] + x ];
+      libspectrum_byte attr = screen[ display_attr_start[y] + x ];
       
       /* Split it into (possibly bright) INK and PAPER */
-      ink = (attr & 0x07) + ( (attr & 0x40) >> 3 );
-      paper = (attr & ( 0x0f << 3 ) ) >> 3;
-
-      data = screen[ display_line_start[y]+x ];
+      ink[x] = (attr & 0x07) + ( (attr & 0x40) >> 3 );
+      paper[x] = (attr & ( 0x0f << 3 ) ) >> 3;
 
-      uidisplay_plot8( x + DISPLAY_BORDER_WIDTH_COLS, y + DISPLAY_BORDER_HEIGHT,
-                       data, ink, paper );
+      data[x] = screen[ display_line_start[y]+x ];
     }
+
+    uidisplay_plot8_run( DISPLAY_BORDER_WIDTH_COLS, y + DISPLAY_BORDER_HEIGHT,
+                         DISPLAY_WIDTH_COLS, data, ink, paper );
   }
 
   uidisplay_area( 0, 0, scale * DISPLAY_ASPECT_WIDTH,
 		  scale * DISPLAY_SCREEN_HEIGHT );
 }
+
+/* Check the expansion kernel against the obvious bit-by-bit version */
+int
+uidisplay_expand_unittest( void )
+{
+  libspectrum_byte data[ 2 * DISPLAY_SCREEN_WIDTH_COLS ];
+  libspectrum_word ink16[ 2 * DISPLAY_SCREEN_WIDTH_COLS ];
+  libspectrum_word paper16[ 2 * DISPLAY_SCREEN_WIDTH_COLS ];
+  libspectrum_word out16[ 2 * DISPLAY_SCREEN_WIDTH_COLS * 32 + 1 ];
+  libspectrum_dword seed = 0x12345678;
+  int count = 2 * DISPLAY_SCREEN_WIDTH_COLS, scale, i, j, r = 0;
+
+  for( i = 0; i < count; i++ ) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = i < 2 ? ( i ? 0xff : 0x00 ) : seed >> 16;
+    ink16[i] = seed >> 8; paper16[i] = ~seed;
+  }
+
+  for( scale = 1; scale <= UIDISPLAY_MAX_EXPAND; scale++ ) {
+    int n = 8 * scale;
+
+    /* Check we don't write past the end of the run */
+    out16[ count * n ] = 0x5a5a;
+
+    uidisplay_expand16( out16, data, ink16, paper16, count, scale );
+
+    for( i = 0; i < count; i++ ) {
+      for( j = 0; j < n; j++ ) {
+        int set = data[i] & ( 0x80 >> ( j / scale ) );
+        if( out16[ i * n + j ] != ( set ? ink16[i] : paper16[i] ) ) {
+          fprintf( stderr, "%s: uidisplay: expansion of 0x%02x at scale %d "
+                   "wrong at pixel %d\n", fuse_progname, data[i], scale, j );
+          return 1;
+        }
+      }
+    }
+
+    if( out16[ count * n ] != 0x5a5a ) {
+      fprintf( stderr, "%s: uidisplay: expansion overran at scale %d\n",
+               fuse_progname, scale );
+      r++;
+    }
+  }
+
+  return r;
+}
@@ -26,14 +26,20 @@
 
 #include <libspectrum.h>
 
+#include "bitmap.h"
+#include "compat.h"
 #include "debugger/debugger.h"
+#include "display.h"
+#include "event.h"
 #include "fuse.h"
 #include "machine.h"
 #include "mempool.h"
 #include "periph.h"
 #include "peripherals/disk/beta.h"
+#include "peripherals/disk/crc.h"
 #include "peripherals/disk/didaktik.h"
 #include "peripherals/disk/disciple.h"
+#include "peripherals/disk/fdd.h"
 #include "peripherals/disk/opus.h"
 #include "peripherals/disk/plusd.h"
 #include "peripherals/ide/divide.h"
@@ -47,7 +53,13 @@
 #include "peripherals/ttx2000s.h"
 #include "peripherals/ula.h"
 #include "peripherals/usource.h"
+#include "pokefinder/pokefinder.h"
+#include "rectangle.h"
+#include "rewind.h"
 #include "settings.h"
+#include "sound.h"
+#include "ui/scaler/scaler.h"
+#include "ui/uidisplay.h"
 #include "unittests.h"
 
 static int
@@ -143,6 +155,50 @@ contention_test( void )
   return error;
 }
 
+/* Looking up a whole port access's contention in one go must give the
+   same delay as doing the early and late halves separately, for every
+   class of port and at every point in the frame */
+static int
+port_contention_test( void )
+{
+  static const libspectrum_word ports[] = {
+    0x00fe, 0x00ff, 0x40fe, 0x40ff, 0x80fe, 0x80ff, 0xc0fe, 0xc0ff
+  };
+  libspectrum_dword old_tstates = tstates;
+  libspectrum_dword old_contention = ula_contention_tstates;
+  libspectrum_dword start, combined, combined_contention;
+  size_t i;
+  int error = 0;
+
+  for( i = 0; i < ARRAY_SIZE( ports ) && !error; i++ ) {
+    for( start = 0;
+         start < machine_current->timings.tstates_per_frame && !error;
+         start++ ) {
+      tstates = start; ula_contention_tstates = 0;
+      ula_contend_port( ports[i] );
+      combined = tstates; combined_contention = ula_contention_tstates;
+
+      tstates = start; ula_contention_tstates = 0;
+      ula_contend_port_early( ports[i] );
+      ula_contend_port_late( ports[i] );
+
+      if( tstates != combined ||
+          ula_contention_tstates != combined_contention ) {
+        printf( "%s: port contention test: port 0x%04x at %u took %u/%u "
+                "T-states, expected %u/%u\n", fuse_progname, ports[i], start,
+                tstates - start, ula_contention_tstates, combined - start,
+                combined_contention );
+        error = 1;
+      }
+    }
+  }
+
+  tstates = old_tstates;
+  ula_contention_tstates = old_contention;
+
+  return error;
+}
+
 static int
 floating_bus_test( void )
 {
@@ -309,6 +365,293 @@ mempool_test( void )
   return 0;
 }
 
+/* The WD1770's search for an ID address mark, as done by read_id() in
+   peripherals/disk/wd_fdc.c, with or without the jump over the bytes
+   before the next ID made by fdd_skip_to_id() */
+typedef struct fdd_skip_search_t {
+  int rev, mfm, skip;
+  libspectrum_word crc;
+  libspectrum_byte id[4];
+} fdd_skip_search_t;
+
+static libspectrum_dword fdd_skip_seed;
+
+static int
+fdd_skip_random( int n )
+{
+  fdd_skip_seed = fdd_skip_seed * 1103515245 + 12345;
+  return ( fdd_skip_seed >> 16 ) % n;
+}
+
+static int
+fdd_skip_read( fdd_t *d, fdd_skip_search_t *s )
+{
+  fdd_read_data( d );
+  if( d->index ) s->rev--;
+  s->crc = crc_fdc( s->crc, d->data & 0xff );
+
+  return d->data;
+}
+
+static int
+fdd_skip_read_id( fdd_t *d, fdd_skip_search_t *s )
+{
+  int i = s->rev, j;
+
+  if( s->rev <= 0 )
+    return 1;
+
+  while( i == s->rev ) {
+    if( s->skip && fdd_skip_to_id( d ) && d->index ) {
+      s->rev--;
+      continue;
+    }
+    s->crc = 0xffff;
+    if( s->mfm && ( fdd_skip_read( d, s ) != 0xffa1 ||
+                    fdd_skip_read( d, s ) != 0xffa1 ||
+                    fdd_skip_read( d, s ) != 0xffa1 ) )
+      continue;
+    if( fdd_skip_read( d, s ) != ( s->mfm ? 0x00fe : 0xfffe ) )
+      continue;
+    for( j = 0; j < 4; j++ ) s->id[j] = fdd_skip_read( d, s );
+    fdd_skip_read( d, s );
+    fdd_skip_read( d, s );
+    return s->crc ? 2 : 0;
+  }
+
+  return 1;
+}
+
+static void
+fdd_skip_put( fdd_t *d, int *pos, libspectrum_byte data, int clock )
+{
+  if( *pos >= d->c_bpt )
+    return;
+
+  d->disk.track[ *pos ] = data;
+  if( clock ) bitmap_set( d->disk.clocks, *pos );
+  (*pos)++;
+}
+
+/* Fill the current track with IDs at random places. Some have bad CRCs,
+   too few or too many 0xa1s or an FM mark in an MFM track, and there are
+   stray clock marked bytes between them and round the index hole */
+static void
+fdd_skip_track( fdd_t *d, int mfm )
+{
+  disk_t *disk = &d->disk;
+  int pos, n, j, sector;
+  libspectrum_word crc;
+  libspectrum_byte id[4];
+
+  for( pos = 0; pos < d->c_bpt; pos++ ) {
+    disk->track[ pos ] = mfm ? 0x4e : 0xff;
+    bitmap_reset( disk->clocks, pos );
+    bitmap_reset( disk->weak, pos );
+    if( mfm )
+      bitmap_reset( disk->fm, pos );
+    else
+      bitmap_set( disk->fm, pos );
+  }
+
+  for( pos = 0, sector = 1; pos < d->c_bpt - 50; sector++ ) {
+    pos += fdd_skip_random( 40 );
+
+    if( !fdd_skip_random( 8 ) ) {
+      n = fdd_skip_random( 6 );
+      for( j = 0; j < n; j++ )
+        fdd_skip_put( d, &pos, fdd_skip_random( 3 ) ?
+                                 0xa1 : fdd_skip_random( 256 ), 1 );
+      continue;
+    }
+
+    for( j = 0; j < ( mfm ? 12 : 6 ); j++ ) fdd_skip_put( d, &pos, 0x00, 0 );
+    crc = 0xffff;
+    if( mfm ) {
+      n = fdd_skip_random( 5 ) ? 3 : fdd_skip_random( 5 ) + 1;
+      for( j = 0; j < n; j++ ) fdd_skip_put( d, &pos, 0xa1, 1 );
+      for( j = 0; j < 3; j++ ) crc = crc_fdc( crc, 0xa1 );
+    }
+    fdd_skip_put( d, &pos, 0xfe, !mfm || !fdd_skip_random( 15 ) );
+    crc = crc_fdc( crc, 0xfe );
+
+    id[0] = fdd_skip_random( 80 ); id[1] = 0; id[2] = sector; id[3] = 2;
+    for( j = 0; j < 4; j++ ) {
+      fdd_skip_put( d, &pos, id[j], 0 );
+      crc = crc_fdc( crc, id[j] );
+    }
+    if( !fdd_skip_random( 10 ) ) crc ^= 1;
+    fdd_skip_put( d, &pos, crc >> 8, 0 );
+    fdd_skip_put( d, &pos, crc & 0xff, 0 );
+
+    pos += fdd_skip_random( 300 );
+  }
+
+  /* An ID whose sync bytes go round past the index hole */
+  if( mfm && !fdd_skip_random( 4 ) ) {
+    libspectrum_byte wrap[10] = { 0xa1, 0xa1, 0xa1, 0xfe, 0, 0, 0xf0, 2 };
+
+    crc = 0xffff;
+    for( j = 0; j < 8; j++ ) crc = crc_fdc( crc, wrap[j] );
+    wrap[8] = crc >> 8; wrap[9] = crc & 0xff;
+
+    pos = d->c_bpt - 1 - fdd_skip_random( 2 );
+    for( j = 0; j < 10; j++, pos++ ) {
+      if( pos == d->c_bpt ) pos = 0;
+      disk->track[ pos ] = wrap[j];
+      if( j < 3 )
+        bitmap_set( disk->clocks, pos );
+      else
+        bitmap_reset( disk->clocks, pos );
+    }
+  }
+
+  d->plain_end = 0;
+  disk_track_changed( disk );
+}
+
+/* Jumping to the next ID with fdd_skip_to_id() must find the same IDs,
+   with the head in the same place afterwards, as reading every byte.
+   Also check the time fdd_tstates_since() gives for the head to move */
+static int
+fdd_skip_test( void )
+{
+  fdd_t plain, skip;
+  fdd_skip_search_t a, b;
+  libspectrum_dword byte_tstates;
+  int i, n, r1, r2, mfm, bpt, error = 0;
+
+  memset( &skip, 0, sizeof( skip ) );
+  fdd_init( &skip, FDD_SHUGART, NULL, 0 );
+  TEST_ASSERT( disk_new( &skip.disk, 1, 40, DISK_DD, DISK_UDI ) == DISK_OK );
+  TEST_ASSERT( fdd_load( &skip, 0 ) == FDD_OK );
+  skip.selected = skip.ready = skip.loadhead = skip.motoron = 1;
+  bpt = skip.c_bpt;
+
+  fdd_skip_seed = 1;
+  for( i = 0; i < 500 && !error; i++ ) {
+    mfm = fdd_skip_random( 2 );
+    fdd_skip_track( &skip, mfm );
+    skip.disk.i = fdd_skip_random( bpt );
+    plain = skip;
+
+    memset( &a, 0, sizeof( a ) );
+    a.mfm = mfm;
+    a.rev = 1 + fdd_skip_random( 3 );
+    b = a;
+    b.skip = 1;
+
+    for( n = 0; n < 30 && a.rev > 0 && !error; n++ ) {
+      r1 = fdd_skip_read_id( &plain, &a );
+      r2 = fdd_skip_read_id( &skip, &b );
+      if( r1 != r2 || a.rev != b.rev || plain.disk.i != skip.disk.i ||
+          plain.index != skip.index ||
+          ( r1 != 1 && memcmp( a.id, b.id, sizeof( a.id ) ) ) ) {
+        printf( "%s: ID search %d/%d (%s) differs with fdd_skip_to_id(): "
+                "returned %d/%d, head at %d/%d\n", fuse_progname, i, n,
+                mfm ? "MFM" : "FM", r1, r2, plain.disk.i, skip.disk.i );
+        error = 1;
+      }
+    }
+  }
+
+  /* Even a single byte takes some time, and going round past the index
+     hole doesn't give a negative time */
+  byte_tstates = machine_current->timings.processor_speed / ( 5 * bpt );
+  skip.disk.i = 10;
+  if( !error && ( fdd_tstates_since( &skip, 10 ) != 0 ||
+                  fdd_tstates_since( &skip, 9 ) != byte_tstates ||
+                  byte_tstates == 0 ||
+                  fdd_tstates_since( &skip, bpt - 5 ) !=
+                    (libspectrum_qword)15 *
+                    machine_current->timings.processor_speed / ( 5 * bpt ) ) ) {
+    printf( "%s: fdd_tstates_since() gave the wrong time\n", fuse_progname );
+    error = 1;
+  }
+
+  disk_close( &skip.disk );
+
+  return error;
+}
+
+/* Decoding the tracks of a lazily loaded UDI image one at a time, in any
+   order, must give the same disk as decoding them all when it's opened */
+static int
+disk_lazy_load_test( void )
+{
+  disk_t image, eager, lazy, *d = &image;
+  char path[ PATH_MAX ];
+  int order[ 2 * 40 ];
+  int lazy_load = settings_current.disk_lazy_load;
+  int tracks, i, j, t, bpt, error = 0;
+  libspectrum_dword seed = 0x1234;
+
+  snprintf( path, PATH_MAX, "%s" FUSE_DIR_SEP_STR "fuse-disk-test.udi",
+            compat_get_temp_path() );
+
+  /* Tracks of various lengths, some of random data and some which will
+     compress well, with clock marks, FM and weak data here and there */
+  memset( &image, 0, sizeof( image ) );
+  TEST_ASSERT( disk_new( &image, 2, 40, DISK_DD, DISK_UDI ) == DISK_OK );
+  tracks = image.sides * image.cylinders;
+  for( i = 0; i < tracks; i++ ) {
+    DISK_SET_TRACK_IDX( d, i );
+    bpt = d->bpt - ( i % 3 ) * 100;
+    d->track[-3] = bpt & 0xff;
+    d->track[-2] = bpt >> 8;
+    for( j = 0; j < bpt; j++ ) {
+      seed = seed * 1103515245 + 12345;
+      d->track[j] = i % 2 ? seed >> 16 : 0x4e;
+      if( !( seed & 0x3f000 ) ) bitmap_set( d->clocks, j );
+      if( i % 5 == 0 && j < 100 ) bitmap_set( d->fm, j );
+      if( i % 7 == 0 && j >= 200 && j < 210 ) bitmap_set( d->weak, j );
+    }
+  }
+  error = disk_write( &image, path ) != DISK_OK;
+  disk_close( &image );
+  TEST_ASSERT( !error );
+
+  memset( &eager, 0, sizeof( eager ) );
+  memset( &lazy, 0, sizeof( lazy ) );
+  settings_current.disk_lazy_load = 0;
+  error = disk_open( &eager, path, 0, 0 ) != DISK_OK;
+  settings_current.disk_lazy_load = 1;
+  if( !error ) error = disk_open( &lazy, path, 0, 0 ) != DISK_OK;
+  settings_current.disk_lazy_load = lazy_load;
+  remove( path );
+  if( error ) {
+    printf( "%s: couldn't open the disk test image\n", fuse_progname );
+    if( eager.data ) disk_close( &eager );
+    return 1;
+  }
+
+  if( lazy.source == NULL ) {
+    printf( "%s: disk test image wasn't loaded lazily\n", fuse_progname );
+    error = 1;
+  }
+
+  for( i = 0; i < tracks; i++ ) order[i] = i;
+  for( i = tracks - 1; i > 0; i-- ) {
+    seed = seed * 1103515245 + 12345;
+    j = ( seed >> 16 ) % ( i + 1 );
+    t = order[i]; order[i] = order[j]; order[j] = t;
+  }
+  for( i = 0; i < tracks; i++ )
+    disk_decode_track( &lazy, order[i] );
+
+  if( !error && ( lazy.source != NULL || lazy.tlen != eager.tlen ||
+                  memcmp( lazy.data, eager.data, tracks * eager.tlen ) ) ) {
+    printf( "%s: lazily loaded disk differs from the eagerly loaded one\n",
+            fuse_progname );
+    error = 1;
+  }
+
+  disk_close( &eager );
+  disk_close( &lazy );
+
+  return error;
+}
+
 static int
 assert_page( libspectrum_word base, libspectrum_word length, int source, int page )
 {
@@ -783,11 +1126,26 @@ unittests_run( void )
   int r = 0;
 
   r += contention_test();
+  r += port_contention_test();
   r += floating_bus_test();
   r += floating_bus_merge_test();
+  r += periph_dispatch_unittest();
   r += mempool_test();
   r += paging_test();
+  r += debugger_breakpoint_unittest();
   r += debugger_disassemble_unittest();
+  r += display_raster_unittest();
+  r += pokefinder_unittest();
+  r += uidisplay_expand_unittest();
+  r += rectangle_unittest();
+  r += scaler_hq_unittest();
+  r += scaler_threads_unittest();
+  r += sound_ay_unittest();
+  r += rewind_unittest();
+  r += event_unittest();
+  r += fdd_unittest();
+  r += fdd_skip_test();
+  r += disk_lazy_load_test();
 
   printf("Final return value: %d (should be 0)\n", r);
 
@@ -32,7 +32,12 @@
 #ifdef HAVE_LIBGEN_H
 #include <libgen.h>
 #endif				/* #ifdef HAVE_LIBGEN_H */
+#include <fcntl.h>
 #include <string.h>
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#endif				/* #ifdef HAVE_MMAP */
+#include <sys/stat.h>
 #include <ui/ui.h>
 #include <unistd.h>
 
@@ -365,6 +370,7 @@ utils_read_fd( compat_fd fd, const char *filename, utils_file *file )
   if( file->length == -1 ) return 1;
 
   file->buffer = libspectrum_new( unsigned char, file->length );
+  file->mapped = 0;
 
   if( compat_file_read( fd, file ) ) {
     libspectrum_free( file->buffer );
@@ -382,9 +388,47 @@ utils_read_fd( compat_fd fd, const char *filename, utils_file *file )
   return 0;
 }
 
+/* As utils_read_file(), but map the file into memory rather than reading it
+   in where we can, saving copying it into a buffer of our own. The buffer
+   must not be written to, and must be closed before anything can change
+   the file */
+int
+utils_map_file( const char *filename, utils_file *file )
+{
+#ifdef HAVE_MMAP
+  struct stat info;
+  void *map;
+  int fd;
+
+  fd = open( filename, O_RDONLY );
+  if( fd != -1 ) {
+    if( !fstat( fd, &info ) && S_ISREG( info.st_mode ) && info.st_size > 0 ) {
+      map = mmap( NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+      if( map != MAP_FAILED ) {
+        close( fd );
+        file->buffer = map;
+        file->length = info.st_size;
+        file->mapped = 1;
+        return 0;
+      }
+    }
+    close( fd );
+  }
+#endif				/* #ifdef HAVE_MMAP */
+
+  return utils_read_file( filename, file );
+}
+
 void
 utils_close_file( utils_file *file )
 {
+#ifdef HAVE_MMAP
+  if( file->mapped ) {
+    munmap( file->buffer, file->length );
+    return;
+  }
+#endif				/* #ifdef HAVE_MMAP */
+
   libspectrum_free( file->buffer );
 }
 
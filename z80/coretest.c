@@ -420,6 +420,12 @@ profile_map( libspectrum_word pc GCC_UNUSED )
   abort();
 }
 
+void
+profile_interrupt( void )
+{
+  abort();
+}
+
 int
 debugger_check( debugger_breakpoint_type type GCC_UNUSED, libspectrum_dword value GCC_UNUSED )
 {
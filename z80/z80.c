@@ -34,6 +34,7 @@
 #include "module.h"
 #include "peripherals/scld.h"
 #include "peripherals/spectranet.h"
+#include "profile.h"
 #include "rzx.h"
 #include "settings.h"
 #include "spectrum.h"
@@ -208,6 +209,8 @@ z80_interrupt( void )
 
     writebyte( --SP, PCH ); writebyte( --SP, PCL );
 
+    if( profile_active ) profile_interrupt();
+
     switch(IM) {
       case 0:
         /* We assume 0xff (RST 38) is on the data bus, as the Spectrum leaves
@@ -261,6 +264,8 @@ z80_nmi( libspectrum_dword ts, int type, void *user_data )
 
   writebyte( --SP, PCH ); writebyte( --SP, PCL );
 
+  if( profile_active ) profile_interrupt();
+
   /* TODO: check whether any of these should occur before PC is pushed. */
   if( machine_current->capabilities &
       LIBSPECTRUM_MACHINE_CAPABILITY_SCORP_MEMORY ) {
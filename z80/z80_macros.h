@@ -108,17 +108,17 @@
 
 #define contend_read(address,time) \
   if( memory_map_read[ (address) >> MEMORY_PAGE_SIZE_LOGARITHM ].contended ) \
-    tstates += ula_contention[ tstates ]; \
+    ula_contend( ula_contention ); \
   tstates += (time);
 
 #define contend_read_no_mreq(address,time) \
   if( memory_map_read[ (address) >> MEMORY_PAGE_SIZE_LOGARITHM ].contended ) \
-    tstates += ula_contention_no_mreq[ tstates ]; \
+    ula_contend( ula_contention_no_mreq ); \
   tstates += (time);
 
 #define contend_write_no_mreq(address,time) \
   if( memory_map_write[ (address) >> MEMORY_PAGE_SIZE_LOGARITHM ].contended ) \
-    tstates += ula_contention_no_mreq[ tstates ]; \
+    ula_contend( ula_contention_no_mreq ); \
   tstates += (time);
 
 #else				/* #ifndef CORETEST */
@@ -116,6 +116,9 @@ z80_do_opcodes( void )
   libspectrum_byte opcode = 0x00;
 #endif
   libspectrum_byte last_Q;
+#ifndef CORETEST
+  const memory_page *fetch_page;
+#endif				/* #ifndef CORETEST */
 
   int even_m1 =
     machine_current->capabilities & LIBSPECTRUM_MACHINE_CAPABILITY_EVEN_M1; 
@@ -262,7 +265,16 @@ z80_do_opcodes( void )
 
   opcode_delay:
 
+#ifndef CORETEST
+    /* Look up the page holding the opcode once and use it for both the
+       M1 contention and the fetch itself */
+    fetch_page = &memory_map_read[ PC >> MEMORY_PAGE_SIZE_LOGARITHM ];
+
+    if( fetch_page->contended ) ula_contend( ula_contention );
+    tstates += 4;
+#else				/* #ifndef CORETEST */
     contend_read( PC, 4 );
+#endif				/* #ifndef CORETEST */
 
     /* Check to see if M1 cycles happen on even tstates */
     CHECK( evenm1, even_m1 )
@@ -278,7 +290,11 @@ z80_do_opcodes( void )
   run_opcode:
     /* Do the instruction fetch; readbyte_internal used here to avoid
        triggering read breakpoints */
+#ifndef CORETEST
+    opcode = fetch_page->page[ PC & MEMORY_PAGE_SIZE_MASK ];
+#else				/* #ifndef CORETEST */
     opcode = readbyte_internal( PC );
+#endif				/* #ifndef CORETEST */
 
     CHECK( if1u, if1_available )
 